@@ -37,6 +37,34 @@ void os_file_init()
 #endif
 }
 
+#ifndef __WIN__
+// Turns on O_DIRECT for file and probes it by an aligned read,
+// some file systems (e.g. tmpfs) reject O_DIRECT, the file is kept in buffered i/o for them.
+static void os_file_try_direct_io(os_file_t file)
+{
+    int flags = fcntl(file, F_GETFL);
+    if (flags == -1 || fcntl(file, F_SETFL, flags | O_DIRECT) == -1) {
+        return;
+    }
+
+    byte probe_buf[OS_FILE_DIRECT_IO_BLOCK_SIZE * 2];
+    byte* buf = (byte *)ut_align_up(probe_buf, OS_FILE_DIRECT_IO_BLOCK_SIZE);
+    if (pread(file, buf, OS_FILE_DIRECT_IO_BLOCK_SIZE, 0) == -1) {
+        fcntl(file, F_SETFL, flags);
+    }
+}
+#endif
+
+bool32 os_file_is_direct_io(os_file_t file)
+{
+#ifdef __WIN__
+    return FALSE;
+#else
+    int flags = fcntl(file, F_GETFL);
+    return flags != -1 && (flags & O_DIRECT);
+#endif
+}
+
 bool32 os_open_file(char *name, uint32 create_mode, uint32 purpose, os_file_t *file)
 {
     bool32 success = TRUE;
@@ -60,10 +88,11 @@ bool32 os_open_file(char *name, uint32 create_mode, uint32 purpose, os_file_t *f
         ut_error;
     }
 
-    if (purpose == OS_FILE_AIO) {
+    if (purpose & OS_FILE_AIO) {
         /* use asynchronous (overlapped) io and no buffering of writes in the OS */
         attributes |= FILE_FLAG_OVERLAPPED;
     }
+    // OS_FILE_DIRECT_IO is ignored, FILE_FLAG_NO_BUFFERING requires sector aligned i/o
 
     *file = CreateFile(name,
         GENERIC_READ | GENERIC_WRITE, /* read and write access */
@@ -88,7 +117,7 @@ bool32 os_open_file(char *name, uint32 create_mode, uint32 purpose, os_file_t *f
         ut_error;
     }
 
-    if (purpose == OS_FILE_SYNC) {
+    if (purpose & OS_FILE_SYNC) {
         create_flag = create_flag | O_SYNC;
     }
 
@@ -97,6 +126,10 @@ bool32 os_open_file(char *name, uint32 create_mode, uint32 purpose, os_file_t *f
     } else {
         *file = open(name, create_flag);
     }
+
+    if (*file != OS_FILE_INVALID_HANDLE && (purpose & OS_FILE_DIRECT_IO)) {
+        os_file_try_direct_io(*file);
+    }
 #endif
 
     if (*file == OS_FILE_INVALID_HANDLE) {
@@ -382,6 +415,8 @@ void os_file_get_error_desc_by_err(int32 err, char *desc, uint32 size)
         sprintf_s(desc, size, "OS_FILE_IO_ABANDONED");
     } else if (err == OS_FILE_IO_WAIT_FAILED) {
         sprintf_s(desc, size, "OS_FILE_IO_WAIT_FAILED");
+    } else if (err == OS_FILE_OPERATION_NOT_SUPPORTED) {
+        sprintf_s(desc, size, "OS_FILE_OPERATION_NOT_SUPPORTED");
     } else {
         sprintf_s(desc, size, "unknow error %d", err);
     }
@@ -410,6 +445,8 @@ int32 os_file_get_last_error()
         return OS_FILE_PATH_NOT_FOUND;
     } else if (err == ERROR_ACCESS_DENIED) {
         return OS_FILE_ACCESS_DENIED;
+    } else if (err == ERROR_NOT_SUPPORTED) {
+        return OS_FILE_OPERATION_NOT_SUPPORTED;
     } else {
         return 100 + err;
     }
@@ -425,6 +462,8 @@ int32 os_file_get_last_error()
         return(OS_FILE_ALREADY_EXISTS);
     } else if (err == EACCES) {
         return OS_FILE_ACCESS_DENIED;
+    } else if (err == EOPNOTSUPP || err == ENOSYS) {
+        return OS_FILE_OPERATION_NOT_SUPPORTED;
     } else {
         return 100 + err;
     }
@@ -493,6 +532,35 @@ error_handling:
     return FALSE;
 }
 
+// Allocates a zero-filled range of file without writing data,
+// returns FALSE with OS_FILE_OPERATION_NOT_SUPPORTED if the file system does not support it
+bool32 os_file_fallocate(os_file_t file, uint64 offset, uint64 len)
+{
+#ifdef __WIN__
+    SetLastError(ERROR_NOT_SUPPORTED);
+    return FALSE;
+#else
+#ifdef FALLOC_FL_ZERO_RANGE
+    if (fallocate(file, FALLOC_FL_ZERO_RANGE, (off_t)offset, (off_t)len) == 0) {
+        return TRUE;
+    }
+    if (errno != EOPNOTSUPP && errno != ENOSYS) {
+        return FALSE;
+    }
+#endif
+    // the range beyond end of file always reads as zeros
+    uint64 file_size;
+    if (!os_file_get_size(file, &file_size)) {
+        return FALSE;
+    }
+    if (offset < file_size) {
+        errno = EOPNOTSUPP;
+        return FALSE;
+    }
+    return fallocate(file, 0, (off_t)offset, (off_t)len) == 0;
+#endif
+}
+
 bool32 os_file_get_size(os_file_t file, uint64 *size)
 {
 #ifdef __WIN__
@@ -710,6 +778,8 @@ static os_aio_slot_t* os_aio_context_alloc_slot(
     os_file_t         file,   /* in: file handle */
     const char*       name,   /* in: name of the file or path as a null-terminated string */
     void*             buf,    /* in: buffer where to read or from which to write */
+    os_iovec_t*       iov,    /* in: buffers for vectored i/o, NULL if buf is used */
+    uint32            iov_count, /* in: number of buffers in iov */
     uint64            offset, /* in: file offset */
     uint32            len,    /* in: length of the block to read or write */
     aio_slot_func     slot_func,
@@ -754,6 +824,8 @@ loop:
     slot->name      = name;
     slot->type      = type;
     slot->buf       = (byte*)buf;
+    slot->iov       = iov;
+    slot->iov_count = iov_count;
     slot->offset    = offset;
 
 #ifdef __WIN__
@@ -766,7 +838,14 @@ loop:
     aio_offset = (off_t) offset;
 
     iocb = &slot->control;
-    if (type == OS_FILE_READ) {
+    if (iov != NULL) {
+        if (type == OS_FILE_READ) {
+            io_prep_preadv(iocb, file, iov, (int)iov_count, aio_offset);
+        } else {
+            ut_a(type == OS_FILE_WRITE);
+            io_prep_pwritev(iocb, file, iov, (int)iov_count, aio_offset);
+        }
+    } else if (type == OS_FILE_READ) {
         io_prep_pread(iocb, file, buf, len, aio_offset);
     } else {
         ut_a(type == OS_FILE_WRITE);
@@ -788,6 +867,8 @@ void os_aio_context_free_slot(os_aio_slot_t* slot)
 
     ut_ad(slot->is_used);
     slot->is_used = FALSE;
+    slot->iov = NULL;
+    slot->iov_count = 0;
 
 #ifdef __WIN__
     ResetEvent(slot->handle);
@@ -1007,7 +1088,7 @@ os_aio_slot_t* os_file_aio_submit(
     ut_ad(type == OS_FILE_READ || type == OS_FILE_WRITE);
 
     slot = os_aio_context_alloc_slot(context, type,
-        file, name, buf, offset, count, slot_func, message1, message2);
+        file, name, buf, NULL, 0, offset, count, slot_func, message1, message2);
 
 #ifdef __WIN__
 
@@ -1055,6 +1136,56 @@ os_aio_slot_t* os_file_aio_submit(
     return NULL;
 }
 
+os_aio_slot_t* os_file_aio_submitv(
+    os_aio_context_t* context,
+    uint32            type,      /* in: OS_FILE_READ or OS_FILE_WRITE */
+    const char*       name,      /* in: name of the file or path as a null-terminated string */
+    os_file_t         file,      /* in: handle to a file */
+    os_iovec_t*       iov,       /* in: buffers where to read or from which to write */
+    uint32            iov_count, /* in: number of buffers */
+    uint64            offset,    /* in: file offset where to read or write */
+    aio_slot_func     slot_func,
+    void*             message1,  /* in: message to be passed along with the aio operation */
+    void*             message2)  /* in: message to be passed along with the aio operation */
+{
+    os_aio_slot_t*  slot;
+    uint32          count = 0;
+
+    ut_ad(type == OS_FILE_READ || type == OS_FILE_WRITE);
+    ut_a(iov_count > 0 && iov_count <= OS_AIO_IOV_MAX_COUNT);
+
+    if (iov_count == 1) {
+        return os_file_aio_submit(context, type, name, file, iov[0].iov_base,
+            (uint32)iov[0].iov_len, offset, slot_func, message1, message2);
+    }
+
+#ifdef __WIN__
+
+    // ReadFileScatter/WriteFileGather need unbuffered i/o with page-aligned buffers,
+    // callers must split the request into single buffers on windows
+    SetLastError(ERROR_NOT_SUPPORTED);
+    return NULL;
+
+#else
+
+    for (uint32 i = 0; i < iov_count; i++) {
+        count += (uint32)iov[i].iov_len;
+    }
+
+    slot = os_aio_context_alloc_slot(context, type,
+        file, name, NULL, iov, iov_count, offset, count, slot_func, message1, message2);
+
+    if (os_aio_linux_submit(context, slot)) {
+        // aio was queued successfully
+        return slot;
+    }
+
+    os_aio_context_free_slot(slot);
+
+    return NULL;
+
+#endif // __WIN__
+}
 
 // Waits for an aio operation to complete.
 int32 os_file_aio_slot_wait(os_aio_slot_t* slot, uint32 timeout_us)
@@ -86,6 +86,17 @@ void os_thread_yield(void)
 #endif
 }
 
+/*Returns the processor which the calling thread is running on. */
+uint32 os_thread_get_cpu_id(void)
+{
+#ifdef __WIN__
+    return (uint32)GetCurrentProcessorNumber();
+#else
+    int cpu = sched_getcpu();
+    return cpu < 0 ? (uint32)g_thread_internal_id : (uint32)cpu;
+#endif
+}
+
 /*The thread sleeps at least the time given in microseconds. */
 void os_thread_sleep(unsigned int microseconds)  /* in: time in microseconds */
 {
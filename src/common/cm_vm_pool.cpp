@@ -418,7 +418,8 @@ status_t vm_pool_add_file(vm_pool_t *pool, char *name, uint64 size)
 
 #ifdef __WIN__
     for (uint32 i = 0; i <= VM_FILE_HANDLE_COUNT; i++) {
-        ret = os_open_file(name, i == 0 ? OS_FILE_CREATE : OS_FILE_OPEN, OS_FILE_AIO, &vm_file->handle[i]);
+        ret = os_open_file(name, i == 0 ? OS_FILE_CREATE : OS_FILE_OPEN,
+            OS_FILE_AIO | (pool->is_direct_io ? OS_FILE_DIRECT_IO : 0), &vm_file->handle[i]);
         if (ret == FALSE) {
             char err_info[CM_ERR_MSG_MAX_LEN];
             os_file_get_last_error_desc(err_info, CM_ERR_MSG_MAX_LEN);
@@ -428,7 +429,8 @@ status_t vm_pool_add_file(vm_pool_t *pool, char *name, uint64 size)
         }
     }
 #else
-    ret = os_open_file(name, OS_FILE_CREATE, OS_FILE_AIO, &vm_file->handle[0]);
+    ret = os_open_file(name, OS_FILE_CREATE,
+        OS_FILE_AIO | (pool->is_direct_io ? OS_FILE_DIRECT_IO : 0), &vm_file->handle[0]);
     if (ret == FALSE) {
         char err_info[CM_ERR_MSG_MAX_LEN];
         os_file_get_last_error_desc(err_info, CM_ERR_MSG_MAX_LEN);
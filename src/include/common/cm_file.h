@@ -6,6 +6,7 @@
 #include "cm_mutex.h"
 
 #ifndef __WIN__
+#include <sys/uio.h>
 #include <libaio.h>
 #endif
 
@@ -23,6 +24,11 @@ extern "C" {
 // Options for file_create
 #define OS_FILE_AIO                         1
 #define OS_FILE_SYNC                        2
+// bypass the OS page cache, buffers, offsets and lengths of i/o must be aligned
+// to OS_FILE_DIRECT_IO_BLOCK_SIZE; falls back to buffered i/o if file system rejects it
+#define OS_FILE_DIRECT_IO                   0x100
+
+#define OS_FILE_DIRECT_IO_BLOCK_SIZE        512
 
 
 #define OS_FILE_IO_INPROCESS                (-1)
@@ -39,6 +45,7 @@ extern "C" {
 #define OS_FILE_IO_TIMEOUT                  8
 #define OS_FILE_IO_ABANDONED                9
 #define OS_FILE_IO_WAIT_FAILED              10
+#define OS_FILE_OPERATION_NOT_SUPPORTED     11
 
 
 /* io type */
@@ -71,6 +78,8 @@ extern void os_file_get_error_desc_by_err(int32 err, char *desc, uint32 size);
 extern bool32 os_file_handle_error(const char *name, const char* operation, bool32 should_exit);
 extern bool32 os_file_get_size(os_file_t file, uint64 *size);
 extern bool32 os_file_extend(char *file_name, os_file_t file, uint64 extend_size);
+extern bool32 os_file_fallocate(os_file_t file, uint64 offset, uint64 len);
+extern bool32 os_file_is_direct_io(os_file_t file);
 extern bool32 os_file_status(const char* path, bool32 *exists, os_file_type_t *type);
 extern bool32 os_file_rename(const char* oldpath, const char* newpath);
 extern bool32 os_file_set_eof(os_file_t file);
@@ -87,6 +96,18 @@ extern int32 get_file_size(char  *file_name, long long *file_byte_size);
 // windows MAXIMUM_WAIT_OBJECTS does not allow more than 64
 #define OS_AIO_N_PENDING_IOS_PER_THREAD     64
 
+// maximum number of buffers in one vectored aio request
+#define OS_AIO_IOV_MAX_COUNT                256
+
+#ifdef __WIN__
+typedef struct st_os_iovec {
+    void*     iov_base;
+    size_t    iov_len;
+} os_iovec_t;
+#else
+typedef struct iovec os_iovec_t;
+#endif
+
 #define AIO_SLOT_IS_IO_INPROCESS(slot)      (slot->ret == OS_FILE_IO_INPROCESS)
 #define AIO_SLOT_IS_IO_COMPLETION(slot)     (slot->ret == OS_FILE_IO_COMPLETION)
 
@@ -105,6 +126,8 @@ struct st_os_aio_slot {
     os_file_t       file;       /* file where to read or write */
     bool32          is_used;    /* TRUE if this slot is used */
     byte*           buf;        /* buffer used in i/o */
+    os_iovec_t*     iov;        /* buffers used in vectored i/o, NULL if buf is used */
+    uint32          iov_count;  /* number of buffers in iov */
     time_t          used_time;  /*!< time when used */
     uint32          type;       /* OS_FILE_READ or OS_FILE_WRITE */
     uint64          offset;     /* file offset in bytes */
@@ -175,6 +198,20 @@ extern os_aio_slot_t* os_file_aio_submit(
     void*             message1 = NULL,  /* in: message to be passed along with the aio operation */
     void*             message2 = NULL); /* in: message to be passed along with the aio operation */
 
+// Vectored version of os_file_aio_submit, the buffers of iov are read or written
+// contiguously from offset, iov must be valid until the aio is completed.
+extern os_aio_slot_t* os_file_aio_submitv(
+    os_aio_context_t* context,
+    uint32            type,      /* in: OS_FILE_READ or OS_FILE_WRITE */
+    const char*       name,      /* in: name of the file or path as a null-terminated string */
+    os_file_t         file,      /* in: handle to a file */
+    os_iovec_t*       iov,       /* in: buffers where to read or from which to write */
+    uint32            iov_count, /* in: number of buffers, not more than OS_AIO_IOV_MAX_COUNT */
+    uint64            offset,    /* in: file offset where to read or write */
+    aio_slot_func     slot_func = NULL,
+    void*             message1 = NULL,  /* in: message to be passed along with the aio operation */
+    void*             message2 = NULL); /* in: message to be passed along with the aio operation */
+
 extern int32 os_file_aio_slot_wait(os_aio_slot_t* slot, uint32 timeout_us);
 
 //Waits for an aio operation to complete.
@@ -92,6 +92,7 @@ extern inline os_thread_t os_thread_get_curr(void);
 extern inline uint32 os_thread_get_last_error(void);
 
 extern void os_thread_yield(void);
+extern uint32 os_thread_get_cpu_id(void);
 extern void os_thread_sleep(unsigned int microseconds);
 extern uint64 os_thread_delay(uint64 delay);
 
@@ -93,11 +93,15 @@ but not format or unused which we use quite a lot.
 #elif defined(HAVE_IB_GCC_ATOMIC_THREAD_FENCE)
 #define os_rmb          __atomic_thread_fence(__ATOMIC_ACQUIRE)
 #define os_wmb          __atomic_thread_fence(__ATOMIC_RELEASE)
-#define os_mb           __atomic_thread_fence()
+#define os_mb           __atomic_thread_fence(__ATOMIC_SEQ_CST)
 #elif defined(HAVE_IB_GCC_SYNC_SYNCHRONISE)
 #define os_rmb          __sync_synchronize()
 #define os_wmb          __sync_synchronize()
-#define os_mmb          __sync_synchronize()
+#define os_mb           __sync_synchronize()
+#elif defined(__GNUC__)
+#define os_rmb          __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define os_wmb          __atomic_thread_fence(__ATOMIC_RELEASE)
+#define os_mb           __atomic_thread_fence(__ATOMIC_SEQ_CST)
 #else
 #define os_rmb
 #define os_wmb
@@ -115,6 +115,7 @@ struct vm_pool_t {
     vm_file_t        vm_files[VM_FILE_COUNT];
 
     os_aio_array_t  *aio_array;
+    bool32           is_direct_io; // swap files bypass the OS page cache
 
     vm_free_ctrls_t  free_ctrl_list[VM_FREE_CTRL_LIST_COUNT];
     vm_free_pages_t  free_page_list[VM_FREE_PAGE_LIST_COUNT];
@@ -5,7 +5,9 @@
 #include "cm_memory.h"
 #include "cm_attribute.h"
 #include "knl_session.h"
+#include "knl_btree.h"
 #include "knl_heap.h"
+#include "knl_heap_toast.h"
 #include "knl_trx.h"
 
 enum ha_rkey_function {
@@ -72,6 +74,85 @@ typedef struct st_scan_key
     Datum     argument; // data to compare
 } scan_key_t;
 
+// Operators of pushed down filter, a comparison is UNKNOWN if the column is null,
+// and UNKNOWN is handled as FALSE since there is no NOT operator.
+typedef enum en_scan_filter_op {
+    SCAN_FILTER_EQ = 0,
+    SCAN_FILTER_NE,
+    SCAN_FILTER_LT,
+    SCAN_FILTER_LE,
+    SCAN_FILTER_GT,
+    SCAN_FILTER_GE,
+    SCAN_FILTER_IS_NULL,
+    SCAN_FILTER_IS_NOT_NULL,
+    SCAN_FILTER_AND,
+    SCAN_FILTER_OR,
+} scan_filter_op_t;
+
+// an instruction of filter program, instructions are in postfix order
+typedef struct st_scan_filter_inst {
+    uint8         op;
+    uint8         reserved;
+    uint16        column_id;
+    uint16        value_len;
+    const byte*   value;  // in the format of column data in row, integers in native byte order
+} scan_filter_inst_t;
+
+#define SCAN_FILTER_MAX_INSTS   32
+
+typedef struct st_scan_filter {
+    uint16        inst_count;
+    uint16        depth;  // depth of evaluation stack after last instruction
+    uint16        column_count;  // columns to be decoded, max column id + 1
+    scan_filter_inst_t insts[SCAN_FILTER_MAX_INSTS];
+} scan_filter_t;
+
+inline void scan_filter_init(scan_filter_t* filter)
+{
+    filter->inst_count = 0;
+    filter->depth = 0;
+    filter->column_count = 0;
+}
+
+// column op value, or column IS [NOT] NULL with value is NULL
+inline bool32 scan_filter_add_column(scan_filter_t* filter, scan_filter_op_t op,
+    uint16 column_id, const byte* value, uint16 value_len)
+{
+    if (filter->inst_count >= SCAN_FILTER_MAX_INSTS || op > SCAN_FILTER_IS_NOT_NULL) {
+        return FALSE;
+    }
+
+    scan_filter_inst_t* inst = &filter->insts[filter->inst_count++];
+    inst->op = (uint8)op;
+    inst->column_id = column_id;
+    inst->value = value;
+    inst->value_len = value_len;
+    filter->depth++;
+    if (column_id >= filter->column_count) {
+        filter->column_count = column_id + 1;
+    }
+
+    return TRUE;
+}
+
+// combines the results of last two predicates
+inline bool32 scan_filter_add_logic(scan_filter_t* filter, scan_filter_op_t op)
+{
+    if (filter->inst_count >= SCAN_FILTER_MAX_INSTS || filter->depth < 2 ||
+        (op != SCAN_FILTER_AND && op != SCAN_FILTER_OR)) {
+        return FALSE;
+    }
+
+    scan_filter_inst_t* inst = &filter->insts[filter->inst_count++];
+    inst->op = (uint8)op;
+    inst->column_id = 0;
+    inst->value = NULL;
+    inst->value_len = 0;
+    filter->depth--;
+
+    return TRUE;
+}
+
 typedef enum en_scan_cursor_action {
     CURSOR_ACTION_FOR_UPDATE_SCAN = 1,
     CURSOR_ACTION_SELECT = 2,
@@ -161,10 +242,29 @@ typedef struct st_snapshot
 } snapshot_t;
 
 
+typedef struct st_heap_parallel_scan heap_parallel_scan_t;
+
+// rows returned by a batched fetch, arrays and buffer are provided by caller
+typedef struct st_heap_row_vector {
+    uint32          max_count;  // capacity of row_ids, rows and lens
+    uint32          count;      // number of rows returned
+    row_id_t*       row_ids;
+    row_header_t**  rows;       // point to cached page of cursor or buf, valid until next fetch
+    uint16*         lens;
+    char*           buf;        // for rows of older version, at least one max row size
+    uint32          buf_size;
+    uint32          buf_used;
+} heap_row_vector_t;
+
+
 class scan_cursor_t : public BaseObject {
 public:
     scan_cursor_t(memory_stack_context_t* mcontext_stack)
     {
+        pscan = NULL;
+        filter = NULL;
+        zone_extent_no = UINT32_UNDEFINED;
+        zone_extent_match = TRUE;
         reset_memory_stack_context(mcontext_stack);
     }
 
@@ -196,14 +296,12 @@ public:
     char*           cache_page_buf; // a copy of page for select
 
     // btree position
-    uint32          old_stored; /*!< BTR_PCUR_OLD_STORED or BTR_PCUR_OLD_NOT_STORED */
-    rec_t*          old_rec; /*!< if cursor position is stored, contains an initial segment of the
-                                latest record cursor was positioned either on, before, or after */
-    uint32          old_n_fields;  /*!< number of fields in old_rec */
-    uint32          rel_pos; /*!< BTR_PCUR_ON, BTR_PCUR_BEFORE, or BTR_PCUR_AFTER,
-                  depending on whether cursor was on, before, or after the old_rec record */
-    buf_block_t*    block_when_stored;/* buffer block when the position was stored */
-    uint64          modify_clock; /*!< the modify clock value of the buffer block when the cursor position was stored */
+    btr_pcur_t      btr_pcur;
+    // range of index scan built from keys, value mode is BTR_VALUE_MIN or BTR_VALUE_MAX
+    btr_key_t       btr_low_key;
+    btr_key_t       btr_high_key;
+    int32           btr_low_mode;
+    int32           btr_high_mode;
 
 public:
     scan_key_t*     keys;
@@ -235,6 +333,9 @@ public:
     //update_node_t*  update_node; // SQL update node used to perform updates and deletes
 
     /*----------------------*/
+    scan_filter_t*  filter; // pushed down filter of heap scan, NULL if not used, set by heap_push_filter
+    uint32          zone_extent_no;    // extent of the last zone map check of serial scan
+    bool32          zone_extent_match; // filter may match rows of zone_extent_no
     void*           idx_cond;  // In ICP, NULL if index condition pushdown is not used
     uint32          idx_cond_n_cols; // Number of fields in idx_cond_cols. 0 if and only if idx_cond == NULL.
 
@@ -249,6 +350,8 @@ public:
 
     uint32          select_lock_type;// LOCK_NONE, LOCK_S, or LOCK_X
 
+    heap_parallel_scan_t* pscan; // not NULL if rows are fetched from parallel scan workers
+
     void*           m_mcontext_stack_save_ptr;
     memory_stack_context_t* m_mcontext_stack;
 };
@@ -311,6 +414,9 @@ public:
     void rollback(que_sess_t* sess, trx_savepoint_t* savepoint = NULL);
     void commit(que_sess_t* sess);
 
+    // undo committed after the snapshot of query is kept until the query is ended
+    void begin_query(que_sess_t* sess, scan_cursor_t* scan);
+    void end_query(que_sess_t* sess);
 
     /*----------------------*/
     status_t insert_row(que_sess_t* sess, scan_cursor_t* cursor);
@@ -325,18 +431,46 @@ public:
     int index_read(byte * buf, const byte * key, uint key_len, enum ha_rkey_function find_flag);
     int index_read_idx(byte * buf, uint index, const byte * key, uint key_len, enum ha_rkey_function find_flag);
 
-    int32 general_fetch(    scan_cursor_t* scan, byte* buf,
+    int32 general_fetch(que_sess_t* sess, scan_cursor_t* scan, byte* buf,
         row_fetch_direction direction, row_fetch_match_mode match_mode);
-    int index_next(scan_cursor_t* scan, byte* buf);
-    int32 index_prev(scan_cursor_t* scan, byte* buf);
+    int index_next(que_sess_t* sess, scan_cursor_t* scan, byte* buf);
+    int32 index_prev(que_sess_t* sess, scan_cursor_t* scan, byte* buf);
 
-    int32 index_first(scan_cursor_t* scan, byte* buf);
-    int32 index_last(scan_cursor_t* scan, byte* buf);
-    int32 index_fetch(scan_cursor_t* scan,
+    int32 index_first(que_sess_t* sess, scan_cursor_t* scan, byte* buf);
+    int32 index_last(que_sess_t* sess, scan_cursor_t* scan, byte* buf);
+    int32 index_fetch(que_sess_t* sess, scan_cursor_t* scan,
         byte* buf, // in/out: buffer for the row
         row_fetch_match_mode match_mode);
 
-    status_t fetch_by_rowid(scan_cursor_t* scan, byte* buf, bool32* is_found);
+    status_t fetch_by_rowid(que_sess_t* sess, scan_cursor_t* scan, byte* buf, bool32* is_found);
+
+    // filter is used by heap scans of scan only if heap evaluates it exactly,
+    // FALSE if it is not pushed down and caller has to evaluate it
+    bool32 push_filter(scan_cursor_t* scan, scan_filter_t* filter);
+
+    // Values of externally stored columns are not in the fetched row, the row keeps a toast pointer.
+    // fetch_ext_column reads the value of column of current row in one call,
+    // open_ext_column and read_ext_column read it piece by piece, is_null is set if column is null.
+    status_t fetch_ext_column(scan_cursor_t* scan, uint32 column_id, byte* buf, uint32 buf_size,
+        uint32* len, bool32* is_null);
+    status_t open_ext_column(scan_cursor_t* scan, uint32 column_id, toast_reader_t* reader, bool32* is_null);
+    status_t read_ext_column(toast_reader_t* reader, byte* buf, uint32 size, uint32* read_len);
+
+    // fetch visible rows of a page in one call
+    status_t fetch_rows(que_sess_t* sess, scan_cursor_t* scan, heap_row_vector_t* rows);
+
+    /*----------------------*/
+    // full table scan by worker threads, rows are returned in no particular order
+    status_t parallel_scan_begin(que_sess_t* sess, scan_cursor_t* scan, uint32 worker_count);
+    status_t parallel_scan_next(que_sess_t* sess, scan_cursor_t* scan);
+    void parallel_scan_end(que_sess_t* sess, scan_cursor_t* scan);
+
+    // reorganize sparse heap pages of table online
+    status_t compact_table(que_sess_t* sess, dict_table_t* table);
+    // keep min/max of columns for extents of table, full table scan skips extents by them
+    status_t create_zone_map(que_sess_t* sess, dict_table_t* table, const uint16* column_ids, uint16 column_count);
+    // fill the new empty index from rows of scan->table, by worker_count parallel scan workers
+    status_t build_index(que_sess_t* sess, scan_cursor_t* scan, dict_index_t* index, uint32 worker_count);
 
     /*----------------------*/
     int create_table(const char* table_name, HA_CREATE_INFO* create_info);
@@ -348,6 +482,19 @@ public:
 };
 
 
+extern status_t heap_get_ext_column(scan_cursor_t* cursor, uint32 column_id, const byte** ptr);
+extern bool32 heap_push_filter(scan_cursor_t* cursor, scan_filter_t* filter);
+extern status_t heap_fetch_batch(que_sess_t* sess, scan_cursor_t* cursor, heap_row_vector_t* vector);
+extern status_t heap_parallel_scan_begin(que_sess_t* sess, scan_cursor_t* cursor, uint32 worker_count);
+extern status_t heap_parallel_scan_fetch(que_sess_t* sess, scan_cursor_t* cursor);
+extern void heap_parallel_scan_end(que_sess_t* sess, scan_cursor_t* cursor);
+extern status_t heap_compact(que_sess_t* sess, dict_table_t* table);
+extern status_t heap_build_index(que_sess_t* sess, scan_cursor_t* cursor, dict_index_t* index, uint32 worker_count);
+extern status_t heap_fetch_by_rowid(que_sess_t* sess, scan_cursor_t* cursor, const byte* key, uint32 key_len,
+    bool32* is_found);
+extern status_t heap_create_zone_map(que_sess_t* sess, dict_table_t* table,
+    const uint16* column_ids, uint16 column_count);
+
 extern status_t knl_server_init(char* base_dir, attribute_t* attr);
 extern status_t knl_server_end();
 
@@ -68,7 +68,10 @@ extern bool32 buf_pool_should_madvise;
 
 
 /* The number of purge threads to use.*/
-extern uint32 srv_purge_threads;
+#define SRV_MAX_PURGE_THREADS    16
+extern uint32 srv_purge_threads;  // 0 means purge is disabled
+// pages of update undo purged from an undo tablespace by a round at least, more if backlog is long
+extern uint32 srv_purge_batch_size;
 /* Use srv_n_io_[read|write]_threads instead. */
 extern uint32 srv_n_file_io_threads;
 extern uint32 srv_read_io_threads;
@@ -78,11 +81,59 @@ extern uint32 srv_sync_io_contexts;
 extern uint32 srv_read_io_timeout_seconds;
 extern uint32 srv_write_io_timeout_seconds;
 
+// maximum bytes of consecutive dirty pages merged into one write by checkpoint
+extern uint32 srv_checkpoint_io_merge_size;
+
+// limits of i/o scheduling classes, the number of pending i/o's and bytes per second, 0 means unlimited.
+// The limits of background classes are reduced to 1/4 while synchronous page reads are pending.
+extern uint32 srv_io_prefetch_max_pending;
+extern uint32 srv_io_write_max_pending;
+extern uint64 srv_io_prefetch_rate;
+extern uint64 srv_io_write_rate;
+
+// open files of each type with OS_FILE_DIRECT_IO, set by flush_method:
+//   O_DIRECT: data and doublewrite files, O_DIRECT_ALL: redo and temporary files as well, others: none
+extern bool32 srv_data_file_direct_io;
+extern bool32 srv_log_file_direct_io;
+extern bool32 srv_dblwr_file_direct_io;
+extern bool32 srv_temp_file_direct_io;
+
+// extend data files by fallocate instead of writing zero pages if the file system supports it
+extern bool32 srv_use_fallocate;
+// background thread extends an autoextend tablespace ahead of demand
+// once its free pages drop below this watermark, 0 means disabled
+extern uint32 srv_space_preextend_free_pages;
+
 
 // Move blocks to "new" LRU list only if the first access was at least this many milliseconds ago.
 // Not protected by any mutex or latch.
 extern uint32 srv_buf_LRU_old_threshold_ms;
 
+// maximum number of worker threads of a parallel full table scan,
+// and the number of rows buffered by each worker before it waits for the consumer
+extern uint32 srv_parallel_scan_max_workers;
+extern uint32 srv_parallel_scan_queue_rows;
+
+// commit cleans itls of at most srv_fast_clean_max_pages pages, the others are queued
+// to buffer pool instance of page and cleaned by delayed cleanout threads
+extern uint32 srv_fast_clean_max_pages;
+#define SRV_MAX_DELAYED_CLEANOUT_THREADS    16
+extern uint32 srv_delayed_cleanout_threads;
+extern uint32 srv_delayed_cleanout_queue_size;  // per buffer pool instance, 0 means disabled
+// consistent read page images cached by each buffer pool instance for mvcc readers, 0 means disabled
+extern uint32 srv_cr_pages_per_instance;
+// insert undo pages kept by each session for the next trxs, 0 means disabled
+extern uint32 srv_sess_undo_cached_pages;
+// seconds a trx waits for a lock of lock manager, 0 means no timeout
+extern uint32 srv_lock_wait_timeout;
+// threads rolling back the trxs active at crash in background after startup, at least 1
+#define SRV_MAX_TRX_ROLLBACK_THREADS    16
+extern uint32 srv_trx_rollback_threads;
+// memory of index build to sort keys, sorted runs are spilled into srv_temp_mem_pool if it is full
+extern uint32 srv_index_build_sort_buffer_size;
+// percent of page filled by index build, 50 ~ 100, the rest is left for later inserts
+extern uint32 srv_index_build_fill_factor;
+
 extern os_aio_array_t* srv_os_aio_async_read_array;
 extern os_aio_array_t* srv_os_aio_async_write_array;
 extern os_aio_array_t* srv_os_aio_sync_array;
@@ -1,9 +1,743 @@
 #include "knl_btree.h"
+#include "cm_log.h"
+#include "knl_buf.h"
+#include "knl_fsp.h"
 
+// X latched pages of a pessimistic change, from leaf (level 0) to root
+typedef struct st_btr_path {
+    uint32          height;
+    buf_block_t*    blocks[BTR_MAX_LEVELS];
+    uint32          slots[BTR_MAX_LEVELS];  // slot of node pointer to the page below
+    // pages allocated for splits before any change
+    uint32          free_block_count;
+    buf_block_t*    free_blocks[BTR_MAX_LEVELS + 1];
+} btr_path_t;
 
+/*-------------------------------------------------- */
+// key encoding
 
+static inline byte* btr_key_reserve(btr_key_t* key, uint32 len)
+{
+    if (key->is_overflow || key->len + len > BTR_KEY_MAX_LEN) {
+        key->is_overflow = TRUE;
+        return NULL;
+    }
+
+    byte* ptr = key->data + key->len;
+    key->len += len;
+    return ptr;
+}
+
+void btr_key_put_null(btr_key_t* key)
+{
+    byte* ptr = btr_key_reserve(key, 1);
+    if (ptr != NULL) {
+        *ptr = 0x00;
+    }
+}
+
+// sign bit is flipped, so that negative values are less in memcmp
+void btr_key_put_int(btr_key_t* key, int64 value)
+{
+    byte* ptr = btr_key_reserve(key, 9);
+    if (ptr != NULL) {
+        *ptr = 0x01;
+        mach_write_to_8(ptr + 1, (uint64)value ^ ((uint64)1 << 63));
+    }
+}
+
+void btr_key_put_uint(btr_key_t* key, uint64 value)
+{
+    byte* ptr = btr_key_reserve(key, 9);
+    if (ptr != NULL) {
+        *ptr = 0x01;
+        mach_write_to_8(ptr + 1, value);
+    }
+}
+
+// 0x00 of data is written as 0x00 0xFF and data ends with 0x00 0x00,
+// so a value is never a prefix of another one and the key of next column is not compared with data
+void btr_key_put_bytes(btr_key_t* key, const byte* data, uint32 len)
+{
+    uint32 zero_count = 0;
+    for (uint32 i = 0; i < len; i++) {
+        if (data[i] == 0x00) {
+            zero_count++;
+        }
+    }
+
+    byte* ptr = btr_key_reserve(key, 1 + len + zero_count + 2);
+    if (ptr == NULL) {
+        return;
+    }
+
+    *ptr++ = 0x01;
+    for (uint32 i = 0; i < len; i++) {
+        *ptr++ = data[i];
+        if (data[i] == 0x00) {
+            *ptr++ = 0xFF;
+        }
+    }
+    *ptr++ = 0x00;
+    *ptr = 0x00;
+}
+
+/*-------------------------------------------------- */
+// page and record
+
+// free space between records and slot directory
+static inline uint32 btr_page_get_free_space(const page_t* page, uint32 physical_size)
+{
+    return physical_size - FIL_PAGE_DATA_END - btr_page_get_n_recs(page) * BTR_SLOT_SIZE
+        - btr_page_get_heap_top(page);
+}
+
+// size of records and slots in use
+static inline uint32 btr_page_get_data_size(const page_t* page)
+{
+    return btr_page_get_heap_top(page) - BTR_PAGE_RECS - btr_page_get_garbage(page)
+        + btr_page_get_n_recs(page) * BTR_SLOT_SIZE;
+}
+
+static inline bool32 btr_page_is_leaf_of(const page_t* page, dict_index_t* index)
+{
+    return mach_read_from_2(page + FIL_PAGE_TYPE) == FIL_PAGE_TYPE_BTREE_LEAF &&
+        mach_read_from_8(page + BTR_PAGE_HEADER + BTR_PAGE_INDEX_ID) == index->id;
+}
+
+static int32 btr_cmp_tuple_key(const btr_tuple_t* tuple, const byte* key, uint32 key_len,
+    uint64 value, bool32 cmp_value)
+{
+    int32 ret = memcmp(tuple->key, key, ut_min(tuple->key_len, key_len));
+
+    if (ret != 0) {
+        return ret < 0 ? -1 : 1;
+    }
+    if (tuple->key_len < key_len) {
+        // key of tuple is a prefix of record
+        return tuple->value_mode == BTR_VALUE_MAX ? 1 : -1;
+    }
+    if (tuple->key_len > key_len) {
+        return 1;
+    }
+    if (tuple->value_mode != BTR_VALUE_EXACT) {
+        return tuple->value_mode;
+    }
+    if (!cmp_value) {
+        return 0;
+    }
+
+    return tuple->value < value ? -1 : (tuple->value > value ? 1 : 0);
+}
+
+static inline int32 btr_cmp_tuple_rec(const btr_tuple_t* tuple, const byte* rec, bool32 cmp_value)
+{
+    return btr_cmp_tuple_key(tuple, rec + BTR_REC_KEY, btr_rec_get_key_len(rec),
+        btr_rec_get_value(rec), cmp_value);
+}
+
+// Returns the first slot from low whose record is greater than tuple,
+// or not less than tuple if strict is FALSE
+static uint32 btr_page_search_slot(page_t* page, uint32 physical_size, const btr_tuple_t* tuple,
+    bool32 cmp_value, bool32 strict, uint32 low)
+{
+    uint32 high = btr_page_get_n_recs(page);
+
+    while (low < high) {
+        uint32 mid = (low + high) / 2;
+        int32 ret = btr_cmp_tuple_rec(tuple, btr_page_get_rec(page, physical_size, mid), cmp_value);
+        if (ret < 0 || (ret == 0 && !strict)) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+
+    return low;
+}
+
+// Returns the slot of node pointer to the subtree of tuple,
+// the first node pointer is minus infinity
+static inline uint32 btr_node_ptr_search(page_t* page, uint32 physical_size,
+    const btr_tuple_t* tuple, bool32 cmp_value)
+{
+    return btr_page_search_slot(page, physical_size, tuple, cmp_value, TRUE, 1) - 1;
+}
+
+static void btr_page_init(buf_block_t* block, index_id_t index_id, uint32 level, mtr_t* mtr)
+{
+    page_t* page = buf_block_get_frame(block);
+    byte* header = page + BTR_PAGE_HEADER;
+
+    mlog_write_uint32(page + FIL_PAGE_TYPE,
+        level == 0 ? FIL_PAGE_TYPE_BTREE_LEAF : FIL_PAGE_TYPE_BTREE_NONLEAF, MLOG_2BYTES, mtr);
+    mlog_write_uint32(page + FIL_PAGE_PREV, FIL_NULL, MLOG_4BYTES, mtr);
+    mlog_write_uint32(page + FIL_PAGE_NEXT, FIL_NULL, MLOG_4BYTES, mtr);
+
+    mach_write_to_2(header + BTR_PAGE_LEVEL, level);
+    mach_write_to_2(header + BTR_PAGE_N_RECS, 0);
+    mach_write_to_2(header + BTR_PAGE_HEAP_TOP, BTR_PAGE_RECS);
+    mach_write_to_2(header + BTR_PAGE_GARBAGE, 0);
+    mach_write_to_8(header + BTR_PAGE_INDEX_ID, index_id);
+    mlog_log_string(header, BTR_PAGE_HEADER_SIZE, mtr);
+}
+
+// Copies records of page into a work area, rec is placed at pos if not NULL,
+// the work area is freed by ut_free
+static byte** btr_page_copy_recs(page_t* page, uint32 physical_size, const byte* rec,
+    uint32 pos, uint32* count)
+{
+    uint32 n_recs = btr_page_get_n_recs(page);
+    uint32 rec_size = rec ? btr_rec_get_size(rec, btr_page_get_level(page)) : 0;
+    byte** recs = (byte **)ut_malloc(sizeof(byte*) * (n_recs + 1) + physical_size + rec_size);
+    ut_a(recs);
+
+    byte* copy = (byte *)(recs + n_recs + 1);
+    memcpy(copy, page, physical_size);
+    if (rec) {
+        memcpy(copy + physical_size, rec, rec_size);
+    }
+
+    uint32 i = 0;
+    for (uint32 slot = 0; slot < n_recs; slot++) {
+        if (rec && slot == pos) {
+            recs[i++] = copy + physical_size;
+        }
+        recs[i++] = btr_page_get_rec(copy, physical_size, slot);
+    }
+    if (rec && pos == n_recs) {
+        recs[i++] = copy + physical_size;
+    }
+    *count = i;
+
+    return recs;
+}
+
+// Writes records into page in order, recs must not point to the page
+static void btr_page_rebuild(buf_block_t* block, uint32 physical_size, uint32 level,
+    byte** recs, uint32 count, mtr_t* mtr)
+{
+    page_t* page = buf_block_get_frame(block);
+    byte* header = page + BTR_PAGE_HEADER;
+    uint32 offset = BTR_PAGE_RECS;
+
+    for (uint32 i = 0; i < count; i++) {
+        uint32 size = btr_rec_get_size(recs[i], level);
+        memcpy(page + offset, recs[i], size);
+        mach_write_to_2(BTR_PAGE_SLOT(page, physical_size, i), offset);
+        offset += size;
+    }
+    ut_a(offset + count * BTR_SLOT_SIZE <= physical_size - FIL_PAGE_DATA_END);
+
+    mlog_write_uint32(page + FIL_PAGE_TYPE,
+        level == 0 ? FIL_PAGE_TYPE_BTREE_LEAF : FIL_PAGE_TYPE_BTREE_NONLEAF, MLOG_2BYTES, mtr);
+    mach_write_to_2(header + BTR_PAGE_LEVEL, level);
+    mach_write_to_2(header + BTR_PAGE_N_RECS, count);
+    mach_write_to_2(header + BTR_PAGE_HEAP_TOP, offset);
+    mach_write_to_2(header + BTR_PAGE_GARBAGE, 0);
+    mlog_log_string(header, offset - BTR_PAGE_HEADER, mtr);
+    if (count > 0) {
+        mlog_log_string(BTR_PAGE_SLOT(page, physical_size, count - 1), count * BTR_SLOT_SIZE, mtr);
+    }
+}
+
+// Removes the garbage of deleted records, the order of records is not changed
+static void btr_page_reorganize(buf_block_t* block, uint32 physical_size, mtr_t* mtr)
+{
+    page_t* page = buf_block_get_frame(block);
+    uint32 count;
+
+    byte** recs = btr_page_copy_recs(page, physical_size, NULL, 0, &count);
+    btr_page_rebuild(block, physical_size, btr_page_get_level(page), recs, count, mtr);
+    ut_free(recs);
+}
+
+// Inserts rec at slot pos, returns FALSE if the page is full
+static bool32 btr_page_insert_rec(buf_block_t* block, uint32 physical_size,
+    const byte* rec, uint32 pos, mtr_t* mtr)
+{
+    page_t* page = buf_block_get_frame(block);
+    uint32 n_recs = btr_page_get_n_recs(page);
+    uint32 size = btr_rec_get_size(rec, btr_page_get_level(page));
+
+    ut_ad(pos <= n_recs);
+
+    if (btr_page_get_free_space(page, physical_size) < size + BTR_SLOT_SIZE) {
+        if (btr_page_get_free_space(page, physical_size) + btr_page_get_garbage(page) < size + BTR_SLOT_SIZE) {
+            return FALSE;
+        }
+        btr_page_reorganize(block, physical_size, mtr);
+    }
+
+    uint32 offset = btr_page_get_heap_top(page);
+    memcpy(page + offset, rec, size);
+    mlog_log_string(page + offset, size, mtr);
+
+    // slots from pos are moved by one slot towards page begin
+    byte* slot = BTR_PAGE_SLOT(page, physical_size, n_recs);
+    memmove(slot, slot + BTR_SLOT_SIZE, (n_recs - pos) * BTR_SLOT_SIZE);
+    mach_write_to_2(BTR_PAGE_SLOT(page, physical_size, pos), offset);
+    mlog_log_string(slot, (n_recs - pos + 1) * BTR_SLOT_SIZE, mtr);
+
+    mlog_write_uint32(page + BTR_PAGE_HEADER + BTR_PAGE_N_RECS, n_recs + 1, MLOG_2BYTES, mtr);
+    mlog_write_uint32(page + BTR_PAGE_HEADER + BTR_PAGE_HEAP_TOP, offset + size, MLOG_2BYTES, mtr);
+
+    return TRUE;
+}
+
+static void btr_page_delete_rec(buf_block_t* block, uint32 physical_size, uint32 pos, mtr_t* mtr)
+{
+    page_t* page = buf_block_get_frame(block);
+    uint32 n_recs = btr_page_get_n_recs(page);
+    byte* rec = btr_page_get_rec(page, physical_size, pos);
+    uint32 size = btr_rec_get_size(rec, btr_page_get_level(page));
+
+    ut_ad(pos < n_recs);
+
+    // slots after pos are moved by one slot towards page end
+    byte* slot = BTR_PAGE_SLOT(page, physical_size, n_recs - 1);
+    if (pos + 1 < n_recs) {
+        memmove(slot + BTR_SLOT_SIZE, slot, (n_recs - 1 - pos) * BTR_SLOT_SIZE);
+        mlog_log_string(slot + BTR_SLOT_SIZE, (n_recs - 1 - pos) * BTR_SLOT_SIZE, mtr);
+    }
+
+    mlog_write_uint32(page + BTR_PAGE_HEADER + BTR_PAGE_N_RECS, n_recs - 1, MLOG_2BYTES, mtr);
+    if ((uint32)(rec - page) + size == btr_page_get_heap_top(page)) {
+        mlog_write_uint32(page + BTR_PAGE_HEADER + BTR_PAGE_HEAP_TOP, (uint32)(rec - page), MLOG_2BYTES, mtr);
+    } else {
+        mlog_write_uint32(page + BTR_PAGE_HEADER + BTR_PAGE_GARBAGE,
+            btr_page_get_garbage(page) + size, MLOG_2BYTES, mtr);
+    }
+
+    buf_block_modify_clock_inc(block);
+}
+
+// The page type is reset, so that a cursor which follows a stale sibling link finds it is not a leaf
+static void btr_page_free(dict_index_t* index, const page_size_t& page_size, buf_block_t* block, mtr_t* mtr)
+{
+    mlog_write_uint32(buf_block_get_frame(block) + FIL_PAGE_TYPE, FIL_PAGE_TYPE_ALLOCATED, MLOG_2BYTES, mtr);
+    buf_block_modify_clock_inc(block);
+
+    const page_id_t page_id(index->space_id, block->get_page_no());
+    fsp_free_page(page_id, page_size, mtr);
+}
+
+// Links new_block as the right sibling of block
+static void btr_page_link_right(dict_index_t* index, const page_size_t& page_size,
+    buf_block_t* block, buf_block_t* new_block, mtr_t* mtr)
+{
+    page_t* page = buf_block_get_frame(block);
+    page_no_t next_page_no = mach_read_from_4(page + FIL_PAGE_NEXT);
+
+    if (next_page_no != FIL_NULL) {
+        const page_id_t next_page_id(index->space_id, next_page_no);
+        buf_block_t* next_block = buf_page_get(next_page_id, page_size, RW_X_LATCH, mtr);
+        mlog_write_uint32(buf_block_get_frame(next_block) + FIL_PAGE_PREV,
+            new_block->get_page_no(), MLOG_4BYTES, mtr);
+    }
+    mlog_write_uint32(buf_block_get_frame(new_block) + FIL_PAGE_PREV, block->get_page_no(), MLOG_4BYTES, mtr);
+    mlog_write_uint32(buf_block_get_frame(new_block) + FIL_PAGE_NEXT, next_page_no, MLOG_4BYTES, mtr);
+    mlog_write_uint32(page + FIL_PAGE_NEXT, new_block->get_page_no(), MLOG_4BYTES, mtr);
+}
+
+/*-------------------------------------------------- */
+// search
+
+// Descends from root to the leaf of tuple, the leaf is latched in latch_mode.
+// If optimistic, a page is released before its child is latched, the child is buffer fixed
+// and its modify clock is read under the latch of parent. Returns NULL if the clock is changed
+// before the child is latched, since the child may not cover tuple any more.
+// Otherwise a page is released once its child is latched.
+static buf_block_t* btr_search_to_leaf_low(dict_index_t* index, const page_size_t& page_size,
+    const btr_tuple_t* tuple, rw_lock_type_t latch_mode, bool32 optimistic, mtr_t* mtr)
+{
+    bool32 cmp_value = !(index->type & DICT_UNIQUE);
+    const page_id_t root_page_id(index->space_id, index->entry_page_no);
+    buf_block_t* block;
+    uint32 level;
+
+    for (;;) {
+        block = buf_page_get(root_page_id, page_size, RW_S_LATCH, mtr);
+        level = btr_page_get_level(buf_block_get_frame(block));
+        if (level > 0 || latch_mode == RW_S_LATCH) {
+            break;
+        }
+
+        // root is leaf, relatch it and check that it is not split meanwhile
+        mtr_memo_release(mtr, block, MTR_MEMO_PAGE_S_FIX);
+        block = buf_page_get(root_page_id, page_size, latch_mode, mtr);
+        if (btr_page_get_level(buf_block_get_frame(block)) == 0) {
+            return block;
+        }
+        mtr_memo_release(mtr, block, MTR_MEMO_PAGE_X_FIX);
+    }
+
+    while (level > 0) {
+        page_t* page = buf_block_get_frame(block);
+        uint32 slot = btr_node_ptr_search(page, page_size.physical(), tuple, cmp_value);
+        page_no_t child_page_no = btr_node_ptr_get_child(btr_page_get_rec(page, page_size.physical(), slot));
+        rw_lock_type_t child_latch = (level == 1) ? latch_mode : RW_S_LATCH;
+        const page_id_t child_page_id(index->space_id, child_page_no);
+        buf_block_t* child;
+
+        if (optimistic) {
+            // a split or free of child increases its clock under the X latch of parent
+            buf_block_t* fixed = buf_page_get_gen(child_page_id, page_size, RW_NO_LATCH, NULL, Page_fetch::NORMAL, mtr);
+            uint64 modify_clock = fixed->modify_clock;
+            mtr_memo_release(mtr, block, MTR_MEMO_PAGE_S_FIX);
+
+            child = buf_page_get_gen(child_page_id, page_size, child_latch, fixed, Page_fetch::NORMAL, mtr);
+            mtr_memo_release(mtr, fixed, MTR_MEMO_BUF_FIX);
+            if (buf_block_get_modify_clock(child) != modify_clock) {
+                mtr_memo_release(mtr, child, child_latch == RW_S_LATCH ? MTR_MEMO_PAGE_S_FIX : MTR_MEMO_PAGE_X_FIX);
+                return NULL;
+            }
+        } else {
+            child = buf_page_get(child_page_id, page_size, child_latch, mtr);
+            mtr_memo_release(mtr, block, MTR_MEMO_PAGE_S_FIX);
+        }
+
+        block = child;
+        level--;
+        ut_a(btr_page_get_level(buf_block_get_frame(block)) == level);
+    }
+
+    return block;
+}
+
+// Descends optimistically first, with latch coupling if a page of path is changed meanwhile
+static buf_block_t* btr_search_to_leaf(dict_index_t* index, const page_size_t& page_size,
+    const btr_tuple_t* tuple, rw_lock_type_t latch_mode, mtr_t* mtr)
+{
+    buf_block_t* block = btr_search_to_leaf_low(index, page_size, tuple, latch_mode, TRUE, mtr);
+    if (block == NULL) {
+        block = btr_search_to_leaf_low(index, page_size, tuple, latch_mode, FALSE, mtr);
+    }
+
+    return block;
+}
+
+// Descends from root with X latches on all pages of path, index lock must be held in X mode
+static void btr_search_path(dict_index_t* index, const page_size_t& page_size,
+    const btr_tuple_t* tuple, btr_path_t* path, mtr_t* mtr)
+{
+    bool32 cmp_value = !(index->type & DICT_UNIQUE);
+    const page_id_t root_page_id(index->space_id, index->entry_page_no);
+    buf_block_t* block = buf_page_get(root_page_id, page_size, RW_X_LATCH, mtr);
+    uint32 level = btr_page_get_level(buf_block_get_frame(block));
+
+    ut_a(level < BTR_MAX_LEVELS);
+    path->height = level + 1;
+    path->free_block_count = 0;
+
+    for (;;) {
+        path->blocks[level] = block;
+        if (level == 0) {
+            break;
+        }
+
+        page_t* page = buf_block_get_frame(block);
+        uint32 slot = btr_node_ptr_search(page, page_size.physical(), tuple, cmp_value);
+        page_no_t child_page_no = btr_node_ptr_get_child(btr_page_get_rec(page, page_size.physical(), slot));
+        path->slots[level] = slot;
+
+        const page_id_t child_page_id(index->space_id, child_page_no);
+        block = buf_page_get(child_page_id, page_size, RW_X_LATCH, mtr);
+        level--;
+        ut_a(btr_page_get_level(buf_block_get_frame(block)) == level);
+    }
+}
+
+// Returns the slot to insert tuple. *is_done is set if the record is in tree already,
+// or the record with the key of tuple is taken over by tuple, since its row does not exist.
+// The record of unique index with the key of a row which exists is a duplicate.
+static status_t btr_leaf_check_insert(dict_index_t* index, buf_block_t* block, uint32 physical_size,
+    const btr_tuple_t* tuple, btr_row_exists_func_t row_exists, void* arg, uint32* pos,
+    bool32* is_done, mtr_t* mtr)
+{
+    page_t* page = buf_block_get_frame(block);
+    bool32 cmp_value = !(index->type & DICT_UNIQUE);
+
+    *is_done = FALSE;
+    *pos = btr_page_search_slot(page, physical_size, tuple, cmp_value, FALSE, 0);
+    if (*pos >= btr_page_get_n_recs(page)) {
+        return CM_SUCCESS;
+    }
+
+    byte* rec = btr_page_get_rec(page, physical_size, *pos);
+    if (btr_cmp_tuple_rec(tuple, rec, cmp_value) != 0) {
+        return CM_SUCCESS;
+    }
+    if (btr_rec_get_value(rec) == tuple->value) {
+        *is_done = TRUE;
+        return CM_SUCCESS;
+    }
+
+    // only a unique index has a record of the same key and another value
+    if (row_exists == NULL || row_exists(arg, tuple->key, tuple->key_len, btr_rec_get_value(rec))) {
+        CM_SET_ERROR(ERR_DUPLICATE_KEY, index->name);
+        return CM_ERROR;
+    }
+    mlog_write_uint64(rec + BTR_REC_VALUE, tuple->value, mtr);
+    *is_done = TRUE;
+
+    return CM_SUCCESS;
+}
+
+/*-------------------------------------------------- */
+// split
+
+// Allocates the pages of splits before any change of path, a level is split if
+// it has no room for the largest record, so a full tablespace never leaves a split half done
+static status_t btr_path_alloc_blocks(dict_index_t* index, const page_size_t& page_size,
+    btr_path_t* path, uint32 rec_size, mtr_t* mtr)
+{
+    uint32 physical_size = page_size.physical();
+
+    for (uint32 level = 0; level < path->height; level++) {
+        page_t* page = buf_block_get_frame(path->blocks[level]);
+        if (btr_page_get_free_space(page, physical_size) + btr_page_get_garbage(page) >= rec_size + BTR_SLOT_SIZE) {
+            break;
+        }
+
+        // root is split into two new pages
+        uint32 count = (level + 1 == path->height) ? 2 : 1;
+        for (uint32 i = 0; i < count; i++) {
+            buf_block_t* block;
+            if (fsp_alloc_free_page(index->space_id, page_size, Page_fetch::NORMAL, &block, mtr) != CM_SUCCESS) {
+                while (path->free_block_count > 0) {
+                    btr_page_free(index, page_size, path->free_blocks[--path->free_block_count], mtr);
+                }
+                return CM_ERROR;
+            }
+            path->free_blocks[path->free_block_count++] = block;
+        }
+
+        // node pointer to the new page is not built yet
+        rec_size = BTR_REC_MAX_SIZE(physical_size);
+    }
+
+    return CM_SUCCESS;
+}
+
+static inline buf_block_t* btr_path_get_free_block(btr_path_t* path)
+{
+    ut_a(path->free_block_count > 0);
+    return path->free_blocks[--path->free_block_count];
+}
+
+// Returns the number of records kept in left page, both pages get one record at least
+static uint32 btr_page_get_split_point(byte** recs, uint32 count, uint32 level, uint32 pos, bool32 is_rightmost)
+{
+    uint32 total_size = 0;
+    uint32 size = 0;
+    uint32 split;
+
+    ut_ad(count >= 2);
+
+    // ascending insert keeps the left page full
+    if (is_rightmost && pos == count - 1) {
+        return count - 1;
+    }
+
+    for (uint32 i = 0; i < count; i++) {
+        total_size += btr_rec_get_size(recs[i], level) + BTR_SLOT_SIZE;
+    }
+    for (split = 1; split < count - 1; split++) {
+        size += btr_rec_get_size(recs[split - 1], level) + BTR_SLOT_SIZE;
+        if (size * 2 >= total_size) {
+            break;
+        }
+    }
+
+    return split;
+}
+
+static status_t btr_insert_into_level(dict_index_t* index, const page_size_t& page_size,
+    btr_path_t* path, uint32 level, const byte* rec, uint32 pos, mtr_t* mtr);
+
+// Moves records of root to two new pages, the root becomes their parent and
+// keeps its page no
+static void btr_root_raise_and_insert(dict_index_t* index, const page_size_t& page_size,
+    btr_path_t* path, const byte* rec, uint32 pos, mtr_t* mtr)
+{
+    uint32 physical_size = page_size.physical();
+    buf_block_t* root = path->blocks[path->height - 1];
+    uint32 level = btr_page_get_level(buf_block_get_frame(root));
+    byte node_ptrs[2][BTR_REC_KEY + BTR_KEY_MAX_LEN + BTR_NODE_PTR_SIZE];
+    byte* root_recs[2] = { node_ptrs[0], node_ptrs[1] };
+    uint32 count;
+
+    ut_a(level + 1 < BTR_MAX_LEVELS);
+
+    byte** recs = btr_page_copy_recs(buf_block_get_frame(root), physical_size, rec, pos, &count);
+    uint32 split = btr_page_get_split_point(recs, count, level, pos, TRUE);
+
+    buf_block_t* left = btr_path_get_free_block(path);
+    buf_block_t* right = btr_path_get_free_block(path);
+    btr_page_init(left, index->id, level, mtr);
+    btr_page_init(right, index->id, level, mtr);
+    btr_page_rebuild(left, physical_size, level, recs, split, mtr);
+    btr_page_rebuild(right, physical_size, level, recs + split, count - split, mtr);
+    btr_page_link_right(index, page_size, left, right, mtr);
+
+    btr_rec_build(node_ptrs[0], recs[0] + BTR_REC_KEY, btr_rec_get_key_len(recs[0]),
+        btr_rec_get_value(recs[0]), left->get_page_no(), level + 1);
+    btr_rec_build(node_ptrs[1], recs[split] + BTR_REC_KEY, btr_rec_get_key_len(recs[split]),
+        btr_rec_get_value(recs[split]), right->get_page_no(), level + 1);
+    btr_page_rebuild(root, physical_size, level + 1, root_recs, 2, mtr);
+    buf_block_modify_clock_inc(root);
+
+    ut_free(recs);
+}
+
+// Moves the upper half of records to a new right sibling,
+// the node pointer of new page is inserted into parent
+static status_t btr_page_split_and_insert(dict_index_t* index, const page_size_t& page_size,
+    btr_path_t* path, uint32 level, const byte* rec, uint32 pos, mtr_t* mtr)
+{
+    uint32 physical_size = page_size.physical();
+    buf_block_t* block = path->blocks[level];
+    page_t* page = buf_block_get_frame(block);
+    byte node_ptr[BTR_REC_KEY + BTR_KEY_MAX_LEN + BTR_NODE_PTR_SIZE];
+    uint32 count;
+
+    byte** recs = btr_page_copy_recs(page, physical_size, rec, pos, &count);
+    uint32 split = btr_page_get_split_point(recs, count, level, pos,
+        mach_read_from_4(page + FIL_PAGE_NEXT) == FIL_NULL);
+
+    buf_block_t* new_block = btr_path_get_free_block(path);
+    btr_page_init(new_block, index->id, level, mtr);
+    btr_page_rebuild(block, physical_size, level, recs, split, mtr);
+    btr_page_rebuild(new_block, physical_size, level, recs + split, count - split, mtr);
+    buf_block_modify_clock_inc(block);
+    btr_page_link_right(index, page_size, block, new_block, mtr);
+
+    // the first key of new page is the lower bound of it
+    btr_rec_build(node_ptr, recs[split] + BTR_REC_KEY, btr_rec_get_key_len(recs[split]),
+        btr_rec_get_value(recs[split]), new_block->get_page_no(), level + 1);
+    ut_free(recs);
+
+    return btr_insert_into_level(index, page_size, path, level + 1, node_ptr, path->slots[level + 1] + 1, mtr);
+}
+
+static status_t btr_insert_into_level(dict_index_t* index, const page_size_t& page_size,
+    btr_path_t* path, uint32 level, const byte* rec, uint32 pos, mtr_t* mtr)
+{
+    if (btr_page_insert_rec(path->blocks[level], page_size.physical(), rec, pos, mtr)) {
+        return CM_SUCCESS;
+    }
+
+    if (level + 1 == path->height) {
+        btr_root_raise_and_insert(index, page_size, path, rec, pos, mtr);
+        return CM_SUCCESS;
+    }
+
+    return btr_page_split_and_insert(index, page_size, path, level, rec, pos, mtr);
+}
+
+/*-------------------------------------------------- */
+// merge
+
+// Copies the only child into root, the tree becomes lower by one level
+static void btr_root_lower(dict_index_t* index, const page_size_t& page_size,
+    buf_block_t* root, buf_block_t* child, mtr_t* mtr)
+{
+    page_t* page = buf_block_get_frame(child);
+    uint32 count;
+
+    ut_ad(mach_read_from_4(page + FIL_PAGE_PREV) == FIL_NULL);
+    ut_ad(mach_read_from_4(page + FIL_PAGE_NEXT) == FIL_NULL);
+
+    byte** recs = btr_page_copy_recs(page, page_size.physical(), NULL, 0, &count);
+    btr_page_rebuild(root, page_size.physical(), btr_page_get_level(page), recs, count, mtr);
+    buf_block_modify_clock_inc(root);
+    ut_free(recs);
+
+    btr_page_free(index, page_size, child, mtr);
+}
+
+// Merges the page of path at level with its right sibling under the same parent
+// if both fit in one page, the parent is merged in the same way when it becomes small.
+// A page is not merged with its left sibling, which would break the left-to-right latch order.
+static void btr_compress(dict_index_t* index, const page_size_t& page_size,
+    btr_path_t* path, uint32 level, mtr_t* mtr)
+{
+    uint32 physical_size = page_size.physical();
+    byte node_ptr[BTR_REC_KEY + BTR_KEY_MAX_LEN + BTR_NODE_PTR_SIZE];
+
+    for (; level + 1 < path->height; level++) {
+        buf_block_t* block = path->blocks[level];
+        buf_block_t* parent = path->blocks[level + 1];
+        page_t* page = buf_block_get_frame(block);
+        page_t* parent_page = buf_block_get_frame(parent);
+        uint32 slot = path->slots[level + 1];
+
+        if (btr_page_get_data_size(page) >= BTR_MERGE_THRESHOLD(physical_size) ||
+            slot + 1 >= btr_page_get_n_recs(parent_page)) {
+            return;
+        }
+
+        byte* parent_rec = btr_page_get_rec(parent_page, physical_size, slot + 1);
+        const page_id_t right_page_id(index->space_id, btr_node_ptr_get_child(parent_rec));
+        buf_block_t* right = buf_page_get(right_page_id, page_size, RW_X_LATCH, mtr);
+        page_t* right_page = buf_block_get_frame(right);
+        uint32 merged_size = btr_page_get_data_size(page) + btr_page_get_data_size(right_page);
+        byte* right_first = NULL;
+
+        ut_ad(mach_read_from_4(page + FIL_PAGE_NEXT) == right->get_page_no());
+
+        if (level > 0) {
+            // first node pointer of right page gets its lower bound from parent
+            right_first = btr_page_get_rec(right_page, physical_size, 0);
+            btr_rec_build(node_ptr, parent_rec + BTR_REC_KEY, btr_rec_get_key_len(parent_rec),
+                btr_rec_get_value(parent_rec), btr_node_ptr_get_child(right_first), level);
+            merged_size = merged_size - btr_rec_get_size(right_first, level) + btr_rec_get_size(node_ptr, level);
+        }
+        if (merged_size > BTR_PAGE_MAX_DATA_SIZE(physical_size)) {
+            return;
+        }
 
-// Create the root node for a new index tree.
+        uint32 left_count, right_count;
+        byte** left_recs = btr_page_copy_recs(page, physical_size, NULL, 0, &left_count);
+        byte** right_recs = btr_page_copy_recs(right_page, physical_size, NULL, 0, &right_count);
+        byte** recs = (byte **)ut_malloc(sizeof(byte*) * (left_count + right_count));
+        ut_a(recs);
+        memcpy(recs, left_recs, sizeof(byte*) * left_count);
+        memcpy(recs + left_count, right_recs, sizeof(byte*) * right_count);
+        if (right_first != NULL) {
+            recs[left_count] = node_ptr;
+        }
+        btr_page_rebuild(block, physical_size, level, recs, left_count + right_count, mtr);
+        ut_free(recs);
+        ut_free(right_recs);
+        ut_free(left_recs);
+
+        // unlink right page
+        page_no_t next_page_no = mach_read_from_4(right_page + FIL_PAGE_NEXT);
+        if (next_page_no != FIL_NULL) {
+            const page_id_t next_page_id(index->space_id, next_page_no);
+            buf_block_t* next_block = buf_page_get(next_page_id, page_size, RW_X_LATCH, mtr);
+            mlog_write_uint32(buf_block_get_frame(next_block) + FIL_PAGE_PREV,
+                block->get_page_no(), MLOG_4BYTES, mtr);
+        }
+        mlog_write_uint32(page + FIL_PAGE_NEXT, next_page_no, MLOG_4BYTES, mtr);
+        btr_page_free(index, page_size, right, mtr);
+
+        btr_page_delete_rec(parent, physical_size, slot + 1, mtr);
+
+        if (level + 2 == path->height) {
+            if (btr_page_get_n_recs(parent_page) == 1) {
+                btr_root_lower(index, page_size, parent, block, mtr);
+            }
+            return;
+        }
+    }
+}
+
+/*-------------------------------------------------- */
+
+// Create the root node for a new index tree, returns FIL_NULL if tablespace is full
 uint32 btr_create(
     uint32              type,
     uint32              space,
@@ -13,64 +747,298 @@ uint32 btr_create(
     const btr_create_t* btr_redo_create_info,
     mtr_t*              mtr)
 {
-/*
-    uint32       page_no;
-    buf_block_t*    block;
-    buf_frame_t*    frame;
-    page_t*     page;
-    page_zip_des_t* page_zip;
+    buf_block_t* block;
 
-    // Create the two new segments for the index tree;
-    //    the segment headers are put on the allocated root page
+    if (fsp_alloc_free_page(space, page_size, Page_fetch::NORMAL, &block, mtr) != CM_SUCCESS) {
+        return FIL_NULL;
+    }
 
-    block = fseg_create(space, 0, PAGE_HEADER + PAGE_BTR_SEG_TOP, mtr);
-    if (block == NULL) {
-        return(FIL_NULL);
+    btr_page_init(block, index_id, 0, mtr);
+
+    return block->get_page_no();
+}
+
+status_t btr_insert(dict_index_t* index, const byte* key, uint32 key_len, uint64 value,
+    btr_row_exists_func_t row_exists, void* arg)
+{
+    const page_size_t page_size(index->space_id);
+    byte rec[BTR_REC_KEY + BTR_KEY_MAX_LEN];
+    btr_tuple_t tuple;
+    btr_path_t path;
+    bool32 is_done;
+    status_t err;
+    uint32 pos;
+    mtr_t mtr;
+
+    if (key_len > btr_get_max_key_len(page_size.physical())) {
+        CM_SET_ERROR(ERR_ROW_RECORD_TOO_BIG, key_len);
+        return CM_ERROR;
+    }
+
+    btr_tuple_set(&tuple, key, key_len, BTR_VALUE_EXACT, value);
+    uint32 rec_size = btr_rec_build(rec, key, key_len, value, FIL_NULL, 0);
+
+    // optimistic, only the leaf is changed
+    mtr_start(&mtr);
+    buf_block_t* block = btr_search_to_leaf(index, page_size, &tuple, RW_X_LATCH, &mtr);
+    err = btr_leaf_check_insert(index, block, page_size.physical(), &tuple, row_exists, arg, &pos, &is_done, &mtr);
+    if (err != CM_SUCCESS || is_done || btr_page_insert_rec(block, page_size.physical(), rec, pos, &mtr)) {
+        mtr_commit(&mtr);
+        return err;
+    }
+    mtr_commit(&mtr);
+
+    // pessimistic, the leaf is split
+    mtr_start(&mtr);
+    mtr_x_lock(&index->lock, &mtr);
+    btr_search_path(index, page_size, &tuple, &path, &mtr);
+    err = btr_leaf_check_insert(index, path.blocks[0], page_size.physical(), &tuple, row_exists, arg,
+        &pos, &is_done, &mtr);
+    if (err == CM_SUCCESS && !is_done) {
+        err = btr_path_alloc_blocks(index, page_size, &path, rec_size, &mtr);
+        if (err == CM_SUCCESS) {
+            err = btr_insert_into_level(index, page_size, &path, 0, rec, pos, &mtr);
+            // allocated for a level which has room at last
+            while (path.free_block_count > 0) {
+                btr_page_free(index, page_size, btr_path_get_free_block(&path), &mtr);
+            }
+        }
+    }
+    mtr_commit(&mtr);
+
+    return err;
+}
+
+bool32 btr_delete(dict_index_t* index, const byte* key, uint32 key_len, uint64 value)
+{
+    const page_size_t page_size(index->space_id);
+    bool32 cmp_value = !(index->type & DICT_UNIQUE);
+    bool32 need_compress = FALSE;
+    btr_tuple_t tuple;
+    btr_path_t path;
+    mtr_t mtr;
+
+    btr_tuple_set(&tuple, key, key_len, BTR_VALUE_EXACT, value);
+
+    mtr_start(&mtr);
+    buf_block_t* block = btr_search_to_leaf(index, page_size, &tuple, RW_X_LATCH, &mtr);
+    page_t* page = buf_block_get_frame(block);
+    uint32 slot = btr_page_search_slot(page, page_size.physical(), &tuple, cmp_value, FALSE, 0);
+    // the record of unique index may be taken over by another row
+    if (slot >= btr_page_get_n_recs(page) ||
+        btr_cmp_tuple_rec(&tuple, btr_page_get_rec(page, page_size.physical(), slot), cmp_value) != 0 ||
+        btr_rec_get_value(btr_page_get_rec(page, page_size.physical(), slot)) != value) {
+        mtr_commit(&mtr);
+        return FALSE;
+    }
+    btr_page_delete_rec(block, page_size.physical(), slot, &mtr);
+    if (block->get_page_no() != index->entry_page_no &&
+        btr_page_get_data_size(page) < BTR_MERGE_THRESHOLD(page_size.physical())) {
+        need_compress = TRUE;
+    }
+    mtr_commit(&mtr);
+
+    if (need_compress) {
+        mtr_start(&mtr);
+        mtr_x_lock(&index->lock, &mtr);
+        btr_search_path(index, page_size, &tuple, &path, &mtr);
+        btr_compress(index, page_size, &path, 0, &mtr);
+        mtr_commit(&mtr);
+    }
+
+    return TRUE;
+}
+
+/*-------------------------------------------------- */
+// persistent cursor
+
+static void btr_pcur_store(btr_pcur_t* pcur, buf_block_t* block, uint32 physical_size, uint32 slot)
+{
+    byte* rec = btr_page_get_rec(buf_block_get_frame(block), physical_size, slot);
+
+    pcur->state = BTR_PCUR_ON;
+    pcur->block = block;
+    pcur->page_no = block->get_page_no();
+    pcur->modify_clock = buf_block_get_modify_clock(block);
+    pcur->value = btr_rec_get_value(rec);
+    pcur->key_len = btr_rec_get_key_len(rec);
+    memcpy(pcur->key, rec + BTR_REC_KEY, pcur->key_len);
+}
+
+// Positions cursor on the first record from slot of leaf, the next leaf is
+// latched before the current one is released
+static void btr_pcur_move_forward_from(btr_pcur_t* pcur, const page_size_t& page_size,
+    buf_block_t* block, uint32 slot, mtr_t* mtr)
+{
+    while (slot >= btr_page_get_n_recs(buf_block_get_frame(block))) {
+        page_no_t next_page_no = mach_read_from_4(buf_block_get_frame(block) + FIL_PAGE_NEXT);
+        if (next_page_no == FIL_NULL) {
+            pcur->state = BTR_PCUR_AFTER_LAST;
+            return;
+        }
+
+        const page_id_t next_page_id(pcur->index->space_id, next_page_no);
+        buf_block_t* next_block = buf_page_get(next_page_id, page_size, RW_S_LATCH, mtr);
+        mtr_memo_release(mtr, block, MTR_MEMO_PAGE_S_FIX);
+        block = next_block;
+        slot = 0;
     }
-    //buf_block_dbg_add_level(block, SYNC_TREE_NODE_NEW);
-    page_no = buf_block_get_page_no(block);
-    frame = buf_block_get_frame(block);
 
-    if (!fseg_create(space, page_no, PAGE_HEADER + PAGE_BTR_SEG_LEAF, mtr)) {
-        // Not enough space for new segment, free root segment before return
-        btr_free_root(space, zip_size, page_no, mtr);
-        return(FIL_NULL);
+    btr_pcur_store(pcur, block, page_size.physical(), slot);
+}
+
+// Positions cursor on the last record before slot of leaf. The leaf is released
+// before its left sibling is latched, returns FALSE if the link is changed meanwhile.
+static bool32 btr_pcur_move_backward_from(btr_pcur_t* pcur, const page_size_t& page_size,
+    buf_block_t* block, uint32 slot, mtr_t* mtr)
+{
+    while (slot == 0) {
+        page_no_t page_no = block->get_page_no();
+        page_no_t prev_page_no = mach_read_from_4(buf_block_get_frame(block) + FIL_PAGE_PREV);
+        if (prev_page_no == FIL_NULL) {
+            pcur->state = BTR_PCUR_BEFORE_FIRST;
+            return TRUE;
+        }
+
+        mtr_memo_release(mtr, block, MTR_MEMO_PAGE_S_FIX);
+        const page_id_t prev_page_id(pcur->index->space_id, prev_page_no);
+        block = buf_page_get(prev_page_id, page_size, RW_S_LATCH, mtr);
+        page_t* page = buf_block_get_frame(block);
+        if (!btr_page_is_leaf_of(page, pcur->index) || mach_read_from_4(page + FIL_PAGE_NEXT) != page_no) {
+            return FALSE;
+        }
+        slot = btr_page_get_n_recs(page);
+    }
+
+    btr_pcur_store(pcur, block, page_size.physical(), slot - 1);
+    return TRUE;
+}
+
+// Latches the leaf of stored position without search if its modify clock is not changed.
+// *slot is the slot of stored record, or the slot it would be inserted at if it is deleted.
+static buf_block_t* btr_pcur_restore(btr_pcur_t* pcur, const page_size_t& page_size,
+    uint32* slot, bool32* is_on, mtr_t* mtr)
+{
+    bool32 cmp_value = !(pcur->index->type & DICT_UNIQUE);
+    const page_id_t page_id(pcur->index->space_id, pcur->page_no);
+    btr_tuple_t tuple;
+
+    btr_tuple_set(&tuple, pcur->key, pcur->key_len, BTR_VALUE_EXACT, pcur->value);
+
+    buf_block_t* block = buf_page_get_gen(page_id, page_size, RW_S_LATCH, pcur->block, Page_fetch::NORMAL, mtr);
+    if (block != pcur->block || buf_block_get_modify_clock(block) != pcur->modify_clock) {
+        mtr_memo_release(mtr, block, MTR_MEMO_PAGE_S_FIX);
+        block = btr_search_to_leaf(pcur->index, page_size, &tuple, RW_S_LATCH, mtr);
     }
 
-    // The fseg create acquires a second latch on the page, therefore we must declare it
-    //buf_block_dbg_add_level(block, SYNC_TREE_NODE_NEW);
+    page_t* page = buf_block_get_frame(block);
+    *slot = btr_page_search_slot(page, page_size.physical(), &tuple, cmp_value, FALSE, 0);
+    *is_on = *slot < btr_page_get_n_recs(page) &&
+        btr_cmp_tuple_rec(&tuple, btr_page_get_rec(page, page_size.physical(), *slot), cmp_value) == 0;
 
-    // Create a new index page on the allocated segment page
-    page = page_create(block, mtr, dict_table_is_comp(index->table));
-    // Set the level of the new index page
-    btr_page_set_level(page, NULL, 0, mtr);
+    return block;
+}
 
-    block->check_index_page_at_flush = TRUE;
+void btr_pcur_open(dict_index_t* index, const btr_tuple_t* tuple,
+    btr_search_mode_t mode, btr_pcur_t* pcur)
+{
+    const page_size_t page_size(index->space_id);
+    bool32 cmp_value = !(index->type & DICT_UNIQUE);
+    bool32 is_done;
+    mtr_t mtr;
 
-    // Set the index id of the page
-    mlog_write_uint64(page + (PAGE_HEADER + PAGE_INDEX_ID), id, mtr);
+    pcur->index = index;
+    pcur->state = BTR_PCUR_NOT_POSITIONED;
 
-    // Set the next node and previous node fields
-    btr_page_set_next(page, page_zip, FIL_NULL, mtr);
-    btr_page_set_prev(page, page_zip, FIL_NULL, mtr);
+    do {
+        mtr_start(&mtr);
+        buf_block_t* block = btr_search_to_leaf(index, page_size, tuple, RW_S_LATCH, &mtr);
+        page_t* page = buf_block_get_frame(block);
 
-    // We reset the free bits for the page to allow creation of several
-    // trees in the same mtr, otherwise the latch on a bitmap page would
-    // prevent it because of the latching order
+        is_done = TRUE;
+        switch (mode) {
+        case BTR_SEARCH_GE:
+        case BTR_SEARCH_GT: {
+            uint32 slot = btr_page_search_slot(page, page_size.physical(), tuple, cmp_value, mode == BTR_SEARCH_GT, 0);
+            btr_pcur_move_forward_from(pcur, page_size, block, slot, &mtr);
+            break;
+        }
+        case BTR_SEARCH_LE:
+        case BTR_SEARCH_LT: {
+            uint32 slot = btr_page_search_slot(page, page_size.physical(), tuple, cmp_value, mode == BTR_SEARCH_LE, 0);
+            is_done = btr_pcur_move_backward_from(pcur, page_size, block, slot, &mtr);
+            break;
+        }
+        default:
+            ut_error;
+        }
+        mtr_commit(&mtr);
+    } while (!is_done);
+}
+
+void btr_pcur_open_at_side(dict_index_t* index, bool32 from_left, btr_pcur_t* pcur)
+{
+    btr_tuple_t tuple;
 
-    if (!(type & DICT_CLUSTERED)) {
-        ibuf_reset_free_bits(block);
+    // an empty key with MIN or MAX is before or after all records
+    if (from_left) {
+        btr_tuple_set(&tuple, (const byte *)"", 0, BTR_VALUE_MIN, 0);
+        btr_pcur_open(index, &tuple, BTR_SEARCH_GE, pcur);
+    } else {
+        btr_tuple_set(&tuple, (const byte *)"", 0, BTR_VALUE_MAX, 0);
+        btr_pcur_open(index, &tuple, BTR_SEARCH_LE, pcur);
     }
+}
 
-    // In the following assertion we test that two records of maximum
-    // allowed size fit on the root page: this fact is needed to ensure
-    // correctness of split algorithms
+void btr_pcur_move_to_next(btr_pcur_t* pcur)
+{
+    const page_size_t page_size(pcur->index->space_id);
+    bool32 is_on;
+    uint32 slot;
+    mtr_t mtr;
 
-    ut_ad(page_get_max_insert_size(page, 2) > 2 * BTR_PAGE_MAX_REC_SIZE);
+    if (pcur->state == BTR_PCUR_BEFORE_FIRST) {
+        btr_pcur_open_at_side(pcur->index, TRUE, pcur);
+        return;
+    }
+    if (pcur->state != BTR_PCUR_ON) {
+        return;
+    }
 
-    return page_no;
-*/
+    mtr_start(&mtr);
+    buf_block_t* block = btr_pcur_restore(pcur, page_size, &slot, &is_on, &mtr);
+    btr_pcur_move_forward_from(pcur, page_size, block, is_on ? slot + 1 : slot, &mtr);
+    mtr_commit(&mtr);
+}
+
+void btr_pcur_move_to_prev(btr_pcur_t* pcur)
+{
+    const page_size_t page_size(pcur->index->space_id);
+    bool32 is_done;
+    bool32 is_on;
+    uint32 slot;
+    mtr_t mtr;
+
+    if (pcur->state == BTR_PCUR_AFTER_LAST) {
+        btr_pcur_open_at_side(pcur->index, FALSE, pcur);
+        return;
+    }
+    if (pcur->state != BTR_PCUR_ON) {
+        return;
+    }
 
-    return 0;
+    do {
+        mtr_start(&mtr);
+        buf_block_t* block = btr_pcur_restore(pcur, page_size, &slot, &is_on, &mtr);
+        is_done = btr_pcur_move_backward_from(pcur, page_size, block, slot, &mtr);
+        mtr_commit(&mtr);
+    } while (!is_done);
 }
 
+// Compares tuple with the record of cursor
+int32 btr_pcur_cmp_tuple(const btr_pcur_t* pcur, const btr_tuple_t* tuple)
+{
+    ut_ad(pcur->state == BTR_PCUR_ON);
+    return btr_cmp_tuple_key(tuple, pcur->key, pcur->key_len, pcur->value,
+        !(pcur->index->type & DICT_UNIQUE));
+}
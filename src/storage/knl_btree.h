@@ -2,15 +2,12 @@
 #define _KNL_BTREE_H
 
 #include "cm_type.h"
+#include "knl_buf.h"
 #include "knl_dict.h"
 #include "knl_mtr.h"
 #include "knl_page_id.h"
 #include "knl_page_size.h"
 
-/** Persistent cursor */
-struct btr_pcur_t;
-/** B-tree cursor */
-struct btr_cur_t;
 /** B-tree search information for the adaptive hash index */
 struct btr_search_t;
 
@@ -61,24 +58,206 @@ struct btr_create_t {
     uint32			trx_id_pos;
 };
 
+// B+tree of index, the root page is index->entry_page_no and never moves.
+//
+// A record is a key and a value, the key is a byte string compared by memcmp,
+// index columns are encoded by btr_key_put_* to keep their order. The value of
+// leaf record is the row of heap, records of non-unique index are ordered by
+// (key, value), so that every record of tree is distinct. A key of unique index
+// with a null column ends with the row of heap, so nulls never compare equal.
+// A non-leaf record also has the child page, its key is the lower bound of the
+// subtree and the first record of non-leaf page is handled as minus infinity.
+//
+// Records are kept in order by a slot directory growing down from page end,
+// leaf pages of a level are linked by FIL_PAGE_PREV and FIL_PAGE_NEXT.
+//
+// Latching: a search holds one S latch at a time. The child is buffer fixed and
+// its modify clock is read while the parent is latched, the parent is released
+// before the child is latched and the clock is checked again. Split and free of
+// a page increase the clock, so an unchanged clock means the child still covers
+// the tuple, otherwise the search is repeated with latch coupling. A change which
+// fits in the leaf X latches the leaf only. Split and merge take index->lock in
+// X mode and X latch the path from root, pages of a level are always latched
+// from left to right. A cursor holds no latch between fetches, it keeps the
+// block and modify clock of leaf, the clock is increased when a record is
+// removed from the page, so an unchanged clock means the record is still there.
+//
+// Records of deleted rows are kept for older snapshots, fetch by index rechecks
+// the key on the row. A unique index has at most one record of a key, a record
+// whose row does not exist any more is taken over by the insert of the key.
 
-/********************************************************//**
-Sets the node level field in an index page. */
-inline void btr_page_set_level(
-    page_t* page,   /*!< in: index page */
-    uint32  level,  /*!< in: level, leaf level == 0 */
-    mtr_t*  mtr)    /*!< in: mini-transaction handle */
+#define BTR_PAGE_HEADER              FIL_PAGE_DATA
+
+#define BTR_PAGE_LEVEL               0   // 2 bytes, 0 for leaf
+#define BTR_PAGE_N_RECS              2   // 2 bytes
+#define BTR_PAGE_HEAP_TOP            4   // 2 bytes, offset of free space after records
+#define BTR_PAGE_GARBAGE             6   // 2 bytes, size of deleted records
+#define BTR_PAGE_INDEX_ID            8   // 8 bytes
+#define BTR_PAGE_HEADER_SIZE         16
+
+#define BTR_PAGE_RECS                (BTR_PAGE_HEADER + BTR_PAGE_HEADER_SIZE)
+
+// slot n of directory, slot 0 is the nearest to page end
+#define BTR_SLOT_SIZE                2
+#define BTR_PAGE_SLOT(page, physical_page_size, n) \
+    ((page) + (physical_page_size) - FIL_PAGE_DATA_END - ((n) + 1) * BTR_SLOT_SIZE)
+
+// record: key length, value, key, child page (non-leaf only)
+#define BTR_REC_KEY_LEN              0
+#define BTR_REC_VALUE                2
+#define BTR_REC_KEY                  10
+#define BTR_NODE_PTR_SIZE            4
+
+#define BTR_KEY_MAX_LEN              1024
+#define BTR_MAX_LEVELS               16
+
+// a page holds at least 4 records, so both pages of split have one
+#define BTR_PAGE_MAX_DATA_SIZE(physical_page_size) \
+    ((physical_page_size) - BTR_PAGE_RECS - FIL_PAGE_DATA_END)
+#define BTR_REC_MAX_SIZE(physical_page_size) \
+    (BTR_PAGE_MAX_DATA_SIZE(physical_page_size) / 4 - BTR_SLOT_SIZE)
+
+// a page is merged with its right sibling if the data size is lower
+#define BTR_MERGE_THRESHOLD(physical_page_size) \
+    (BTR_PAGE_MAX_DATA_SIZE(physical_page_size) / 4)
+
+typedef struct st_btr_key {
+    uint16      len;
+    bool8       is_overflow;  // longer than BTR_KEY_MAX_LEN
+    byte        data[BTR_KEY_MAX_LEN];
+} btr_key_t;
+
+// value_mode of tuple, a tuple with MIN or MAX is placed before or after
+// all records whose key begins with the key of tuple
+#define BTR_VALUE_MIN                (-1)
+#define BTR_VALUE_EXACT              0
+#define BTR_VALUE_MAX                1
+
+typedef struct st_btr_tuple {
+    const byte* key;
+    uint32      key_len;
+    int32       value_mode;
+    uint64      value;  // compared only for non-unique index and BTR_VALUE_EXACT
+} btr_tuple_t;
+
+typedef enum en_btr_search_mode {
+    BTR_SEARCH_GE = 0,  // first record >= tuple
+    BTR_SEARCH_GT = 1,  // first record > tuple
+    BTR_SEARCH_LE = 2,  // last record <= tuple
+    BTR_SEARCH_LT = 3,  // last record < tuple
+} btr_search_mode_t;
+
+#define BTR_PCUR_NOT_POSITIONED      0
+#define BTR_PCUR_ON                  1  // on a record
+#define BTR_PCUR_BEFORE_FIRST        2
+#define BTR_PCUR_AFTER_LAST          3
+
+// Persistent cursor on leaf records
+typedef struct st_btr_pcur {
+    dict_index_t*   index;
+    uint32          state;
+    // leaf of stored position
+    buf_block_t*    block;
+    page_no_t       page_no;
+    uint64          modify_clock;
+    // copy of current record
+    uint64          value;
+    uint32          key_len;
+    byte            key[BTR_KEY_MAX_LEN];
+} btr_pcur_t;
+
+inline void btr_tuple_set(btr_tuple_t* tuple, const byte* key, uint32 key_len, int32 value_mode, uint64 value)
 {
-    ut_ad(page && mtr);
-    //ut_ad(level <= BTR_MAX_NODE_LEVEL);
-    //mlog_write_uint32(page + (PAGE_HEADER + PAGE_LEVEL), level, MLOG_2BYTES, mtr);
+    tuple->key = key;
+    tuple->key_len = key_len;
+    tuple->value_mode = value_mode;
+    tuple->value = value;
 }
 
+inline void btr_key_init(btr_key_t* key)
+{
+    key->len = 0;
+    key->is_overflow = FALSE;
+}
 
+inline bool32 btr_pcur_is_on_rec(const btr_pcur_t* pcur)
+{
+    return pcur->state == BTR_PCUR_ON;
+}
+
+// page and record access
+
+inline uint32 btr_page_get_level(const page_t* page)
+{
+    return mach_read_from_2(page + BTR_PAGE_HEADER + BTR_PAGE_LEVEL);
+}
 
+inline uint32 btr_page_get_n_recs(const page_t* page)
+{
+    return mach_read_from_2(page + BTR_PAGE_HEADER + BTR_PAGE_N_RECS);
+}
 
+inline uint32 btr_page_get_heap_top(const page_t* page)
+{
+    return mach_read_from_2(page + BTR_PAGE_HEADER + BTR_PAGE_HEAP_TOP);
+}
 
-uint32 btr_create(
+inline uint32 btr_page_get_garbage(const page_t* page)
+{
+    return mach_read_from_2(page + BTR_PAGE_HEADER + BTR_PAGE_GARBAGE);
+}
+
+inline byte* btr_page_get_rec(page_t* page, uint32 physical_size, uint32 slot)
+{
+    return page + mach_read_from_2(BTR_PAGE_SLOT(page, physical_size, slot));
+}
+
+inline uint32 btr_rec_get_key_len(const byte* rec)
+{
+    return mach_read_from_2(rec + BTR_REC_KEY_LEN);
+}
+
+inline uint64 btr_rec_get_value(const byte* rec)
+{
+    return mach_read_from_8(rec + BTR_REC_VALUE);
+}
+
+inline uint32 btr_rec_get_size(const byte* rec, uint32 level)
+{
+    return BTR_REC_KEY + btr_rec_get_key_len(rec) + (level > 0 ? BTR_NODE_PTR_SIZE : 0);
+}
+
+inline page_no_t btr_node_ptr_get_child(const byte* rec)
+{
+    return mach_read_from_4(rec + BTR_REC_KEY + btr_rec_get_key_len(rec));
+}
+
+inline uint32 btr_rec_build(byte* buf, const byte* key, uint32 key_len,
+    uint64 value, page_no_t child, uint32 level)
+{
+    mach_write_to_2(buf + BTR_REC_KEY_LEN, key_len);
+    mach_write_to_8(buf + BTR_REC_VALUE, value);
+    memcpy(buf + BTR_REC_KEY, key, key_len);
+    if (level > 0) {
+        mach_write_to_4(buf + BTR_REC_KEY + key_len, child);
+    }
+    return btr_rec_get_size(buf, level);
+}
+
+// the node pointer of a record must not exceed BTR_REC_MAX_SIZE too
+inline uint32 btr_get_max_key_len(uint32 physical_size)
+{
+    uint32 max_key_len = BTR_REC_MAX_SIZE(physical_size) - BTR_REC_KEY - BTR_NODE_PTR_SIZE;
+    return max_key_len < BTR_KEY_MAX_LEN ? max_key_len : BTR_KEY_MAX_LEN;
+}
+
+// key encoding, null is less than any value
+extern void btr_key_put_null(btr_key_t* key);
+extern void btr_key_put_int(btr_key_t* key, int64 value);
+extern void btr_key_put_uint(btr_key_t* key, uint64 value);
+extern void btr_key_put_bytes(btr_key_t* key, const byte* data, uint32 len);
+
+extern uint32 btr_create(
     uint32          type,
     uint32			space,
     const page_size_t&	page_size,
@@ -87,4 +266,22 @@ uint32 btr_create(
     const btr_create_t*	btr_redo_create_info,
     mtr_t*			mtr);
 
+// Returns TRUE if the row of value exists and has the key of record,
+// a row deleted by another active transaction exists
+typedef bool32 (*btr_row_exists_func_t)(void* arg, const byte* key, uint32 key_len, uint64 value);
+
+// row_exists is asked for the record with the same key of unique index, the insert
+// fails with ERR_DUPLICATE_KEY if it returns TRUE. A record which is in tree already is not an error.
+extern status_t btr_insert(dict_index_t* index, const byte* key, uint32 key_len, uint64 value,
+    btr_row_exists_func_t row_exists, void* arg);
+// Returns FALSE if the record is not found
+extern bool32 btr_delete(dict_index_t* index, const byte* key, uint32 key_len, uint64 value);
+
+extern void btr_pcur_open(dict_index_t* index, const btr_tuple_t* tuple,
+    btr_search_mode_t mode, btr_pcur_t* pcur);
+extern void btr_pcur_open_at_side(dict_index_t* index, bool32 from_left, btr_pcur_t* pcur);
+extern void btr_pcur_move_to_next(btr_pcur_t* pcur);
+extern void btr_pcur_move_to_prev(btr_pcur_t* pcur);
+extern int32 btr_pcur_cmp_tuple(const btr_pcur_t* pcur, const btr_tuple_t* tuple);
+
 #endif  /* _KNL_BTREE_H */
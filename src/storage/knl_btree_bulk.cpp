@@ -0,0 +1,633 @@
+#include "knl_btree_bulk.h"
+#include "cm_log.h"
+#include "knl_buf.h"
+#include "knl_fsp.h"
+#include "knl_server.h"
+
+// reader of a sorted run, or of the sort buffer
+typedef struct st_btr_bulk_reader {
+    bool32      is_buf;
+    // run, pages are in bulk->run_pages[page_index, end_index)
+    uint32      page_index;
+    uint32      end_index;
+    byte*       data;      // data of open page
+    uint32      offset;
+    uint32      used;
+    // sort buffer
+    byte**      recs;
+    uint32      rec_count;
+    uint32      pos;
+    byte*       rec;       // current record, NULL at end
+} btr_bulk_reader_t;
+
+/*-------------------------------------------------- */
+// sort
+
+// records are ordered by key, then by value, the same as the tree
+static inline int32 btr_bulk_rec_cmp(const byte* rec1, const byte* rec2)
+{
+    uint32 len1 = btr_rec_get_key_len(rec1);
+    uint32 len2 = btr_rec_get_key_len(rec2);
+    int32 ret = memcmp(rec1 + BTR_REC_KEY, rec2 + BTR_REC_KEY, ut_min(len1, len2));
+
+    if (ret != 0) {
+        return ret < 0 ? -1 : 1;
+    }
+    if (len1 != len2) {
+        return len1 < len2 ? -1 : 1;
+    }
+
+    uint64 value1 = btr_rec_get_value(rec1);
+    uint64 value2 = btr_rec_get_value(rec2);
+    return value1 < value2 ? -1 : (value1 > value2 ? 1 : 0);
+}
+
+static int btr_bulk_rec_ptr_cmp(const void* ptr1, const void* ptr2)
+{
+    return btr_bulk_rec_cmp(*(const byte* const *)ptr1, *(const byte* const *)ptr2);
+}
+
+static inline byte** btr_bulk_buf_recs(btr_bulk_t* bulk)
+{
+    return (byte **)(bulk->buf + bulk->buf_size) - bulk->buf_rec_count;
+}
+
+static status_t btr_bulk_extend_array(void** array, uint32 count, uint32* max_count, uint32 elem_size)
+{
+    if (count < *max_count) {
+        return CM_SUCCESS;
+    }
+
+    uint32 new_count = (*max_count == 0) ? 64 : *max_count * 2;
+    void* new_array = ut_malloc(new_count * elem_size);
+    if (new_array == NULL) {
+        CM_SET_ERROR(ERR_ALLOC_MEMORY, new_count * elem_size, "index build");
+        return CM_ERROR;
+    }
+    if (count > 0) {
+        memcpy(new_array, *array, count * elem_size);
+    }
+    ut_free(*array);
+    *array = new_array;
+    *max_count = new_count;
+
+    return CM_SUCCESS;
+}
+
+// Appends an open page to run_pages, it is freed by btr_bulk_end
+static status_t btr_bulk_run_new_page(btr_bulk_t* bulk, byte** data)
+{
+    vm_pool_t* pool = srv_temp_mem_pool;
+
+    CM_RETURN_IF_ERROR(btr_bulk_extend_array((void **)&bulk->run_pages,
+        bulk->run_page_count, &bulk->max_run_page_count, sizeof(vm_ctrl_t*)));
+
+    vm_ctrl_t* ctrl = vm_alloc(pool);
+    if (ctrl == NULL) {
+        CM_SET_ERROR(ERR_ALLOC_MEMORY, pool->page_size, "index build run");
+        return CM_ERROR;
+    }
+    bulk->run_pages[bulk->run_page_count++] = ctrl;
+
+    if (!vm_open(pool, ctrl)) {
+        CM_SET_ERROR(ERR_ALLOC_MEMORY, pool->page_size, "index build run");
+        return CM_ERROR;
+    }
+    *data = (byte *)VM_CTRL_GET_DATA_PTR(ctrl);
+
+    return CM_SUCCESS;
+}
+
+// Sorts the buffer and writes it as a new run, pages of run are closed after written
+static status_t btr_bulk_spill(btr_bulk_t* bulk)
+{
+    vm_pool_t* pool = srv_temp_mem_pool;
+    byte** recs = btr_bulk_buf_recs(bulk);
+    byte* data = NULL;
+    uint32 used = 0;
+
+    CM_RETURN_IF_ERROR(btr_bulk_extend_array((void **)&bulk->runs,
+        bulk->run_count, &bulk->max_run_count, sizeof(uint32)));
+
+    qsort(recs, bulk->buf_rec_count, sizeof(byte*), btr_bulk_rec_ptr_cmp);
+    bulk->runs[bulk->run_count++] = bulk->run_page_count;
+
+    for (uint32 i = 0; i < bulk->buf_rec_count; i++) {
+        uint32 size = btr_rec_get_size(recs[i], 0);
+        if (data == NULL || used + size > pool->page_size) {
+            if (data != NULL) {
+                mach_write_to_4(data + BTR_BULK_RUN_USED, used);
+                vm_close(pool, bulk->run_pages[bulk->run_page_count - 1]);
+            }
+            CM_RETURN_IF_ERROR(btr_bulk_run_new_page(bulk, &data));
+            used = BTR_BULK_RUN_RECS;
+        }
+        memcpy(data + used, recs[i], size);
+        used += size;
+    }
+    mach_write_to_4(data + BTR_BULK_RUN_USED, used);
+    vm_close(pool, bulk->run_pages[bulk->run_page_count - 1]);
+
+    bulk->buf_used = 0;
+    bulk->buf_rec_count = 0;
+
+    return CM_SUCCESS;
+}
+
+/*-------------------------------------------------- */
+// merge
+
+static status_t btr_bulk_reader_open_page(btr_bulk_t* bulk, btr_bulk_reader_t* reader)
+{
+    vm_pool_t* pool = srv_temp_mem_pool;
+
+    reader->rec = NULL;
+    if (!vm_open(pool, bulk->run_pages[reader->page_index])) {
+        CM_SET_ERROR(ERR_ALLOC_MEMORY, pool->page_size, "index build run");
+        return CM_ERROR;
+    }
+
+    reader->data = (byte *)VM_CTRL_GET_DATA_PTR(bulk->run_pages[reader->page_index]);
+    reader->used = mach_read_from_4(reader->data + BTR_BULK_RUN_USED);
+    reader->offset = BTR_BULK_RUN_RECS;
+    reader->rec = reader->data + reader->offset;
+
+    return CM_SUCCESS;
+}
+
+// A page of run is freed as soon as all its records are consumed
+static status_t btr_bulk_reader_next(btr_bulk_t* bulk, btr_bulk_reader_t* reader)
+{
+    vm_pool_t* pool = srv_temp_mem_pool;
+
+    if (reader->is_buf) {
+        reader->pos++;
+        reader->rec = (reader->pos < reader->rec_count) ? reader->recs[reader->pos] : NULL;
+        return CM_SUCCESS;
+    }
+
+    reader->offset += btr_rec_get_size(reader->rec, 0);
+    if (reader->offset < reader->used) {
+        reader->rec = reader->data + reader->offset;
+        return CM_SUCCESS;
+    }
+
+    vm_ctrl_t* ctrl = bulk->run_pages[reader->page_index];
+    vm_close(pool, ctrl);
+    vm_free(pool, ctrl);
+    bulk->run_pages[reader->page_index] = NULL;
+
+    reader->page_index++;
+    if (reader->page_index == reader->end_index) {
+        reader->rec = NULL;
+        return CM_SUCCESS;
+    }
+
+    return btr_bulk_reader_open_page(bulk, reader);
+}
+
+static void btr_bulk_heap_sift_down(btr_bulk_reader_t** heap, uint32 count, uint32 i)
+{
+    for (;;) {
+        uint32 min = i;
+        uint32 left = 2 * i + 1;
+        uint32 right = left + 1;
+
+        if (left < count && btr_bulk_rec_cmp(heap[left]->rec, heap[min]->rec) < 0) {
+            min = left;
+        }
+        if (right < count && btr_bulk_rec_cmp(heap[right]->rec, heap[min]->rec) < 0) {
+            min = right;
+        }
+        if (min == i) {
+            break;
+        }
+
+        btr_bulk_reader_t* tmp = heap[i];
+        heap[i] = heap[min];
+        heap[min] = tmp;
+        i = min;
+    }
+}
+
+/*-------------------------------------------------- */
+// build
+
+// The page is remembered in bulk->pages, so a failed build returns it
+static status_t btr_bulk_alloc_page(btr_bulk_t* bulk, page_no_t* page_no)
+{
+    const page_size_t page_size(bulk->index->space_id);
+    buf_block_t* block;
+    mtr_t mtr;
+
+    CM_RETURN_IF_ERROR(btr_bulk_extend_array((void **)&bulk->pages,
+        bulk->page_count, &bulk->max_page_count, sizeof(page_no_t)));
+
+    mtr_start(&mtr);
+    status_t err = fsp_alloc_free_page(bulk->index->space_id, page_size, Page_fetch::NORMAL, &block, &mtr);
+    if (err == CM_SUCCESS) {
+        *page_no = block->get_page_no();
+        bulk->pages[bulk->page_count++] = *page_no;
+    }
+    mtr_commit(&mtr);
+
+    return err;
+}
+
+// Frees the pages allocated by an unfinished build, the root is kept empty
+static void btr_bulk_free_pages(btr_bulk_t* bulk)
+{
+    const page_size_t page_size(bulk->index->space_id);
+    mtr_t mtr;
+
+    for (uint32 i = 0; i < bulk->page_count; i++) {
+        const page_id_t page_id(bulk->index->space_id, bulk->pages[i]);
+
+        mtr_start(&mtr);
+        fsp_free_page(page_id, page_size, &mtr);
+        mtr_commit(&mtr);
+    }
+    bulk->page_count = 0;
+}
+
+// Writes image into page_no in one mini-transaction, records and slots are logged as they are
+static void btr_bulk_write_page(btr_bulk_t* bulk, const page_t* image, page_no_t page_no,
+    page_no_t prev_page_no, page_no_t next_page_no)
+{
+    const page_size_t page_size(bulk->index->space_id);
+    const page_id_t page_id(bulk->index->space_id, page_no);
+    uint32 physical_size = bulk->physical_size;
+    uint32 n_recs = btr_page_get_n_recs(image);
+    uint32 heap_top = btr_page_get_heap_top(image);
+    mtr_t mtr;
+
+    mtr_start(&mtr);
+
+    buf_block_t* block = buf_page_get(page_id, page_size, RW_X_LATCH, &mtr);
+    page_t* page = buf_block_get_frame(block);
+
+    mlog_write_uint32(page + FIL_PAGE_TYPE, btr_page_get_level(image) == 0 ?
+        FIL_PAGE_TYPE_BTREE_LEAF : FIL_PAGE_TYPE_BTREE_NONLEAF, MLOG_2BYTES, &mtr);
+    mlog_write_uint32(page + FIL_PAGE_PREV, prev_page_no, MLOG_4BYTES, &mtr);
+    mlog_write_uint32(page + FIL_PAGE_NEXT, next_page_no, MLOG_4BYTES, &mtr);
+
+    memcpy(page + BTR_PAGE_HEADER, image + BTR_PAGE_HEADER, heap_top - BTR_PAGE_HEADER);
+    mlog_log_string(page + BTR_PAGE_HEADER, heap_top - BTR_PAGE_HEADER, &mtr);
+    if (n_recs > 0) {
+        byte* slots = BTR_PAGE_SLOT(page, physical_size, n_recs - 1);
+        memcpy(slots, BTR_PAGE_SLOT(image, physical_size, n_recs - 1), n_recs * BTR_SLOT_SIZE);
+        mlog_log_string(slots, n_recs * BTR_SLOT_SIZE, &mtr);
+    }
+    buf_block_modify_clock_inc(block);
+
+    mtr_commit(&mtr);
+}
+
+// Starts a new page image of level, page_no is allocated when the page is full
+static status_t btr_bulk_level_init(btr_bulk_t* bulk, uint32 level, page_no_t page_no, page_no_t prev_page_no)
+{
+    btr_bulk_level_t* lvl = &bulk->levels[level];
+
+    if (lvl->page == NULL) {
+        lvl->page = (page_t *)ut_malloc(bulk->physical_size);
+        if (lvl->page == NULL) {
+            CM_SET_ERROR(ERR_ALLOC_MEMORY, bulk->physical_size, "index build");
+            return CM_ERROR;
+        }
+        memset(lvl->page, 0x00, bulk->physical_size);
+        lvl->page_count = 0;
+    }
+
+    byte* header = lvl->page + BTR_PAGE_HEADER;
+    mach_write_to_2(header + BTR_PAGE_LEVEL, level);
+    mach_write_to_2(header + BTR_PAGE_N_RECS, 0);
+    mach_write_to_2(header + BTR_PAGE_HEAP_TOP, BTR_PAGE_RECS);
+    mach_write_to_2(header + BTR_PAGE_GARBAGE, 0);
+    mach_write_to_8(header + BTR_PAGE_INDEX_ID, bulk->index->id);
+
+    lvl->page_no = page_no;
+    lvl->prev_page_no = prev_page_no;
+    lvl->page_count++;
+
+    return CM_SUCCESS;
+}
+
+static status_t btr_bulk_level_insert(btr_bulk_t* bulk, uint32 level, const byte* rec);
+
+static inline void btr_bulk_page_append(btr_bulk_t* bulk, page_t* page, uint32 level, const byte* rec)
+{
+    uint32 n_recs = btr_page_get_n_recs(page);
+    uint32 heap_top = btr_page_get_heap_top(page);
+    uint32 size = btr_rec_get_size(rec, level);
+
+    memcpy(page + heap_top, rec, size);
+    mach_write_to_2(BTR_PAGE_SLOT(page, bulk->physical_size, n_recs), heap_top);
+    mach_write_to_2(page + BTR_PAGE_HEADER + BTR_PAGE_N_RECS, n_recs + 1);
+    mach_write_to_2(page + BTR_PAGE_HEADER + BTR_PAGE_HEAP_TOP, heap_top + size);
+}
+
+// Writes the full page of level, and starts the next page whose first record is rec.
+// A level gets a parent level when its first page is full, so the top level always has one page.
+static status_t btr_bulk_level_next_page(btr_bulk_t* bulk, uint32 level, const byte* rec)
+{
+    btr_bulk_level_t* lvl = &bulk->levels[level];
+    byte node_ptr[BTR_REC_KEY + BTR_KEY_MAX_LEN + BTR_NODE_PTR_SIZE];
+    page_no_t next_page_no;
+
+    if (lvl->page_no == FIL_NULL) {
+        CM_RETURN_IF_ERROR(btr_bulk_alloc_page(bulk, &lvl->page_no));
+    }
+    CM_RETURN_IF_ERROR(btr_bulk_alloc_page(bulk, &next_page_no));
+    btr_bulk_write_page(bulk, lvl->page, lvl->page_no, lvl->prev_page_no, next_page_no);
+
+    if (lvl->page_count == 1) {
+        const byte* first_rec = btr_page_get_rec(lvl->page, bulk->physical_size, 0);
+        btr_rec_build(node_ptr, first_rec + BTR_REC_KEY, btr_rec_get_key_len(first_rec),
+            btr_rec_get_value(first_rec), lvl->page_no, level + 1);
+        CM_RETURN_IF_ERROR(btr_bulk_level_insert(bulk, level + 1, node_ptr));
+    }
+
+    CM_RETURN_IF_ERROR(btr_bulk_level_init(bulk, level, next_page_no, lvl->page_no));
+    btr_bulk_page_append(bulk, lvl->page, level, rec);
+    btr_rec_build(node_ptr, rec + BTR_REC_KEY, btr_rec_get_key_len(rec),
+        btr_rec_get_value(rec), next_page_no, level + 1);
+
+    return btr_bulk_level_insert(bulk, level + 1, node_ptr);
+}
+
+// Appends rec to the page of level, a page is full at fill_size, but always holds 2 records at least
+static status_t btr_bulk_level_insert(btr_bulk_t* bulk, uint32 level, const byte* rec)
+{
+    btr_bulk_level_t* lvl = &bulk->levels[level];
+    uint32 size = btr_rec_get_size(rec, level);
+
+    if (level == bulk->height) {
+        if (level == BTR_MAX_LEVELS) {
+            CM_SET_ERROR(ERR_UNSUPPORTED, "index tree height");
+            return CM_ERROR;
+        }
+        CM_RETURN_IF_ERROR(btr_bulk_level_init(bulk, level, FIL_NULL, FIL_NULL));
+        bulk->height++;
+    }
+
+    page_t* page = lvl->page;
+    uint32 n_recs = btr_page_get_n_recs(page);
+    uint32 heap_top = btr_page_get_heap_top(page);
+    uint32 data_size = heap_top - BTR_PAGE_RECS + n_recs * BTR_SLOT_SIZE;
+
+    if (n_recs > 1 && data_size + size + BTR_SLOT_SIZE > bulk->fill_size) {
+        return btr_bulk_level_next_page(bulk, level, rec);
+    }
+    btr_bulk_page_append(bulk, page, level, rec);
+
+    return CM_SUCCESS;
+}
+
+static status_t btr_bulk_build_rec(btr_bulk_t* bulk, const byte* rec)
+{
+    // keys with a null column end with the row id, see heap_build_index_key
+    if (bulk->is_unique) {
+        uint32 key_len = btr_rec_get_key_len(rec);
+        if (bulk->rec_count > 0 && key_len == btr_rec_get_key_len(bulk->last_rec) &&
+            memcmp(rec + BTR_REC_KEY, bulk->last_rec + BTR_REC_KEY, key_len) == 0) {
+            CM_SET_ERROR(ERR_DUPLICATE_KEY, bulk->index->name);
+            return CM_ERROR;
+        }
+        memcpy(bulk->last_rec, rec, BTR_REC_KEY + key_len);
+    }
+    bulk->rec_count++;
+
+    return btr_bulk_level_insert(bulk, 0, rec);
+}
+
+// Merges the runs and the sort buffer, records are passed to btr_bulk_build_rec in order
+static status_t btr_bulk_merge(btr_bulk_t* bulk)
+{
+    vm_pool_t* pool = srv_temp_mem_pool;
+    uint32 reader_count = bulk->run_count + 1;
+    status_t err = CM_SUCCESS;
+    uint32 count = 0;
+
+    btr_bulk_reader_t* readers = (btr_bulk_reader_t *)ut_malloc_zero(
+        (sizeof(btr_bulk_reader_t) + sizeof(btr_bulk_reader_t*)) * reader_count);
+    if (readers == NULL) {
+        CM_SET_ERROR(ERR_ALLOC_MEMORY, sizeof(btr_bulk_reader_t) * reader_count, "index build");
+        return CM_ERROR;
+    }
+    btr_bulk_reader_t** heap = (btr_bulk_reader_t **)(readers + reader_count);
+
+    // the rest of sort buffer is not spilled
+    readers[0].is_buf = TRUE;
+    readers[0].recs = btr_bulk_buf_recs(bulk);
+    readers[0].rec_count = bulk->buf_rec_count;
+    readers[0].pos = 0;
+    readers[0].rec = (bulk->buf_rec_count > 0) ? readers[0].recs[0] : NULL;
+    qsort(readers[0].recs, bulk->buf_rec_count, sizeof(byte*), btr_bulk_rec_ptr_cmp);
+
+    for (uint32 i = 0; i < bulk->run_count && err == CM_SUCCESS; i++) {
+        btr_bulk_reader_t* reader = &readers[i + 1];
+        reader->is_buf = FALSE;
+        reader->page_index = bulk->runs[i];
+        reader->end_index = (i + 1 < bulk->run_count) ? bulk->runs[i + 1] : bulk->run_page_count;
+        err = btr_bulk_reader_open_page(bulk, reader);
+    }
+
+    for (uint32 i = 0; i < reader_count; i++) {
+        if (readers[i].rec != NULL) {
+            heap[count++] = &readers[i];
+        }
+    }
+    for (uint32 i = count / 2; i > 0; i--) {
+        btr_bulk_heap_sift_down(heap, count, i - 1);
+    }
+
+    while (err == CM_SUCCESS && count > 0) {
+        btr_bulk_reader_t* reader = heap[0];
+
+        err = btr_bulk_build_rec(bulk, reader->rec);
+        if (err == CM_SUCCESS) {
+            err = btr_bulk_reader_next(bulk, reader);
+        }
+        if (reader->rec == NULL) {
+            heap[0] = heap[--count];
+        }
+        btr_bulk_heap_sift_down(heap, count, 0);
+    }
+
+    // runs are left open only on error
+    for (uint32 i = 1; i < reader_count; i++) {
+        if (readers[i].rec != NULL) {
+            vm_close(pool, bulk->run_pages[readers[i].page_index]);
+        }
+    }
+    ut_free(readers);
+
+    return err;
+}
+
+/*-------------------------------------------------- */
+// interface
+
+status_t btr_bulk_begin(btr_bulk_t* bulk, dict_index_t* index)
+{
+    const page_size_t page_size(index->space_id);
+    uint32 fill_factor = srv_index_build_fill_factor;
+
+    if (fill_factor < 50) {
+        fill_factor = 50;
+    } else if (fill_factor > 100) {
+        fill_factor = 100;
+    }
+
+    memset(bulk, 0x00, sizeof(btr_bulk_t));
+    bulk->index = index;
+    bulk->physical_size = page_size.physical();
+    bulk->fill_size = BTR_PAGE_MAX_DATA_SIZE(bulk->physical_size) * fill_factor / 100;
+    bulk->is_unique = (index->type & DICT_UNIQUE) ? TRUE : FALSE;
+
+    // a full buffer holds at least a run page of records
+    bulk->buf_size = ut_max(srv_index_build_sort_buffer_size, srv_temp_mem_pool->page_size) & ~(uint32)7;
+    bulk->buf = (byte *)ut_malloc(bulk->buf_size);
+    if (bulk->buf == NULL) {
+        CM_SET_ERROR(ERR_ALLOC_MEMORY, bulk->buf_size, "index build");
+        return CM_ERROR;
+    }
+
+    return CM_SUCCESS;
+}
+
+status_t btr_bulk_add(btr_bulk_t* bulk, const byte* key, uint32 key_len, uint64 value)
+{
+    if (key_len > btr_get_max_key_len(bulk->physical_size)) {
+        CM_SET_ERROR(ERR_ROW_RECORD_TOO_BIG, key_len);
+        return CM_ERROR;
+    }
+
+    uint32 size = BTR_REC_KEY + key_len;
+    if (bulk->buf_used + size + (bulk->buf_rec_count + 1) * sizeof(byte*) > bulk->buf_size) {
+        CM_RETURN_IF_ERROR(btr_bulk_spill(bulk));
+    }
+
+    byte* rec = bulk->buf + bulk->buf_used;
+    btr_rec_build(rec, key, key_len, value, FIL_NULL, 0);
+    bulk->buf_used += size;
+    bulk->buf_rec_count++;
+    btr_bulk_buf_recs(bulk)[0] = rec;
+
+    return CM_SUCCESS;
+}
+
+#ifdef UNIV_DEBUG
+// Checks the built tree: every level is a chain of pages whose count equals the records of the
+// level above, and a full scan of cursor returns all records in order.
+static void btr_bulk_validate(btr_bulk_t* bulk)
+{
+    dict_index_t* index = bulk->index;
+    const page_size_t page_size(index->space_id);
+    page_no_t page_no = index->entry_page_no;
+    uint64 parent_rec_count = 1;
+    btr_pcur_t pcur;
+
+    for (uint32 level = bulk->height; level > 0; level--) {
+        page_no_t first_child = FIL_NULL;
+        uint64 page_count = 0;
+        uint64 rec_count = 0;
+
+        while (page_no != FIL_NULL) {
+            const page_id_t page_id(index->space_id, page_no);
+            mtr_t mtr;
+
+            mtr_start(&mtr);
+            buf_block_t* block = buf_page_get(page_id, page_size, RW_S_LATCH, &mtr);
+            page_t* page = buf_block_get_frame(block);
+            uint32 n_recs = btr_page_get_n_recs(page);
+
+            ut_a(btr_page_get_level(page) == level - 1);
+            ut_a(n_recs > 0);
+            if (first_child == FIL_NULL && level > 1) {
+                first_child = btr_node_ptr_get_child(btr_page_get_rec(page, bulk->physical_size, 0));
+            }
+            page_count++;
+            rec_count += n_recs;
+            page_no = mach_read_from_4(page + FIL_PAGE_NEXT);
+            mtr_commit(&mtr);
+        }
+
+        ut_a(page_count == parent_rec_count);
+        parent_rec_count = rec_count;
+        page_no = first_child;
+    }
+    ut_a(parent_rec_count == bulk->rec_count);
+
+    uint64 rec_count = 0;
+    uint64 last_value = 0;
+    uint32 last_key_len = 0;
+    byte last_key[BTR_KEY_MAX_LEN];
+
+    btr_pcur_open_at_side(index, TRUE, &pcur);
+    while (btr_pcur_is_on_rec(&pcur)) {
+        if (rec_count > 0) {
+            int32 ret = memcmp(last_key, pcur.key, ut_min(last_key_len, pcur.key_len));
+            ut_a(ret < 0 || (ret == 0 && (last_key_len < pcur.key_len ||
+                (last_key_len == pcur.key_len && !bulk->is_unique && last_value < pcur.value))));
+        }
+        memcpy(last_key, pcur.key, pcur.key_len);
+        last_key_len = pcur.key_len;
+        last_value = pcur.value;
+        rec_count++;
+        btr_pcur_move_to_next(&pcur);
+    }
+    ut_a(rec_count == bulk->rec_count);
+}
+#endif
+
+status_t btr_bulk_finish(btr_bulk_t* bulk)
+{
+    dict_index_t* index = bulk->index;
+
+    CM_RETURN_IF_ERROR(btr_bulk_merge(bulk));
+    if (bulk->height == 0) {
+        return CM_SUCCESS;
+    }
+
+    // the last page of every level, pages below the top level are allocated already
+    for (uint32 level = 0; level + 1 < bulk->height; level++) {
+        btr_bulk_level_t* lvl = &bulk->levels[level];
+        btr_bulk_write_page(bulk, lvl->page, lvl->page_no, lvl->prev_page_no, FIL_NULL);
+    }
+
+    btr_bulk_level_t* top = &bulk->levels[bulk->height - 1];
+    ut_a(top->page_count == 1 && top->page_no == FIL_NULL);
+    btr_bulk_write_page(bulk, top->page, index->entry_page_no, FIL_NULL, FIL_NULL);
+    bulk->is_finished = TRUE;
+    ut_d(btr_bulk_validate(bulk));
+
+    LOGGER_INFO(LOGGER, LOG_MODULE_INDEX_BTREE,
+        "btr_bulk_finish: index %s, %llu records, %u runs, height %u",
+        index->name, bulk->rec_count, bulk->run_count, bulk->height);
+
+    return CM_SUCCESS;
+}
+
+void btr_bulk_end(btr_bulk_t* bulk)
+{
+    if (!bulk->is_finished && bulk->index != NULL) {
+        btr_bulk_free_pages(bulk);
+    }
+    ut_free(bulk->pages);
+
+    for (uint32 i = 0; i < bulk->run_page_count; i++) {
+        if (bulk->run_pages[i] != NULL) {
+            vm_free(srv_temp_mem_pool, bulk->run_pages[i]);
+        }
+    }
+    ut_free(bulk->run_pages);
+    ut_free(bulk->runs);
+    ut_free(bulk->buf);
+
+    for (uint32 level = 0; level < BTR_MAX_LEVELS; level++) {
+        ut_free(bulk->levels[level].page);
+    }
+
+    memset(bulk, 0x00, sizeof(btr_bulk_t));
+}
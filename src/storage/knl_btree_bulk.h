@@ -0,0 +1,73 @@
+#ifndef _KNL_BTREE_BULK_H
+#define _KNL_BTREE_BULK_H
+
+#include "cm_type.h"
+#include "cm_vm_pool.h"
+#include "knl_btree.h"
+#include "knl_dict.h"
+
+// Bulk build of an empty B+tree from unordered records.
+//
+// Records are appended to a sort buffer of srv_index_build_sort_buffer_size,
+// a full buffer is sorted and written as a run into pages of srv_temp_mem_pool,
+// which swaps them to disk under memory pressure. At finish, runs and the rest
+// of buffer are merged by a min-heap, and the sorted records are placed into
+// leaf pages from left to right, every level keeps one page being filled in
+// memory and a full page gets a node pointer in the level above. A page is
+// written in one mini-transaction as a whole image, so the build produces no
+// redo of single records. The top page is copied into the root at last.
+//
+// Caller must ensure that there is no dml on the index during build. Pages of
+// an unfinished build are freed by btr_bulk_end.
+
+// a run page is the used length and records, a record never spans pages
+#define BTR_BULK_RUN_USED            0   // 4 bytes
+#define BTR_BULK_RUN_RECS            4
+
+typedef struct st_btr_bulk_level {
+    page_t*         page;          // image of the page being filled
+    page_no_t       page_no;       // page allocated for image
+    page_no_t       prev_page_no;
+    uint32          page_count;
+} btr_bulk_level_t;
+
+typedef struct st_btr_bulk {
+    dict_index_t*   index;
+    uint32          physical_size;
+    uint32          fill_size;     // data size of a full page
+    bool32          is_unique;
+
+    // sort buffer, records from the begin, pointers to them from the end
+    byte*           buf;
+    uint32          buf_size;
+    uint32          buf_used;
+    uint32          buf_rec_count;
+
+    // pages of sorted runs in srv_temp_mem_pool, NULL if freed by merge
+    vm_ctrl_t**     run_pages;
+    uint32          run_page_count;
+    uint32          max_run_page_count;
+    uint32*         runs;  // index of the first page of each run
+    uint32          run_count;
+    uint32          max_run_count;
+
+    // pages allocated for levels, freed by btr_bulk_end if the build fails
+    page_no_t*      pages;
+    uint32          page_count;
+    uint32          max_page_count;
+    bool32          is_finished;
+
+    uint32          height;
+    btr_bulk_level_t levels[BTR_MAX_LEVELS];
+    uint64          rec_count;
+    byte            last_rec[BTR_REC_KEY + BTR_KEY_MAX_LEN];  // for duplicate check of unique index
+} btr_bulk_t;
+
+extern status_t btr_bulk_begin(btr_bulk_t* bulk, dict_index_t* index);
+extern status_t btr_bulk_add(btr_bulk_t* bulk, const byte* key, uint32 key_len, uint64 value);
+// Merges the records and builds the tree, the root is unchanged if there is no record
+extern status_t btr_bulk_finish(btr_bulk_t* bulk);
+// Frees memory and runs of bulk, must be called after btr_bulk_begin whether or not it is finished
+extern void btr_bulk_end(btr_bulk_t* bulk);
+
+#endif  /* _KNL_BTREE_BULK_H */
@@ -1190,6 +1190,38 @@ static void buf_pool_create_instance(buf_pool_t* buf_pool,
 
     memset(&buf_pool->stat, 0x00, sizeof(buf_pool->stat));
 
+    /* 3. Initialize delayed cleanout queue */
+    mutex_create(&buf_pool->cleanout_mutex);
+    if (srv_delayed_cleanout_queue_size > 0) {
+        buf_pool->cleanout_pages = (buf_cleanout_page_t *)ut_malloc_zero(
+            srv_delayed_cleanout_queue_size * sizeof(buf_cleanout_page_t));
+        if (buf_pool->cleanout_pages == NULL) {
+            *err = CM_ERROR;
+            return;
+        }
+    }
+    buf_pool->cleanout_head = 0;
+    buf_pool->cleanout_count = 0;
+
+    /* 4. Initialize consistent read pages */
+    mutex_create(&buf_pool->cr_mutex);
+    UT_LIST_INIT(buf_pool->cr_LRU);
+    if (srv_cr_pages_per_instance > 0) {
+        buf_pool->cr_hash_size = srv_cr_pages_per_instance * 2;
+        buf_pool->cr_pages = (buf_cr_page_t *)ut_malloc_zero(srv_cr_pages_per_instance * sizeof(buf_cr_page_t));
+        buf_pool->cr_frames = (byte *)ut_malloc_zero((uint64)srv_cr_pages_per_instance * UNIV_PAGE_SIZE);
+        buf_pool->cr_hash = (buf_cr_page_t **)ut_malloc_zero(buf_pool->cr_hash_size * sizeof(buf_cr_page_t *));
+        if (buf_pool->cr_pages == NULL || buf_pool->cr_frames == NULL || buf_pool->cr_hash == NULL) {
+            *err = CM_ERROR;
+            return;
+        }
+        for (uint32 i = 0; i < srv_cr_pages_per_instance; i++) {
+            buf_cr_page_t* cr_page = &buf_pool->cr_pages[i];
+            cr_page->page_no = FIL_NULL;
+            cr_page->frame = buf_pool->cr_frames + (uint64)i * UNIV_PAGE_SIZE;
+            UT_LIST_ADD_LAST(LRU_node, buf_pool->cr_LRU, cr_page);
+        }
+    }
 
     *err = CM_SUCCESS;
 }
@@ -1203,6 +1235,24 @@ static void buf_pool_free_instance(buf_pool_t *buf_pool)
     mutex_destroy(&buf_pool->free_list_mutex);
     mutex_destroy(&buf_pool->flush_state_mutex);
     mutex_destroy(&buf_pool->flush_list_mutex);
+    mutex_destroy(&buf_pool->cleanout_mutex);
+    if (buf_pool->cleanout_pages) {
+        ut_free(buf_pool->cleanout_pages);
+        buf_pool->cleanout_pages = NULL;
+    }
+    mutex_destroy(&buf_pool->cr_mutex);
+    if (buf_pool->cr_pages) {
+        ut_free(buf_pool->cr_pages);
+        buf_pool->cr_pages = NULL;
+    }
+    if (buf_pool->cr_frames) {
+        ut_free(buf_pool->cr_frames);
+        buf_pool->cr_frames = NULL;
+    }
+    if (buf_pool->cr_hash) {
+        ut_free(buf_pool->cr_hash);
+        buf_pool->cr_hash = NULL;
+    }
 
     for (bpage = UT_LIST_GET_LAST(buf_pool->LRU); bpage != NULL; bpage = prev_bpage) {
         prev_bpage = UT_LIST_GET_PREV(LRU_list_node, bpage);
@@ -1374,6 +1424,94 @@ lsn_t buf_pool_get_recovery_lsn(void)
     return recovery_lsn;
 }
 
+static inline uint32 buf_cr_page_hash(buf_pool_t* buf_pool, uint32 space_id, uint32 page_no)
+{
+    return ((space_id << 20) + space_id + page_no) % buf_pool->cr_hash_size;
+}
+
+static void buf_cr_page_hash_remove(buf_pool_t* buf_pool, buf_cr_page_t* cr_page)
+{
+    buf_cr_page_t** prev = &buf_pool->cr_hash[buf_cr_page_hash(buf_pool, cr_page->space_id, cr_page->page_no)];
+
+    while (*prev != cr_page) {
+        ut_ad(*prev != NULL);
+        prev = &(*prev)->hash_next;
+    }
+    *prev = cr_page->hash_next;
+    cr_page->hash_next = NULL;
+    cr_page->page_no = FIL_NULL;
+}
+
+// Copies the image of page built for a snapshot in [low_scn, high_scn] into frame.
+// Images built from an older version of page are stale, they are released when found.
+bool32 buf_cr_page_get(const page_id_t& page_id, lsn_t lsn, uint64 query_scn, byte* frame, uint32 size)
+{
+    buf_pool_t* buf_pool = buf_pool_from_page_id(page_id);
+    buf_cr_page_t *cr_page, *next;
+    bool32 found = FALSE;
+
+    if (buf_pool->cr_pages == NULL) {
+        return FALSE;
+    }
+
+    mutex_enter(&buf_pool->cr_mutex, NULL);
+    cr_page = buf_pool->cr_hash[buf_cr_page_hash(buf_pool, page_id.get_space_id(), page_id.get_page_no())];
+    for (; cr_page != NULL; cr_page = next) {
+        next = cr_page->hash_next;
+        if (cr_page->space_id != page_id.get_space_id() || cr_page->page_no != page_id.get_page_no()) {
+            continue;
+        }
+        if (cr_page->lsn < lsn) {
+            buf_cr_page_hash_remove(buf_pool, cr_page);
+            UT_LIST_REMOVE(LRU_node, buf_pool->cr_LRU, cr_page);
+            UT_LIST_ADD_LAST(LRU_node, buf_pool->cr_LRU, cr_page);
+            continue;
+        }
+        if (cr_page->lsn == lsn && cr_page->low_scn <= query_scn && query_scn <= cr_page->high_scn) {
+            memcpy(frame, cr_page->frame, size);
+            UT_LIST_REMOVE(LRU_node, buf_pool->cr_LRU, cr_page);
+            UT_LIST_ADD_FIRST(LRU_node, buf_pool->cr_LRU, cr_page);
+            found = TRUE;
+            break;
+        }
+    }
+    mutex_exit(&buf_pool->cr_mutex);
+
+    return found;
+}
+
+// Caches the image of page in place of the least recently used one
+void buf_cr_page_put(const page_id_t& page_id, lsn_t lsn, uint64 low_scn, uint64 high_scn,
+    const byte* frame, uint32 size)
+{
+    buf_pool_t* buf_pool = buf_pool_from_page_id(page_id);
+    buf_cr_page_t* cr_page;
+    uint32 hash;
+
+    if (buf_pool->cr_pages == NULL || size > UNIV_PAGE_SIZE) {
+        return;
+    }
+
+    mutex_enter(&buf_pool->cr_mutex, NULL);
+    cr_page = UT_LIST_GET_LAST(buf_pool->cr_LRU);
+    if (cr_page->page_no != FIL_NULL) {
+        buf_cr_page_hash_remove(buf_pool, cr_page);
+    }
+    cr_page->space_id = page_id.get_space_id();
+    cr_page->page_no = page_id.get_page_no();
+    cr_page->lsn = lsn;
+    cr_page->low_scn = low_scn;
+    cr_page->high_scn = high_scn;
+    memcpy(cr_page->frame, frame, size);
+
+    hash = buf_cr_page_hash(buf_pool, cr_page->space_id, cr_page->page_no);
+    cr_page->hash_next = buf_pool->cr_hash[hash];
+    buf_pool->cr_hash[hash] = cr_page;
+    UT_LIST_REMOVE(LRU_node, buf_pool->cr_LRU, cr_page);
+    UT_LIST_ADD_FIRST(LRU_node, buf_pool->cr_LRU, cr_page);
+    mutex_exit(&buf_pool->cr_mutex);
+}
+
 // Invalidates file pages in one buffer pool instance
 static void buf_pool_invalidate_instance(buf_pool_t *buf_pool)
 {
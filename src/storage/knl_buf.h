@@ -241,6 +241,29 @@ typedef enum en_buf_flush {
     BUF_FLUSH_N_TYPES      /*!< index of last element + 1  */
 } buf_flush_t;
 
+// page whose itl is left active by a committed trx, cleaned by delayed cleanout threads
+typedef struct st_buf_cleanout_page {
+    uint32       space_id;
+    uint32       page_no;
+    buf_block_t* block;        // guess block, page may be evicted or reused
+    uint64       trx_slot_id;
+    uint64       scn;          // commit scn of trx
+    uint8        itl_id;
+} buf_cleanout_page_t;
+
+// consistent read image of a page, rows of image are the versions seen by snapshots in [low_scn, high_scn]
+typedef struct st_buf_cr_page buf_cr_page_t;
+struct st_buf_cr_page {
+    uint32          space_id;
+    uint32          page_no;  // FIL_NULL if slot is unused
+    lsn_t           lsn;      // newest modification of page the image is built from
+    uint64          low_scn;
+    uint64          high_scn;
+    byte*           frame;
+    buf_cr_page_t*  hash_next;
+    UT_LIST_NODE_T(buf_cr_page_t) LRU_node;
+};
+
 typedef struct st_buf_pool {
     mutex_t    mutex;      /*!< Buffer pool mutex of this instance */
 
@@ -351,6 +374,20 @@ typedef struct st_buf_pool {
     // NOTE: LRU_old_len must be adjusted whenever LRU_old shrinks or grows!
     uint32 LRU_old_len;
 
+    mutex_t cleanout_mutex;  /*!< protects cleanout_pages */
+    // ring of pages queued for delayed cleanout, srv_delayed_cleanout_queue_size entries
+    buf_cleanout_page_t* cleanout_pages;
+    uint32 cleanout_head;
+    uint32 cleanout_count;
+
+    mutex_t cr_mutex;  /*!< protects consistent read pages */
+    // srv_cr_pages_per_instance images, the least recently used one is replaced
+    buf_cr_page_t* cr_pages;
+    byte* cr_frames;
+    buf_cr_page_t** cr_hash;
+    uint32 cr_hash_size;
+    UT_LIST_BASE_NODE_T(buf_cr_page_t) cr_LRU;
+
 } buf_pool_t;
 
 
@@ -362,6 +399,10 @@ extern inline buf_pool_t* buf_pool_from_bpage(const buf_page_t *bpage);
 extern inline buf_pool_t* buf_pool_from_block(const buf_block_t *block);
 extern lsn_t buf_pool_get_recovery_lsn(void);
 
+extern bool32 buf_cr_page_get(const page_id_t& page_id, lsn_t lsn, uint64 query_scn, byte* frame, uint32 size);
+extern void buf_cr_page_put(const page_id_t& page_id, lsn_t lsn, uint64 low_scn, uint64 high_scn,
+    const byte* frame, uint32 size);
+
 
 
 
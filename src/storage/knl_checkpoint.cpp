@@ -17,25 +17,28 @@ status_t checkpoint_init(char* dbwr_file_name, uint64 dbwr_file_size)
     mutex_create(&checkpoint->mutex);
     checkpoint->group.item_count = 0;
     checkpoint->group.buf_size = CHECKPOINT_GROUP_MAX_SIZE * UNIV_PAGE_SIZE;
-    checkpoint->group.buf = (char *)ut_malloc(checkpoint->group.buf_size);
-    if (checkpoint->group.buf == NULL) {
+    checkpoint->group.buf_ptr = (char *)ut_malloc(checkpoint->group.buf_size + UNIV_PAGE_SIZE);
+    if (checkpoint->group.buf_ptr == NULL) {
         LOGGER_ERROR(LOGGER, LOG_MODULE_CHECKPOINT, "checkpoint_init: failed to malloc doublewrite memory");
         return CM_ERROR;
     }
+    // aligned for direct i/o of data files and doublewrite file
+    checkpoint->group.buf = (char *)ut_align_up(checkpoint->group.buf_ptr, UNIV_PAGE_SIZE);
     checkpoint->flush_timeout_us = 1000000 * 300; // 300s
     
     checkpoint->enable_double_write = TRUE;
     checkpoint->double_write.name = dbwr_file_name;
     checkpoint->double_write.size = dbwr_file_size;
 
-    if (!os_open_file(dbwr_file_name, OS_FILE_OPEN, OS_FILE_AIO, &checkpoint->double_write.handle)) {
+    if (!os_open_file(dbwr_file_name, OS_FILE_OPEN,
+            OS_FILE_AIO | (srv_dblwr_file_direct_io ? OS_FILE_DIRECT_IO : 0), &checkpoint->double_write.handle)) {
         char err_info[CM_ERR_MSG_MAX_LEN];
         os_file_get_last_error_desc(err_info, CM_ERR_MSG_MAX_LEN);
         LOGGER_ERROR(LOGGER, LOG_MODULE_CHECKPOINT,
             "checkpoint_init: failed to open doublewrite file, name %s, error desc %s",
             dbwr_file_name, err_info);
 
-        ut_free(checkpoint->group.buf);
+        ut_free(checkpoint->group.buf_ptr);
         return CM_ERROR;
     }
 
@@ -44,7 +47,7 @@ status_t checkpoint_init(char* dbwr_file_name, uint64 dbwr_file_size)
     uint32 io_context_count = 1;
     checkpoint->double_write.aio_array = os_aio_array_create(io_pending_count_per_context, io_context_count);
     if (checkpoint->double_write.aio_array == NULL) {
-        ut_free(checkpoint->group.buf);
+        ut_free(checkpoint->group.buf_ptr);
         os_close_file(checkpoint->double_write.handle);
         LOGGER_ERROR(LOGGER, LOG_MODULE_CHECKPOINT, "checkpoint_init: failed to create aio array for doublewrite");
         return CM_ERROR;
@@ -80,6 +83,9 @@ static uint64 checkpoint_copy_item(checkpoint_t* checkpoint,
     mach_write_to_8(block->frame + FIL_PAGE_LSN, newest_modification);
     memcpy(checkpoint->group.buf + UNIV_PAGE_SIZE * checkpoint->group.item_count,
         block->frame, block->page.size.physical());
+    // page trailer lsn, used to detect torn page
+    mach_write_to_8(checkpoint->group.buf + UNIV_PAGE_SIZE * checkpoint->group.item_count +
+        block->page.size.physical() - FIL_PAGE_END_LSN, newest_modification);
 
     // 2 reset page.recovery_lsn and remove block from buf_pool->flush_list
     mutex_enter(&buf_pool->flush_list_mutex);
@@ -94,6 +100,7 @@ static uint64 checkpoint_copy_item(checkpoint_t* checkpoint,
     checkpoint_sort_item_t* item = &checkpoint->group.items[checkpoint->group.item_count];
     item->page_id.copy_from(block->page.id);
     item->buf_id = checkpoint->group.item_count;
+    item->merged_count = 1;
     item->is_flushed = FALSE;
     checkpoint->group.item_count++;
 
@@ -267,7 +274,10 @@ static status_t checkpoint_flush_callback(int32 code, os_aio_slot_t* slot)
         ut_error;
     }
 
-    item->is_flushed = TRUE;
+    // all pages of a merged write are completed together
+    for (uint32 i = 0; i < item->merged_count; i++) {
+        item[i].is_flushed = TRUE;
+    }
 
     fil_node_t* node = (fil_node_t*)slot->message1;
     ut_ad(node);
@@ -277,24 +287,74 @@ static status_t checkpoint_flush_callback(int32 code, os_aio_slot_t* slot)
     return CM_SUCCESS;
 }
 
+// Gets the number of sorted items from begin which are consecutive pages of one data file,
+// they are written by one vectored i/o of not more than srv_checkpoint_io_merge_size bytes.
+static uint32 checkpoint_get_merge_count(checkpoint_t* checkpoint,
+    uint32 begin, uint32 end, const page_size_t &page_size)
+{
+    checkpoint_sort_item_t* first = &checkpoint->group.items[begin];
+    checkpoint_sort_item_t* item;
+    uint32 max_count, count = 1;
+
+#ifdef __WIN__
+    // vectored aio is not supported
+    return 1;
+#endif
+
+    max_count = srv_checkpoint_io_merge_size / page_size.physical();
+    if (max_count > OS_AIO_IOV_MAX_COUNT) {
+        max_count = OS_AIO_IOV_MAX_COUNT;
+    }
+
+    while (begin + count < end && count < max_count) {
+        item = &checkpoint->group.items[begin + count];
+        if (item->page_id.get_space_id() != first->page_id.get_space_id() ||
+            item->page_id.get_page_no() != first->page_id.get_page_no() + count) {
+            break;
+        }
+        count++;
+    }
+
+    if (count > 1) {
+        // a write can not cross the end of data file
+        uint32 file_page_count = fil_get_contiguous_page_count(first->page_id);
+        if (file_page_count == 0) {
+            count = 1;
+        } else if (count > file_page_count) {
+            count = file_page_count;
+        }
+    }
+
+    return count;
+}
+
 static status_t checkpoint_write_pages(checkpoint_t* checkpoint, uint32 begin, uint32 end)
 {
     status_t err;
+    uint32 merged_count;
     checkpoint_sort_item_t* item;
 
-    for (uint32 i = begin; i < end; i++) {
+    for (uint32 i = begin; i < end; i += merged_count) {
         item = &checkpoint->group.items[i];
         const page_size_t page_size(item->page_id.get_space_id());
 
-        // checkpoint->group.buf is aligned by UNIV_PAGE_SIZE
-        err = fil_write(FALSE, item->page_id, page_size, page_size.physical(),
-            checkpoint->group.buf + UNIV_PAGE_SIZE * item->buf_id,
-            checkpoint_flush_callback, item);
+        merged_count = checkpoint_get_merge_count(checkpoint, i, end, page_size);
+        for (uint32 j = 0; j < merged_count; j++) {
+            // checkpoint->group.buf is aligned by UNIV_PAGE_SIZE
+            os_iovec_t* iov = &checkpoint->group.iovs[i + j];
+            iov->iov_base = checkpoint->group.buf + UNIV_PAGE_SIZE * item[j].buf_id;
+            iov->iov_len = page_size.physical();
+        }
+        item->merged_count = merged_count;
+
+        err = fil_writev(FALSE, item->page_id, page_size,
+            &checkpoint->group.iovs[i], merged_count, checkpoint_flush_callback, item);
         if (err != CM_SUCCESS) {
             LOGGER_FATAL(LOGGER, LOG_MODULE_CHECKPOINT,
                 "checkpoint_flush: fatal error occurred for fil_write, service exited");
             ut_error;
         }
+        checkpoint->stat.disk_write_requests++;
     }
 
     uint32 count = 0;
@@ -396,6 +456,7 @@ static bool32 checkpoint_double_write(checkpoint_t* checkpoint)
 
     aio_ctx = os_aio_array_alloc_context(checkpoint->double_write.aio_array);
     ut_ad(aio_ctx);
+    fil_io_class_enter(FIL_IO_CLASS_DBLWR, UNIV_PAGE_SIZE * checkpoint->group.item_count);
     aio_slot = os_file_aio_submit(aio_ctx, OS_FILE_WRITE,
         checkpoint->double_write.name, checkpoint->double_write.handle,
         (void *)checkpoint->group.buf, UNIV_PAGE_SIZE *checkpoint->group.item_count, 0);
@@ -410,6 +471,7 @@ static bool32 checkpoint_double_write(checkpoint_t* checkpoint)
 
     bool32 ret = TRUE;
     int32 err = os_file_aio_context_wait(aio_ctx, &aio_slot, checkpoint->flush_timeout_us);
+    fil_io_class_exit(FIL_IO_CLASS_DBLWR);
     switch (err) {
     case OS_FILE_IO_COMPLETION:
         break;
@@ -15,14 +15,18 @@
 typedef struct st_checkpoint_sort_item {
     page_id_t       page_id;
     uint32          buf_id;
+    uint32          merged_count;  // number of items written by one i/o starting from this item
     volatile bool32 is_flushed;
 } checkpoint_sort_item_t;
 
 typedef struct st_checkpoint_group {
     uint32 item_count;
     uint32 buf_size;
-    char*  buf;
+    char*  buf_ptr; // unaligned buffer
+    char*  buf;     // aligned by UNIV_PAGE_SIZE
     checkpoint_sort_item_t items[CHECKPOINT_GROUP_MAX_SIZE];
+    // iovs[i] describes the page of items[i] when consecutive pages are merged into one write
+    os_iovec_t             iovs[CHECKPOINT_GROUP_MAX_SIZE];
 } checkpoint_group_t;
 
 typedef struct st_checkpoint_dbwr {
@@ -37,6 +41,7 @@ typedef struct st_checkpoint_stat {
     uint64 double_writes;
     uint64 double_write_time;
     uint64 disk_writes;
+    uint64 disk_write_requests;  // number of i/o requests for disk_writes pages
     uint64 disk_write_time;
     uint64 ckpt_total_neighbors_times;
     uint64 ckpt_total_neighbors_len;
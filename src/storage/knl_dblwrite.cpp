@@ -1,4 +1,11 @@
 #include "knl_dblwrite.h"
+#include "cm_log.h"
+#include "cm_util.h"
+#include "cm_atomic.h"
+#include "cm_date.h"
+#include "knl_file_system.h"
+#include "knl_page_size.h"
+#include "knl_server.h"
 
 bool32    buf_dblwr_being_created = FALSE;
 
@@ -28,3 +35,311 @@ bool32 buf_dblwr_page_inside(const page_id_t &page_id)
     return(FALSE);
 }
 
+/*-------------------------------------------------- */
+
+typedef struct st_dblwr_restore_batch dblwr_restore_batch_t;
+
+typedef struct st_dblwr_restore_page {
+    dblwr_restore_batch_t* batch;
+    page_id_t              page_id;
+    byte*                  dblwr_page; // intact copy in doublewrite file
+    byte*                  data_page;  // page read from data file
+    bool32                 is_read_failed;
+} dblwr_restore_page_t;
+
+struct st_dblwr_restore_batch {
+    uint32                 page_count;
+    atomic32_t             io_count;   // completed i/o of current step
+    byte*                  dblwr_buf;
+    byte*                  data_buf;
+    dblwr_restore_page_t   pages[DBLWR_RESTORE_BATCH_PAGES];
+};
+
+// A page image is complete if the lsn in page header equals to the lsn in page trailer,
+// checkpoint stamps both of them before the page is written.
+// The trailer of a page written before the stamp is 0, there is no page checksum to
+// check such a page, it is taken as intact if the header is of the page.
+static inline bool32 buf_dblwr_page_is_intact(const byte* page, const page_id_t &page_id,
+    const page_size_t &page_size)
+{
+    lsn_t end_lsn = mach_read_from_8(page + page_size.physical() - FIL_PAGE_END_LSN);
+
+    if (end_lsn == 0) {
+        return mach_read_from_4(page + FIL_PAGE_SPACE) == page_id.get_space_id() &&
+               mach_read_from_4(page + FIL_PAGE_OFFSET) == page_id.get_page_no();
+    }
+
+    return mach_read_from_8(page + FIL_PAGE_LSN) == end_lsn;
+}
+
+static status_t buf_dblwr_restore_io_callback(int32 code, os_aio_slot_t* slot)
+{
+    dblwr_restore_page_t* page = (dblwr_restore_page_t *)slot->message2;
+
+    if (code != OS_FILE_IO_COMPLETION) {
+        if (slot->type == OS_FILE_WRITE) {
+            char err_info[CM_ERR_MSG_MAX_LEN];
+            os_file_get_error_desc_by_err(code, err_info, CM_ERR_MSG_MAX_LEN);
+            LOGGER_FATAL(LOGGER, LOG_MODULE_RECOVERY,
+                "buf_dblwr_restore: fatal error occurred for writing page (space id %lu, page no %lu), "
+                "error = %d err desc = %s, service exited",
+                page->page_id.get_space_id(), page->page_id.get_page_no(), code, err_info);
+            ut_error;
+        }
+        // page is beyond the end of data file, it has never been written completely
+        page->is_read_failed = TRUE;
+    }
+
+    fil_node_t* node = (fil_node_t *)slot->message1;
+    ut_ad(node);
+    fil_node_complete_io(node, slot->type);
+
+    atomic32_inc(&page->batch->io_count);
+
+    return CM_SUCCESS;
+}
+
+static status_t buf_dblwr_restore_wait_io(dblwr_restore_batch_t* batch, uint32 io_count)
+{
+    uint32 wait_loop = 0, wait_count = srv_read_io_timeout_seconds * MILLISECS_PER_SECOND;
+
+    while ((uint32)atomic32_get(&batch->io_count) < io_count && wait_loop < wait_count) {
+        os_thread_sleep(1000);
+        wait_loop++;
+    }
+    if (wait_loop == wait_count) {
+        LOGGER_ERROR(LOGGER, LOG_MODULE_RECOVERY,
+            "buf_dblwr_restore: IO timeout(%u seconds) for data file pages", srv_read_io_timeout_seconds);
+        return CM_ERROR;
+    }
+
+    return CM_SUCCESS;
+}
+
+// Returns the page of batch with page_id, NULL if not found
+static dblwr_restore_page_t* buf_dblwr_restore_find_page(dblwr_restore_batch_t* batch, const page_id_t &page_id)
+{
+    for (uint32 i = 0; i < batch->page_count; i++) {
+        if (batch->pages[i].page_id.equals_to(page_id)) {
+            return &batch->pages[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Collects the valid pages of doublewrite buffer into batch,
+// a slot of doublewrite file is UNIV_PAGE_SIZE whatever the page size of tablespace is.
+// A page may be written to doublewrite file several times, only the newest copy is kept,
+// so that two writes of one page are never issued together.
+static void buf_dblwr_restore_collect_pages(dblwr_restore_batch_t* batch, uint32 slot_count)
+{
+    batch->page_count = 0;
+
+    for (uint32 i = 0; i < slot_count; i++) {
+        byte* dblwr_page = batch->dblwr_buf + i * UNIV_PAGE_SIZE;
+        uint32 space_id = mach_read_from_4(dblwr_page + FIL_PAGE_SPACE);
+        uint32 page_no = mach_read_from_4(dblwr_page + FIL_PAGE_OFFSET);
+        const page_size_t page_size(space_id);
+        page_id_t page_id(space_id, page_no);
+
+        // slot never used, or torn in doublewrite file itself
+        if (mach_read_from_8(dblwr_page + FIL_PAGE_LSN) == 0 ||
+            !buf_dblwr_page_is_intact(dblwr_page, page_id, page_size)) {
+            continue;
+        }
+
+        if (fil_get_contiguous_page_count(page_id) == 0) {
+            // tablespace has been dropped
+            continue;
+        }
+
+        dblwr_restore_page_t* page = buf_dblwr_restore_find_page(batch, page_id);
+        if (page != NULL) {
+            if (mach_read_from_8(dblwr_page + FIL_PAGE_LSN) > mach_read_from_8(page->dblwr_page + FIL_PAGE_LSN)) {
+                page->dblwr_page = dblwr_page;
+            }
+            continue;
+        }
+
+        page = &batch->pages[batch->page_count];
+        page->batch = batch;
+        page->page_id.copy_from(page_id);
+        page->dblwr_page = dblwr_page;
+        page->data_page = batch->data_buf + batch->page_count * UNIV_PAGE_SIZE;
+        page->is_read_failed = FALSE;
+        batch->page_count++;
+    }
+}
+
+static int buf_dblwr_page_id_cmp(const void* a, const void* b)
+{
+    const page_id_t* page_id1 = (const page_id_t *)a;
+    const page_id_t* page_id2 = (const page_id_t *)b;
+
+    if (page_id1->get_space_id() != page_id2->get_space_id()) {
+        return page_id1->get_space_id() < page_id2->get_space_id() ? -1 : 1;
+    }
+    if (page_id1->get_page_no() != page_id2->get_page_no()) {
+        return page_id1->get_page_no() < page_id2->get_page_no() ? -1 : 1;
+    }
+    return 0;
+}
+
+// Flushes every data file containing the restored pages once,
+// in order of page id a data file holds the pages up to its contiguous page count.
+static status_t buf_dblwr_restore_flush_files(page_id_t* page_ids, uint32 count)
+{
+    qsort(page_ids, count, sizeof(page_id_t), buf_dblwr_page_id_cmp);
+
+    uint32 i = 0;
+    while (i < count) {
+        if (!fil_flush_file_of_page(page_ids[i])) {
+            return CM_ERROR;
+        }
+
+        uint32 space_id = page_ids[i].get_space_id();
+        uint32 file_end = page_ids[i].get_page_no() + fil_get_contiguous_page_count(page_ids[i]);
+        i++;
+        while (i < count && page_ids[i].get_space_id() == space_id && page_ids[i].get_page_no() < file_end) {
+            i++;
+        }
+    }
+
+    return CM_SUCCESS;
+}
+
+static status_t buf_dblwr_restore_batch(dblwr_restore_batch_t* batch, uint32* restored_count)
+{
+    page_id_t written_page_ids[DBLWR_RESTORE_BATCH_PAGES];
+    uint32 write_count = 0;
+    status_t err;
+
+    // 1. read all data pages of batch in parallel
+    atomic32_test_and_set(&batch->io_count, 0);
+    for (uint32 i = 0; i < batch->page_count; i++) {
+        dblwr_restore_page_t* page = &batch->pages[i];
+        const page_size_t page_size(page->page_id.get_space_id());
+        err = fil_read(FALSE, page->page_id, page_size, page_size.physical(),
+            page->data_page, buf_dblwr_restore_io_callback, page);
+        CM_RETURN_IF_ERROR(err);
+    }
+    CM_RETURN_IF_ERROR(buf_dblwr_restore_wait_io(batch, batch->page_count));
+
+    // 2. overwrite torn or stale pages by the copy in doublewrite file
+    atomic32_test_and_set(&batch->io_count, 0);
+    for (uint32 i = 0; i < batch->page_count; i++) {
+        dblwr_restore_page_t* page = &batch->pages[i];
+        const page_size_t page_size(page->page_id.get_space_id());
+        lsn_t dblwr_lsn = mach_read_from_8(page->dblwr_page + FIL_PAGE_LSN);
+
+        if (!page->is_read_failed &&
+            buf_dblwr_page_is_intact(page->data_page, page->page_id, page_size) &&
+            mach_read_from_4(page->data_page + FIL_PAGE_SPACE) == page->page_id.get_space_id() &&
+            mach_read_from_4(page->data_page + FIL_PAGE_OFFSET) == page->page_id.get_page_no() &&
+            mach_read_from_8(page->data_page + FIL_PAGE_LSN) >= dblwr_lsn) {
+            continue;
+        }
+
+        LOGGER_NOTICE(LOGGER, LOG_MODULE_RECOVERY,
+            "buf_dblwr_restore: restoring page (space id %lu, page no %lu) from doublewrite, "
+            "data page lsn %llu %s, doublewrite page lsn %llu",
+            page->page_id.get_space_id(), page->page_id.get_page_no(),
+            page->is_read_failed ? 0 : mach_read_from_8(page->data_page + FIL_PAGE_LSN),
+            page->is_read_failed ? "(missing)" :
+                (buf_dblwr_page_is_intact(page->data_page, page->page_id, page_size) ? "(stale)" : "(torn)"),
+            dblwr_lsn);
+
+        err = fil_write(FALSE, page->page_id, page_size, page_size.physical(),
+            page->dblwr_page, buf_dblwr_restore_io_callback, page);
+        CM_RETURN_IF_ERROR(err);
+        written_page_ids[write_count].copy_from(page->page_id);
+        write_count++;
+    }
+    CM_RETURN_IF_ERROR(buf_dblwr_restore_wait_io(batch, write_count));
+
+    // 3. restored pages must be durable before redo is applied
+    CM_RETURN_IF_ERROR(buf_dblwr_restore_flush_files(written_page_ids, write_count));
+
+    *restored_count += write_count;
+
+    return CM_SUCCESS;
+}
+
+status_t buf_dblwr_restore_corrupt_pages(char* dbwr_file_name, uint64 dbwr_file_size)
+{
+    os_file_t handle;
+    uint64 file_size = 0;
+    uint32 restored_count = 0, checked_count = 0;
+    status_t err = CM_SUCCESS;
+    dblwr_restore_batch_t* batch;
+
+    if (!os_open_file(dbwr_file_name, OS_FILE_OPEN, 0, &handle)) {
+        char err_info[CM_ERR_MSG_MAX_LEN];
+        os_file_get_last_error_desc(err_info, CM_ERR_MSG_MAX_LEN);
+        LOGGER_ERROR(LOGGER, LOG_MODULE_RECOVERY,
+            "buf_dblwr_restore: failed to open doublewrite file, name %s, error desc %s",
+            dbwr_file_name, err_info);
+        return CM_ERROR;
+    }
+    if (!os_file_get_size(handle, &file_size)) {
+        os_close_file(handle);
+        return CM_ERROR;
+    }
+    if (file_size > dbwr_file_size) {
+        file_size = dbwr_file_size;
+    }
+
+    batch = (dblwr_restore_batch_t *)ut_malloc_zero(sizeof(dblwr_restore_batch_t) +
+        2 * DBLWR_RESTORE_BATCH_PAGES * UNIV_PAGE_SIZE + UNIV_PAGE_SIZE);
+    if (batch == NULL) {
+        os_close_file(handle);
+        LOGGER_ERROR(LOGGER, LOG_MODULE_RECOVERY, "buf_dblwr_restore: failed to malloc memory");
+        return CM_ERROR;
+    }
+    batch->dblwr_buf = (byte *)ut_align_up((byte *)batch + sizeof(dblwr_restore_batch_t), UNIV_PAGE_SIZE);
+    batch->data_buf = batch->dblwr_buf + DBLWR_RESTORE_BATCH_PAGES * UNIV_PAGE_SIZE;
+
+    LOGGER_INFO(LOGGER, LOG_MODULE_RECOVERY,
+        "buf_dblwr_restore: checking data file pages by doublewrite file %s, size %llu",
+        dbwr_file_name, file_size);
+
+    for (uint64 offset = 0; offset + UNIV_PAGE_SIZE <= file_size;
+         offset += DBLWR_RESTORE_BATCH_PAGES * UNIV_PAGE_SIZE) {
+        uint32 read_size = 0;
+        uint32 size = (uint32)ut_min(file_size - offset, (uint64)DBLWR_RESTORE_BATCH_PAGES * UNIV_PAGE_SIZE);
+
+        if (!os_pread_file(handle, offset, batch->dblwr_buf, size, &read_size)) {
+            char err_info[CM_ERR_MSG_MAX_LEN];
+            os_file_get_last_error_desc(err_info, CM_ERR_MSG_MAX_LEN);
+            LOGGER_ERROR(LOGGER, LOG_MODULE_RECOVERY,
+                "buf_dblwr_restore: failed to read doublewrite file, name %s, error desc %s",
+                dbwr_file_name, err_info);
+            err = CM_ERROR;
+            break;
+        }
+
+        buf_dblwr_restore_collect_pages(batch, read_size / UNIV_PAGE_SIZE);
+        if (batch->page_count == 0) {
+            // no valid page in this part, slots of dropped tablespaces or torn slots
+            // may be followed by valid ones
+            continue;
+        }
+        checked_count += batch->page_count;
+
+        err = buf_dblwr_restore_batch(batch, &restored_count);
+        if (err != CM_SUCCESS) {
+            break;
+        }
+    }
+
+    ut_free(batch);
+    os_close_file(handle);
+
+    LOGGER_NOTICE(LOGGER, LOG_MODULE_RECOVERY,
+        "buf_dblwr_restore: checked %lu pages, restored %lu pages from doublewrite file",
+        checked_count, restored_count);
+
+    return err;
+}
+
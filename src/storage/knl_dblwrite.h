@@ -4,9 +4,15 @@
 #include "cm_type.h"
 #include "knl_page_id.h"
 
+// number of doublewrite pages read and verified by one batch at startup
+#define DBLWR_RESTORE_BATCH_PAGES        64  // 1MB
 
 extern bool32 buf_dblwr_page_inside(const page_id_t &page_id);
 
+// Checks the data file pages which have a copy in the doublewrite file,
+// torn or stale pages are overwritten by the intact copy before redo is applied.
+extern status_t buf_dblwr_restore_corrupt_pages(char* dbwr_file_name, uint64 dbwr_file_size);
+
 extern bool32    buf_dblwr_being_created;
 
 
@@ -7,6 +7,8 @@
 #include "knl_btree.h"
 #include "knl_fsp.h"
 #include "knl_heap.h"
+#include "knl_heap_fsm.h"
+#include "knl_heap_zone.h"
 #include "knl_trx.h"
 #include "knl_handler.h"
 
@@ -167,6 +169,7 @@ static status_t dict_init(memory_pool_t* mem_pool, uint64 memory_cache_size, uin
         mutex_create(&dict_sys->table_LRU_list_mutex[i]);
         UT_LIST_INIT(dict_sys->table_LRU_list[i]);
     }
+    mutex_create(&dict_sys->table_hash_epoch_mutex);
 
     dict_sys->table_hash = HASH_TABLE_CREATE(table_hash_array_size, HASH_TABLE_SYNC_RW_LOCK, 4096);
     if (dict_sys->table_hash == NULL) {
@@ -371,6 +374,8 @@ static inline uint64 dict_cache_clean_memory_size()
     return size;
 }
 
+static bool32 dict_remove_table_from_cache_low(uint64 user_id, char* table_name, bool32 is_evict);
+
 static inline void dict_cache_lru_remove_tables_low(uint32 lru_list_id)
 {
     uint64 size = dict_cache_clean_memory_size();
@@ -414,8 +419,8 @@ static inline void dict_cache_lru_remove_tables_low(uint32 lru_list_id)
         }
         mutex_exit(&dict_sys->table_LRU_list_mutex[lru_list_id]);
 
-        //
-        if (dict_remove_table_from_cache(user_id, table_name)) {
+        // a table pinned after the check of LRU is skipped
+        if (table && dict_remove_table_from_cache_low(user_id, table_name, TRUE)) {
             skip_table_id = DICT_INVALID_OBJECT_ID;
         }
 
@@ -485,6 +490,12 @@ inline void dict_mem_table_destroy(dict_table_t* table)
     ut_ad(table->ref_count == 1);
 
     mutex_destroy(&table->mutex);
+    if (table->insert_cache != NULL) {
+        fsm_insert_cache_destroy(table->insert_cache);
+    }
+    if (table->zone_map_cache != NULL) {
+        zone_map_cache_destroy(table->zone_map_cache);
+    }
     mcontext_stack_destroy(table->mcontext_stack);
 }
 
@@ -524,6 +535,7 @@ dict_table_t* dict_mem_table_create(
     table->user_id = user_id;
     table->space_id = space_id;
     table->entry_page_no = FIL_NULL;
+    table->zone_map_page_no = FIL_NULL;
     table->init_trans = DICT_INI_TRANS;
     table->pctfree = DICT_PCT_FREE;
     table->cr_mode = DICT_CR_ROW;
@@ -548,6 +560,22 @@ dict_table_t* dict_mem_table_create(
     }
     memset((char *)table->columns, 0x00, column_count * sizeof(dict_col_t*));
 
+    table->insert_cache = (fsm_insert_cache_t*)dict_cache_alloc_memory(table_id, table->mcontext_stack,
+                                                                      FSM_INSERT_CACHE_STRIPES * sizeof(fsm_insert_cache_t));
+    if (table->insert_cache == NULL) {
+        CM_SET_ERROR(ERR_ALLOC_MEMORY, FSM_INSERT_CACHE_STRIPES * sizeof(fsm_insert_cache_t), "creating table");
+        goto err_exit;
+    }
+    fsm_insert_cache_init(table->insert_cache);
+
+    table->zone_map_cache = (zone_map_cache_t*)dict_cache_alloc_memory(table_id, table->mcontext_stack,
+                                                                        ZONE_MAP_CACHE_STRIPES * sizeof(zone_map_cache_t));
+    if (table->zone_map_cache == NULL) {
+        CM_SET_ERROR(ERR_ALLOC_MEMORY, ZONE_MAP_CACHE_STRIPES * sizeof(zone_map_cache_t), "creating table");
+        goto err_exit;
+    }
+    zone_map_cache_init(table->zone_map_cache);
+
     return table;
 
 err_exit:
@@ -614,6 +642,8 @@ status_t dict_mem_table_add_col(
     case DATA_BIGINT:
     case DATA_SMALLINT:
     case DATA_TINYINT:
+        col->is_unsigned = (precision & DATA_UNSIGNED) ? 1 : 0;
+        break;
     case DATA_BOOLEAN:
         break;
     case DATA_FLOAT:
@@ -728,6 +758,7 @@ dict_index_t* dict_mem_index_create(
     index->space_id = space_id;
     index->entry_page_no = FIL_NULL;
     index->field_count = field_count;
+    rw_lock_create(&index->lock);
 
     UT_LIST_ADD_LAST(list_node, table->indexes, index);
 
@@ -766,6 +797,47 @@ dict_index_t* dict_table_get_index_by_index_name(dict_table_t* table, const char
 
 
 
+// A reader of table_hash is counted in the epoch it entered, the epoch is checked again after
+// the count is added, so a reader either is seen by dict_hash_wait_readers or enters a later epoch.
+static inline uint32 dict_hash_enter()
+{
+    uint32 slot = os_thread_get_cpu_id() % DICT_HASH_READER_SLOTS;
+
+    for (;;) {
+        int64 epoch = dict_sys->table_hash_epoch;
+        atomic32_t* count = &dict_sys->table_hash_readers[slot].count[epoch & 1];
+
+        // the fence keeps the recheck of epoch after the count is added, atomic32_inc does not on ARM
+        atomic32_inc(count);
+        os_mb;
+        if (dict_sys->table_hash_epoch == epoch) {
+            return slot * 2 + (uint32)(epoch & 1);
+        }
+        atomic32_dec(count);
+    }
+}
+
+static inline void dict_hash_exit(uint32 ticket)
+{
+    atomic32_dec(&dict_sys->table_hash_readers[ticket / 2].count[ticket % 2]);
+}
+
+// Waits for the readers which could see a table removed from table_hash before
+static void dict_hash_wait_readers()
+{
+    mutex_enter(&dict_sys->table_hash_epoch_mutex);
+
+    int64 epoch = atomic64_inc(&dict_sys->table_hash_epoch) - 1;
+    os_mb;
+    for (uint32 i = 0; i < DICT_HASH_READER_SLOTS; i++) {
+        while (atomic32_get(&dict_sys->table_hash_readers[i].count[epoch & 1]) > 0) {
+            os_thread_sleep(10);
+        }
+    }
+
+    mutex_exit(&dict_sys->table_hash_epoch_mutex);
+}
+
 inline bool32 dict_add_table_to_cache(dict_table_t* table, bool32 can_be_evicted)
 {
     rw_lock_t *name_hash_lock;
@@ -803,7 +875,8 @@ inline bool32 dict_add_table_to_cache(dict_table_t* table, bool32 can_be_evicted
     //    }
     //}
 
-    // Add table to hash table of tables
+    // Add table to hash table of tables, readers see the table after it is initialized
+    os_wmb;
     HASH_INSERT(dict_table_t, name_hash, dict_sys->table_hash, fold, table);
     // Add table to hash table of tables based on table id
     //HASH_INSERT(dict_table_t, id_hash, dict_sys->table_id_hash, id_fold, table);
@@ -837,13 +910,12 @@ err_exit:
 inline uint32 dict_get_table_from_cache_by_name(uint64 user_id, char* table_name, dict_table_t** table)
 {
     dict_table_t* find_table;
-    rw_lock_t* hash_lock;
     uint32 fold;
 
     fold = ut_fold_string(table_name);
-    hash_lock = hash_get_lock(dict_sys->table_hash, fold);
 
-    rw_lock_s_lock(hash_lock);
+    // no latch, the tables of hash are not destroyed until dict_hash_exit
+    uint32 ticket = dict_hash_enter();
 
     // Look for a table with the same name
     HASH_SEARCH(name_hash, dict_sys->table_hash, fold,
@@ -851,10 +923,17 @@ inline uint32 dict_get_table_from_cache_by_name(uint64 user_id, char* table_name
         (find_table->user_id == user_id && !find_table->to_be_cache_removed &&
          strcmp(find_table->name, table_name) == 0));
     if (find_table) {
+        // dict_remove_table_from_cache_low checks ref_count after it sets to_be_cache_removed,
+        // the flag is read after the pin is visible to it
         atomic32_inc(&find_table->ref_count);
+        os_mb;
+        if (find_table->to_be_cache_removed) {
+            atomic32_dec(&find_table->ref_count);
+            find_table = NULL;
+        }
     }
 
-    rw_lock_s_unlock(hash_lock);
+    dict_hash_exit(ticket);
 
     if (find_table == NULL) {
         *table = NULL;
@@ -882,7 +961,9 @@ inline void dict_release_table(dict_table_t* table)
     atomic32_dec(&table->ref_count);
 }
 
-inline bool32 dict_remove_table_from_cache(uint64 user_id, char* table_name)
+// Removes table from cache and destroys it after all handles are released, an evictor
+// does not wait for handles but gives up and returns FALSE if the table is in use.
+static bool32 dict_remove_table_from_cache_low(uint64 user_id, char* table_name, bool32 is_evict)
 {
     dict_table_t* table;
     rw_lock_t* hash_lock;
@@ -905,17 +986,30 @@ retry:
 
     if (table->to_be_cache_removed) {
         rw_lock_x_unlock(hash_lock);
+        if (is_evict) {
+            return FALSE;
+        }
         os_thread_sleep(100);
         goto retry;
     }
 
+    // a reader who pins the table after the fence sees to_be_cache_removed,
+    // a pin before it is seen by the check of ref_count
     table->to_be_cache_removed = TRUE;
     atomic32_inc(&table->ref_count);
+    os_mb;
 
     rw_lock_x_unlock(hash_lock);
 
     // wait for free table
     while (table->ref_count != 1) {
+        if (is_evict) {
+            rw_lock_x_lock(hash_lock);
+            table->to_be_cache_removed = FALSE;
+            atomic32_dec(&table->ref_count);
+            rw_lock_x_unlock(hash_lock);
+            return FALSE;
+        }
         os_thread_sleep(100);
     }
 
@@ -925,6 +1019,9 @@ retry:
         ut_fold_string(table->name), table);
     rw_lock_x_unlock(hash_lock);
 
+    // readers of hash may still be on the table
+    dict_hash_wait_readers();
+
     //fold = ut_fold_uint64(table->id);
     //hash_lock = hash_get_lock(dict_sys->table_id_hash, fold);
     //rw_lock_s_lock(hash_lock);
@@ -974,6 +1071,11 @@ retry:
     return TRUE;
 }
 
+inline bool32 dict_remove_table_from_cache(uint64 user_id, char* table_name)
+{
+    return dict_remove_table_from_cache_low(user_id, table_name, FALSE);
+}
+
 
 
 // Loads a table definition from a SYS_TABLES record to dict_table_t.
@@ -1039,7 +1141,7 @@ static dict_table_t* dict_load_table(que_sess_t* sess, uint64 user_id, char* tab
     CM_SAVE_STACK(&sess->stack);
 
     rec_buf = (byte *)cm_stack_push(&sess->stack, ROW_RECORD_MAX_SIZE);
-    handler.index_fetch(&scan, rec_buf, FETCH_ROW_KEY_EXACT);
+    handler.index_fetch(sess, &scan, rec_buf, FETCH_ROW_KEY_EXACT);
 
     const char* err_desc = dict_load_create_mem_table(table_name, rec_buf, &table);
     if (err_desc) {
@@ -1137,6 +1239,9 @@ void index_fetch()
 inline status_t dict_get_table(que_sess_t* sess, uint64 user_id, char* table_name, dict_table_t** table)
 {
     uint32 status;
+    bool32 is_add_failed = FALSE;
+
+retry:
 
     status = dict_get_table_from_cache_by_name(user_id, table_name, table);
     if (status & DICT_TABLE_TO_BE_DROPED) {
@@ -1150,6 +1255,11 @@ inline status_t dict_get_table(que_sess_t* sess, uint64 user_id, char* table_nam
         return CM_SUCCESS;
     }
 
+    // the table of the same name in cache is to_be_cache_removed, wait for it to go
+    if (is_add_failed) {
+        os_thread_sleep(100);
+    }
+
     // table is not found from cache, now load it from sys_table
 
     *table = dict_load_table(sess, user_id, table_name, TRUE);
@@ -1158,9 +1268,12 @@ inline status_t dict_get_table(que_sess_t* sess, uint64 user_id, char* table_nam
     }
     atomic32_inc(&(*table)->ref_count);
 
-    //
+    // cached by another session, which is found at once by retry, or the old one is being removed
     if (!dict_add_table_to_cache(*table, TRUE)) {
+        (*table)->to_be_cache_removed = TRUE;
         dict_mem_table_destroy(*table);
+        is_add_failed = TRUE;
+        goto retry;
     }
 
     return CM_SUCCESS;
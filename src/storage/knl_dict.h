@@ -18,6 +18,7 @@
 
 #define DICT_INVALID_OBJECT_ID        UINT_MAX64
 #define DICT_TABLE_COLUMN_MAX_COUNT   1000
+#define DICT_ZONE_MAP_MAX_COLUMNS     4
 #define DICT_INDEX_COLUMN_MAX_COUNT   30
 
 //
@@ -376,7 +377,7 @@ typedef struct st_dict_col {
     uint32 is_droped     : 1;
     uint32 is_hidden     : 1;
     uint32 is_ext        : 1;
-    uint32 reserved      : 1;
+    uint32 is_unsigned   : 1;  // integer column without sign
     uint32 default_const_value_len : 16;
     void* default_const_value;
     void *default_expr;    // deserialized default expr
@@ -481,6 +482,9 @@ struct st_dict_index{
 #define TABLE_TYPE_EXTERNAL        5
 
 
+typedef struct st_fsm_insert_cache fsm_insert_cache_t;
+typedef struct st_zone_map_cache zone_map_cache_t;
+
 struct st_dict_table {
     uint64          user_id;
     table_id_t      id; // table id
@@ -503,6 +507,14 @@ struct st_dict_table {
     uint8           pctfree;
     uint8           cr_mode;
     bool32          heap_io_in_progress;
+    fsm_insert_cache_t* insert_cache;  // FSM_INSERT_CACHE_STRIPES stripes of insert target pages
+
+    // zone map of heap, loaded from fsm root page when it is used for the first time
+    volatile bool32 zone_map_loaded;
+    page_no_t       zone_map_page_no;  // FIL_NULL if table has no zone map
+    uint16          zone_map_column_count;
+    uint16          zone_map_columns[DICT_ZONE_MAP_MAX_COLUMNS];
+    zone_map_cache_t* zone_map_cache;  // ZONE_MAP_CACHE_STRIPES stripes of extent ranges
 
     mutex_t         mutex;
 
@@ -555,6 +567,16 @@ struct st_dict_table {
 #define DICT_TABLE_LRU_LIST_COUNT         16
 #define DICT_TABLE_GET_LRU_LIST_ID(table) (table->id % DICT_TABLE_LRU_LIST_COUNT)
 
+// Readers of table_hash take no latch, they are counted by epoch in the slot of their cpu,
+// a table removed from hash is destroyed after the readers of the epochs which could see it.
+#define DICT_HASH_READER_SLOTS            64
+#define DICT_HASH_READER_SLOT_SIZE        64  // a cache line
+
+typedef struct st_dict_hash_readers {
+    atomic32_t      count[2];  // readers entered in even and odd epochs
+    char            pad[DICT_HASH_READER_SLOT_SIZE - 2 * sizeof(atomic32_t)];
+} dict_hash_readers_t;
+
 /* Dictionary system struct */
 struct dict_sys_t {
     mutex_t             mutex;
@@ -564,8 +586,11 @@ struct dict_sys_t {
     uint64              max_space_id;
     uint64              mix_id_low;
 
-    // hash table of the tables, based on name
+    // hash table of the tables, based on name, latches of hash are taken by writers only
     HASH_TABLE*         table_hash;
+    dict_hash_readers_t table_hash_readers[DICT_HASH_READER_SLOTS];
+    atomic64_t          table_hash_epoch;
+    mutex_t             table_hash_epoch_mutex;
     // hash table of the tables, based on id
     HASH_TABLE*         table_id_hash;
 
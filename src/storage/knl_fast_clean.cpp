@@ -1,8 +1,13 @@
 #include "knl_fast_clean.h"
 #include "cm_memory.h"
 #include "cm_log.h"
+#include "cm_thread.h"
+#include "knl_buf.h"
+#include "knl_heap.h"
+#include "knl_server.h"
 
 #define FAST_CLEAN_BLOCK_PAGE_COUNT        4
+#define DELAYED_CLEANOUT_PAGES_PER_MTR     8
 
 void fast_clean_mgr_t::init(memory_pool_t* pool)
 {
@@ -166,3 +171,122 @@ void fast_clean_mgr_t::append_clean_block(uint32 space_id, uint32 page_no, void*
     clean_block->itl_id = itl_id;
 }
 
+
+void buf_delayed_cleanout_add(uint32 space_id, uint32 page_no, void* block,
+    uint64 trx_slot_id, uint8 itl_id, uint64 scn)
+{
+    const page_id_t page_id(space_id, page_no);
+    buf_pool_t* buf_pool = buf_pool_from_page_id(page_id);
+
+    if (buf_pool->cleanout_pages == NULL) {
+        return;
+    }
+
+    mutex_enter(&buf_pool->cleanout_mutex, NULL);
+    if (buf_pool->cleanout_count < srv_delayed_cleanout_queue_size) {
+        uint32 index = (buf_pool->cleanout_head + buf_pool->cleanout_count) % srv_delayed_cleanout_queue_size;
+        buf_cleanout_page_t* page = &buf_pool->cleanout_pages[index];
+        page->space_id = space_id;
+        page->page_no = page_no;
+        page->block = (buf_block_t *)block;
+        page->trx_slot_id = trx_slot_id;
+        page->scn = scn;
+        page->itl_id = itl_id;
+        buf_pool->cleanout_count++;
+    }
+    mutex_exit(&buf_pool->cleanout_mutex);
+}
+
+static uint32 buf_delayed_cleanout_pop(buf_pool_t* buf_pool, buf_cleanout_page_t* pages, uint32 max_count)
+{
+    uint32 count = 0;
+
+    if (buf_pool->cleanout_count == 0) {
+        return 0;
+    }
+
+    mutex_enter(&buf_pool->cleanout_mutex, NULL);
+    while (count < max_count && buf_pool->cleanout_count > 0) {
+        pages[count++] = buf_pool->cleanout_pages[buf_pool->cleanout_head];
+        buf_pool->cleanout_head = (buf_pool->cleanout_head + 1) % srv_delayed_cleanout_queue_size;
+        buf_pool->cleanout_count--;
+    }
+    mutex_exit(&buf_pool->cleanout_mutex);
+
+    return count;
+}
+
+static int buf_cleanout_page_cmp(const void* a, const void* b)
+{
+    const buf_cleanout_page_t* page1 = (const buf_cleanout_page_t *)a;
+    const buf_cleanout_page_t* page2 = (const buf_cleanout_page_t *)b;
+
+    if (page1->space_id != page2->space_id) {
+        return page1->space_id < page2->space_id ? -1 : 1;
+    }
+    if (page1->page_no != page2->page_no) {
+        return page1->page_no < page2->page_no ? -1 : 1;
+    }
+    return 0;
+}
+
+// Cleans a batch of pages in one mini-transaction, pages are latched in order of page id.
+// A page evicted already is skipped, the reader cleans it when the page is loaded again.
+static void buf_delayed_cleanout_batch(buf_cleanout_page_t* pages, uint32 count)
+{
+    mtr_t mtr;
+    buf_block_t* block = NULL;
+
+    qsort(pages, count, sizeof(buf_cleanout_page_t), buf_cleanout_page_cmp);
+
+    mtr_start(&mtr);
+
+    for (uint32 i = 0; i < count; i++) {
+        // the same page may be queued by several trx
+        if (i == 0 || buf_cleanout_page_cmp(&pages[i - 1], &pages[i]) != 0) {
+            const page_id_t page_id(pages[i].space_id, pages[i].page_no);
+            const page_size_t page_size(pages[i].space_id);
+            block = buf_page_get_gen(page_id, page_size, RW_X_LATCH,
+                pages[i].block, Page_fetch::PEEK_IF_IN_POOL, &mtr);
+        }
+        if (block == NULL) {
+            continue;
+        }
+
+        trx_slot_id_t slot_id;
+        slot_id.id = pages[i].trx_slot_id;
+        heap_cleanout_itl(block, slot_id, pages[i].itl_id, pages[i].scn, &mtr);
+    }
+
+    mtr_commit(&mtr);
+}
+
+void* buf_delayed_cleanout_thread(void* arg)
+{
+    uint32 index = *(uint32 *)arg;
+    buf_cleanout_page_t pages[DELAYED_CLEANOUT_PAGES_PER_MTR];
+
+    LOGGER_INFO(LOGGER, LOG_MODULE_BUFFERPOOL, "buf_delayed_cleanout thread (id = %u) starting ...", index);
+
+    while (srv_shutdown_state != SHUTDOWN_EXIT_THREADS) {
+        uint32 cleaned_count = 0;
+
+        for (uint32 i = index; i < buf_pool_get_instances() && srv_shutdown_state != SHUTDOWN_EXIT_THREADS;
+             i += srv_delayed_cleanout_threads) {
+            buf_pool_t* buf_pool = buf_pool_get(i);
+            uint32 count = buf_delayed_cleanout_pop(buf_pool, pages, DELAYED_CLEANOUT_PAGES_PER_MTR);
+            if (count > 0) {
+                buf_delayed_cleanout_batch(pages, count);
+                cleaned_count += count;
+            }
+        }
+
+        if (cleaned_count == 0) {
+            os_thread_sleep(10000); // 10ms
+        }
+    }
+
+    LOGGER_INFO(LOGGER, LOG_MODULE_BUFFERPOOL, "buf_delayed_cleanout thread (id = %u) exited", index);
+
+    return NULL;
+}
@@ -54,6 +54,12 @@ private:
     UT_LIST_BASE_NODE_T(memory_pool_t) m_used_pages;
 };
 
+// Queues a page whose itl is not cleaned by commit to its buffer pool instance,
+// the page is dropped if the queue is full and the next reader cleans it
+extern void buf_delayed_cleanout_add(uint32 space_id, uint32 page_no, void* block,
+    uint64 trx_slot_id, uint8 itl_id, uint64 scn);
+extern void* buf_delayed_cleanout_thread(void* arg);
+
 
 #ifdef __cplusplus
 }
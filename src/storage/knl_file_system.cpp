@@ -2,6 +2,7 @@
 #include "cm_util.h"
 #include "cm_file.h"
 #include "cm_log.h"
+#include "cm_datetime.h"
 #include "knl_buf.h"
 #include "knl_mtr.h"
 #include "knl_flst.h"
@@ -21,7 +22,7 @@ static inline bool32 fil_node_prepare_for_io(fil_node_t *node);
 bool32 fil_system_init(memory_pool_t *mem_pool, uint32 max_n_open)
 {
     fil_system = (fil_system_t *)ut_malloc_zero(ut_align8(sizeof(fil_system_t)) +
-        DB_SPACE_DATA_FILE_MAX_COUNT * sizeof(fil_node_t *));
+        DB_SPACE_DATA_FILE_MAX_COUNT * sizeof(fil_node_t *) + UNIV_PAGE_SIZE * 2);
     if (fil_system == NULL) {
         return FALSE;
     }
@@ -35,6 +36,8 @@ bool32 fil_system_init(memory_pool_t *mem_pool, uint32 max_n_open)
     fil_system->fil_node_num = 0;
     fil_system->fil_node_max_count = DB_SPACE_DATA_FILE_MAX_COUNT;
     fil_system->fil_nodes = (fil_node_t **)((char *)fil_system + ut_align8(sizeof(fil_system_t)));
+    fil_system->extend_page_buf = (byte *)ut_align_up(
+        (byte *)fil_system->fil_nodes + DB_SPACE_DATA_FILE_MAX_COUNT * sizeof(fil_node_t *), UNIV_PAGE_SIZE);
 
     mutex_create(&fil_system->mutex);
     mutex_create(&fil_system->lru_mutex);
@@ -75,6 +78,19 @@ bool32 fil_system_init(memory_pool_t *mem_pool, uint32 max_n_open)
         goto err_exit;
     }
 
+    for (uint32 i = 0; i < FIL_IO_CLASS_COUNT; i++) {
+        mutex_create(&fil_system->io_classes[i].mutex);
+        fil_system->io_classes[i].refill_time = (uint64)current_monotonic_time();
+    }
+    fil_system->io_classes[FIL_IO_CLASS_FG_READ].name = "fg_read";
+    fil_system->io_classes[FIL_IO_CLASS_PREFETCH].name = "prefetch";
+    fil_system->io_classes[FIL_IO_CLASS_PREFETCH].max_pending = srv_io_prefetch_max_pending;
+    fil_system->io_classes[FIL_IO_CLASS_PREFETCH].rate = srv_io_prefetch_rate;
+    fil_system->io_classes[FIL_IO_CLASS_WRITE].name = "write";
+    fil_system->io_classes[FIL_IO_CLASS_WRITE].max_pending = srv_io_write_max_pending;
+    fil_system->io_classes[FIL_IO_CLASS_WRITE].rate = srv_io_write_rate;
+    fil_system->io_classes[FIL_IO_CLASS_DBLWR].name = "dblwr";
+
     return TRUE;
 
 err_exit:
@@ -196,6 +212,7 @@ fil_space_t* fil_space_create(char *name, uint32 space_id, uint32 flags)
     space->id = space_id;
     space->size_in_header = 0;
     space->free_limit = 0;
+    space->size_in_file = 0;
     space->flags = flags;
     //space->page_size = 0;
     //space->n_reserved_extents = 0;
@@ -293,6 +310,7 @@ fil_node_t* fil_node_create(fil_space_t *space, uint32 node_id,
     node->is_open = 0;
     node->is_io_progress = 0;
     node->is_extend = is_extend;
+    node->is_fallocate_unsupported = 0;
     node->n_pending = 0;
     node->n_pending_flushes = 0;
     
@@ -516,6 +534,48 @@ static status_t fil_space_extend_node_callback(int32 code, os_aio_slot_t* slot)
     return CM_SUCCESS;
 }
 
+// Extends a node by fallocate, the filesystem zero-fills the range without writing data.
+// return CM_ERROR if fallocate is unavailable, the caller falls back to writing zero pages
+static status_t fil_space_extend_node_by_fallocate(fil_node_t* node, uint32 page_hwm, uint32 size_increase)
+{
+    const page_size_t page_size(node->space->id);
+    status_t err = CM_SUCCESS;
+
+    fil_system_pin_space(node->space);
+    if (!fil_node_prepare_for_io(node)) {
+        fil_system_unpin_space(node->space);
+        return CM_ERROR;
+    }
+
+    if (!os_file_fallocate(node->handle, (uint64)page_hwm * page_size.physical(),
+                           (uint64)size_increase * page_size.physical())) {
+        int32 os_err = os_file_get_last_error();
+        if (os_err == OS_FILE_DISK_FULL) {
+            LOGGER_ERROR(LOGGER, LOG_MODULE_TABLESPACE, "fil_space_extend: disk is full, name %s", node->name);
+            err = ERR_DISK_IS_FULL;
+        } else {
+            char err_info[CM_ERR_MSG_MAX_LEN];
+            os_file_get_error_desc_by_err(os_err, err_info, CM_ERR_MSG_MAX_LEN);
+            LOGGER_WARN(LOGGER, LOG_MODULE_TABLESPACE,
+                "fil_space_extend: fallocate is unavailable, write zero pages instead, name %s error %s",
+                node->name, err_info);
+            node->is_fallocate_unsupported = (os_err == OS_FILE_OPERATION_NOT_SUPPORTED);
+            err = CM_ERROR;
+        }
+    } else if (!os_fsync_file(node->handle)) {
+        char err_info[CM_ERR_MSG_MAX_LEN];
+        os_file_get_last_error_desc(err_info, CM_ERR_MSG_MAX_LEN);
+        LOGGER_WARN(LOGGER, LOG_MODULE_TABLESPACE,
+            "fil_space_extend: fail to sync file after fallocate, name = %s error = %s",
+            node->name, err_info);
+        err = CM_ERROR;
+    }
+
+    fil_node_complete_io(node, OS_FILE_WRITE);
+
+    return err;
+}
+
 static status_t fil_space_extend_node(fil_node_t* node, uint32 page_hwm,
     uint32 size_increase, uint32 *actual_size)
 {
@@ -531,6 +591,16 @@ static status_t fil_space_extend_node(fil_node_t* node, uint32 page_hwm,
 
     *actual_size = 0;
 
+    if (srv_use_fallocate && !node->is_fallocate_unsupported) {
+        status_t err = fil_space_extend_node_by_fallocate(node, page_hwm, size_increase);
+        if (err == CM_SUCCESS) {
+            *actual_size = size_increase;
+            return CM_SUCCESS;
+        } else if (err == ERR_DISK_IS_FULL) {
+            return ERR_DISK_IS_FULL;
+        }
+    }
+
     //
     mutex_create(&node_extend.mutex);
     node_extend.node = node;
@@ -591,6 +661,9 @@ err_exit:
     return CM_ERROR;
 }
 
+// Extends the data files of space so that space can grow to size_after_extend pages,
+// the pages have been extended ahead of demand are reused without i/o.
+// actual_size: number of pages the space can grow beyond size_in_header
 status_t fil_space_extend_to_desired_size(fil_space_t* space, uint32 size_after_extend, uint32* actual_size)
 {
     ut_ad(!srv_read_only_mode || fsp_is_system_temporary(space->id));
@@ -598,11 +671,19 @@ status_t fil_space_extend_to_desired_size(fil_space_t* space, uint32 size_after_
     ut_ad(space->io_in_progress);
 
     ut_a(space->size_in_header < size_after_extend);
-    uint32 size_increase = size_after_extend - space->size_in_header;
-    *actual_size = 0;
+    if (space->size_in_file < space->size_in_header) {
+        space->size_in_file = space->size_in_header;
+    }
+    if (space->size_in_file >= size_after_extend) {
+        *actual_size = size_after_extend - space->size_in_header;
+        return CM_SUCCESS;
+    }
+
+    uint32 size_increase = size_after_extend - space->size_in_file;
+    *actual_size = space->size_in_file - space->size_in_header;
 
-    // find a node by space->size_in_header
-    uint32 page_hwm = space->size_in_header;
+    // find a node by space->size_in_file
+    uint32 page_hwm = space->size_in_file;
     fil_node_t* node = UT_LIST_GET_FIRST(space->fil_nodes);
     for (; node != NULL && page_hwm >= node->page_max_count;) {
         page_hwm -= node->page_max_count;
@@ -624,6 +705,7 @@ status_t fil_space_extend_to_desired_size(fil_space_t* space, uint32 size_after_
         ut_ad(node_actual_size > 0);
 
         page_hwm = 0;
+        space->size_in_file += node_actual_size;
         *actual_size += node_actual_size;
         size_increase -= node_actual_size;
 
@@ -698,13 +780,17 @@ static inline bool32 fil_node_open_file(fil_node_t *node)
     ut_ad(node->is_io_progress);
 
     // Open the file for reading and writing
-    bool32 ret = os_open_file(node->name, OS_FILE_OPEN, OS_FILE_AIO, &node->handle);
+    bool32 ret = os_open_file(node->name, OS_FILE_OPEN,
+        OS_FILE_AIO | (srv_data_file_direct_io ? OS_FILE_DIRECT_IO : 0), &node->handle);
     if (UNLIKELY(!ret)) {
         char err_info[CM_ERR_MSG_MAX_LEN];
         os_file_get_last_error_desc(err_info, CM_ERR_MSG_MAX_LEN);
         LOGGER_ERROR(LOGGER, LOG_MODULE_TABLESPACE,
             "fil_node_open_file: failed to open file, name = %s err desc = %s",
             node->name, err_info);
+    } else if (srv_data_file_direct_io && !os_file_is_direct_io(node->handle)) {
+        LOGGER_WARN(LOGGER, LOG_MODULE_TABLESPACE,
+            "fil_node_open_file: O_DIRECT is not supported, use buffered i/o, name = %s", node->name);
     }
 
     return ret;
@@ -892,7 +978,150 @@ inline fil_node_t* fil_node_get_by_page_id(fil_space_t* space, const page_id_t &
     return node;
 }
 
-inline status_t fil_io(
+// Returns the number of pages from page_id to the end of the data file which contains it,
+// a vectored i/o started at page_id can not cover more pages than this.
+uint32 fil_get_contiguous_page_count(const page_id_t &page_id)
+{
+    fil_space_t* space;
+    fil_node_t*  node;
+    uint32       block_offset;
+    uint32       count = 0;
+
+    space = fil_system_get_space_by_id(page_id.get_space_id());
+    if (space == NULL) {
+        return 0;
+    }
+
+    rw_lock_s_lock(&space->rw_lock);
+    block_offset = page_id.get_page_no();
+    node = UT_LIST_GET_FIRST(space->fil_nodes);
+    while (node != NULL && node->page_max_count <= block_offset) {
+        block_offset -= node->page_max_count;
+        node = UT_LIST_GET_NEXT(chain_list_node, node);
+    }
+    if (node != NULL) {
+        count = node->page_max_count - block_offset;
+    }
+    rw_lock_s_unlock(&space->rw_lock);
+
+    fil_system_unpin_space(space);
+
+    return count;
+}
+
+// Flushes to disk the writes of data file which contains page_id,
+// it is used out of checkpoint thread, so fil_node_unflushed is not touched.
+bool32 fil_flush_file_of_page(const page_id_t &page_id)
+{
+    fil_space_t* space;
+    fil_node_t*  node;
+    bool32       ret = TRUE;
+
+    space = fil_system_get_space_by_id(page_id.get_space_id());
+    if (space == NULL) {
+        return TRUE;
+    }
+
+    rw_lock_s_lock(&space->rw_lock);
+    node = fil_node_get_by_page_id(space, page_id);
+    if (node) {
+        mutex_enter(&node->mutex);
+        if (node->is_open && node->handle != OS_FILE_INVALID_HANDLE) {
+            node->n_pending_flushes++;
+            mutex_exit(&node->mutex);
+
+            if (!os_fsync_file(node->handle)) {
+                char err_info[CM_ERR_MSG_MAX_LEN];
+                os_file_get_last_error_desc(err_info, CM_ERR_MSG_MAX_LEN);
+                LOGGER_ERROR(LOGGER, LOG_MODULE_TABLESPACE,
+                    "fil_flush_file_of_page: fail to flush file, name %s error %s",
+                    node->name, err_info);
+                ret = FALSE;
+            }
+
+            mutex_enter(&node->mutex);
+            node->n_pending_flushes--;
+        }
+        mutex_exit(&node->mutex);
+    }
+    rw_lock_s_unlock(&space->rw_lock);
+
+    fil_system_unpin_space(space);
+
+    return ret;
+}
+
+// Checks if the first waiting request of class can be dispatched, caller holds io_class->mutex
+static inline bool32 fil_io_class_can_dispatch(fil_io_class_t* io_class)
+{
+    uint32 max_pending = io_class->max_pending;
+    if (max_pending > 0 && io_class != &fil_system->io_classes[FIL_IO_CLASS_FG_READ] &&
+        fil_system->io_classes[FIL_IO_CLASS_FG_READ].pending > 0) {
+        // synchronous page reads go first
+        max_pending = ut_max(max_pending / 4, 1);
+    }
+    if (max_pending > 0 && io_class->pending >= max_pending) {
+        return FALSE;
+    }
+
+    if (io_class->rate > 0) {
+        uint64 now = (uint64)current_monotonic_time();
+        if (now > io_class->refill_time) {
+            // burst is limited to 100ms
+            int64 burst = (int64)(io_class->rate / 10);
+            uint64 elapsed = ut_min(now - io_class->refill_time, (uint64)MICROSECS_PER_SECOND);
+            io_class->tokens += (int64)(elapsed * io_class->rate / MICROSECS_PER_SECOND);
+            if (io_class->tokens > burst) {
+                io_class->tokens = burst;
+            }
+            io_class->refill_time = now;
+        }
+        if (io_class->tokens <= 0) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+// Waits until the request can be dispatched by the limits of io_class,
+// the request is charged and must be released by fil_io_class_exit after completion.
+void fil_io_class_enter(uint32 io_class_id, uint32 len)
+{
+    fil_io_class_t* io_class = &fil_system->io_classes[io_class_id];
+    uint64 wait_count = 0;
+
+    ut_ad(io_class_id < FIL_IO_CLASS_COUNT);
+
+    mutex_enter(&io_class->mutex);
+    uint64 ticket = io_class->next_ticket++;
+    while (ticket != io_class->dispatch_ticket || !fil_io_class_can_dispatch(io_class)) {
+        mutex_exit(&io_class->mutex);
+        os_thread_sleep(100); // 100us
+        wait_count++;
+        mutex_enter(&io_class->mutex);
+    }
+    io_class->dispatch_ticket++;
+    io_class->pending++;
+    io_class->tokens -= len;
+    io_class->dispatch_count++;
+    io_class->wait_count += wait_count;
+    mutex_exit(&io_class->mutex);
+}
+
+void fil_io_class_exit(uint32 io_class_id)
+{
+    fil_io_class_t* io_class = &fil_system->io_classes[io_class_id];
+
+    ut_ad(io_class_id < FIL_IO_CLASS_COUNT);
+
+    mutex_enter(&io_class->mutex);
+    ut_a(io_class->pending > 0);
+    io_class->pending--;
+    mutex_exit(&io_class->mutex);
+}
+
+static inline status_t fil_io_low(
     uint32 type, // in: OS_FILE_READ, OS_FILE_WRITE
     bool32 sync, // in: true if synchronous aio is desired
     const page_id_t &page_id, // in:
@@ -901,6 +1130,8 @@ inline status_t fil_io(
                         // in aio this must be divisible by the OS block size
     uint32 len, // in: this must be a block size multiple
     void*  buf, // in/out: buffer where to store data read
+    os_iovec_t* iov, // in/out: buffers of consecutive pages for vectored i/o, NULL if buf is used
+    uint32 iov_count, // in: number of buffers in iov
     aio_slot_func slot_func,
     void*  message) // in: message for aio handler if non-sync aio used, else ignored
 {
@@ -959,6 +1190,15 @@ inline status_t fil_io(
         }
     }
 
+    // vectored i/o can not cross the end of data file
+    if (iov != NULL && block_offset + len / page_size.physical() > node->page_max_count) {
+        rw_lock_s_unlock(&space->rw_lock);
+        LOGGER_ERROR(LOGGER, LOG_MODULE_TABLESPACE,
+            "fil_io: vectored i/o exceeds data file %s (space id = %lu page no = %lu pages = %lu)",
+            node->name, page_id.get_space_id(), page_id.get_page_no(), len / page_size.physical());
+        goto err_exit;
+    }
+
     // Open file if closed
     if (!fil_node_prepare_for_io(node)) {
         rw_lock_s_unlock(&space->rw_lock);
@@ -974,7 +1214,15 @@ inline status_t fil_io(
     // 3. file offset for filnode
     uint64 offset = block_offset * page_size.physical() + byte_offset;
 
-    // 4. get i/o context
+    // 4. wait for i/o scheduling and get i/o context
+
+    uint32 io_class;
+    if (type == OS_FILE_READ) {
+        io_class = sync ? FIL_IO_CLASS_FG_READ : FIL_IO_CLASS_PREFETCH;
+    } else {
+        io_class = FIL_IO_CLASS_WRITE;
+    }
+    fil_io_class_enter(io_class, len);
 
     if (sync) {
         uint32 ctx_index = page_id.get_page_no() % srv_sync_io_contexts;
@@ -992,8 +1240,13 @@ inline status_t fil_io(
 
     // 5. do i/o
 
-    tmp_slot = os_file_aio_submit(aio_ctx, type, node->name,
-        node->handle, (void *)buf, len, offset, slot_func, node, message);
+    if (iov != NULL) {
+        tmp_slot = os_file_aio_submitv(aio_ctx, type, node->name,
+            node->handle, iov, iov_count, offset, slot_func, node, message);
+    } else {
+        tmp_slot = os_file_aio_submit(aio_ctx, type, node->name,
+            node->handle, (void *)buf, len, offset, slot_func, node, message);
+    }
     if (tmp_slot == NULL) {
         char err_info[CM_ERR_MSG_MAX_LEN];
         os_file_get_last_error_desc(err_info, CM_ERR_MSG_MAX_LEN);
@@ -1026,6 +1279,7 @@ inline status_t fil_io(
             goto err_exit;
         }
 
+        fil_io_class_exit(io_class);
         fil_node_complete_io(node, type);
 
     }
@@ -1040,6 +1294,38 @@ err_exit:
     return CM_ERROR;
 }
 
+inline status_t fil_io(
+    uint32 type, // in: OS_FILE_READ, OS_FILE_WRITE
+    bool32 sync, // in: true if synchronous aio is desired
+    const page_id_t &page_id, // in:
+    const page_size_t &page_size, // in:
+    uint32 byte_offset, // in: remainder of offset in bytes;
+                        // in aio this must be divisible by the OS block size
+    uint32 len, // in: this must be a block size multiple
+    void*  buf, // in/out: buffer where to store data read
+    aio_slot_func slot_func,
+    void*  message) // in: message for aio handler if non-sync aio used, else ignored
+{
+    return fil_io_low(type, sync, page_id, page_size, byte_offset, len, buf, NULL, 0, slot_func, message);
+}
+
+// Writes iov_count consecutive pages starting at page_id with one vectored i/o,
+// each buffer of iov holds one page, iov must be valid until the i/o is completed.
+inline status_t fil_writev(
+    bool32 sync, const page_id_t &page_id, const page_size_t &page_size,
+    os_iovec_t* iov, uint32 iov_count, aio_slot_func slot_func, void* message)
+{
+    ut_ad(iov_count > 0 && iov_count <= OS_AIO_IOV_MAX_COUNT);
+
+    if (iov_count == 1) {
+        return fil_io_low(OS_FILE_WRITE, sync, page_id, page_size, 0, (uint32)iov[0].iov_len,
+            iov[0].iov_base, NULL, 0, slot_func, message);
+    }
+
+    return fil_io_low(OS_FILE_WRITE, sync, page_id, page_size, 0, iov_count * page_size.physical(),
+        NULL, iov, iov_count, slot_func, message);
+}
+
 inline status_t fil_read(
     bool32 sync, const page_id_t &page_id, const page_size_t &page_size,
     uint32 len, void* buf, aio_slot_func slot_func, void* message)
@@ -1073,6 +1359,9 @@ inline void fil_aio_reader_and_writer_wait(os_aio_context_t* context)
     //}
 
     if (slot) {
+        // only asynchronous i/o's of fil_io are submitted to the context
+        fil_io_class_exit(slot->type == OS_FILE_READ ? FIL_IO_CLASS_PREFETCH : FIL_IO_CLASS_WRITE);
+
         if (slot->callback_func) {
             slot->callback_func(ret, slot);
         }
@@ -78,6 +78,7 @@ extern fil_addr_t   fil_addr_null;
 #define FIL_PAGE_TYPE_HASH_HDR       15   // B-tree non-leaf node page
 #define FIL_PAGE_TYPE_HASH_DATA      17   // B-tree node
 #define FIL_PAGE_TYPE_TOAST          18   // Toast page
+#define FIL_PAGE_TYPE_HEAP_ZONE      19   // Zone map page of heap
 
 #define FIL_PAGE_TYPE_MASK           0xFF //
 
@@ -118,7 +119,8 @@ typedef struct st_fil_node {
     uint32       is_extend : 1;
     uint32       is_io_progress : 1;  // io progress for open or close
     uint32       is_in_unflushed_list : 1; // only for checkpoint thread, unprotected by mutex
-    uint32       reserved : 28;
+    uint32       is_fallocate_unsupported : 1; // protected by space->io_in_progress
+    uint32       reserved : 27;
 
     // count of pending i/o's on this file;
     // closing of the file is not allowed if this is > 0
@@ -168,6 +170,9 @@ struct st_fil_space {
     uint32       flags; // tablespace type: FSP_FLAG_SYSTEM, etc
     uint32       size_in_header; // FSP_SIZE in the tablespace header; 0 if not known yet
     uint32       free_limit; // contents of FSP_FREE_LIMIT
+    // size of data files in pages, the pages beyond size_in_header have been extended
+    // ahead of demand; 0 if not known yet. Protected by io_in_progress
+    uint32       size_in_file;
     //bool32       is_autoextend;
     //uint32       autoextend_size;
     //uint32       page_size;  // space size in pages
@@ -199,6 +204,29 @@ struct st_fil_space {
 #define M_FIL_SPACE_MAGIC_N         89472
 #define M_FIL_SYSTEM_HASH_LOCKS     4096
 
+/* i/o scheduling classes */
+#define FIL_IO_CLASS_FG_READ        0  // synchronous page read of session, never throttled
+#define FIL_IO_CLASS_PREFETCH       1  // asynchronous page read
+#define FIL_IO_CLASS_WRITE          2  // page write of checkpoint and tablespace extension
+#define FIL_IO_CLASS_DBLWR          3  // doublewrite buffer write
+#define FIL_IO_CLASS_COUNT          4
+
+// Requests of a class are dispatched in arrival order,
+// limited by the number of pending i/o's and a token bucket of bytes.
+typedef struct st_fil_io_class {
+    mutex_t         mutex;
+    const char*     name;
+    uint32          max_pending;  // 0 means unlimited
+    uint64          rate;         // bytes per second, 0 means unlimited
+    volatile uint32 pending;      // number of dispatched i/o's not completed
+    uint64          next_ticket;  // ticket of next arrival
+    uint64          dispatch_ticket; // ticket can be dispatched now
+    int64           tokens;       // bytes can be dispatched, negative if in debt
+    uint64          refill_time;  // monotonic time in microseconds
+    uint64          dispatch_count;
+    uint64          wait_count;   // number of 100us waits for dispatching
+} fil_io_class_t;
+
 typedef struct st_fil_system {
     uint32              max_n_open; /* maximum allowed open files */
     atomic32_t          open_pending_num; /* current number of open files with pending i/o-ops on them */
@@ -210,12 +238,14 @@ typedef struct st_fil_system {
     memory_area_t      *mem_area;
     memory_pool_t      *mem_pool;
     memory_context_t   *mem_context;
-    byte                extend_page_buf[UNIV_PAGE_SIZE];
+    byte*               extend_page_buf; // zero page aligned for direct i/o
 
     uint32              aio_pending_count_per_context;
     uint32              aio_context_count;
     os_aio_array_t     *aio_array;
 
+    fil_io_class_t      io_classes[FIL_IO_CLASS_COUNT];
+
     rw_lock_t           rw_lock[M_FIL_SYSTEM_HASH_LOCKS];
     HASH_TABLE         *space_id_hash; // hash table based on space id
     HASH_TABLE         *name_hash; // hash table based on space name
@@ -270,6 +300,8 @@ extern bool32 fil_node_destroy(fil_space_t* space, fil_node_t* node, bool32 need
 extern bool32 fil_node_open(fil_space_t *space, fil_node_t *node);
 extern bool32 fil_node_close(fil_space_t *space, fil_node_t *node);
 
+extern uint32 fil_get_contiguous_page_count(const page_id_t &page_id);
+extern bool32 fil_flush_file_of_page(const page_id_t &page_id);
 extern inline fil_node_t* fil_node_get_by_page_id(fil_space_t* space, const page_id_t &page_id);
 extern inline void fil_node_complete_io(fil_node_t* node, uint32 type);
 
@@ -281,9 +313,13 @@ extern inline status_t fil_io(uint32 type, bool32 sync, const page_id_t &page_id
     aio_slot_func slot_func = NULL, void* message = NULL);
 extern inline status_t fil_write(bool32 sync, const page_id_t &page_id,
     const page_size_t &page_size, uint32 len, void* buf, aio_slot_func slot_func, void* message);
+extern inline status_t fil_writev(bool32 sync, const page_id_t &page_id,
+    const page_size_t &page_size, os_iovec_t* iov, uint32 iov_count, aio_slot_func slot_func, void* message);
 extern inline status_t fil_read(bool32 sync, const page_id_t &page_id,
     const page_size_t &page_size, uint32 len, void* buf, aio_slot_func slot_func, void* message);
 extern inline void fil_aio_reader_and_writer_wait(os_aio_context_t* context);
+extern void fil_io_class_enter(uint32 io_class, uint32 len);
+extern void fil_io_class_exit(uint32 io_class);
 
 extern status_t fil_space_extend_to_desired_size(fil_space_t* space,
     uint32 size_after_extend, uint32 *actual_size);
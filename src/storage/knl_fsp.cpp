@@ -1168,6 +1168,92 @@ retry:
     return err;
 }
 
+// Extends the data files of space ahead of demand once its free pages drop below
+// srv_space_preextend_free_pages, so that fsp_extend_space only formats the pages on disk.
+static void fsp_preextend_space(uint32 space_id)
+{
+    fil_space_t* space = fil_system_get_space_by_id(space_id);
+    if (space == NULL) {
+        return;
+    }
+    if (space->size_in_header == 0) {
+        fil_system_unpin_space(space);
+        return;
+    }
+
+    mtr_t mtr;
+    mtr_start(&mtr);
+
+    const page_id_t page_id(space->id, 0);
+    const page_size_t page_size(space->id);
+    buf_block_t* block = buf_page_get(page_id, page_size, RW_S_LATCH, &mtr);
+    fsp_header_t* header = FSP_HEADER_OFFSET + buf_block_get_frame(block);
+    uint32 size = mach_read_from_4(header + FSP_SIZE);
+    uint32 max_size = mach_read_from_4(header + FSP_MAX_SIZE);
+    uint32 free_pages = flst_get_len(header + FSP_FREE) * FSP_EXTENT_SIZE;
+
+    mtr_commit(&mtr);
+
+    if (free_pages >= srv_space_preextend_free_pages || size >= max_size) {
+        fil_system_unpin_space(space);
+        return;
+    }
+
+    mutex_enter(&space->mutex);
+    if (space->io_in_progress) {
+        // a session is extending the space now
+        mutex_exit(&space->mutex);
+        fil_system_unpin_space(space);
+        return;
+    }
+    space->io_in_progress = TRUE;
+    mutex_exit(&space->mutex);
+
+    uint32 size_after_extend = space->size_in_header + fsp_get_autoextend_increment(space);
+    if (size_after_extend > max_size) {
+        size_after_extend = max_size;
+    }
+    if (space->size_in_header < size_after_extend && space->size_in_file < size_after_extend) {
+        uint32 actual_size = 0;
+        status_t err = fil_space_extend_to_desired_size(space, size_after_extend, &actual_size);
+        if (err != CM_SUCCESS) {
+            LOGGER_WARN(LOGGER, LOG_MODULE_FSP,
+                "fsp_preextend_space: failed to extend space id %lu to %lu pages, error %d",
+                space->id, size_after_extend, err);
+        } else {
+            LOGGER_DEBUG(LOGGER, LOG_MODULE_FSP,
+                "fsp_preextend_space: space id %lu size %lu, data files extended to %lu pages",
+                space->id, space->size_in_header, space->size_in_file);
+        }
+    }
+
+    mutex_enter(&space->mutex);
+    space->io_in_progress = FALSE;
+    mutex_exit(&space->mutex);
+
+    fil_system_unpin_space(space);
+}
+
+void* fsp_preextend_thread(void *arg)
+{
+    LOGGER_INFO(LOGGER, LOG_MODULE_FSP, "fsp_preextend thread starting ...");
+
+    while (srv_shutdown_state != SHUTDOWN_EXIT_THREADS) {
+        fsp_preextend_space(FIL_SYSTEM_SPACE_ID);
+        for (uint32 i = FIL_UNDO_START_SPACE_ID; i <= FIL_UNDO_END_SPACE_ID; i++) {
+            fsp_preextend_space(i);
+        }
+        for (uint32 i = 0; i < DB_USER_SPACE_MAX_COUNT && srv_shutdown_state != SHUTDOWN_EXIT_THREADS; i++) {
+            fsp_preextend_space(FIL_USER_SPACE_ID + i);
+        }
+        os_thread_sleep(100000); // 100ms
+    }
+
+    LOGGER_INFO(LOGGER, LOG_MODULE_FSP, "fsp_preextend thread exited");
+
+    return NULL;
+}
+
 // Returns an extent to the free list of a space
 void fsp_free_extent(uint32 space_id, xdes_t* xdes, mtr_t* mtr)
 {
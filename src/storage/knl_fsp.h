@@ -293,6 +293,7 @@ extern inline fsp_header_t* fsp_get_space_header(uint32 space_id, const page_siz
 extern status_t fsp_init_space(uint32 space_id, uint64 init_size, uint64 max_size, uint32 flags);
 extern status_t fsp_reserve_system_space();
 extern status_t fsp_open_space(uint32 space_id);
+extern void* fsp_preextend_thread(void *arg);
 
 extern void fsp_free_page(const page_id_t& page_id, const page_size_t& page_size, mtr_t* mtr);
 extern status_t fsp_alloc_free_page(uint32 space_id, const page_size_t& page_size,
@@ -106,8 +106,10 @@ status_t knl_server_end()
 
 void knl_handler::savepoint(que_sess_t* sess, trx_savepoint_t* savepoint)
 {
+    // savepoint does not begin the slot of trx
     if (sess->trx == NULL) {
-        trx_start_if_not_started(sess);
+        sess->trx = trx_begin(sess);
+        ut_a(sess->trx);
     }
 
     trx_savepoint(sess, sess->trx, savepoint);
@@ -127,6 +129,16 @@ void knl_handler::commit(que_sess_t* sess)
     }
 }
 
+void knl_handler::begin_query(que_sess_t* sess, scan_cursor_t* scan)
+{
+    scan->query_scn = trx_open_snapshot(sess);
+}
+
+void knl_handler::end_query(que_sess_t* sess)
+{
+    trx_close_snapshot(sess);
+}
+
 static void
 heapam_tuple_insert(Relation relation, TupleTableSlot *slot, CommandId cid,
 					int options, BulkInsertState bistate)
@@ -168,22 +180,12 @@ status_t knl_handler::insert_row(que_sess_t* sess, scan_cursor_t* cursor)
 	tuple = heap_form_tuple(tupDesc, values, Nulls);
 
 
-    // heap
+    // heap and index, the keys of row are inserted into all indexes by heap_insert
     err = heap_insert(sess, cursor->insert_node);
     if (err != CM_SUCCESS) {
         goto err_exit;
     }
 
-    // index
-    dict_index_t* index = UT_LIST_GET_FIRST(cursor->insert_node->table->indexes);
-    while (index) {
-        //
-        
-
-        index = UT_LIST_GET_NEXT(list_node, index);
-    }
-
-
     return CM_SUCCESS;
 
 err_exit:
@@ -200,22 +202,13 @@ status_t knl_handler::update_row(que_sess_t* sess, scan_cursor_t* cursor)
     trx_savepoint_t save_point;
     savepoint(sess, &save_point);
 
-    // heap
-    err = heap_insert(sess, cursor->insert_node);
+    // heap, the row at cursor is locked and replaced by the new version,
+    // keys of the new version are inserted into indexes, keys of the old one are kept
+    err = heap_update(sess, cursor->table, cursor->row_id, cursor->insert_node);
     if (err != CM_SUCCESS) {
         goto err_exit;
     }
 
-    // index
-    dict_index_t* index = UT_LIST_GET_FIRST(cursor->insert_node->table->indexes);
-    while (index) {
-        //
-        
-
-        index = UT_LIST_GET_NEXT(list_node, index);
-    }
-
-
     return CM_SUCCESS;
 
 err_exit:
@@ -225,16 +218,115 @@ err_exit:
     return CM_ERROR;
 }
 
+// Index entries of the row are kept for older snapshots, fetch by index skips them
+// once the row is not visible, and a unique key of the row may be taken over by an insert
 status_t knl_handler::delete_row(que_sess_t* sess, scan_cursor_t* cursor)
 {
+    trx_savepoint_t save_point;
+    savepoint(sess, &save_point);
+
+    if (heap_delete(sess, cursor->table, cursor->row_id) != CM_SUCCESS) {
+        rollback(sess, &save_point);
+        return CM_ERROR;
+    }
+
     return CM_SUCCESS;
 }
 
-status_t knl_handler::fetch_by_rowid(scan_cursor_t* scan, byte* buf, bool32* is_found)
+// Copies the row of index record at scan->btr_pcur into buf, if its visible version has the key of record
+status_t knl_handler::fetch_by_rowid(que_sess_t* sess, scan_cursor_t* scan, byte* buf, bool32* is_found)
 {
+    CM_RETURN_IF_ERROR(heap_fetch_by_rowid(sess, scan, scan->btr_pcur.key, scan->btr_pcur.key_len, is_found));
+    if (*is_found) {
+        memcpy(buf, scan->row, scan->row->size);
+    }
+
     return CM_SUCCESS;
 }
 
+status_t knl_handler::fetch_ext_column(scan_cursor_t* scan, uint32 column_id, byte* buf, uint32 buf_size,
+    uint32* len, bool32* is_null)
+{
+    const byte* ptr;
+
+    CM_RETURN_IF_ERROR(heap_get_ext_column(scan, column_id, &ptr));
+    *is_null = (ptr == NULL);
+    if (*is_null) {
+        *len = 0;
+        return CM_SUCCESS;
+    }
+
+    return toast_read_value(ptr, buf, buf_size, len);
+}
+
+status_t knl_handler::open_ext_column(scan_cursor_t* scan, uint32 column_id, toast_reader_t* reader, bool32* is_null)
+{
+    const byte* ptr;
+
+    CM_RETURN_IF_ERROR(heap_get_ext_column(scan, column_id, &ptr));
+    *is_null = (ptr == NULL);
+    if (!*is_null) {
+        toast_open(reader, ptr);
+    }
+
+    return CM_SUCCESS;
+}
+
+status_t knl_handler::read_ext_column(toast_reader_t* reader, byte* buf, uint32 size, uint32* read_len)
+{
+    return toast_read(reader, buf, size, read_len);
+}
+
+bool32 knl_handler::push_filter(scan_cursor_t* scan, scan_filter_t* filter)
+{
+    return heap_push_filter(scan, filter);
+}
+
+status_t knl_handler::fetch_rows(que_sess_t* sess, scan_cursor_t* scan, heap_row_vector_t* rows)
+{
+    return heap_fetch_batch(sess, scan, rows);
+}
+
+status_t knl_handler::parallel_scan_begin(que_sess_t* sess, scan_cursor_t* scan, uint32 worker_count)
+{
+    if (worker_count > srv_parallel_scan_max_workers) {
+        worker_count = srv_parallel_scan_max_workers;
+    }
+
+    return heap_parallel_scan_begin(sess, scan, worker_count);
+}
+
+// scan->is_eof is set when all workers are finished
+status_t knl_handler::parallel_scan_next(que_sess_t* sess, scan_cursor_t* scan)
+{
+    return heap_parallel_scan_fetch(sess, scan);
+}
+
+void knl_handler::parallel_scan_end(que_sess_t* sess, scan_cursor_t* scan)
+{
+    heap_parallel_scan_end(sess, scan);
+}
+
+status_t knl_handler::compact_table(que_sess_t* sess, dict_table_t* table)
+{
+    return heap_compact(sess, table);
+}
+
+status_t knl_handler::create_zone_map(que_sess_t* sess, dict_table_t* table,
+    const uint16* column_ids, uint16 column_count)
+{
+    return heap_create_zone_map(sess, table, column_ids, column_count);
+}
+
+status_t knl_handler::build_index(que_sess_t* sess, scan_cursor_t* scan, dict_index_t* index, uint32 worker_count)
+{
+    if (worker_count > srv_parallel_scan_max_workers) {
+        worker_count = srv_parallel_scan_max_workers;
+    }
+
+    return heap_build_index(sess, scan, index, worker_count);
+}
+
 int knl_handler::index_init(uint32 index)
 {
     return 0;
@@ -245,39 +337,212 @@ int knl_handler::index_end()
     return 0;
 }
 
+// Encodes value of index column into key, Datum of an integer, date or time column
+// is the value, Datum of other columns points to a text_t, 0 for null.
+static status_t index_key_put_datum(dict_col_t* col, Datum argument, btr_key_t* key)
+{
+    data_type_desc_t* desc = g_data_type_desc[col->mtype];
+
+    if (col->mtype == DATA_FLOAT || col->mtype == DATA_DOUBLE || col->mtype == DATA_REAL) {
+        CM_SET_ERROR(ERR_UNSUPPORTED, "index key column type");
+        return CM_ERROR;
+    }
+
+    if (desc != NULL && desc->fixed_length > 0) {
+        if (col->is_unsigned) {
+            btr_key_put_uint(key, (uint64)argument);
+        } else {
+            btr_key_put_int(key, (int64)argument);
+        }
+    } else if (argument == 0) {
+        btr_key_put_null(key);
+    } else {
+        text_t* text = (text_t *)argument;
+        btr_key_put_bytes(key, (const byte *)text->str, text->len);
+    }
+
+    return CM_SUCCESS;
+}
+
+// Builds the range of index scan from keys, keys are on the leading columns of index in order:
+// EQUAL on a prefix of columns, then a lower and an upper bound at most on the next column.
+static status_t index_scan_build_range(scan_cursor_t* scan)
+{
+    dict_index_t* index = scan->index;
+    uint32 field_no = 0;
+    bool32 has_low = FALSE;
+    bool32 has_high = FALSE;
+
+    btr_key_init(&scan->btr_low_key);
+    btr_key_init(&scan->btr_high_key);
+    scan->btr_low_mode = BTR_VALUE_MIN;
+    scan->btr_high_mode = BTR_VALUE_MAX;
+
+    // keys of prefix fields are not built, see heap_build_index_key
+    for (uint32 i = 0; i < index->field_count; i++) {
+        if (index->fields[i].prefix_len > 0) {
+            CM_SET_ERROR(ERR_UNSUPPORTED, "index prefix column");
+            return CM_ERROR;
+        }
+    }
+
+    for (uint32 i = 0; i < scan->key_count; i++) {
+        scan_key_t* key = &scan->keys[i];
+
+        if (key->attr_no >= index->field_count) {
+            CM_SET_ERROR(ERR_COLUMN_NOT_EXIST, "index key column");
+            return CM_ERROR;
+        }
+        if (key->attr_no != field_no) {
+            CM_SET_ERROR(ERR_UNSUPPORTED, "index key column order");
+            return CM_ERROR;
+        }
+
+        dict_col_t* col = index->table->columns[index->fields[key->attr_no].col_ind];
+        switch (key->strategy) {
+        case BTREE_FETCH_STRATEGY_EQUAL:
+            if (has_low || has_high) {
+                CM_SET_ERROR(ERR_UNSUPPORTED, "index key column order");
+                return CM_ERROR;
+            }
+            CM_RETURN_IF_ERROR(index_key_put_datum(col, key->argument, &scan->btr_low_key));
+            CM_RETURN_IF_ERROR(index_key_put_datum(col, key->argument, &scan->btr_high_key));
+            field_no++;
+            break;
+        case BTREE_FETCH_STRATEGY_GREATER_EQUAL:
+        case BTREE_FETCH_STRATEGY_GREATER:
+            if (has_low) {
+                CM_SET_ERROR(ERR_UNSUPPORTED, "index key range");
+                return CM_ERROR;
+            }
+            CM_RETURN_IF_ERROR(index_key_put_datum(col, key->argument, &scan->btr_low_key));
+            scan->btr_low_mode = (key->strategy == BTREE_FETCH_STRATEGY_GREATER) ? BTR_VALUE_MAX : BTR_VALUE_MIN;
+            has_low = TRUE;
+            break;
+        case BTREE_FETCH_STRATEGY_LESS_EQUAL:
+        case BTREE_FETCH_STRATEGY_LESS:
+            if (has_high) {
+                CM_SET_ERROR(ERR_UNSUPPORTED, "index key range");
+                return CM_ERROR;
+            }
+            CM_RETURN_IF_ERROR(index_key_put_datum(col, key->argument, &scan->btr_high_key));
+            scan->btr_high_mode = (key->strategy == BTREE_FETCH_STRATEGY_LESS) ? BTR_VALUE_MIN : BTR_VALUE_MAX;
+            has_high = TRUE;
+            break;
+        default:
+            CM_SET_ERROR(ERR_UNSUPPORTED, "index key strategy");
+            return CM_ERROR;
+        }
+    }
+
+    if (scan->btr_low_key.is_overflow || scan->btr_high_key.is_overflow) {
+        CM_SET_ERROR(ERR_UNSUPPORTED, "index key length");
+        return CM_ERROR;
+    }
+
+    return CM_SUCCESS;
+}
+
+// Sets is_found and row_id of scan if the record of index cursor is in the range
+static void index_scan_check_range(scan_cursor_t* scan, bool32 is_forward)
+{
+    btr_tuple_t tuple;
+
+    if (!btr_pcur_is_on_rec(&scan->btr_pcur)) {
+        scan->is_eof = TRUE;
+    } else if (is_forward) {
+        btr_tuple_set(&tuple, scan->btr_high_key.data, scan->btr_high_key.len, scan->btr_high_mode, 0);
+        scan->is_eof = btr_pcur_cmp_tuple(&scan->btr_pcur, &tuple) < 0;
+    } else {
+        btr_tuple_set(&tuple, scan->btr_low_key.data, scan->btr_low_key.len, scan->btr_low_mode, 0);
+        scan->is_eof = btr_pcur_cmp_tuple(&scan->btr_pcur, &tuple) > 0;
+    }
+
+    scan->is_found = !scan->is_eof;
+    if (scan->is_found) {
+        scan->row_id.id = scan->btr_pcur.value;
+    }
+}
+
+// Fetches the row of the record at index cursor into buf, records whose rows are not visible
+// are skipped in direction of scan, until the end of range
+static status_t index_scan_fetch_row(knl_handler* handler, que_sess_t* sess, scan_cursor_t* scan,
+    byte* buf, bool32 is_forward)
+{
+    for (;;) {
+        index_scan_check_range(scan, is_forward);
+        if (!scan->is_found) {
+            return CM_SUCCESS;
+        }
+
+        CM_RETURN_IF_ERROR(handler->fetch_by_rowid(sess, scan, buf, &scan->is_found));
+        if (scan->is_found) {
+            return CM_SUCCESS;
+        }
+
+        if (is_forward) {
+            btr_pcur_move_to_next(&scan->btr_pcur);
+        } else {
+            btr_pcur_move_to_prev(&scan->btr_pcur);
+        }
+    }
+}
+
+// Positions index cursor on the first record in the range of scan->keys
 // buf: in/out, buffer for the row
-int32 knl_handler::index_fetch(scan_cursor_t* scan, byte* buf, row_fetch_match_mode match_mode)
+int32 knl_handler::index_fetch(que_sess_t* sess, scan_cursor_t* scan, byte* buf, row_fetch_match_mode match_mode)
 {
-    return 0;
+    btr_tuple_t tuple;
+
+    CM_RETURN_IF_ERROR(index_scan_build_range(scan));
+
+    btr_tuple_set(&tuple, scan->btr_low_key.data, scan->btr_low_key.len, scan->btr_low_mode, 0);
+    btr_pcur_open(scan->index, &tuple, BTR_SEARCH_GE, &scan->btr_pcur);
+
+    return index_scan_fetch_row(this, sess, scan, buf, TRUE);
 }
 
-int32 knl_handler::index_first(scan_cursor_t* scan, byte* buf)
+int32 knl_handler::index_first(que_sess_t* sess, scan_cursor_t* scan, byte* buf)
 {
-    return index_fetch(scan, buf, FETCH_ROW_KEY_EXACT);
+    return index_fetch(sess, scan, buf, FETCH_ROW_KEY_EXACT);
 }
 
-int32 knl_handler::index_last(scan_cursor_t* scan, byte* buf)
+// Positions index cursor on the last record in the range of scan->keys
+int32 knl_handler::index_last(que_sess_t* sess, scan_cursor_t* scan, byte* buf)
 {
-    return index_fetch(scan, buf, FETCH_ROW_KEY_EXACT);
+    btr_tuple_t tuple;
+
+    CM_RETURN_IF_ERROR(index_scan_build_range(scan));
+
+    btr_tuple_set(&tuple, scan->btr_high_key.data, scan->btr_high_key.len, scan->btr_high_mode, 0);
+    btr_pcur_open(scan->index, &tuple, BTR_SEARCH_LE, &scan->btr_pcur);
+
+    return index_scan_fetch_row(this, sess, scan, buf, FALSE);
 }
 
-// Reads the next or previous row from a cursor, which must have previously been positioned using index_read.
-// return 0, HA_ERR_END_OF_FILE, or error number
+// Reads the next or previous row from a cursor, which must have previously been positioned
+// by index_fetch, index_first or index_last. scan->is_eof is set at the end of range.
 // buf: in/out, buffer for the row
-int32 knl_handler::general_fetch(    scan_cursor_t* scan, byte* buf,
+int32 knl_handler::general_fetch(que_sess_t* sess, scan_cursor_t* scan, byte* buf,
     row_fetch_direction direction, row_fetch_match_mode match_mode)
 {
-    return 0;
+    if (direction == FETCH_ROW_NEXT) {
+        btr_pcur_move_to_next(&scan->btr_pcur);
+    } else {
+        btr_pcur_move_to_prev(&scan->btr_pcur);
+    }
+
+    return index_scan_fetch_row(this, sess, scan, buf, direction == FETCH_ROW_NEXT);
 }
 
-int32 knl_handler::index_next(    scan_cursor_t* scan, byte* buf)
+int32 knl_handler::index_next(que_sess_t* sess, scan_cursor_t* scan, byte* buf)
 {
-    return general_fetch(scan, buf, FETCH_ROW_NEXT, FETCH_ROW_KEY_EXACT);
+    return general_fetch(sess, scan, buf, FETCH_ROW_NEXT, FETCH_ROW_KEY_EXACT);
 }
 
-int32 knl_handler::index_prev(    scan_cursor_t* scan, byte* buf)
+int32 knl_handler::index_prev(que_sess_t* sess, scan_cursor_t* scan, byte* buf)
 {
-    return general_fetch(scan, buf, FETCH_ROW_PREV, FETCH_ROW_KEY_EXACT);
+    return general_fetch(sess, scan, buf, FETCH_ROW_PREV, FETCH_ROW_KEY_EXACT);
 }
 
 
@@ -1,10 +1,12 @@
 #include "knl_heap_fsm.h"
 #include "cm_log.h"
+#include "cm_memory.h"
 #include "knl_buf.h"
 #include "knl_flst.h"
 #include "knl_page.h"
 #include "knl_fsp.h"
 #include "knl_heap.h"
+#include "knl_heap_zone.h"
 
 #define FSM_CATEGORIES       127
 
@@ -134,7 +136,8 @@ static inline uint8 fsm_get_max_avail(page_t* page)
 // Searches for a slot with category at least minvalue.
 // Returns slot number, or -1 if none found.
 // The caller must hold at least a shared lock on the page.
-static int32 fsm_search_avail(buf_block_t* block, uint8 min_value)
+// target_hint: slot to start the search from, FSM_INVALID_SLOT to use fp_next_slot
+static int32 fsm_search_avail(buf_block_t* block, uint8 min_value, int32 target_hint)
 {
     heap_fsm_nodes_t* fsm_nodes;
     int32             node_no;
@@ -151,7 +154,7 @@ static int32 fsm_search_avail(buf_block_t* block, uint8 min_value)
     // It's just a hint, so check that it's sane.
     // (This also handles wrapping around when the prior call returned the last slot on the page.)
 
-    target = fsm_get_next_slot(fsm_nodes);
+    target = (target_hint != FSM_INVALID_SLOT) ? target_hint : fsm_get_next_slot(fsm_nodes);
     if (target < 0 || target >= FSM_LEAF_NODES_PER_PAGE) {
         target = 0;
     }
@@ -206,7 +209,9 @@ static int32 fsm_search_avail(buf_block_t* block, uint8 min_value)
 
     // Update the next-target pointer
     // Note that we do this even if we're only holding a shared lock
-    fsm_set_next_slot(fsm_nodes, slot + 1);
+    if (target_hint == FSM_INVALID_SLOT) {
+        fsm_set_next_slot(fsm_nodes, slot + 1);
+    }
 
     return slot;
 }
@@ -384,6 +389,9 @@ static bool32 fsm_extend_table_segment(dict_table_t* table)
     table->heap_io_in_progress = TRUE;
     mutex_exit(&table->mutex);
 
+    // zone map of new extents is maintained in mtr of extending
+    zone_map_load(table);
+
     mtr_t mtr;
 
     mtr_start(&mtr);
@@ -429,7 +437,10 @@ static bool32 fsm_extend_table_segment(dict_table_t* table)
 }
 
 // Search the tree for a heap page with at least min_cat of free space
-page_no_t fsm_search_free_page(dict_table_t* table, uint8 min_category, fsm_search_path_t& search_path)
+// stripe_count > 0: the search in leaf map page starts from the range of stripe_no,
+// so that concurrent inserters of different stripes are steered to different pages
+page_no_t fsm_search_free_page(dict_table_t* table, uint8 min_category, fsm_search_path_t& search_path,
+    uint32 stripe_no, uint32 stripe_count)
 {
     int restarts = 0;
     page_id_t page_id(table->space_id, table->entry_page_no);
@@ -453,7 +464,12 @@ page_no_t fsm_search_free_page(dict_table_t* table, uint8 min_category, fsm_sear
         buf_block_lock_and_fix(block, RW_S_LATCH, &mtr);
 
         // Search within the page
-        int32 slot = fsm_search_avail(block, min_category);
+        int32 target_hint = FSM_INVALID_SLOT;
+        if (level == FSM_BOTTOM_LEVEL && stripe_count > 0) {
+            uint32 page_count = mach_read_from_4(buf_block_get_frame(block) + FSM_NODES + FSM_NODES_PAGE_COUNT);
+            target_hint = (int32)(stripe_no * page_count / stripe_count);
+        }
+        int32 slot = fsm_search_avail(block, min_category, target_hint);
         search_path.nodes[level].page_slot_in_upper_level = slot;
 
         if (slot != FSM_INVALID_SLOT) {
@@ -654,6 +670,7 @@ static inline void fsm_page_init(buf_block_t* block, mtr_t* mtr)
     mlog_write_uint32(header + FSM_HEAP_FIRST_PAGE, FIL_NULL, MLOG_4BYTES, mtr);
     mlog_write_uint32(header + FSM_HEAP_LAST_PAGE, FIL_NULL, MLOG_4BYTES, mtr);
     mlog_write_uint32(header + FSM_HEAP_PAGE_COUNT, 0, MLOG_4BYTES, mtr);
+    mlog_write_uint32(header + FSM_ZONE_MAP_PAGE, FIL_NULL, MLOG_4BYTES, mtr);
 
     flst_init(header + FSM_FSEG_FREE, mtr);
     flst_init(header + FSM_FSEG_NOT_FULL, mtr);
@@ -910,6 +927,7 @@ static bool32 fsm_extend_heap_extents(dict_table_t* table, uint32 extent_count,
 
         // add pages to map page
         fsm_add_free_extents(table->space_id, table->entry_page_no, descr[i], mtr);
+        zone_map_add_extent(table, xdes_get_offset(descr[i]), mtr);
     }
 
     return TRUE;
@@ -935,3 +953,123 @@ bool32 fsm_alloc_heap_page(dict_table_t* table, uint32 page_count, mtr_t* mtr)
     return fsm_extend_heap_extents(table, page_count / FSP_EXTENT_SIZE, mtr);
 }
 
+typedef struct st_fsm_scan_entry {
+    page_no_t page_no;  // child map page or heap page
+    int32     slot;
+    uint8     category;
+} fsm_scan_entry_t;
+
+// Collects the slots of a map page with category at least min_category
+static uint32 fsm_collect_slots(uint32 space_id, page_no_t page_no, uint8 min_category, fsm_scan_entry_t* entries)
+{
+    mtr_t mtr;
+    uint32 count = 0;
+    const page_id_t page_id(space_id, page_no);
+    const page_size_t page_size(space_id);
+
+    mtr_start(&mtr);
+
+    buf_block_t* block = buf_page_get(page_id, page_size, RW_S_LATCH, &mtr);
+    ut_ad(block->get_page_type() == FIL_PAGE_TYPE_HEAP_FSM);
+    page_t* page = buf_block_get_frame(block);
+
+    uint32 page_count = fsm_get_nodes_page_count(block);
+    for (int32 slot = 0; slot < (int32)page_count && slot < FSM_LEAF_NODES_PER_PAGE; slot++) {
+        uint8 category = fsm_get_avail(page, slot);
+        if (category < min_category) {
+            continue;
+        }
+        entries[count].page_no = fsm_get_child(block, slot);
+        entries[count].slot = slot;
+        entries[count].category = category;
+        count++;
+    }
+
+    mtr_commit(&mtr);
+
+    return count;
+}
+
+// Visits heap pages with category at least min_category, from the root map page down.
+// No latch of map pages is held while visitor is called, so visitor can change category of page.
+status_t fsm_scan_heap_pages(dict_table_t* table, uint8 min_category, fsm_page_visitor_t visitor, void* arg)
+{
+    fsm_search_path_t search_path;
+    fsm_scan_entry_t* entries[FSM_PATH_LEVEL_COUNT];
+    uint32 counts[FSM_PATH_LEVEL_COUNT];
+
+    entries[0] = (fsm_scan_entry_t *)ut_malloc_zero(FSM_PATH_LEVEL_COUNT * FSM_LEAF_NODES_PER_PAGE * sizeof(fsm_scan_entry_t));
+    if (entries[0] == NULL) {
+        LOGGER_ERROR(LOGGER, LOG_MODULE_HEAP_FSM, "fsm_scan_heap_pages: failed to malloc memory");
+        return CM_ERROR;
+    }
+    entries[1] = entries[0] + FSM_LEAF_NODES_PER_PAGE;
+    entries[2] = entries[1] + FSM_LEAF_NODES_PER_PAGE;
+
+    search_path.space_id = table->space_id;
+    search_path.nodes[FSM_PATH_MAX_LEVEL].page_no = table->entry_page_no;
+    counts[2] = fsm_collect_slots(table->space_id, table->entry_page_no, min_category, entries[2]);
+
+    for (uint32 i2 = 0; i2 < counts[2]; i2++) {
+        search_path.nodes[2].page_slot_in_upper_level = entries[2][i2].slot;
+        search_path.nodes[1].page_no = entries[2][i2].page_no;
+        counts[1] = fsm_collect_slots(table->space_id, entries[2][i2].page_no, min_category, entries[1]);
+
+        for (uint32 i1 = 0; i1 < counts[1]; i1++) {
+            search_path.nodes[1].page_slot_in_upper_level = entries[1][i1].slot;
+            search_path.nodes[0].page_no = entries[1][i1].page_no;
+            counts[0] = fsm_collect_slots(table->space_id, entries[1][i1].page_no, min_category, entries[0]);
+
+            for (uint32 i0 = 0; i0 < counts[0]; i0++) {
+                search_path.nodes[0].page_slot_in_upper_level = entries[0][i0].slot;
+                search_path.category = entries[0][i0].category;
+                if (!visitor(table, entries[0][i0].page_no, search_path, arg)) {
+                    ut_free(entries[0]);
+                    return CM_SUCCESS;
+                }
+            }
+        }
+    }
+
+    ut_free(entries[0]);
+
+    return CM_SUCCESS;
+}
+
+void fsm_insert_cache_init(fsm_insert_cache_t* cache)
+{
+    for (uint32 i = 0; i < FSM_INSERT_CACHE_STRIPES; i++) {
+        mutex_create(&cache[i].mutex);
+        cache[i].page_no = INVALID_PAGE_NO;
+    }
+}
+
+void fsm_insert_cache_destroy(fsm_insert_cache_t* cache)
+{
+    for (uint32 i = 0; i < FSM_INSERT_CACHE_STRIPES; i++) {
+        mutex_destroy(&cache[i].mutex);
+    }
+}
+
+bool32 fsm_insert_cache_get(fsm_insert_cache_t* cache, fsm_search_path_t& search_path, page_no_t* page_no)
+{
+    mutex_enter(&cache->mutex, NULL);
+    *page_no = cache->page_no;
+    if (*page_no != INVALID_PAGE_NO) {
+        search_path = cache->search_path;
+    }
+    mutex_exit(&cache->mutex);
+
+    return *page_no != INVALID_PAGE_NO;
+}
+
+// page_no: INVALID_PAGE_NO to clear the cached page
+void fsm_insert_cache_set(fsm_insert_cache_t* cache, page_no_t page_no, fsm_search_path_t& search_path)
+{
+    mutex_enter(&cache->mutex, NULL);
+    cache->page_no = page_no;
+    if (page_no != INVALID_PAGE_NO) {
+        cache->search_path = search_path;
+    }
+    mutex_exit(&cache->mutex);
+}
@@ -20,7 +20,8 @@ typedef byte heap_fsm_header_t;
 #define FSM_FSEG_FRAG_ARR           (24 + 3 * FLST_BASE_NODE_SIZE)  /* array of individual pages */
 
 #define FSM_FSEG_INODE_SIZE         (3 * FLST_BASE_NODE_SIZE + FSP_EXTENT_SIZE * FSM_NODE_PAGE_NO_SIZE)
-#define FSM_HEADER_SIZE             (24 + FSM_FSEG_INODE_SIZE)
+#define FSM_ZONE_MAP_PAGE           (24 + FSM_FSEG_INODE_SIZE)  // root page of zone map, FIL_NULL if none
+#define FSM_HEADER_SIZE             (28 + FSM_FSEG_INODE_SIZE)
 
 typedef byte      heap_fsm_nodes_t;
 
@@ -76,6 +77,27 @@ extern void fsm_recursive_set_catagory(dict_table_t* table, fsm_search_path_t& a
 extern uint32 fsm_create(uint32     space_id);
 extern bool32 fsm_alloc_heap_page(dict_table_t* table, uint32 page_count, mtr_t* mtr);
 extern void fsm_add_free_page(uint32 space_id, uint32 root_page_no, uint32 free_page_no, mtr_t* mtr);
-extern page_no_t fsm_search_free_page(dict_table_t* table, uint8 min_category, fsm_search_path_t& search_path);
+extern page_no_t fsm_search_free_page(dict_table_t* table, uint8 min_category, fsm_search_path_t& search_path,
+    uint32 stripe_no = 0, uint32 stripe_count = 0);
+
+#define FSM_INSERT_CACHE_STRIPES    8
+
+// Last heap page inserted into by the sessions of a stripe, with its fsm path and category.
+// Inserts search the fsm only when the cached page is full.
+struct st_fsm_insert_cache {
+    mutex_t           mutex;
+    page_no_t         page_no;  // INVALID_PAGE_NO if no page is cached
+    fsm_search_path_t search_path;
+    byte              reserved[64];  // keep stripes in different cache lines
+};
+
+extern void fsm_insert_cache_init(fsm_insert_cache_t* cache);
+extern void fsm_insert_cache_destroy(fsm_insert_cache_t* cache);
+extern bool32 fsm_insert_cache_get(fsm_insert_cache_t* cache, fsm_search_path_t& search_path, page_no_t* page_no);
+extern void fsm_insert_cache_set(fsm_insert_cache_t* cache, page_no_t page_no, fsm_search_path_t& search_path);
+
+// returns FALSE to stop the scan
+typedef bool32 (*fsm_page_visitor_t)(dict_table_t* table, page_no_t page_no, fsm_search_path_t& search_path, void* arg);
+extern status_t fsm_scan_heap_pages(dict_table_t* table, uint8 min_category, fsm_page_visitor_t visitor, void* arg);
 
 #endif  /* _KNL_HEAP_FSM_H */
@@ -1,4 +1,240 @@
 #include "knl_heap_toast.h"
+#include "cm_log.h"
+#include "knl_buf.h"
+#include "knl_fsp.h"
+#include "knl_mtr.h"
+#include "knl_trx.h"
 
+inline void toast_read_pointer(const byte* ptr, toast_pointer_t* pointer)
+{
+    pointer->space_id = mach_read_from_4(ptr);
+    pointer->page_no = mach_read_from_4(ptr + 4);
+    pointer->length = mach_read_from_4(ptr + 8);
+}
 
+inline void toast_write_pointer(byte* ptr, const toast_pointer_t* pointer)
+{
+    mach_write_to_4(ptr, pointer->space_id);
+    mach_write_to_4(ptr + 4, pointer->page_no);
+    mach_write_to_4(ptr + 8, pointer->length);
+}
 
+// UNDO_LOB_INSERT is written in the mini-transaction of first page,
+// rollback frees the chain from first page whatever the chain is completed or not.
+// UNDO_LOB_DELETE is kept in update undo, purge frees the chain when no snapshot sees the row.
+static status_t toast_write_undo(que_sess_t* sess, const toast_pointer_t* pointer,
+    undo_type_t type, mtr_t* mtr)
+{
+    undo_data_t undo_data;
+
+    undo_data.undo_op = (type == UNDO_LOB_INSERT) ? UNDO_INSERT_OP : UNDO_MODIFY_OP;
+    undo_data.query_min_scn = 0;
+    undo_data.rec_mgr.m_trx = sess->trx;
+    undo_data.rec_mgr.m_type = type;
+    undo_data.rec_mgr.m_cid = sess->cid;
+    undo_data.rec_mgr.m_data_size = TOAST_POINTER_SIZE;
+    undo_data.rec_mgr.m_lob.space_id = pointer->space_id;
+    undo_data.rec_mgr.m_lob.page_no = pointer->page_no;
+    undo_data.rec_mgr.m_lob.length = pointer->length;
+
+    CM_RETURN_IF_ERROR(trx_undo_prepare(sess, &undo_data, mtr));
+    return trx_undo_write_log_rec(sess, &undo_data, mtr);
+}
+
+static inline void toast_page_init(buf_block_t* block, const byte* data, uint32 data_len, uint32 total_len, mtr_t* mtr)
+{
+    page_t* page = buf_block_get_frame(block);
+
+    mlog_write_uint32(page + FIL_PAGE_TYPE, FIL_PAGE_TYPE_TOAST, MLOG_2BYTES, mtr);
+    mlog_write_uint32(page + FIL_PAGE_NEXT, FIL_NULL, MLOG_4BYTES, mtr);
+    mlog_write_uint32(page + TOAST_HEADER + TOAST_HEADER_DATA_LEN, data_len, MLOG_4BYTES, mtr);
+    mlog_write_uint32(page + TOAST_HEADER + TOAST_HEADER_TOTAL_LEN, total_len, MLOG_4BYTES, mtr);
+    if (data_len > 0) {
+        mlog_write_string(page + TOAST_DATA, data, data_len, mtr);
+    }
+}
+
+// Writes value into a chain of toast pages, one mini-transaction per page,
+// every new page is linked to the previous page of chain in the same mini-transaction.
+status_t toast_write_value(que_sess_t* sess, dict_table_t* table,
+    const byte* data, uint32 len, toast_pointer_t* pointer)
+{
+    mtr_t mtr;
+    buf_block_t* block;
+    const page_size_t page_size(table->space_id);
+    uint32 chunk_size = TOAST_CHUNK_MAX_SIZE(page_size.physical());
+    uint32 prev_page_no = FIL_NULL;
+    uint32 offset = 0;
+
+    if (len > TOAST_VALUE_MAX_SIZE) {
+        CM_SET_ERROR(ERR_VARIANT_DATA_TOO_BIG, len);
+        return CM_ERROR;
+    }
+
+    pointer->space_id = table->space_id;
+    pointer->page_no = FIL_NULL;
+    pointer->length = len;
+
+    do {
+        uint32 chunk_len = ut_min(len - offset, chunk_size);
+
+        mtr_start(&mtr);
+
+        if (fsp_alloc_free_page(table->space_id, page_size, Page_fetch::NORMAL, &block, &mtr) != CM_SUCCESS) {
+            mtr_commit(&mtr);
+            LOGGER_ERROR(LOGGER, LOG_MODULE_TOAST,
+                "toast_write_value: failed to alloc page, table %s space id %u value length %u",
+                table->name, table->space_id, len);
+            return CM_ERROR;
+        }
+        toast_page_init(block, data + offset, chunk_len, len, &mtr);
+
+        if (prev_page_no == FIL_NULL) {
+            pointer->page_no = block->get_page_no();
+            if (toast_write_undo(sess, pointer, UNDO_LOB_INSERT, &mtr) != CM_SUCCESS) {
+                fsp_free_page(page_id_t(table->space_id, block->get_page_no()), page_size, &mtr);
+                mtr_commit(&mtr);
+                return CM_ERROR;
+            }
+        } else {
+            const page_id_t prev_page_id(table->space_id, prev_page_no);
+            buf_block_t* prev_block = buf_page_get(prev_page_id, page_size, RW_X_LATCH, &mtr);
+            mlog_write_uint32(buf_block_get_frame(prev_block) + FIL_PAGE_NEXT,
+                block->get_page_no(), MLOG_4BYTES, &mtr);
+        }
+
+        prev_page_no = block->get_page_no();
+        mtr_commit(&mtr);
+
+        offset += chunk_len;
+    } while (offset < len);
+
+    return CM_SUCCESS;
+}
+
+// The chain of toast pointer at ptr is no longer referenced by the row deleted by trx of sess,
+// it is kept for consistent read and rollback, and freed by purge.
+status_t toast_delete_value(que_sess_t* sess, const byte* ptr, mtr_t* mtr)
+{
+    toast_pointer_t pointer;
+
+    toast_read_pointer(ptr, &pointer);
+    if (pointer.page_no == FIL_NULL) {
+        return CM_SUCCESS;
+    }
+
+    return toast_write_undo(sess, &pointer, UNDO_LOB_DELETE, mtr);
+}
+
+// Frees the first page of chain and moves pointer to the next page, FALSE if chain is empty.
+// A caller logging the moved pointer in the same mtr never frees a page twice.
+bool32 toast_free_first_page(toast_pointer_t* pointer, mtr_t* mtr)
+{
+    if (pointer->page_no == FIL_NULL) {
+        return FALSE;
+    }
+
+    const page_size_t page_size(pointer->space_id);
+    const page_id_t page_id(pointer->space_id, pointer->page_no);
+    buf_block_t* block = buf_page_get(page_id, page_size, RW_X_LATCH, mtr);
+    ut_a(block->get_page_type() == FIL_PAGE_TYPE_TOAST);
+    pointer->page_no = block->get_next_page_no();
+    fsp_free_page(page_id, page_size, mtr);
+
+    return TRUE;
+}
+
+void toast_free_value(const toast_pointer_t* pointer)
+{
+    mtr_t mtr;
+    toast_pointer_t chain = *pointer;
+
+    for (;;) {
+        mtr_start(&mtr);
+        bool32 is_freed = toast_free_first_page(&chain, &mtr);
+        mtr_commit(&mtr);
+        if (!is_freed) {
+            break;
+        }
+    }
+}
+
+void toast_open(toast_reader_t* reader, const byte* ptr)
+{
+    toast_read_pointer(ptr, &reader->pointer);
+    reader->page_no = reader->pointer.page_no;
+    reader->page_offset = 0;
+    reader->read_len = 0;
+}
+
+inline bool32 toast_is_eof(toast_reader_t* reader)
+{
+    return reader->read_len >= reader->pointer.length || reader->page_no == FIL_NULL;
+}
+
+// Reads next size bytes of value at most, only the pages covering the requested data are fetched.
+status_t toast_read(toast_reader_t* reader, byte* buf, uint32 size, uint32* read_len)
+{
+    mtr_t mtr;
+    const page_size_t page_size(reader->pointer.space_id);
+
+    *read_len = 0;
+    while (*read_len < size && !toast_is_eof(reader)) {
+        const page_id_t page_id(reader->pointer.space_id, reader->page_no);
+
+        mtr_start(&mtr);
+        buf_block_t* block = buf_page_get(page_id, page_size, RW_S_LATCH, &mtr);
+        page_t* page = buf_block_get_frame(block);
+        uint32 data_len = mach_read_from_4(page + TOAST_HEADER + TOAST_HEADER_DATA_LEN);
+        if (block->get_page_type() != FIL_PAGE_TYPE_TOAST ||
+            mach_read_from_4(page + TOAST_HEADER + TOAST_HEADER_TOTAL_LEN) != reader->pointer.length ||
+            reader->page_offset > data_len) {
+            mtr_commit(&mtr);
+            LOGGER_ERROR(LOGGER, LOG_MODULE_TOAST,
+                "toast_read: invalid toast page (space id %u page no %u), value length %u",
+                page_id.get_space_id(), page_id.get_page_no(), reader->pointer.length);
+            return CM_ERROR;
+        }
+
+        uint32 copy_len = ut_min(data_len - reader->page_offset, size - *read_len);
+        memcpy(buf + *read_len, page + TOAST_DATA + reader->page_offset, copy_len);
+        *read_len += copy_len;
+        reader->read_len += copy_len;
+        reader->page_offset += copy_len;
+        if (reader->page_offset == data_len) {
+            reader->page_no = block->get_next_page_no();
+            reader->page_offset = 0;
+        }
+
+        mtr_commit(&mtr);
+    }
+
+    return CM_SUCCESS;
+}
+
+status_t toast_read_value(const byte* ptr, byte* buf, uint32 buf_size, uint32* len)
+{
+    toast_reader_t reader;
+
+    toast_open(&reader, ptr);
+    if (buf_size < reader.pointer.length) {
+        CM_SET_ERROR(ERR_VARIANT_DATA_TOO_BIG, reader.pointer.length);
+        return CM_ERROR;
+    }
+
+    return toast_read(&reader, buf, reader.pointer.length, len);
+}
+
+void toast_undo_insert(que_sess_t* sess, trx_t* trx, trx_undo_rec_hdr_t* undo_rec, uint32 undo_rec_size)
+{
+    undo_rec_mgr_t undo_mgr;
+    toast_pointer_t pointer;
+
+    undo_mgr.deserialize(undo_rec, undo_rec_size);
+    ut_a(undo_mgr.m_type == UNDO_LOB_INSERT);
+
+    pointer.space_id = undo_mgr.m_lob.space_id;
+    pointer.page_no = undo_mgr.m_lob.page_no;
+    pointer.length = undo_mgr.m_lob.length;
+    toast_free_value(&pointer);
+}
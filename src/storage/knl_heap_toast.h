@@ -2,13 +2,59 @@
 #define _KNL_HEAP_TOAST_H
 
 #include "cm_type.h"
-//#include "cm_space.h"
-//#include "cm_page.h"
+#include "knl_dict.h"
+#include "knl_session.h"
+#include "knl_trx_types.h"
+#include "knl_trx_undo.h"
 
+// Large values of externally stored columns are moved out of heap row,
+// into a chain of toast pages allocated from the tablespace of table.
+// The row keeps a toast pointer of TOAST_POINTER_SIZE in place of value.
 
+typedef byte toast_page_header_t;
 
+#define TOAST_HEADER                 FIL_PAGE_DATA
 
+#define TOAST_HEADER_DATA_LEN        0   // length of chunk data in page
+#define TOAST_HEADER_TOTAL_LEN       4   // length of whole value, for checking
+#define TOAST_HEADER_SIZE            8
 
+#define TOAST_DATA                   (TOAST_HEADER + TOAST_HEADER_SIZE)
+#define TOAST_CHUNK_MAX_SIZE(physical_page_size) \
+    ((physical_page_size) - TOAST_DATA - FIL_PAGE_DATA_END)
 
+#define TOAST_VALUE_MAX_SIZE         (uint32)0x40000000  // 1GB
+
+typedef struct st_toast_pointer {
+    uint32      space_id;
+    uint32      page_no;  // first page of chain
+    uint32      length;   // length of value
+} toast_pointer_t;
+
+#define TOAST_POINTER_SIZE           12
+
+// Streaming reader of a toast value, pages are fetched only when the data is requested
+typedef struct st_toast_reader {
+    toast_pointer_t pointer;
+    uint32      page_no;      // page to read, FIL_NULL if end of chain
+    uint32      page_offset;  // read offset in chunk data of page
+    uint32      read_len;     // length of data already returned
+} toast_reader_t;
+
+extern status_t toast_write_value(que_sess_t* sess, dict_table_t* table,
+    const byte* data, uint32 len, toast_pointer_t* pointer);
+extern status_t toast_delete_value(que_sess_t* sess, const byte* ptr, mtr_t* mtr);
+extern void toast_free_value(const toast_pointer_t* pointer);
+extern bool32 toast_free_first_page(toast_pointer_t* pointer, mtr_t* mtr);
+
+extern inline void toast_read_pointer(const byte* ptr, toast_pointer_t* pointer);
+extern inline void toast_write_pointer(byte* ptr, const toast_pointer_t* pointer);
+
+extern void toast_open(toast_reader_t* reader, const byte* ptr);
+extern status_t toast_read(toast_reader_t* reader, byte* buf, uint32 size, uint32* read_len);
+extern inline bool32 toast_is_eof(toast_reader_t* reader);
+extern status_t toast_read_value(const byte* ptr, byte* buf, uint32 buf_size, uint32* len);
+
+extern void toast_undo_insert(que_sess_t* sess, trx_t* trx, trx_undo_rec_hdr_t* undo_rec, uint32 undo_rec_size);
 
 #endif  /* _KNL_HEAP_TOAST_H */
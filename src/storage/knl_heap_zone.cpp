@@ -0,0 +1,338 @@
+#include "knl_heap_zone.h"
+#include "cm_log.h"
+#include "knl_buf.h"
+#include "knl_flst.h"
+#include "knl_fsp.h"
+#include "knl_heap_fsm.h"
+
+static inline void zone_map_fill(byte* ptr, byte value, uint32 len, mtr_t* mtr)
+{
+    memset(ptr, value, len);
+    mlog_log_string(ptr, len, mtr);
+}
+
+static inline void zone_map_page_init(buf_block_t* block, mtr_t* mtr)
+{
+    page_t* page = buf_block_get_frame(block);
+
+    mlog_write_uint32(page + FIL_PAGE_TYPE, FIL_PAGE_TYPE_HEAP_ZONE, MLOG_2BYTES, mtr);
+    mlog_write_uint32(page + FIL_PAGE_NEXT, FIL_NULL, MLOG_4BYTES, mtr);
+    zone_map_fill(page + ZONE_MAP_HEADER, 0x00, ZONE_MAP_HEADER_SIZE, mtr);
+}
+
+static inline byte* zone_map_get_column(page_t* leaf_page, uint32 entry_no, uint32 column_no)
+{
+    return leaf_page + ZONE_MAP_ENTRIES + entry_no * ZONE_MAP_ENTRY_SIZE + column_no * ZONE_MAP_COLUMN_SIZE;
+}
+
+// Returns the leaf page of extent of page_no with latch, NULL if the extent is not tracked.
+// Root page is x-latched only if alloc_leaf is TRUE, a missing leaf page is created then.
+static buf_block_t* zone_map_get_leaf(dict_table_t* table, page_no_t page_no, bool32 alloc_leaf,
+    rw_lock_type_t latch_mode, uint32* entry_no, mtr_t* mtr)
+{
+    const page_size_t page_size(table->space_id);
+    uint32 leaf_extents = ZONE_MAP_LEAF_EXTENTS(page_size.physical());
+    uint32 extent_no = page_no / FSP_EXTENT_SIZE;
+    uint32 slot = extent_no / leaf_extents;
+
+    if (slot >= ZONE_MAP_DIR_SLOTS(page_size.physical())) {
+        return NULL;
+    }
+    *entry_no = extent_no % leaf_extents;
+
+    const page_id_t root_page_id(table->space_id, table->zone_map_page_no);
+    buf_block_t* root = buf_page_get(root_page_id, page_size, alloc_leaf ? RW_X_LATCH : RW_S_LATCH, mtr);
+    ut_a(root->get_page_type() == FIL_PAGE_TYPE_HEAP_ZONE);
+    byte* dir = buf_block_get_frame(root) + ZONE_MAP_DIR + slot * 4;
+    page_no_t leaf_page_no = mach_read_from_4(dir);
+
+    if (leaf_page_no != FIL_NULL) {
+        const page_id_t leaf_page_id(table->space_id, leaf_page_no);
+        return buf_page_get(leaf_page_id, page_size, latch_mode, mtr);
+    }
+    if (!alloc_leaf) {
+        return NULL;
+    }
+
+    buf_block_t* leaf;
+    if (fsp_alloc_free_page(table->space_id, page_size, Page_fetch::NORMAL, &leaf, mtr) != CM_SUCCESS) {
+        LOGGER_WARN(LOGGER, LOG_MODULE_HEAP,
+            "zone_map: failed to alloc leaf page, table %s, extents from %u are not tracked",
+            table->name, slot * leaf_extents);
+        return NULL;
+    }
+    zone_map_page_init(leaf, mtr);
+    mlog_write_uint32(buf_block_get_frame(leaf) + ZONE_MAP_HEADER + ZONE_MAP_HEADER_FIRST_EXTENT,
+        slot * leaf_extents, MLOG_4BYTES, mtr);
+    // extents allocated before the leaf page may have rows, they are untracked
+    zone_map_fill(buf_block_get_frame(leaf) + ZONE_MAP_ENTRIES, ZONE_MAP_UNKNOWN,
+        leaf_extents * ZONE_MAP_ENTRY_SIZE, mtr);
+    mlog_write_uint32(dir, leaf->get_page_no(), MLOG_4BYTES, mtr);
+
+    return leaf;
+}
+
+status_t zone_map_create(dict_table_t* table, const uint16* column_ids, uint16 column_count)
+{
+    mtr_t mtr;
+    buf_block_t* block;
+    const page_size_t page_size(table->space_id);
+
+    ut_a(column_count > 0 && column_count <= DICT_ZONE_MAP_MAX_COLUMNS);
+
+    zone_map_load(table);
+    if (table->zone_map_page_no != FIL_NULL) {
+        LOGGER_ERROR(LOGGER, LOG_MODULE_HEAP, "zone_map: table %s already has zone map", table->name);
+        return CM_ERROR;
+    }
+
+    mtr_start(&mtr);
+
+    const page_id_t fsm_page_id(table->space_id, table->entry_page_no);
+    buf_block_t* fsm_block = buf_page_get(fsm_page_id, page_size, RW_X_LATCH, &mtr);
+    ut_a(fsm_block->get_page_type() == FIL_PAGE_TYPE_HEAP_FSM);
+
+    if (fsp_alloc_free_page(table->space_id, page_size, Page_fetch::NORMAL, &block, &mtr) != CM_SUCCESS) {
+        mtr_commit(&mtr);
+        LOGGER_ERROR(LOGGER, LOG_MODULE_HEAP, "zone_map: failed to alloc root page, table %s", table->name);
+        return CM_ERROR;
+    }
+
+    page_t* page = buf_block_get_frame(block);
+    zone_map_page_init(block, &mtr);
+    mlog_write_uint32(page + ZONE_MAP_HEADER + ZONE_MAP_HEADER_COLUMN_COUNT, column_count, MLOG_2BYTES, &mtr);
+    for (uint32 i = 0; i < column_count; i++) {
+        mlog_write_uint32(page + ZONE_MAP_HEADER + ZONE_MAP_HEADER_COLUMNS + i * 2,
+            column_ids[i], MLOG_2BYTES, &mtr);
+    }
+    zone_map_fill(page + ZONE_MAP_DIR, 0xFF, ZONE_MAP_DIR_SLOTS(page_size.physical()) * 4, &mtr);
+
+    mlog_write_uint32(buf_block_get_frame(fsm_block) + FSM_HEADER + FSM_ZONE_MAP_PAGE,
+        block->get_page_no(), MLOG_4BYTES, &mtr);
+
+    mtr_commit(&mtr);
+
+    // extents allocated from now on are tracked
+    mutex_enter(&table->mutex);
+    table->zone_map_column_count = column_count;
+    memcpy(table->zone_map_columns, column_ids, column_count * sizeof(uint16));
+    table->zone_map_page_no = block->get_page_no();
+    mutex_exit(&table->mutex);
+
+    LOGGER_INFO(LOGGER, LOG_MODULE_HEAP,
+        "zone_map: created zone map of %u columns for table %s, root page %u",
+        column_count, table->name, table->zone_map_page_no);
+
+    return CM_SUCCESS;
+}
+
+// Must be called without any latch of table pages, since table->mutex is acquired
+void zone_map_load(dict_table_t* table)
+{
+    mtr_t mtr;
+    page_no_t page_no;
+    uint16 column_count = 0;
+    uint16 column_ids[DICT_ZONE_MAP_MAX_COLUMNS];
+
+    if (table->zone_map_loaded) {
+        return;
+    }
+
+    mtr_start(&mtr);
+
+    const page_size_t page_size(table->space_id);
+    const page_id_t fsm_page_id(table->space_id, table->entry_page_no);
+    buf_block_t* fsm_block = buf_page_get(fsm_page_id, page_size, RW_S_LATCH, &mtr);
+    page_no = mach_read_from_4(buf_block_get_frame(fsm_block) + FSM_HEADER + FSM_ZONE_MAP_PAGE);
+    if (page_no != FIL_NULL) {
+        const page_id_t page_id(table->space_id, page_no);
+        buf_block_t* block = buf_page_get(page_id, page_size, RW_S_LATCH, &mtr);
+        page_t* page = buf_block_get_frame(block);
+        ut_a(block->get_page_type() == FIL_PAGE_TYPE_HEAP_ZONE);
+        column_count = mach_read_from_2(page + ZONE_MAP_HEADER + ZONE_MAP_HEADER_COLUMN_COUNT);
+        ut_a(column_count <= DICT_ZONE_MAP_MAX_COLUMNS);
+        for (uint32 i = 0; i < column_count; i++) {
+            column_ids[i] = mach_read_from_2(page + ZONE_MAP_HEADER + ZONE_MAP_HEADER_COLUMNS + i * 2);
+        }
+    }
+
+    mtr_commit(&mtr);
+
+    mutex_enter(&table->mutex);
+    if (!table->zone_map_loaded) {
+        table->zone_map_column_count = column_count;
+        memcpy(table->zone_map_columns, column_ids, column_count * sizeof(uint16));
+        table->zone_map_page_no = page_no;
+        table->zone_map_loaded = TRUE;
+    }
+    mutex_exit(&table->mutex);
+}
+
+void zone_map_cache_init(zone_map_cache_t* cache)
+{
+    for (uint32 i = 0; i < ZONE_MAP_CACHE_STRIPES; i++) {
+        mutex_create(&cache[i].mutex);
+        cache[i].extent_no = UINT32_UNDEFINED;
+    }
+}
+
+void zone_map_cache_destroy(zone_map_cache_t* cache)
+{
+    for (uint32 i = 0; i < ZONE_MAP_CACHE_STRIPES; i++) {
+        mutex_destroy(&cache[i].mutex);
+    }
+}
+
+static inline bool32 zone_map_range_covers(const zone_map_range_t* range, const zone_map_value_t* value)
+{
+    if (range->state == ZONE_MAP_UNKNOWN || value->is_null) {
+        return TRUE;
+    }
+
+    return range->state == ZONE_MAP_RANGE && !value->is_unknown &&
+        value->value >= range->min_value && value->value <= range->max_value;
+}
+
+static bool32 zone_map_cache_covers(dict_table_t* table, zone_map_cache_t* cache, uint32 extent_no,
+    const zone_map_value_t* values)
+{
+    bool32 is_covered = FALSE;
+
+    mutex_enter(&cache->mutex, NULL);
+    if (cache->extent_no == extent_no) {
+        is_covered = TRUE;
+        for (uint32 i = 0; i < table->zone_map_column_count && is_covered; i++) {
+            is_covered = zone_map_range_covers(&cache->ranges[i], &values[i]);
+        }
+    }
+    mutex_exit(&cache->mutex);
+
+    return is_covered;
+}
+
+// A new extent of heap has no row, its entry starts tracking from empty
+void zone_map_add_extent(dict_table_t* table, page_no_t first_page_no, mtr_t* mtr)
+{
+    uint32 entry_no;
+    uint32 extent_no = first_page_no / FSP_EXTENT_SIZE;
+
+    if (!table->zone_map_loaded || table->zone_map_page_no == FIL_NULL) {
+        return;
+    }
+
+    buf_block_t* leaf = zone_map_get_leaf(table, first_page_no, TRUE, RW_X_LATCH, &entry_no, mtr);
+    if (leaf == NULL) {
+        return;
+    }
+
+    // the cached ranges of a reused extent are wider than its entry now
+    for (uint32 i = 0; i < ZONE_MAP_CACHE_STRIPES; i++) {
+        mutex_enter(&table->zone_map_cache[i].mutex, NULL);
+        if (table->zone_map_cache[i].extent_no == extent_no) {
+            table->zone_map_cache[i].extent_no = UINT32_UNDEFINED;
+        }
+        mutex_exit(&table->zone_map_cache[i].mutex);
+    }
+
+    for (uint32 i = 0; i < table->zone_map_column_count; i++) {
+        byte* column = zone_map_get_column(buf_block_get_frame(leaf), entry_no, i);
+        mlog_write_uint32(column + ZONE_MAP_COLUMN_STATE, ZONE_MAP_EMPTY, MLOG_1BYTE, mtr);
+    }
+}
+
+// Widens the entry of extent of page_no by the values of a row inserted into the page.
+// The leaf is latched only if the values are out of the ranges cached in the stripe of caller.
+void zone_map_add_values(dict_table_t* table, page_no_t page_no, const zone_map_value_t* values,
+    zone_map_cache_t* cache, mtr_t* mtr)
+{
+    uint32 entry_no;
+    uint32 extent_no = page_no / FSP_EXTENT_SIZE;
+    bool32 is_widened = FALSE;
+
+    if (table->zone_map_page_no == FIL_NULL) {
+        return;
+    }
+    if (zone_map_cache_covers(table, cache, extent_no, values)) {
+        return;
+    }
+
+    buf_block_t* leaf = zone_map_get_leaf(table, page_no, FALSE, RW_X_LATCH, &entry_no, mtr);
+    if (leaf == NULL) {
+        return;
+    }
+
+    for (uint32 i = 0; i < table->zone_map_column_count; i++) {
+        byte* column = zone_map_get_column(buf_block_get_frame(leaf), entry_no, i);
+        uint8 state = mach_read_from_1(column + ZONE_MAP_COLUMN_STATE);
+
+        if (state == ZONE_MAP_UNKNOWN || values[i].is_null) {
+            continue;
+        }
+        if (values[i].is_unknown) {
+            mlog_write_uint32(column + ZONE_MAP_COLUMN_STATE, ZONE_MAP_UNKNOWN, MLOG_1BYTE, mtr);
+            is_widened = TRUE;
+            continue;
+        }
+
+        if (state == ZONE_MAP_EMPTY) {
+            mlog_write_uint64(column + ZONE_MAP_COLUMN_MIN, (uint64)values[i].value, mtr);
+            mlog_write_uint64(column + ZONE_MAP_COLUMN_MAX, (uint64)values[i].value, mtr);
+            mlog_write_uint32(column + ZONE_MAP_COLUMN_STATE, ZONE_MAP_RANGE, MLOG_1BYTE, mtr);
+            is_widened = TRUE;
+            continue;
+        }
+        if (values[i].value < (int64)mach_read_from_8(column + ZONE_MAP_COLUMN_MIN)) {
+            mlog_write_uint64(column + ZONE_MAP_COLUMN_MIN, (uint64)values[i].value, mtr);
+            is_widened = TRUE;
+        }
+        if (values[i].value > (int64)mach_read_from_8(column + ZONE_MAP_COLUMN_MAX)) {
+            mlog_write_uint64(column + ZONE_MAP_COLUMN_MAX, (uint64)values[i].value, mtr);
+            is_widened = TRUE;
+        }
+    }
+
+    // Only an entry which is not changed by this mtr is committed, a row of other session
+    // skipping the leaf by the cache must not be logged before the widening of its range.
+    if (is_widened) {
+        return;
+    }
+    mutex_enter(&cache->mutex, NULL);
+    cache->extent_no = extent_no;
+    for (uint32 i = 0; i < table->zone_map_column_count; i++) {
+        byte* column = zone_map_get_column(buf_block_get_frame(leaf), entry_no, i);
+        cache->ranges[i].state = mach_read_from_1(column + ZONE_MAP_COLUMN_STATE);
+        cache->ranges[i].min_value = (int64)mach_read_from_8(column + ZONE_MAP_COLUMN_MIN);
+        cache->ranges[i].max_value = (int64)mach_read_from_8(column + ZONE_MAP_COLUMN_MAX);
+    }
+    mutex_exit(&cache->mutex);
+}
+
+// Returns FALSE if the extent of page_no is not tracked
+bool32 zone_map_get_ranges(dict_table_t* table, page_no_t page_no, zone_map_range_t* ranges)
+{
+    mtr_t mtr;
+    uint32 entry_no;
+
+    if (table->zone_map_page_no == FIL_NULL) {
+        return FALSE;
+    }
+
+    mtr_start(&mtr);
+
+    buf_block_t* leaf = zone_map_get_leaf(table, page_no, FALSE, RW_S_LATCH, &entry_no, &mtr);
+    if (leaf == NULL) {
+        mtr_commit(&mtr);
+        return FALSE;
+    }
+
+    for (uint32 i = 0; i < table->zone_map_column_count; i++) {
+        byte* column = zone_map_get_column(buf_block_get_frame(leaf), entry_no, i);
+        ranges[i].state = mach_read_from_1(column + ZONE_MAP_COLUMN_STATE);
+        ranges[i].min_value = (int64)mach_read_from_8(column + ZONE_MAP_COLUMN_MIN);
+        ranges[i].max_value = (int64)mach_read_from_8(column + ZONE_MAP_COLUMN_MAX);
+    }
+
+    mtr_commit(&mtr);
+
+    return TRUE;
+}
@@ -0,0 +1,80 @@
+#ifndef _KNL_HEAP_ZONE_H
+#define _KNL_HEAP_ZONE_H
+
+#include "cm_type.h"
+#include "knl_dict.h"
+#include "knl_mtr.h"
+
+// Zone map keeps the min/max values of declared columns for every extent of heap,
+// full table scan skips the extents whose values can not match the filter.
+// The root page is a directory of leaf pages, a leaf page holds the entries of
+// ZONE_MAP_LEAF_EXTENTS consecutive extents of tablespace, entry of a page is
+// found by page_no / FSP_EXTENT_SIZE. An extent without leaf page is not tracked.
+//
+// Latch order: the fsm pages of table are latched before the zone map pages
+// in a mini-transaction which holds both.
+
+typedef byte zone_map_header_t;
+
+#define ZONE_MAP_HEADER              FIL_PAGE_DATA
+
+#define ZONE_MAP_HEADER_COLUMN_COUNT 0   // root page only
+#define ZONE_MAP_HEADER_COLUMNS      2   // root page only, column ids, 2 bytes for each
+#define ZONE_MAP_HEADER_FIRST_EXTENT 12  // leaf page only, extent of first entry
+#define ZONE_MAP_HEADER_SIZE         16
+
+// directory of root page, page number of leaf pages
+#define ZONE_MAP_DIR                 (ZONE_MAP_HEADER + ZONE_MAP_HEADER_SIZE)
+#define ZONE_MAP_DIR_SLOTS(physical_page_size) \
+    (((physical_page_size) - ZONE_MAP_DIR - FIL_PAGE_DATA_END) / 4)
+
+// entries of leaf page, an entry is DICT_ZONE_MAP_MAX_COLUMNS column summaries
+#define ZONE_MAP_ENTRIES             (ZONE_MAP_HEADER + ZONE_MAP_HEADER_SIZE)
+#define ZONE_MAP_COLUMN_STATE        0
+#define ZONE_MAP_COLUMN_MIN          1
+#define ZONE_MAP_COLUMN_MAX          9
+#define ZONE_MAP_COLUMN_SIZE         17
+#define ZONE_MAP_ENTRY_SIZE          (DICT_ZONE_MAP_MAX_COLUMNS * ZONE_MAP_COLUMN_SIZE)
+#define ZONE_MAP_LEAF_EXTENTS(physical_page_size) \
+    (((physical_page_size) - ZONE_MAP_ENTRIES - FIL_PAGE_DATA_END) / ZONE_MAP_ENTRY_SIZE)
+
+typedef enum en_zone_map_state {
+    ZONE_MAP_UNKNOWN = 0,  // values of extent are not tracked
+    ZONE_MAP_EMPTY   = 1,  // no value except null
+    ZONE_MAP_RANGE   = 2,  // values except null are in [min, max]
+} zone_map_state_t;
+
+typedef struct st_zone_map_value {
+    bool32  is_null;
+    bool32  is_unknown;  // value can not be summarized, the column of extent becomes untracked
+    int64   value;
+} zone_map_value_t;
+
+typedef struct st_zone_map_range {
+    uint8   state;
+    int64   min_value;
+    int64   max_value;
+} zone_map_range_t;
+
+#define ZONE_MAP_CACHE_STRIPES       8
+
+// Ranges of an extent as committed in its leaf entry, kept for the inserting sessions of a stripe.
+// Ranges only widen until the extent is reused, so a row covered by them needs no leaf latch.
+struct st_zone_map_cache {
+    mutex_t          mutex;
+    uint32           extent_no;  // UINT32_UNDEFINED if no extent is cached
+    zone_map_range_t ranges[DICT_ZONE_MAP_MAX_COLUMNS];
+    byte             reserved[64];  // keep stripes in different cache lines
+};
+
+// Columns are in the order of zone map, table must be locked against dml by caller.
+extern status_t zone_map_create(dict_table_t* table, const uint16* column_ids, uint16 column_count);
+extern void zone_map_load(dict_table_t* table);
+extern void zone_map_add_extent(dict_table_t* table, page_no_t first_page_no, mtr_t* mtr);
+extern void zone_map_add_values(dict_table_t* table, page_no_t page_no, const zone_map_value_t* values,
+    zone_map_cache_t* cache, mtr_t* mtr);
+extern void zone_map_cache_init(zone_map_cache_t* cache);
+extern void zone_map_cache_destroy(zone_map_cache_t* cache);
+extern bool32 zone_map_get_ranges(dict_table_t* table, page_no_t page_no, zone_map_range_t* ranges);
+
+#endif  /* _KNL_HEAP_ZONE_H */
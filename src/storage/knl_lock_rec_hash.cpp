@@ -0,0 +1,502 @@
+#include "knl_lock_rec_hash.h"
+#include "cm_log.h"
+#include "cm_random.h"
+#include "cm_timer.h"
+
+/* The lock system */
+lock_sys_t* lock_sys = NULL;
+
+static const bool32 lock_compatibility_matrix[LOCK_NUM][LOCK_NUM] = {
+    /*         IS     IX     S      X     */
+    /* IS */ { TRUE,  TRUE,  TRUE,  FALSE },
+    /* IX */ { TRUE,  TRUE,  FALSE, FALSE },
+    /* S  */ { TRUE,  FALSE, TRUE,  FALSE },
+    /* X  */ { FALSE, FALSE, FALSE, FALSE },
+};
+
+// lock_strength_matrix[a][b] is TRUE if mode a covers mode b
+static const bool32 lock_strength_matrix[LOCK_NUM][LOCK_NUM] = {
+    /*         IS     IX     S      X     */
+    /* IS */ { TRUE,  FALSE, FALSE, FALSE },
+    /* IX */ { TRUE,  TRUE,  FALSE, FALSE },
+    /* S  */ { TRUE,  FALSE, TRUE,  FALSE },
+    /* X  */ { TRUE,  TRUE,  TRUE,  TRUE  },
+};
+
+status_t lock_sys_create(uint32 n_cells)
+{
+    lock_sys = (lock_sys_t *)ut_malloc_zero(sizeof(lock_sys_t));
+    if (lock_sys == NULL) {
+        CM_SET_ERROR(ERR_ALLOC_MEMORY, sizeof(lock_sys_t), "creating lock system");
+        return CM_ERROR;
+    }
+
+    mutex_create(&lock_sys->wait_mutex);
+    lock_sys->rec_hash = HASH_TABLE_CREATE(n_cells, HASH_TABLE_SYNC_MUTEX, LOCK_SYS_HASH_LATCHES);
+    lock_sys->table_hash = HASH_TABLE_CREATE(n_cells, HASH_TABLE_SYNC_MUTEX, LOCK_SYS_HASH_LATCHES);
+    if (lock_sys->rec_hash == NULL || lock_sys->table_hash == NULL) {
+        CM_SET_ERROR(ERR_ALLOC_MEMORY, (uint64)n_cells * sizeof(HASH_CELL_T), "creating lock system");
+        return CM_ERROR;
+    }
+
+    return CM_SUCCESS;
+}
+
+void lock_sys_destroy()
+{
+    if (lock_sys == NULL) {
+        return;
+    }
+
+    if (lock_sys->rec_hash) {
+        HASH_TABLE_FREE(lock_sys->rec_hash);
+    }
+    if (lock_sys->table_hash) {
+        HASH_TABLE_FREE(lock_sys->table_hash);
+    }
+    mutex_destroy(&lock_sys->wait_mutex);
+    ut_free(lock_sys);
+    lock_sys = NULL;
+}
+
+/** Calculates the fold value of a page file address: used in inserting or
+ searching for a lock in the hash table.
+ @return folded value */
+inline uint32 lock_rec_fold(space_id_t space,  /*!< in: space */
+                            page_no_t page_no) /*!< in: page number */
+{
+    return ut_fold_uint32_pair(space, page_no);
+}
+
+inline uint32 lock_table_fold(table_id_t table_id)
+{
+    return ut_fold_uint32_pair((uint32)table_id, (uint32)(table_id >> 32));
+}
+
+static inline HASH_TABLE* lock_hash_get(uint32 type)
+{
+    return type == LOCK_REC ? lock_sys->rec_hash : lock_sys->table_hash;
+}
+
+static inline bool32 lock_rec_get_bit(const lock_t* lock, uint32 slot)
+{
+    uint32 bit = slot - lock->rec.first_slot;
+    return (lock->bitmap[bit / 64] >> (bit % 64)) & 1;
+}
+
+static inline void lock_rec_set_bit(lock_t* lock, uint32 slot)
+{
+    uint32 bit = slot - lock->rec.first_slot;
+    lock->bitmap[bit / 64] |= ((uint64)1 << (bit % 64));
+}
+
+// Locks of the same table, or the same bitmap window of a page
+static inline bool32 lock_is_same_object(const lock_t* lock1, const lock_t* lock2)
+{
+    if (lock1->type != lock2->type) {
+        return FALSE;
+    }
+    if (lock1->type == LOCK_TABLE) {
+        return lock1->table_id == lock2->table_id;
+    }
+    return lock1->rec.space_id == lock2->rec.space_id && lock1->rec.page_no == lock2->rec.page_no &&
+           lock1->rec.first_slot == lock2->rec.first_slot;
+}
+
+// slot is ignored for table lock
+static inline bool32 lock_is_on_row(const lock_t* lock, const lock_t* request, uint32 slot)
+{
+    return lock_is_same_object(lock, request) && (lock->type == LOCK_TABLE || lock_rec_get_bit(lock, slot));
+}
+
+static lock_t* lock_alloc(trx_t* trx)
+{
+    lock_t* lock = trx->lock_free_list;
+
+    if (lock != NULL) {
+        trx->lock_free_list = lock->hash_next;
+        trx->lock_free_count--;
+        memset(lock, 0, sizeof(lock_t));
+    } else {
+        lock = (lock_t *)ut_malloc_zero(sizeof(lock_t));
+        if (lock == NULL) {
+            CM_SET_ERROR(ERR_ALLOC_MEMORY, sizeof(lock_t), "creating lock");
+            return NULL;
+        }
+    }
+    lock->trx = trx;
+
+    return lock;
+}
+
+static void lock_free(trx_t* trx, lock_t* lock)
+{
+    if (trx->lock_free_count < LOCK_TRX_CACHE_SIZE) {
+        lock->hash_next = trx->lock_free_list;
+        trx->lock_free_list = lock;
+        trx->lock_free_count++;
+    } else {
+        ut_free(lock);
+    }
+}
+
+static inline void lock_add_blocker(trx_t** blockers, uint32* count, trx_t* trx)
+{
+    for (uint32 i = 0; i < *count; i++) {
+        if (blockers[i] == trx) {
+            return;
+        }
+    }
+    if (*count < TRX_LOCK_WAIT_FOR_MAX) {
+        blockers[(*count)++] = trx;
+    }
+}
+
+// Returns the number of other trxs whose locks conflict with the request on the row.
+// Waiting locks behind stop_lock are not counted, and no waiting lock is counted
+// if trx has been granted a lock on the object, so that an upgrade does not wait
+// behind the waiters which wait for trx.
+static uint32 lock_find_blockers(HASH_TABLE* hash, const lock_t* request, uint32 slot, const lock_t* stop_lock,
+    trx_t** blockers)
+{
+    trx_t* waiting_blockers[TRX_LOCK_WAIT_FOR_MAX];
+    uint32 granted_count = 0;
+    uint32 waiting_count = 0;
+    bool32 has_granted = FALSE;
+    bool32 is_ahead = TRUE;
+
+    for (lock_t* lock = (lock_t *)HASH_GET_FIRST(hash, HASH_CALC_HASH(hash, request->fold));
+         lock != NULL; lock = lock->hash_next) {
+        if (lock == stop_lock) {
+            is_ahead = FALSE;
+            continue;
+        }
+        if (!lock_is_on_row(lock, request, slot)) {
+            continue;
+        }
+        if (lock->trx == request->trx) {
+            has_granted = has_granted || !lock->is_waiting;
+            continue;
+        }
+        if (lock_compatibility_matrix[lock->mode][request->mode]) {
+            continue;
+        }
+        if (!lock->is_waiting) {
+            lock_add_blocker(blockers, &granted_count, lock->trx);
+        } else if (is_ahead) {
+            lock_add_blocker(waiting_blockers, &waiting_count, lock->trx);
+        }
+    }
+
+    if (granted_count > 0 || has_granted) {
+        return granted_count;
+    }
+    memcpy(blockers, waiting_blockers, waiting_count * sizeof(trx_t*));
+    return waiting_count;
+}
+
+static inline void lock_set_wait_for(trx_t* trx, lock_t* lock, trx_t** blockers, uint32 count)
+{
+    mutex_enter(&lock_sys->wait_mutex, NULL);
+    trx->lock_wait = lock;
+    memcpy(trx->lock_wait_for, blockers, count * sizeof(trx_t*));
+    trx->lock_wait_for_count = count;
+    mutex_exit(&lock_sys->wait_mutex);
+}
+
+// Grants the waiting locks of the object of lock which have no conflict any more,
+// the wait-for edges of the others are moved to their current blockers.
+// The hash chain of lock must be latched.
+static void lock_grant_waiters(HASH_TABLE* hash, const lock_t* released)
+{
+    trx_t* blockers[TRX_LOCK_WAIT_FOR_MAX];
+
+    for (lock_t* lock = (lock_t *)HASH_GET_FIRST(hash, HASH_CALC_HASH(hash, released->fold));
+         lock != NULL; lock = lock->hash_next) {
+        if (!lock->is_waiting || !lock_is_same_object(lock, released)) {
+            continue;
+        }
+
+        uint32 slot = 0;
+        if (lock->type == LOCK_REC) {
+            for (uint32 i = 0; i < LOCK_REC_BITMAP_BITS; i++) {
+                if (lock_rec_get_bit(lock, lock->rec.first_slot + i)) {
+                    slot = lock->rec.first_slot + i;
+                    break;
+                }
+            }
+        }
+
+        trx_t* trx = lock->trx;
+        uint32 count = lock_find_blockers(hash, lock, slot, lock, blockers);
+        if (count > 0) {
+            lock_set_wait_for(trx, lock, blockers, count);
+            continue;
+        }
+
+        lock_set_wait_for(trx, NULL, NULL, 0);
+        lock->is_waiting = FALSE;
+        os_event_set(trx->lock_wait_event);
+    }
+}
+
+// Searches the wait-for edges from trx for a path back to trx through trxs of smaller id only.
+// So the trx of the largest id in a cycle is the victim, whichever trx of the cycle checks first,
+// and every cycle loses exactly that trx. A trx waiting behind a cycle it is not in is left
+// to the trxs of the cycle.
+static bool32 lock_deadlock_check(trx_t* trx)
+{
+    trx_t* stack[LOCK_DEADLOCK_MAX_DEPTH];
+    uint32 edges[LOCK_DEADLOCK_MAX_DEPTH];
+    uint32 depth = 1;
+    bool32 is_deadlock = FALSE;
+
+    mutex_enter(&lock_sys->wait_mutex, NULL);
+    uint64 mark = ++lock_sys->deadlock_mark;
+    stack[0] = trx;
+    edges[0] = 0;
+    while (depth > 0) {
+        trx_t* waiter = stack[depth - 1];
+        if (edges[depth - 1] >= waiter->lock_wait_for_count) {
+            depth--;
+            continue;
+        }
+
+        trx_t* blocker = waiter->lock_wait_for[edges[depth - 1]++];
+        if (blocker == trx) {
+            is_deadlock = TRUE;
+            lock_sys->deadlock_count++;
+            break;
+        }
+        if (blocker->trx_slot_id.id > trx->trx_slot_id.id || blocker->lock_deadlock_mark == mark ||
+            depth == LOCK_DEADLOCK_MAX_DEPTH) {
+            continue;
+        }
+        blocker->lock_deadlock_mark = mark;
+        stack[depth] = blocker;
+        edges[depth] = 0;
+        depth++;
+    }
+    mutex_exit(&lock_sys->wait_mutex);
+
+    return is_deadlock;
+}
+
+// Removes the waiting lock of trx, returns FALSE if it has been granted
+static bool32 lock_cancel_wait(trx_t* trx, lock_t* lock)
+{
+    HASH_TABLE* hash = lock_hash_get(lock->type);
+    mutex_t* mutex = HASH_GET_MUTEX(hash, lock->fold);
+
+    mutex_enter(mutex, NULL);
+    if (!lock->is_waiting) {
+        mutex_exit(mutex);
+        return FALSE;
+    }
+
+    HASH_DELETE(lock_t, hash_next, hash, lock->fold, lock);
+    lock_set_wait_for(trx, NULL, NULL, 0);
+    lock_grant_waiters(hash, lock);
+    mutex_exit(mutex);
+
+    UT_LIST_REMOVE(trx_list_node, trx->locks, lock);
+    lock_free(trx, lock);
+
+    return TRUE;
+}
+
+static status_t lock_wait(que_sess_t* sess, lock_t* lock)
+{
+    trx_t* trx = sess->trx;
+    date_t begin_time_us = g_timer()->now_us;
+    date_t timeout_us = (date_t)srv_lock_wait_timeout * MICROSECS_PER_SECOND;
+    status_t ret = CM_SUCCESS;
+
+    srv_stats.n_lock_wait_count.inc();
+    srv_stats.n_lock_wait_current_count.inc();
+
+    for (;;) {
+        uint64 signal_count = os_event_reset(trx->lock_wait_event);
+        if (!lock->is_waiting) {
+            break;
+        }
+
+        if (lock_deadlock_check(trx)) {
+            ret = ERR_DEADLOCK;
+        } else if (timeout_us != 0 && g_timer()->now_us >= begin_time_us + timeout_us) {
+            ret = ERR_LOCK_WAIT_TIMEOUT;
+        } else if (sess->is_killed || sess->is_canceled) {
+            ret = CM_ERROR;
+        }
+        if (ret != CM_SUCCESS) {
+            if (lock_cancel_wait(trx, lock)) {
+                break;
+            }
+            // granted at the same time
+            ret = CM_SUCCESS;
+            break;
+        }
+
+        os_event_wait_time(trx->lock_wait_event, LOCK_WAIT_CHECK_US, signal_count);
+    }
+
+    srv_stats.n_lock_wait_current_count.dec();
+    srv_stats.n_lock_wait_time.add(g_timer()->now_us - begin_time_us);
+
+    if (ret == ERR_DEADLOCK) {
+        LOGGER_WARN(LOGGER, LOG_MODULE_TRX, "lock_wait: deadlock found, trx (rseg %u slot %u) is rolled back",
+            (uint32)trx->trx_slot_id.rseg_id, (uint32)trx->trx_slot_id.slot);
+    }
+
+    return ret;
+}
+
+// Queues the request at the tail of hash chain, the hash chain must be latched
+static lock_t* lock_enqueue(que_sess_t* sess, HASH_TABLE* hash, lock_t* request, uint32 slot,
+    trx_t** blockers, uint32 blocker_count)
+{
+    trx_t* trx = sess->trx;
+    lock_t* lock = lock_alloc(trx);
+    if (lock == NULL) {
+        return NULL;
+    }
+
+    lock->type = request->type;
+    lock->mode = request->mode;
+    lock->fold = request->fold;
+    if (request->type == LOCK_TABLE) {
+        lock->table_id = request->table_id;
+        lock->table = request->table;
+    } else {
+        lock->rec = request->rec;
+        lock_rec_set_bit(lock, slot);
+    }
+
+    if (blocker_count > 0) {
+        lock->is_waiting = TRUE;
+        trx->lock_wait_event = sess->wait_trx_event;
+        lock_set_wait_for(trx, lock, blockers, blocker_count);
+    }
+
+    HASH_INSERT(lock_t, hash_next, hash, lock->fold, lock);
+    UT_LIST_ADD_LAST(trx_list_node, trx->locks, lock);
+
+    return lock;
+}
+
+// Acquires the lock of request on the row, slot is ignored for table lock
+static status_t lock_acquire(que_sess_t* sess, lock_t* request, uint32 slot)
+{
+    HASH_TABLE* hash = lock_hash_get(request->type);
+    mutex_t* mutex = HASH_GET_MUTEX(hash, request->fold);
+    trx_t* blockers[TRX_LOCK_WAIT_FOR_MAX];
+    lock_t* own_lock = NULL;
+    lock_t* lock;
+
+    mutex_enter(mutex, NULL);
+
+    // fast path, the row has been locked by trx in a mode covering the request
+    for (lock = (lock_t *)HASH_GET_FIRST(hash, HASH_CALC_HASH(hash, request->fold));
+         lock != NULL; lock = lock->hash_next) {
+        if (lock->trx != request->trx || lock->is_waiting || !lock_is_same_object(lock, request)) {
+            continue;
+        }
+        if ((lock->type == LOCK_TABLE || lock_rec_get_bit(lock, slot)) &&
+            lock_strength_matrix[lock->mode][request->mode]) {
+            mutex_exit(mutex);
+            return CM_SUCCESS;
+        }
+        if (lock->type == LOCK_REC && lock->mode == request->mode) {
+            own_lock = lock;
+        }
+    }
+
+    uint32 blocker_count = lock_find_blockers(hash, request, slot, NULL, blockers);
+    if (blocker_count == 0 && own_lock != NULL) {
+        lock_rec_set_bit(own_lock, slot);
+        mutex_exit(mutex);
+        return CM_SUCCESS;
+    }
+
+    lock = lock_enqueue(sess, hash, request, slot, blockers, blocker_count);
+    mutex_exit(mutex);
+    if (lock == NULL) {
+        return CM_ERROR;
+    }
+    if (blocker_count == 0) {
+        return CM_SUCCESS;
+    }
+
+    return lock_wait(sess, lock);
+}
+
+status_t lock_table(que_sess_t* sess, dict_table_t* table, uint32 mode)
+{
+    lock_t request;
+
+    ut_ad(sess->trx);
+    ut_ad(mode < LOCK_NUM);
+
+    request.trx = sess->trx;
+    request.type = LOCK_TABLE;
+    request.mode = (uint8)mode;
+    request.table_id = table->id;
+    request.table = table;
+    request.fold = lock_table_fold(table->id);
+
+    return lock_acquire(sess, &request, 0);
+}
+
+status_t lock_rec(que_sess_t* sess, dict_table_t* table, const page_id_t& page_id, uint32 slot, uint32 mode)
+{
+    lock_t request;
+
+    ut_ad(mode == LOCK_S || mode == LOCK_X);
+
+    CM_RETURN_IF_ERROR(lock_table(sess, table, mode == LOCK_S ? LOCK_IS : LOCK_IX));
+
+    request.trx = sess->trx;
+    request.type = LOCK_REC;
+    request.mode = (uint8)mode;
+    request.rec.space_id = page_id.get_space_id();
+    request.rec.page_no = page_id.get_page_no();
+    request.rec.first_slot = slot - slot % LOCK_REC_BITMAP_BITS;
+    request.fold = lock_rec_fold(request.rec.space_id, request.rec.page_no);
+
+    return lock_acquire(sess, &request, slot);
+}
+
+void lock_release_all(trx_t* trx)
+{
+    lock_t* lock = UT_LIST_GET_FIRST(trx->locks);
+
+    while (lock != NULL) {
+        lock_t* next = UT_LIST_GET_NEXT(trx_list_node, lock);
+        HASH_TABLE* hash = lock_hash_get(lock->type);
+        mutex_t* mutex = HASH_GET_MUTEX(hash, lock->fold);
+
+        ut_ad(!lock->is_waiting);
+
+        mutex_enter(mutex, NULL);
+        HASH_DELETE(lock_t, hash_next, hash, lock->fold, lock);
+        lock_grant_waiters(hash, lock);
+        mutex_exit(mutex);
+
+        lock_free(trx, lock);
+        lock = next;
+    }
+    UT_LIST_INIT(trx->locks);
+}
+
+// The lock list of trx is only changed by the thread of trx, it is read without latch
+dict_table_t* lock_get_table(trx_t* trx, table_id_t table_id)
+{
+    for (lock_t* lock = UT_LIST_GET_FIRST(trx->locks); lock != NULL;
+         lock = UT_LIST_GET_NEXT(trx_list_node, lock)) {
+        if (lock->type == LOCK_TABLE && lock->table_id == table_id) {
+            return lock->table;
+        }
+    }
+
+    return NULL;
+}
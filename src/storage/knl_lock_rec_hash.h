@@ -0,0 +1,98 @@
+#ifndef _KNL_LOCK_REC_HASH_H
+#define _KNL_LOCK_REC_HASH_H
+
+#include "cm_type.h"
+#include "cm_list.h"
+#include "cm_mutex.h"
+#include "knl_hash_table.h"
+#include "knl_dict.h"
+#include "knl_session.h"
+#include "knl_trx_types.h"
+
+// Lock manager of table locks and record locks.
+// Locks of a table or a page are queued in the chain of hash cell in request order,
+// chains are latched by the striped mutexes of hash table.
+// A record lock covers LOCK_REC_BITMAP_BITS slots of a heap page, one bit for each row,
+// a trx locking more rows of the page in the same mode only sets bits of its granted lock.
+// A waiter sleeps on the event of session and is woken up only when its lock is granted.
+// Every waiting trx has wait-for edges to the trxs blocking it, deadlock is found by the
+// waiter searching the edges for a path back to itself, at most LOCK_DEADLOCK_MAX_DEPTH deep.
+
+/* CPU cache line size; a constant 64 for now.  */
+#define CACHE_LINE_SIZE 64
+
+enum lock_mode_t {
+    LOCK_IS = 0,  // intention shared, table only
+    LOCK_IX,      // intention exclusive, table only
+    LOCK_S,
+    LOCK_X,
+    LOCK_NUM
+};
+
+#define LOCK_TABLE                  1
+#define LOCK_REC                    2
+
+#define LOCK_REC_BITMAP_BITS        256
+#define LOCK_DEADLOCK_MAX_DEPTH     200
+#define LOCK_TRX_CACHE_SIZE         16       // freed locks kept by trx for reuse
+#define LOCK_WAIT_CHECK_US          100000   // 100ms, waiter checks deadlock and timeout
+
+#define LOCK_SYS_HASH_CELLS         65536
+#define LOCK_SYS_HASH_LATCHES       256      // must be a power of 2
+
+typedef struct st_lock lock_t;
+struct st_lock {
+    trx_t*          trx;
+    uint8           type;         // LOCK_TABLE or LOCK_REC
+    uint8           mode;
+    volatile bool8  is_waiting;   // cleared by the trx granting it
+    uint32          fold;
+    union {
+        struct {
+            table_id_t    table_id;
+            dict_table_t* table;
+        };
+        struct {
+            space_id_t  space_id;
+            page_no_t   page_no;
+            uint32      first_slot;  // slot of bit 0, aligned by LOCK_REC_BITMAP_BITS
+        } rec;
+    };
+    lock_t*         hash_next;
+    UT_LIST_NODE_T(lock_t) trx_list_node;
+    uint64          bitmap[LOCK_REC_BITMAP_BITS / 64];
+};
+
+/** The lock system struct */
+struct lock_sys_t {
+    char            pad1[CACHE_LINE_SIZE];
+    HASH_TABLE*     rec_hash;     // record locks, chained by page
+    HASH_TABLE*     table_hash;   // table locks, chained by table
+
+    char            pad2[CACHE_LINE_SIZE];
+    mutex_t         wait_mutex;   // protects lock_wait and lock_wait_for of trxs, latched last
+    uint64          deadlock_mark;  // number of the last deadlock search, under wait_mutex
+    uint64          deadlock_count;
+};
+
+extern status_t lock_sys_create(uint32 n_cells);
+extern void lock_sys_destroy();
+
+// Caller must have started the trx of session
+extern status_t lock_table(que_sess_t* sess, dict_table_t* table, uint32 mode);
+// Locks the row at slot of heap page, intention lock of table is acquired first
+extern status_t lock_rec(que_sess_t* sess, dict_table_t* table, const page_id_t& page_id, uint32 slot, uint32 mode);
+// Releases all locks of trx at commit or rollback, the waiters granted are woken up
+extern void lock_release_all(trx_t* trx);
+// Returns the table locked by trx, NULL if trx has no lock on it, as a trx recovered after crash
+extern dict_table_t* lock_get_table(trx_t* trx, table_id_t table_id);
+
+/** Calculates the fold value of a page file address: used in inserting or
+ searching for a lock in the hash table.
+ @return folded value */
+extern inline uint32 lock_rec_fold(space_id_t space, page_no_t page_no);
+extern inline uint32 lock_table_fold(table_id_t table_id);
+
+extern lock_sys_t*  lock_sys;
+
+#endif  /* _KNL_LOCK_REC_HASH_H */
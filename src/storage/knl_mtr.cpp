@@ -1081,13 +1081,14 @@ inline byte* mlog_replay_nbytes(
         goto corrupt;
     }
 
+    // FIL_PAGE_LSN is stamped by checkpoint for pages of any type
     byte* page = block ? buf_block_get_frame((buf_block_t*)block) : NULL;
     if (page) {
-        uint64 page_lsn = mach_read_from_8(page + HEAP_HEADER_OFFSET + HEAP_HEADER_LSN);
+        uint64 page_lsn = mach_read_from_8(page + FIL_PAGE_LSN);
         if (page_lsn >= lsn) {
             return log_rec_ptr + 2 /* offset */ +
-                (type == MLOG_8BYTES) ? mach_ull_get_compressed_size(log_rec_ptr + 2)
-                                      : mach_get_compressed_size(log_rec_ptr + 2);
+                ((type == MLOG_8BYTES) ? mach_ull_get_compressed_size(log_rec_ptr + 2)
+                                       : mach_get_compressed_size(log_rec_ptr + 2));
         }
     }
 
@@ -1157,3 +1158,42 @@ corrupt:
     return log_rec_ptr;
 }
 
+// Parses a log record written by mlog_log_string: offset, length and the bytes written
+inline byte* mlog_replay_string(
+    uint32 type,
+    uint64 lsn,
+    byte* log_rec_ptr, // in: buffer
+    byte* log_end_ptr, // in: buffer end
+    void* block) // in: block where to apply the log record, or NULL
+{
+    ut_a(type == MLOG_WRITE_STRING);
+    if (log_end_ptr < log_rec_ptr + 4) {
+        goto corrupt;
+    }
+
+    {
+        uint32 offset = mach_read_from_2(log_rec_ptr);
+        uint32 len = mach_read_from_2(log_rec_ptr + 2);
+        log_rec_ptr += 4;
+        if (offset >= UNIV_PAGE_SIZE || len + offset > UNIV_PAGE_SIZE || log_rec_ptr + len > log_end_ptr) {
+            goto corrupt;
+        }
+
+        byte* page = block ? buf_block_get_frame((buf_block_t*)block) : NULL;
+        if (page && mach_read_from_8(page + FIL_PAGE_LSN) < lsn) {
+            memcpy(page + offset, log_rec_ptr, len);
+        }
+
+        return log_rec_ptr + len;
+    }
+
+corrupt:
+    LOGGER_ERROR(LOGGER, LOG_MODULE_RECOVERY,
+        "mlog_replay_string: invalid log, log_rec %p end_ptr %p, block (%p space_id %lu page_no %lu)",
+        log_rec_ptr, log_end_ptr, block,
+        block ? ((buf_block_t *)block)->get_space_id() : INVALID_SPACE_ID,
+        block ? ((buf_block_t *)block)->get_page_no() : INVALID_PAGE_NO);
+
+    return NULL;
+}
+
@@ -331,6 +331,12 @@ extern inline byte* mlog_replay_nbytes(
     byte* log_rec_ptr, // in: buffer
     byte* log_end_ptr, // in: buffer end
     void* block); // in: block where to apply the log record, or NULL
+extern inline byte* mlog_replay_string(
+    uint32 type, // in: MLOG_WRITE_STRING
+    uint64 lsn,
+    byte* log_rec_ptr, // in: buffer
+    byte* log_end_ptr, // in: buffer end
+    void* block); // in: block where to apply the log record, or NULL
 
 
 // This macro locks an rw-lock in s-mode
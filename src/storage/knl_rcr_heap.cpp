@@ -1,6 +1,15 @@
 #include "knl_heap.h"
 #include "cm_log.h"
+#include "cm_thread.h"
+#include "knl_btree_bulk.h"
+#include "knl_handler.h"
+#include "knl_server.h"
+#include "knl_flst.h"
+#include "knl_fsp.h"
 #include "knl_heap_fsm.h"
+#include "knl_heap_toast.h"
+#include "knl_heap_zone.h"
+#include "knl_lock_rec_hash.h"
 #include "knl_trx.h"
 #include "knl_trx_undo.h"
 #include "knl_trx_rseg.h"
@@ -177,7 +186,8 @@ inline void heap_row_set_itl_id(row_header_t* row, uint8 itl_id)
     mach_write_to_1((uchar*)row + HEAP_TUPLE_HEADER_ITL, itl_id);
 }
 
-static void heap_reorganize_page(que_sess_t* sess, buf_block_t* block, mtr_t* mtr)
+// Deleted rows committed before min_query_scn are freed, 0 if the oldest snapshot is unknown
+static void heap_reorganize_page(buf_block_t* block, uint64 min_query_scn, mtr_t* mtr)
 {
     row_dir_t* dir;
     row_header_t* row;
@@ -203,7 +213,7 @@ static void heap_reorganize_page(que_sess_t* sess, buf_block_t* block, mtr_t* mt
                 continue;
             }
             // itl->is_active == TRUE: commited, but itl is not reused
-            if (!itl->is_active && itl->scn < sess->min_query_scn) {
+            if (!itl->is_active && itl->scn < min_query_scn) {
                 ut_ad(itl->trx_slot_id.id != TRANSACTION_INVALID_ID);
                 heap_row_set_itl_id(row, HEAP_INVALID_ITL_ID);
                 dir->scn = itl->scn;
@@ -268,10 +278,31 @@ static void heap_reorganize_page(que_sess_t* sess, buf_block_t* block, mtr_t* mt
     ut_ad((char *)free_addr - (char *)page) < UNIV_PAGE_SIZE_DEF);
     mach_write_to_2(header + HEAP_HEADER_LOWER, (uint16)((char *)free_addr - (char *)page));
 
-    // write redo log
+    // write redo log, the rows freed depend on min_query_scn, so replay needs it
     if (mtr) {
-        mlog_write_log(MLOG_PAGE_REORGANIZE, block->get_space_id(), block->get_page_no(), NULL, 0, mtr);
+        byte buf[8];
+        mach_write_to_8(buf, min_query_scn);
+        mlog_write_log(MLOG_PAGE_REORGANIZE, block->get_space_id(), block->get_page_no(), buf, 8, mtr);
+    }
+}
+
+// Replays heap_reorganize_page with the oldest snapshot scn of the record,
+// itls of page are replayed up to the record, so the same rows are freed.
+byte* heap_reorganize_page_replay(uint32 type, uint64 lsn, byte* log_rec_ptr, byte* log_end_ptr, void* block)
+{
+    ut_ad(type == MLOG_PAGE_REORGANIZE);
+
+    if (log_end_ptr < log_rec_ptr + 8) {
+        return NULL;
+    }
+
+    page_t* page = buf_block_get_frame((buf_block_t *)block);
+    uint64 page_lsn = mach_read_from_8(page + HEAP_HEADER_OFFSET + HEAP_HEADER_LSN);
+    if (page_lsn < lsn) {
+        heap_reorganize_page((buf_block_t *)block, mach_read_from_8(log_rec_ptr), NULL);
     }
+
+    return log_rec_ptr + 8;
 }
 
 static itl_t* heap_create_itl(buf_block_t* block, uint8* itl_id, mtr_t* mtr)
@@ -289,7 +320,7 @@ static itl_t* heap_create_itl(buf_block_t* block, uint8* itl_id, mtr_t* mtr)
     uint16 upper = mach_read_from_2(header + HEAP_HEADER_UPPER);
     uint16 dir_count = mach_read_from_2(header + HEAP_HEADER_DIRS);
     if (lower + sizeof(itl_t) > upper) {
-        heap_reorganize_page(block, mtr);
+        heap_reorganize_page(block, 0, mtr);
     }
 
     if (dir_count > 0) {
@@ -408,8 +439,9 @@ static itl_t* heap_alloc_itl(buf_block_t* block, trx_t* trx, mtr_t* mtr, uint8*
     return ret_itl;
 }
 
-inline void heap_set_itl_trx_end(buf_block_t* block,
-    trx_slot_id_t slot_id, uint8 itl_id, uint64 scn, mtr_t* mtr)
+// Ends itl on page without redo, returns fsc of itl
+static inline uint16 heap_set_itl_trx_end_low(buf_block_t* block,
+    trx_slot_id_t slot_id, uint8 itl_id, uint64 scn)
 {
     ut_ad(rw_lock_own(&block->rw_lock, RW_X_LATCH));
 
@@ -431,15 +463,104 @@ inline void heap_set_itl_trx_end(buf_block_t* block,
         heap_try_change_map(sess, heap, page_id);
     }
 
+    return itl->fsc;
+}
+
+inline void heap_set_itl_trx_end(buf_block_t* block,
+    trx_slot_id_t slot_id, uint8 itl_id, uint64 scn, mtr_t* mtr)
+{
+    uint16 fsc = heap_set_itl_trx_end_low(block, slot_id, itl_id, scn);
+
     // redo
     const uint32 buf_size = 11;
     byte buf[buf_size];
     mach_write_to_1(buf, itl_id);
     mach_write_to_8(buf + 1, scn);
-    mach_write_to_2(buf + 9, itl->fsc);
+    mach_write_to_2(buf + 9, fsc);
     mlog_write_log(MLOG_HEAP_CLEAN_ITL, block->get_space_id(), block->get_page_no(), buf, buf_size, mtr);
 }
 
+static inline bool32 heap_itl_is_owned_by(buf_block_t* block, trx_slot_id_t slot_id, uint8 itl_id)
+{
+    if (block->get_page_type() != FIL_PAGE_TYPE_HEAP) {
+        return FALSE;
+    }
+
+    itl_t* itl = heap_get_itl(buf_block_get_frame(block), itl_id);
+    return itl != NULL && itl->is_active && itl->trx_slot_id.id == slot_id.id;
+}
+
+// Ends itl of a committed trx lazily, the page may have been reused,
+// or the itl may have been cleaned by a reader or reused by another trx already
+bool32 heap_cleanout_itl(buf_block_t* block, trx_slot_id_t slot_id, uint8 itl_id, uint64 scn, mtr_t* mtr)
+{
+    ut_ad(rw_lock_own(&block->rw_lock, RW_X_LATCH));
+
+    if (block->get_page_type() != FIL_PAGE_TYPE_HEAP) {
+        return FALSE;
+    }
+
+    if (!heap_itl_is_owned_by(block, slot_id, itl_id)) {
+        return FALSE;
+    }
+
+    heap_set_itl_trx_end(block, slot_id, itl_id, scn, mtr);
+
+    return TRUE;
+}
+
+// Ends itls of a committed trx on the pages latched by mtr, all of them are logged by one mtr
+// with a MLOG_HEAP_CLEAN_ITL record for each page, so every record is replayed on its own page.
+// The page reused or whose itl is cleaned already is skipped, returns the pages cleaned.
+uint32 heap_cleanout_itls(heap_cleanout_page_t* pages, uint32 count,
+    trx_slot_id_t slot_id, uint64 scn, mtr_t* mtr)
+{
+    uint32 cleaned_count = 0;
+
+    ut_ad(count <= HEAP_CLEANOUT_MAX_PAGES);
+
+    for (uint32 i = 0; i < count; i++) {
+        buf_block_t* block = pages[i].block;
+        ut_ad(rw_lock_own(&block->rw_lock, RW_X_LATCH));
+
+        if (!heap_itl_is_owned_by(block, slot_id, pages[i].itl_id)) {
+            continue;
+        }
+
+        heap_set_itl_trx_end(block, slot_id, pages[i].itl_id, scn, mtr);
+        cleaned_count++;
+    }
+
+    return cleaned_count;
+}
+
+byte* heap_clean_itl_replay(uint32 type, uint64 lsn, byte* log_rec_ptr, byte* log_end_ptr, void* block)
+{
+    ut_ad(type == MLOG_HEAP_CLEAN_ITL);
+
+    if (log_end_ptr < log_rec_ptr + 11) {
+        return NULL;
+    }
+
+    page_t* page = buf_block_get_frame((buf_block_t *)block);
+    uint64 page_lsn = mach_read_from_8(page + HEAP_HEADER_OFFSET + HEAP_HEADER_LSN);
+    if (page_lsn < lsn) {
+        itl_t* itl = heap_get_itl(page, mach_read_from_1(log_rec_ptr));
+        ut_a(itl);
+        itl->scn = mach_read_from_8(log_rec_ptr + 1);
+        itl->is_active = FALSE;
+        itl->is_ow_scn = FALSE;
+
+        uint16 fsc = mach_read_from_2(log_rec_ptr + 9);
+        if (fsc > 0) {
+            uint16 free_size = mach_read_from_2(page + HEAP_HEADER_OFFSET + HEAP_HEADER_FREE_SIZE);
+            mach_write_to_2(page + HEAP_HEADER_OFFSET + HEAP_HEADER_FREE_SIZE, free_size - fsc);
+        }
+    }
+
+    return log_rec_ptr + 11;
+}
+
 bool32 heap_lock_row(que_sess_t* session, buf_block_t* block, row_header_t* row, mtr_t* mtr)
 {
     itl_t* itl;
@@ -505,7 +626,7 @@ inline void heap_page_init(buf_block_t* block, dict_table_t* table, mtr_t* mtr)
 static inline uint32 heap_get_page_free_space(buf_block_t* block)
 {
     page_t* page = buf_block_get_frame(block);
-    return mach_read_from_1(page + HEAP_HEADER_OFFSET + HEAP_HEADER_FREE_SIZE);
+    return mach_read_from_2(page + HEAP_HEADER_OFFSET + HEAP_HEADER_FREE_SIZE);
 }
 
 static buf_block_t* heap_get_page_for_tuple(dict_table_t* table, uint32 page_no, uint16 row_size, mtr_t* mtr)
@@ -518,7 +639,7 @@ static buf_block_t* heap_get_page_for_tuple(dict_table_t* table, uint32 page_no,
 
     page_t* page = buf_block_get_frame(block);
     heap_page_header_t* page_header = page + HEAP_HEADER_OFFSET;
-    if (mach_read_from_1(page_header + HEAP_HEADER_FREE_SIZE) < row_size) {
+    if (mach_read_from_2(page_header + HEAP_HEADER_FREE_SIZE) < row_size) {
         rw_lock_x_unlock(&(block->rw_lock));
         return NULL;
     }
@@ -526,19 +647,41 @@ static buf_block_t* heap_get_page_for_tuple(dict_table_t* table, uint32 page_no,
     return block;
 }
 
-static buf_block_t* heap_find_free_page(dict_table_t* table,
+static inline fsm_insert_cache_t* heap_get_insert_cache(que_sess_t* sess, dict_table_t* table)
+{
+    return &table->insert_cache[sess->sess_id % FSM_INSERT_CACHE_STRIPES];
+}
+
+// The page last inserted by sessions of same stripe is tried first,
+// fsm is searched only if the page is full, the search starts from
+// the leaf range of stripe, so that concurrent sessions insert into different pages.
+static buf_block_t* heap_find_free_page(que_sess_t* sess, dict_table_t* table,
     uint16 row_size, fsm_search_path_t& search_path, mtr_t* mtr)
 {
+    fsm_insert_cache_t* insert_cache = heap_get_insert_cache(sess, table);
+    uint32 stripe_no = (uint32)(sess->sess_id % FSM_INSERT_CACHE_STRIPES);
+    page_no_t page_no;
+    buf_block_t* block;
+
+    if (fsm_insert_cache_get(insert_cache, search_path, &page_no)) {
+        block = heap_get_page_for_tuple(table, page_no, row_size, mtr);
+        if (block != NULL) {
+            return block;
+        }
+        fsm_insert_cache_set(insert_cache, INVALID_PAGE_NO, search_path);
+    }
+
     search_path.category = fsm_get_needed_to_category(table, row_size);
 
 retry:
 
-    page_no_t page_no = fsm_search_free_page(table, search_path.category, search_path);
+    page_no = fsm_search_free_page(table, search_path.category, search_path,
+        stripe_no, FSM_INSERT_CACHE_STRIPES);
     if (page_no == INVALID_PAGE_NO) {
         return NULL;
     }
 
-    buf_block_t* block = heap_get_page_for_tuple(table, page_no, row_size, mtr);
+    block = heap_get_page_for_tuple(table, page_no, row_size, mtr);
     if (block == NULL) {
         goto retry;
     }
@@ -573,10 +716,11 @@ inline status_t heap_check_row_record_size(row_header_t* row, uint32 len)
 #define ROW_NULL_BITS_IN_BYTES(b)   (((b) + 7) / 8)
 
 
+// Moves value of field to toast pages, row keeps the toast pointer
 static status_t heap_insert_row_ext(que_sess_t *sess,
-    dict_table_t* table, const dfield_t* field, row_id_t* row_id)
+    dict_table_t* table, const dfield_t* field, toast_pointer_t* pointer)
 {
-    return CM_SUCCESS;
+    return toast_write_value(sess, table, (const byte *)dfield_get_data(field), dfield_get_len(field), pointer);
 }
 
 
@@ -606,15 +750,15 @@ static inline status_t heap_convert_dtuple_to_rec(que_sess_t* sess,
         uint32 compressed_size = 2;//mach_get_compressed_size(field_len);
 
         if (dfield_is_ext(field)) {
-            CM_RETURN_IF_ERROR(heap_check_row_record_size(row, sizeof(row_id_t)));
+            CM_RETURN_IF_ERROR(heap_check_row_record_size(row, TOAST_POINTER_SIZE));
 
-            row_id_t row_id;
-            CM_RETURN_IF_ERROR(heap_insert_row_ext(sess, table, field, &row_id));
+            toast_pointer_t pointer;
+            CM_RETURN_IF_ERROR(heap_insert_row_ext(sess, table, field, &pointer));
 
             row->is_ext = TRUE;
-            mach_write_to_8(data, row_id.id);
-            data += sizeof(row_id_t);
-            row->size += sizeof(row_id_t);
+            toast_write_pointer(data, &pointer);
+            data += TOAST_POINTER_SIZE;
+            row->size += TOAST_POINTER_SIZE;
             continue;
         }
 
@@ -670,7 +814,7 @@ static void heap_insert_row_into_page(que_sess_t *sess, buf_block_t* block, row_
 
     // 1. check compact
     if (lower + row->size + sizeof(row_dir_t) > upper) {
-        heap_reorganize_page(block, mtr);
+        heap_reorganize_page(block, undo_data->query_min_scn, mtr);
     }
 
     // 2. alloc directory
@@ -705,7 +849,11 @@ static void heap_insert_row_into_page(que_sess_t *sess, buf_block_t* block, row_
     heap_insert_write_redo(block, row, dir, dir_slot, mtr);
 }
 
-static status_t heap_insert_row(que_sess_t *sess, dict_table_t* table, row_header_t *row)
+static void heap_zone_map_add_row(que_sess_t* sess, dict_table_t* table, buf_block_t* block,
+    row_header_t* row, mtr_t* mtr);
+
+// row_id: out, the row id of inserted row
+static status_t heap_insert_row(que_sess_t *sess, dict_table_t* table, row_header_t *row, row_id_t* row_id)
 {
     status_t ret = CM_SUCCESS;
     mtr_t mtr;
@@ -715,6 +863,8 @@ static status_t heap_insert_row(que_sess_t *sess, dict_table_t* table, row_heade
     uint64 query_min_scn = 0;
     heap_insert_assist_t assist;
 
+    zone_map_load(table);
+
     mtr_start(&mtr);
 
     assist.need_redo = DICT_NEED_REDO(table);
@@ -723,7 +873,7 @@ static status_t heap_insert_row(que_sess_t *sess, dict_table_t* table, row_heade
     }
 
     cost_size = row->size + sizeof(itl_t) + sizeof(row_dir_t);
-    block = heap_find_free_page(table, cost_size, search_path, &mtr);
+    block = heap_find_free_page(sess, table, cost_size, search_path, &mtr);
     if (block == NULL) {
         ret = CM_ERROR;
         goto err_exit;
@@ -746,6 +896,7 @@ static status_t heap_insert_row(que_sess_t *sess, dict_table_t* table, row_heade
     undo_data.undo_op = UNDO_INSERT_OP;
     undo_data.query_min_scn = query_min_scn;
     undo_data->rec_mgr.m_data_size = TRX_UNDO_REC_EXTRA_SIZE + sizeof(row_id_t);
+    undo_data.rec_mgr.m_table_id = table->id;
     if (trx_undo_prepare(sess, &undo_data, &mtr) != CM_SUCCESS) {
         ret = CM_ERROR;
         goto err_exit;
@@ -753,6 +904,7 @@ static status_t heap_insert_row(que_sess_t *sess, dict_table_t* table, row_heade
 
     //
     heap_insert_row_into_page(block, row, sess->cid, &undo_data, &mtr);
+    *row_id = undo_data.rec_mgr.m_insert.row_id;
 
     trx_undo_write_log_rec(sess, &undo_data, &mtr);
 
@@ -761,8 +913,14 @@ static status_t heap_insert_row(que_sess_t *sess, dict_table_t* table, row_heade
     uint8 category = fsm_space_avail_to_category(table, avail);
     if (category != search_path.category) {
         fsm_recursive_set_catagory(table, search_path, category, &mtr);
+        search_path.category = category;
     }
 
+    // zone map pages are latched after fsm pages, as fsm_extend_heap_extents does
+    heap_zone_map_add_row(sess, table, block, row, &mtr);
+    fsm_insert_cache_set(heap_get_insert_cache(sess, table),
+        category > 0 ? block->get_page_no() : INVALID_PAGE_NO, search_path);
+
     // add page to fast_clean_page_list
     sess->fast_clean_mgr.append_clean_block(block->get_space_id(), block->get_page_no(), block, itl_id);
 
@@ -773,14 +931,25 @@ err_exit:
     return ret;
 }
 
+static status_t heap_insert_index_entries(que_sess_t* sess, dict_table_t* table, row_header_t* row, row_id_t row_id);
+
 status_t heap_insert(que_sess_t* sess, insert_node_t* insert_node)
 {
     status_t ret = CM_SUCCESS;
     mtr_t mtr;
     row_header_t* row;
+    row_id_t row_id;
 
     CM_SAVE_STACK(&sess->stack);
 
+    // toast pages of row are protected by undo of trx
+    trx_start_if_not_started(sess);
+
+    if (lock_table(sess, insert_node->table, LOCK_IX) != CM_SUCCESS) {
+        CM_RESTORE_STACK(&sess->stack);
+        return CM_ERROR;
+    }
+
     // Fill in tuple header fields and toast the tuple if necessary
     row = heap_prepare_insert(sess, (dict_table_t*)insert_node->table, insert_node->heap_row);
     if (row == NULL) {
@@ -788,23 +957,17 @@ status_t heap_insert(que_sess_t* sess, insert_node_t* insert_node)
         return CM_ERROR;
     }
 
-    //
-    trx_start_if_not_started(sess);
-
 
     mtr_start(&mtr);
 
-    // 
-    //if (lock_table_shared(session, cursor->dc_entity, LOCK_INF_WAIT) != CT_SUCCESS) {
-    //    err = CM_ERROR;
-    //    goto err_exit;
-    //}
-
-    ret = heap_insert_row(sess, insert_node->table, row);
+    ret = heap_insert_row(sess, insert_node->table, row, &row_id);
     if (ret != CM_SUCCESS) {
         goto err_exit;
     }
 
+    // index pages are latched after the heap page of row is released
+    ret = heap_insert_index_entries(sess, insert_node->table, row, row_id);
+
 err_exit:
 
     mtr_commit(&mtr);
@@ -814,11 +977,180 @@ err_exit:
     return ret;
 }
 
-status_t heap_multi_insert()
+#define HEAP_MULTI_INSERT_MAX_ROWS     32
+
+// Places rows into the latched page as far as they fit without reorganizing the page,
+// rows[0] always fits. Returns the number of rows placed, the dirs get their undo position later.
+static uint32 heap_insert_rows_into_page(buf_block_t* block, dict_table_t* table, row_header_t** rows,
+    uint32 count, uint8 itl_id, command_id_t cid, uint64 query_min_scn, undo_data_t* undo_datas, mtr_t* mtr)
+{
+    page_t* page = buf_block_get_frame(block);
+    heap_page_header_t* hdr = page + HEAP_HEADER_OFFSET;
+    uint32 n;
+
+    for (n = 0; n < count; n++) {
+        row_header_t* row = rows[n];
+        uint16 upper = mach_read_from_2(hdr + HEAP_HEADER_UPPER);
+        uint16 lower = mach_read_from_2(hdr + HEAP_HEADER_LOWER);
+        uint32 free_size = mach_read_from_2(hdr + HEAP_HEADER_FREE_SIZE);
+
+        // the redo of placed rows is written after their undo, the page must not be reorganized in between
+        if (lower + row->size + sizeof(row_dir_t) > upper) {
+            if (n > 0) {
+                break;
+            }
+            heap_reorganize_page(block, query_min_scn, mtr);
+            lower = mach_read_from_2(hdr + HEAP_HEADER_LOWER);
+        } else if (n > 0 && free_size < row->size + sizeof(row_dir_t)) {
+            break;
+        }
+
+        heap_row_set_itl_id(row, itl_id);
+
+        uint32 dir_slot;
+        row_dir_t* dir = heap_alloc_dir(block, &dir_slot, mtr);
+        dir->is_free = 0;
+        dir->scn = cid;
+        dir->is_ow_scn = 0;
+        dir->offset = lower;
+
+        undo_data_t* undo_data = &undo_datas[n];
+        undo_data->undo_op = UNDO_INSERT_OP;
+        undo_data->query_min_scn = query_min_scn;
+        undo_data->rec_mgr.m_type = UNDO_HEAP_INSERT;
+        undo_data->rec_mgr.m_cid = cid;
+        undo_data->rec_mgr.m_table_id = table->id;
+        undo_data->rec_mgr.m_data_size = sizeof(row_id_t);
+        undo_data->rec_mgr.m_insert.row_id.space_id = block->get_space_id();
+        undo_data->rec_mgr.m_insert.row_id.page_no = block->get_page_no();
+        undo_data->rec_mgr.m_insert.row_id.slot = dir_slot;
+
+        uint32 page_rows = mach_read_from_2(hdr + HEAP_HEADER_ROWS);
+        mach_write_to_2(hdr + HEAP_HEADER_LOWER, lower + row->size);
+        mach_write_to_2(hdr + HEAP_HEADER_FREE_SIZE, free_size - row->size);
+        mach_write_to_2(hdr + HEAP_HEADER_ROWS, page_rows + 1);
+        memcpy(page + lower, (const byte *)row, row->size);
+    }
+
+    return n;
+}
+
+// Inserts the rows of a statement, the rows placed into one page share one mtr,
+// their undo records are written by trx_undo_write_log_recs under one undo page latch.
+static status_t heap_insert_rows(que_sess_t *sess, dict_table_t* table, row_header_t** rows, uint32 count)
 {
+    undo_data_t undo_datas[HEAP_MULTI_INSERT_MAX_ROWS];
+    fsm_search_path_t search_path;
+    uint64 query_min_scn = 0;
+    mtr_t mtr;
+
+    ut_ad(count <= HEAP_MULTI_INSERT_MAX_ROWS);
+
+    zone_map_load(table);
+
+    while (count > 0) {
+        mtr_start(&mtr);
+
+        uint32 cost_size = rows[0]->size + sizeof(itl_t) + sizeof(row_dir_t);
+        buf_block_t* block = heap_find_free_page(sess, table, cost_size, search_path, &mtr);
+        if (block == NULL) {
+            mtr_commit(&mtr);
+            return CM_ERROR;
+        }
+
+        uint8 itl_id = HEAP_INVALID_ITL_ID;
+        itl_t* itl = heap_alloc_itl(block, sess->trx, &mtr, &itl_id);
+        if (itl == NULL) {
+            CM_SET_ERROR(ERR_ALLOC_ITL, table->name, block->get_space_id(), block->get_page_no());
+            mtr_commit(&mtr);
+            return CM_ERROR;
+        }
+
+        // undo space of all rows which may fit into the page is reserved before the page is changed,
+        // so the records are written into one undo page
+        undo_data_t reserve;
+        reserve.undo_op = UNDO_INSERT_OP;
+        reserve.query_min_scn = query_min_scn;
+        reserve.rec_mgr.m_data_size = count * (TRX_UNDO_REC_EXTRA_SIZE + sizeof(row_id_t));
+        if (trx_undo_prepare(sess, &reserve, &mtr) != CM_SUCCESS) {
+            mtr_commit(&mtr);
+            return CM_ERROR;
+        }
+
+        uint32 n = heap_insert_rows_into_page(block, table, rows, count, itl_id, sess->cid, query_min_scn, undo_datas, &mtr);
+        status_t ret = trx_undo_write_log_recs(sess, undo_datas, n, &mtr);
+        ut_a(ret == CM_SUCCESS);
+
+        page_t* page = buf_block_get_frame(block);
+        for (uint32 i = 0; i < n; i++) {
+            uint32 dir_slot = (uint32)undo_datas[i].rec_mgr.m_insert.row_id.slot;
+            row_dir_t* dir = heap_get_dir(page, dir_slot);
+            dir->undo_space_index = undo_datas[i].undo_space_index;
+            dir->undo_page_no = undo_datas[i].undo_page_no;
+            dir->undo_page_offset = undo_datas[i].undo_page_offset;
+            heap_insert_write_redo(block, HEAP_GET_ROW(page, dir), dir, dir_slot, &mtr);
+            heap_zone_map_add_row(sess, table, block, rows[i], &mtr);
+        }
+
+        uint16 avail = heap_get_page_free_space(block);
+        uint8 category = fsm_space_avail_to_category(table, avail);
+        if (category != search_path.category) {
+            fsm_recursive_set_catagory(table, search_path, category, &mtr);
+            search_path.category = category;
+        }
+        fsm_insert_cache_set(heap_get_insert_cache(sess, table),
+            category > 0 ? block->get_page_no() : INVALID_PAGE_NO, search_path);
+
+        sess->fast_clean_mgr.append_clean_block(block->get_space_id(), block->get_page_no(), block, itl_id);
+
+        mtr_commit(&mtr);
+
+        for (uint32 i = 0; i < n; i++) {
+            row_id_t row_id = undo_datas[i].rec_mgr.m_insert.row_id;
+            CM_RETURN_IF_ERROR(heap_insert_index_entries(sess, table, rows[i], row_id));
+        }
+
+        rows += n;
+        count -= n;
+    }
+
     return CM_SUCCESS;
 }
 
+// Inserts several rows of a statement, up to HEAP_MULTI_INSERT_MAX_ROWS rows are inserted in a batch
+status_t heap_multi_insert(que_sess_t* sess, dict_table_t* table, dtuple_t** tuples, uint32 count)
+{
+    row_header_t* rows[HEAP_MULTI_INSERT_MAX_ROWS];
+    status_t ret = CM_SUCCESS;
+
+    trx_start_if_not_started(sess);
+
+    CM_RETURN_IF_ERROR(lock_table(sess, table, LOCK_IX));
+
+    for (uint32 i = 0; i < count && ret == CM_SUCCESS; i += HEAP_MULTI_INSERT_MAX_ROWS) {
+        uint32 batch_count = ut_min(count - i, (uint32)HEAP_MULTI_INSERT_MAX_ROWS);
+
+        CM_SAVE_STACK(&sess->stack);
+
+        // rows are toasted before any heap page is latched
+        for (uint32 j = 0; j < batch_count; j++) {
+            rows[j] = heap_prepare_insert(sess, table, tuples[i + j]);
+            if (rows[j] == NULL) {
+                ret = CM_ERROR;
+                break;
+            }
+        }
+
+        if (ret == CM_SUCCESS) {
+            ret = heap_insert_rows(sess, table, rows, batch_count);
+        }
+
+        CM_RESTORE_STACK(&sess->stack);
+    }
+
+    return ret;
+}
+
 void heap_delete_write_redo(buf_block_t* block, row_header_t *row, row_dir_t* dir, uint32 dir_slot, mtr_t* mtr)
 {
     const uint32 buf_size = 11;
@@ -832,62 +1164,82 @@ void heap_delete_write_redo(buf_block_t* block, row_header_t *row, row_dir_t* di
     mlog_write_log(MLOG_HEAP_DELETE, block->get_space_id(), block->get_page_no(), buf, buf_size, mtr);
 }
 
+static bool32 heap_filter_decode_row(dict_table_t* table, row_header_t* row,
+    uint16 column_count, const byte** values, uint16* lens);
+
+// Chains of externally stored values of row are freed by purge after the delete is committed
+static status_t heap_delete_row_ext(que_sess_t *sess, dict_table_t* table, row_header_t* row, mtr_t* mtr)
+{
+    const byte* values[ROW_MAX_COLUMN_COUNT];
+    uint16 lens[ROW_MAX_COLUMN_COUNT];
+    uint16 column_count = (uint16)table->column_count;
+
+    if (!row->is_ext) {
+        return CM_SUCCESS;
+    }
+    if (!heap_filter_decode_row(table, row, column_count, values, lens)) {
+        LOGGER_ERROR(LOGGER, LOG_MODULE_HEAP, "heap_delete_row_ext: row can not be decoded, table %s", table->name);
+        return CM_ERROR;
+    }
+
+    for (uint16 i = 0; i < column_count; i++) {
+        // a column added after the row was inserted has no toast pointer in row
+        if (!table->columns[i]->is_ext || lens[i] != TOAST_POINTER_SIZE ||
+            i >= ((heap_tuple_t *)row)->column_count) {
+            continue;
+        }
+        CM_RETURN_IF_ERROR(toast_delete_value(sess, values[i], mtr));
+    }
+
+    return CM_SUCCESS;
+}
+
+// The row must be locked by lock_rec in X mode, the page is latched after the lock is granted
 static status_t heap_delete_row(que_sess_t *sess, dict_table_t* table, row_id_t row_id)
 {
     status_t ret = CM_SUCCESS;
     mtr_t mtr;
-    uint32 cost_size;
-    fsm_search_path_t search_path;
-    buf_block_t* block;
     uint64 query_min_scn = 0;
-    heap_insert_assist_t assist;
 
     mtr_start(&mtr);
 
-    assist.need_redo = DICT_NEED_REDO(table);
-    if (sess->attr->attr_rep.enable_logical_rep) {
-        assist.table_id = table->id;
-    }
-
-    // get block by row_id
     const page_id_t page_id(row_id.space_id, row_id.page_no);
     const page_size_t page_size(row_id.space_id);
-    buf_block_t* block = buf_page_get(page_id, page_size, RW_X_LATCH, mtr);
+    buf_block_t* block = buf_page_get(page_id, page_size, RW_X_LATCH, &mtr);
     ut_ad(block->get_page_no() == row_id.page_no);
     ut_ad(block->get_page_type() == FIL_PAGE_TYPE_HEAP);
-    //buf_block_dbg_add_level(block, SYNC_DICT_HEADER);
     page_t* page = buf_block_get_frame(block);
 
+    // the row may be deleted by the trx holding the lock before
     row_dir_t* dir = heap_get_dir(page, (uint32)row_id.slot);
-    ut_ad(!dir->is_free);
-    ut_ad(dir->scn < sess->cid);
-
-    row_header_t* row = HEAP_GET_ROW(page, dir);
-    ut_ad(!row->is_deleted);
+    row_header_t* row = dir->is_free ? NULL : HEAP_GET_ROW(page, dir);
+    if (row == NULL || row->is_deleted) {
+        CM_SET_ERROR(ERR_RECORD_NOT_FOUND, table->name);
+        ret = CM_ERROR;
+        goto err_exit;
+    }
 
-    itl_t* itl;
-    uint32 old_itl_id = HEAP_INVALID_ITL_ID;
-    if (row->itl_id == HEAP_INVALID_ITL_ID) {
-        // transaction is committed or aborted for row
-        itl = heap_alloc_itl(block, sess->trx, mtr, &row->itl_id);
-        ut_ad(itl);
-    } else {
-        // row->itl is current transaction
-        old_itl_id = row->itl_id;
-        itl = heap_get_itl(page, row->itl_id);
-        ut_ad(itl);
-        ut_ad(itl->is_active); // row is locked by heap_fetch
+    // an itl of other trx on row is ended, since the row lock of it has been released,
+    // the itl may be reused by alloc, so the old itl and dir of row are saved after it
+    uint8 itl_id;
+    itl_t* itl = heap_alloc_itl(block, sess->trx, &mtr, &itl_id);
+    if (itl == NULL) {
+        CM_SET_ERROR(ERR_ALLOC_ITL, table->name, block->get_space_id(), block->get_page_no());
+        ret = CM_ERROR;
+        goto err_exit;
     }
+    uint8 old_itl_id = row->itl_id;
+    heap_row_set_itl_id(row, itl_id);
     itl->fsc += row->size;
 
-    //
     undo_data_t undo_data;
     undo_data.undo_op = UNDO_MODIFY_OP;
     undo_data.query_min_scn = query_min_scn;
     undo_data.rec_mgr.m_type = undo_type_t::UNDO_HEAP_DELETE;
     undo_data.rec_mgr.m_cid = sess->cid;
+    undo_data.rec_mgr.m_table_id = table->id;
     undo_data.rec_mgr.m_delete.row_id = row_id;
-    undo_data.rec_mgr.m_delete.old_dir = dir;
+    undo_data.rec_mgr.m_delete.old_dir = *dir;
     undo_data.rec_mgr.m_delete.old_itl_id = old_itl_id;
 
     dir->scn = sess->cid;
@@ -900,7 +1252,13 @@ static status_t heap_delete_row(que_sess_t *sess, dict_table_t* table, row_id_t
     ut_ad(rows > 0);
     mach_write_to_2(hdr + HEAP_HEADER_ROWS, rows - 1);
 
-    undo_data->rec_mgr.m_data_size = TRX_UNDO_REC_EXTRA_SIZE + sizeof(row_id_t) + sizeof(row_dir_t) + 1;
+    // written before the delete record, dir points to the delete record
+    if (heap_delete_row_ext(sess, table, row, &mtr) != CM_SUCCESS) {
+        ret = CM_ERROR;
+        goto err_exit;
+    }
+
+    undo_data.rec_mgr.m_data_size = sizeof(row_id_t) + sizeof(row_dir_t) + 1;
     if (trx_undo_prepare(sess, &undo_data, &mtr) != CM_SUCCESS) {
         ret = CM_ERROR;
         goto err_exit;
@@ -908,67 +1266,36 @@ static status_t heap_delete_row(que_sess_t *sess, dict_table_t* table, row_id_t
     trx_undo_write_log_rec(sess, &undo_data, &mtr);
 
     // Sets roll ptr field of row
-    dir->undo_space_index = undo_data->undo_space_index;
-    dir->undo_page_no = undo_data->undo_page_no;
-    dir->undo_page_offset = undo_data->undo_page_offset;
+    dir->undo_space_index = undo_data.undo_space_index;
+    dir->undo_page_no = undo_data.undo_page_no;
+    dir->undo_page_offset = undo_data.undo_page_offset;
     heap_delete_write_redo(block, row, dir, row_id.slot, &mtr);
 
     // add page to fast_clean_page_list
-    sess->fast_clean_mgr.append_clean_block(block->get_space_id(), block->get_page_no(), block, row->itl_id);
+    sess->fast_clean_mgr.append_clean_block(block->get_space_id(), block->get_page_no(), block, itl_id);
 
 err_exit:
 
     mtr_commit(&mtr);
 
     return ret;
-
 }
 
-status_t heap_delete(que_sess_t* sess, delete_node_t* delete_node)
+// Locks the row in X mode, IX lock of table is acquired first, waits for the trx holding it
+static inline status_t heap_lock_row_x(que_sess_t* sess, dict_table_t* table, row_id_t row_id)
 {
-    status_t ret = CM_SUCCESS;
-    mtr_t mtr;
-    row_header_t* row;
-
-    CM_SAVE_STACK(&sess->stack);
+    const page_id_t page_id(row_id.space_id, row_id.page_no);
 
-    // Fill in tuple header fields and toast the tuple if necessary
-    row = heap_prepare_insert(sess, (dict_table_t*)delete_node->table, delete_node->heap_row);
-    if (row == NULL) {
-        return CM_ERROR;
-    }
+    return lock_rec(sess, table, page_id, (uint32)row_id.slot, LOCK_X);
+}
 
-    //
+status_t heap_delete(que_sess_t* sess, dict_table_t* table, row_id_t row_id)
+{
     trx_start_if_not_started(sess);
 
+    CM_RETURN_IF_ERROR(heap_lock_row_x(sess, table, row_id));
 
-    mtr_start(&mtr);
-
-    // 
-    //if (lock_table_shared(session, cursor->dc_entity, LOCK_INF_WAIT) != CT_SUCCESS) {
-    //    err = CM_ERROR;
-    //    goto err_exit;
-    //}
-
-    //if (table->is_contain_lob) {
-    //    if (CT_SUCCESS != lob_delete(sess, cursor)) {
-    //        return CT_ERROR;
-    //    }
-    //}
-
-
-    if (heap_delete_row(sess, insert_node->table, row) != CM_SUCCESS) {
-        ret = CM_ERROR;
-        goto err_exit;
-    }
-
-err_exit:
-
-    mtr_commit(&mtr);
-
-    CM_RESTORE_STACK(&sess->stack);
-
-    return ret;
+    return heap_delete_row(sess, table, row_id);
 }
 
 typedef enum en_heap_update_mode {
@@ -978,48 +1305,44 @@ typedef enum en_heap_update_mode {
 } heap_update_mode_t;
 
 
-status_t heap_update(que_sess_t* sess, update_node_t* update_node)
+// The new version of row is inserted as a new row, the old one is deleted,
+// so the old version is kept for consistent read as any deleted row.
+status_t heap_update(que_sess_t* sess, dict_table_t* table, row_id_t row_id, insert_node_t* insert_node)
 {
-    status_t ret = CM_SUCCESS;
-    mtr_t mtr;
+    status_t ret;
     row_header_t* row;
 
     CM_SAVE_STACK(&sess->stack);
 
+    // toast pages of new values are protected by undo of trx
+    trx_start_if_not_started(sess);
+
+    ret = heap_lock_row_x(sess, table, row_id);
+    if (ret != CM_SUCCESS) {
+        CM_RESTORE_STACK(&sess->stack);
+        return ret;
+    }
+
+    ret = heap_delete_row(sess, table, row_id);
+    if (ret != CM_SUCCESS) {
+        CM_RESTORE_STACK(&sess->stack);
+        return ret;
+    }
+
     // Fill in tuple header fields and toast the tuple if necessary
-    row = heap_prepare_insert(sess, (dict_table_t*)insert_node->table, insert_node->heap_row);
+    row = heap_prepare_insert(sess, table, insert_node->heap_row);
     if (row == NULL) {
+        CM_RESTORE_STACK(&sess->stack);
         return CM_ERROR;
     }
 
-    //
-    trx_start_if_not_started(sess);
-
-
-    mtr_start(&mtr);
-
-    // 
-    //if (lock_table_shared(session, cursor->dc_entity, LOCK_INF_WAIT) != CT_SUCCESS) {
-    //    err = CM_ERROR;
-    //    goto err_exit;
-    //}
-
-    //if (table->is_contain_lob) {
-    //    if (CT_SUCCESS != lob_delete(sess, cursor)) {
-    //        return CT_ERROR;
-    //    }
-    //}
-
-
-    if (heap_delete_row(sess, insert_node->table, row) != CM_SUCCESS) {
-        ret = CM_ERROR;
-        goto err_exit;
+    row_id_t new_row_id;
+    ret = heap_insert_row(sess, table, row, &new_row_id);
+    if (ret == CM_SUCCESS) {
+        // keys of the old version are kept, as for a deleted row
+        ret = heap_insert_index_entries(sess, table, row, new_row_id);
     }
 
-err_exit:
-
-    mtr_commit(&mtr);
-
     CM_RESTORE_STACK(&sess->stack);
 
     return ret;
@@ -1133,6 +1456,623 @@ static status_t heap_row_build_rcr_version(que_sess_t* sess, scan_cursor_t* curs
     return CM_SUCCESS;
 }
 
+/*-------------------------------------------------- */
+// pushed down filter
+
+static inline uint32 heap_filter_col_fixed_len(dict_col_t* col)
+{
+    data_type_desc_t* desc = g_data_type_desc[col->mtype];
+    return desc ? desc->fixed_length : 0;
+}
+
+// Locates the data of first column_count columns in the layout of heap_form_tuple,
+// lens[i] is REC_NULL_VALUE_LEN if column is null
+static bool32 heap_filter_decode_row(dict_table_t* table, row_header_t* row,
+    uint16 column_count, const byte** values, uint16* lens)
+{
+    heap_tuple_t* tuple = (heap_tuple_t *)row;
+    uint16 null_bytes = tuple->is_has_nulls ? HEAP_TUPLE_NULL_BITMAP_LENGTH(tuple->column_count) : 0;
+    const byte* data = (const byte *)row + HEAP_TUPLE_HEADER_SIZE + null_bytes;
+    const byte* end = (const byte *)row + row->size;
+
+    for (uint16 i = 0; i < column_count; i++) {
+        dict_col_t* col = table->columns[i];
+
+        if (i >= tuple->column_count) {
+            // column is added after the row was inserted, row has the default of column if any
+            values[i] = (const byte *)col->default_const_value;
+            lens[i] = (values[i] == NULL) ? REC_NULL_VALUE_LEN : col->default_const_value_len;
+            continue;
+        }
+        if (tuple_check_nth_col_is_null(tuple, i)) {
+            values[i] = NULL;
+            lens[i] = REC_NULL_VALUE_LEN;
+            continue;
+        }
+
+        uint32 fixed_len = heap_filter_col_fixed_len(col);
+        if (fixed_len > 0) {
+            lens[i] = (uint16)fixed_len;
+        } else if (col->is_ext) {
+            lens[i] = TOAST_POINTER_SIZE;
+        } else {
+            lens[i] = mach_read_from_2(data);
+            data += 2;
+        }
+        values[i] = data;
+        data += lens[i];
+        if (data > end) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+// Reads an integer of native byte order, FALSE if len is not size of an integer.
+// An unsigned integer is zero extended, so one of 8 bytes must be compared as uint64.
+static inline bool32 heap_filter_read_int(const byte* data, uint16 len, bool32 is_unsigned, int64* value)
+{
+    switch (len) {
+    case 1:
+        *value = is_unsigned ? (int64)*(uint8 *)data : (int64)*(int8 *)data;
+        return TRUE;
+    case 2: {
+        int16 v;
+        memcpy(&v, data, 2);
+        *value = is_unsigned ? (int64)(uint16)v : (int64)v;
+        return TRUE;
+    }
+    case 4: {
+        int32 v;
+        memcpy(&v, data, 4);
+        *value = is_unsigned ? (int64)(uint32)v : (int64)v;
+        return TRUE;
+    }
+    case 8:
+        memcpy(value, data, 8);
+        return TRUE;
+    default:
+        break;
+    }
+
+    return FALSE;
+}
+
+// integer columns are kept in native byte order with length of column type
+static inline bool32 heap_filter_col_is_int(dict_col_t* col)
+{
+    if (col->is_ext) {
+        return FALSE;
+    }
+    if (col->mtype != DATA_BIGINT && col->mtype != DATA_INT && col->mtype != DATA_SMALLINT) {
+        return FALSE;
+    }
+    return heap_filter_col_fixed_len(col) > 0;
+}
+
+// A comparison is evaluated by heap only if it is in the order of values:
+// integers, floats and binaries. number and decimal are not kept as integers,
+// and strings are compared by collation, so they are left to caller.
+static bool32 heap_filter_inst_is_exact(dict_table_t* table, const scan_filter_inst_t* inst)
+{
+    if (inst->op == SCAN_FILTER_AND || inst->op == SCAN_FILTER_OR) {
+        return TRUE;
+    }
+    if (inst->column_id >= table->column_count) {
+        return FALSE;
+    }
+    if (inst->op == SCAN_FILTER_IS_NULL || inst->op == SCAN_FILTER_IS_NOT_NULL) {
+        return TRUE;
+    }
+
+    dict_col_t* col = table->columns[inst->column_id];
+    if (heap_filter_col_is_int(col)) {
+        return inst->value_len == heap_filter_col_fixed_len(col);
+    }
+    if (col->is_ext) {
+        return FALSE;
+    }
+    switch (col->mtype) {
+    case DATA_FLOAT:
+        return inst->value_len == sizeof(float);
+    case DATA_DOUBLE:
+    case DATA_REAL:
+        return inst->value_len == sizeof(double);
+    case DATA_BINARY:
+    case DATA_VARBINARY:
+    case DATA_RAW:
+        return TRUE;
+    default:
+        break;
+    }
+
+    return FALSE;
+}
+
+// Sets filter of cursor if every comparison of it is evaluated exactly by heap,
+// otherwise cursor is left without filter and caller evaluates it on the rows.
+bool32 heap_push_filter(scan_cursor_t* cursor, scan_filter_t* filter)
+{
+    cursor->filter = NULL;
+
+    if (filter == NULL || filter->inst_count == 0 || filter->depth != 1) {
+        return FALSE;
+    }
+    for (uint32 i = 0; i < filter->inst_count; i++) {
+        if (!heap_filter_inst_is_exact(cursor->table, &filter->insts[i])) {
+            return FALSE;
+        }
+    }
+
+    cursor->filter = filter;
+    cursor->zone_extent_no = UINT32_UNDEFINED;
+
+    return TRUE;
+}
+
+static int32 heap_filter_compare(dict_col_t* col, const byte* data, uint16 len, const scan_filter_inst_t* inst)
+{
+    if (col->mtype == DATA_FLOAT && len == sizeof(float) && inst->value_len == sizeof(float)) {
+        float v1, v2;
+        memcpy(&v1, data, sizeof(float));
+        memcpy(&v2, inst->value, sizeof(float));
+        return v1 < v2 ? -1 : (v1 > v2 ? 1 : 0);
+    }
+    if ((col->mtype == DATA_DOUBLE || col->mtype == DATA_REAL) &&
+        len == sizeof(double) && inst->value_len == sizeof(double)) {
+        double v1, v2;
+        memcpy(&v1, data, sizeof(double));
+        memcpy(&v2, inst->value, sizeof(double));
+        return v1 < v2 ? -1 : (v1 > v2 ? 1 : 0);
+    }
+
+    // integers of native byte order
+    int64 v1, v2;
+    if (heap_filter_col_is_int(col) && len == inst->value_len &&
+        heap_filter_read_int(data, len, col->is_unsigned, &v1) &&
+        heap_filter_read_int(inst->value, len, col->is_unsigned, &v2)) {
+        if (col->is_unsigned) {
+            return (uint64)v1 < (uint64)v2 ? -1 : ((uint64)v1 > (uint64)v2 ? 1 : 0);
+        }
+        return v1 < v2 ? -1 : (v1 > v2 ? 1 : 0);
+    }
+
+    // strings and binaries, compared as bytes
+    int32 ret = memcmp(data, inst->value, ut_min(len, inst->value_len));
+    if (ret != 0) {
+        return ret;
+    }
+    return len < inst->value_len ? -1 : (len > inst->value_len ? 1 : 0);
+}
+
+// Evaluates filter of cursor on the raw row, filter is checked by heap_push_filter.
+// A row which can not be decoded is corrupted, it is not filtered out
+// so that caller meets the corruption when it reads the row.
+static bool32 heap_match_filter(scan_cursor_t* cursor, row_header_t* row)
+{
+    scan_filter_t* filter = cursor->filter;
+    const byte* values[ROW_MAX_COLUMN_COUNT];
+    uint16 lens[ROW_MAX_COLUMN_COUNT];
+    bool8 stack[SCAN_FILTER_MAX_INSTS];
+    uint32 top = 0;
+
+    if (filter == NULL) {
+        return TRUE;
+    }
+    ut_ad(filter->depth == 1);
+    ut_ad(filter->column_count <= cursor->table->column_count);
+
+    if (!heap_filter_decode_row(cursor->table, row, filter->column_count, values, lens)) {
+        LOGGER_ERROR(LOGGER, LOG_MODULE_HEAP, "heap_match_filter: row can not be decoded, table %s", cursor->table->name);
+        ut_ad(0);
+        return TRUE;
+    }
+
+    for (uint32 i = 0; i < filter->inst_count; i++) {
+        const scan_filter_inst_t* inst = &filter->insts[i];
+        bool8 result;
+
+        switch (inst->op) {
+        case SCAN_FILTER_AND:
+            top--;
+            stack[top - 1] = stack[top - 1] && stack[top];
+            continue;
+        case SCAN_FILTER_OR:
+            top--;
+            stack[top - 1] = stack[top - 1] || stack[top];
+            continue;
+        case SCAN_FILTER_IS_NULL:
+            result = (lens[inst->column_id] == REC_NULL_VALUE_LEN);
+            break;
+        case SCAN_FILTER_IS_NOT_NULL:
+            result = (lens[inst->column_id] != REC_NULL_VALUE_LEN);
+            break;
+        default: {
+            dict_col_t* col = cursor->table->columns[inst->column_id];
+            if (lens[inst->column_id] == REC_NULL_VALUE_LEN) {
+                result = FALSE;
+                break;
+            }
+            ut_ad(!col->is_ext);
+            int32 cmp = heap_filter_compare(col, values[inst->column_id], lens[inst->column_id], inst);
+            switch (inst->op) {
+            case SCAN_FILTER_EQ: result = (cmp == 0); break;
+            case SCAN_FILTER_NE: result = (cmp != 0); break;
+            case SCAN_FILTER_LT: result = (cmp < 0); break;
+            case SCAN_FILTER_LE: result = (cmp <= 0); break;
+            case SCAN_FILTER_GT: result = (cmp > 0); break;
+            case SCAN_FILTER_GE: result = (cmp >= 0); break;
+            default: ut_error; result = FALSE; break;
+            }
+            break;
+        }
+        }
+        stack[top++] = result;
+    }
+
+    return stack[0];
+}
+
+// Locates the toast pointer of an externally stored column in current row of cursor,
+// ptr is NULL if the column is null.
+status_t heap_get_ext_column(scan_cursor_t* cursor, uint32 column_id, const byte** ptr)
+{
+    dict_table_t* table = cursor->table;
+    const byte* values[ROW_MAX_COLUMN_COUNT];
+    uint16 lens[ROW_MAX_COLUMN_COUNT];
+
+    if (column_id >= table->column_count) {
+        CM_SET_ERROR(ERR_COLUMN_NOT_EXIST, "ext column");
+        return CM_ERROR;
+    }
+    if (!table->columns[column_id]->is_ext) {
+        CM_SET_ERROR(ERR_UNSUPPORTED, "read of column not externally stored");
+        return CM_ERROR;
+    }
+    if (!heap_filter_decode_row(table, cursor->row, (uint16)(column_id + 1), values, lens)) {
+        LOGGER_ERROR(LOGGER, LOG_MODULE_HEAP, "heap_get_ext_column: row can not be decoded, table %s", table->name);
+        CM_SET_ERROR(ERR_UNSUPPORTED, "corrupted row");
+        return CM_ERROR;
+    }
+
+    // a column added after the row was inserted keeps its default in dictionary
+    if (lens[column_id] == REC_NULL_VALUE_LEN || column_id >= ((heap_tuple_t *)cursor->row)->column_count) {
+        *ptr = NULL;
+        return CM_SUCCESS;
+    }
+    ut_a(lens[column_id] == TOAST_POINTER_SIZE);
+    *ptr = values[column_id];
+
+    return CM_SUCCESS;
+}
+
+// integer columns, which are compared as integers by filter
+// Ranges are kept as int64, an unsigned integer of 8 bytes does not fit
+static inline bool32 heap_zone_map_col_is_supported(dict_col_t* col)
+{
+    if (!heap_filter_col_is_int(col)) {
+        return FALSE;
+    }
+    return !(col->is_unsigned && heap_filter_col_fixed_len(col) == 8);
+}
+
+static void heap_zone_map_add_row(que_sess_t* sess, dict_table_t* table, buf_block_t* block,
+    row_header_t* row, mtr_t* mtr)
+{
+    const byte* values[ROW_MAX_COLUMN_COUNT];
+    uint16 lens[ROW_MAX_COLUMN_COUNT];
+    zone_map_value_t zone_values[DICT_ZONE_MAP_MAX_COLUMNS];
+    uint16 column_count = 0;
+
+    if (table->zone_map_page_no == FIL_NULL) {
+        return;
+    }
+
+    for (uint32 i = 0; i < table->zone_map_column_count; i++) {
+        column_count = ut_max(column_count, table->zone_map_columns[i] + 1);
+    }
+    bool32 is_decoded = heap_filter_decode_row(table, row, column_count, values, lens);
+
+    for (uint32 i = 0; i < table->zone_map_column_count; i++) {
+        uint16 column_id = table->zone_map_columns[i];
+        zone_map_value_t* value = &zone_values[i];
+
+        value->is_null = is_decoded && lens[column_id] == REC_NULL_VALUE_LEN;
+        value->is_unknown = !is_decoded || (!value->is_null &&
+            (lens[column_id] != heap_filter_col_fixed_len(table->columns[column_id]) ||
+             !heap_filter_read_int(values[column_id], lens[column_id],
+                 table->columns[column_id]->is_unsigned, &value->value)));
+    }
+
+    zone_map_add_values(table, block->get_page_no(), zone_values,
+        &table->zone_map_cache[sess->sess_id % ZONE_MAP_CACHE_STRIPES], mtr);
+}
+
+// Evaluates filter on the value ranges of extent of page_no,
+// FALSE only if no row of the extent can match the filter.
+static bool32 heap_zone_map_may_match(dict_table_t* table, scan_filter_t* filter, page_no_t page_no)
+{
+    zone_map_range_t ranges[DICT_ZONE_MAP_MAX_COLUMNS];
+    bool8 stack[SCAN_FILTER_MAX_INSTS];
+    uint32 top = 0;
+
+    if (filter == NULL || filter->inst_count == 0 || table->zone_map_page_no == FIL_NULL) {
+        return TRUE;
+    }
+    if (!zone_map_get_ranges(table, page_no, ranges)) {
+        return TRUE;
+    }
+
+    for (uint32 i = 0; i < filter->inst_count; i++) {
+        const scan_filter_inst_t* inst = &filter->insts[i];
+        zone_map_range_t* range = NULL;
+        int64 value;
+        bool8 result;
+
+        if (inst->op == SCAN_FILTER_AND) {
+            top--;
+            stack[top - 1] = stack[top - 1] && stack[top];
+            continue;
+        }
+        if (inst->op == SCAN_FILTER_OR) {
+            top--;
+            stack[top - 1] = stack[top - 1] || stack[top];
+            continue;
+        }
+
+        for (uint32 j = 0; j < table->zone_map_column_count; j++) {
+            if (table->zone_map_columns[j] == inst->column_id) {
+                range = &ranges[j];
+                break;
+            }
+        }
+
+        if (range == NULL || range->state == ZONE_MAP_UNKNOWN || inst->op == SCAN_FILTER_IS_NULL) {
+            result = TRUE;
+        } else if (range->state == ZONE_MAP_EMPTY) {
+            // comparison of null is not true
+            result = FALSE;
+        } else if (inst->op == SCAN_FILTER_IS_NOT_NULL ||
+                   inst->value_len != heap_filter_col_fixed_len(table->columns[inst->column_id]) ||
+                   !heap_filter_read_int(inst->value, inst->value_len,
+                       table->columns[inst->column_id]->is_unsigned, &value)) {
+            result = TRUE;
+        } else {
+            switch (inst->op) {
+            case SCAN_FILTER_EQ: result = (range->min_value <= value && value <= range->max_value); break;
+            case SCAN_FILTER_NE: result = (range->min_value != value || range->max_value != value); break;
+            case SCAN_FILTER_LT: result = (range->min_value < value); break;
+            case SCAN_FILTER_LE: result = (range->min_value <= value); break;
+            case SCAN_FILTER_GT: result = (range->max_value > value); break;
+            case SCAN_FILTER_GE: result = (range->max_value >= value); break;
+            default: result = TRUE; break;
+            }
+        }
+        stack[top++] = result;
+    }
+
+    return stack[0];
+}
+
+// Declares zone map on columns of table, only the extents allocated later are tracked.
+// It is a ddl, caller must ensure that there is no dml on table.
+status_t heap_create_zone_map(que_sess_t* sess, dict_table_t* table, const uint16* column_ids, uint16 column_count)
+{
+    if (column_count == 0 || column_count > DICT_ZONE_MAP_MAX_COLUMNS) {
+        CM_SET_ERROR(ERR_UNSUPPORTED, "zone map column count");
+        return CM_ERROR;
+    }
+
+    for (uint32 i = 0; i < column_count; i++) {
+        if (column_ids[i] >= table->column_count) {
+            CM_SET_ERROR(ERR_COLUMN_NOT_EXIST, "zone map column");
+            return CM_ERROR;
+        }
+        if (!heap_zone_map_col_is_supported(table->columns[column_ids[i]])) {
+            CM_SET_ERROR(ERR_UNSUPPORTED, "zone map column type");
+            return CM_ERROR;
+        }
+    }
+
+    // existing rows are summarized by the build, dml is excluded until trx ends
+    trx_start_if_not_started(sess);
+    CM_RETURN_IF_ERROR(lock_table(sess, table, LOCK_X));
+
+    return zone_map_create(table, column_ids, column_count);
+}
+
+// Encodes the fields of index in row into key, in the same way as the keys of index scan:
+// integers by value, other columns by their bytes. A key of unique index with a null field
+// ends with row_id, so it never equals the key of another row.
+// Prefix fields are rejected, as index scan has no recheck of the full value.
+static status_t heap_build_index_key(dict_table_t* table, dict_index_t* index, row_header_t* row,
+    row_id_t row_id, btr_key_t* key)
+{
+    const byte* values[ROW_MAX_COLUMN_COUNT];
+    uint16 lens[ROW_MAX_COLUMN_COUNT];
+    uint16 column_count = 0;
+    bool32 has_null = FALSE;
+
+    for (uint32 i = 0; i < index->field_count; i++) {
+        dict_col_t* col = table->columns[index->fields[i].col_ind];
+        if (col->is_ext || col->mtype == DATA_FLOAT || col->mtype == DATA_DOUBLE || col->mtype == DATA_REAL) {
+            CM_SET_ERROR(ERR_UNSUPPORTED, "index key column type");
+            return CM_ERROR;
+        }
+        if (index->fields[i].prefix_len > 0) {
+            CM_SET_ERROR(ERR_UNSUPPORTED, "index prefix column");
+            return CM_ERROR;
+        }
+        column_count = ut_max(column_count, index->fields[i].col_ind + 1);
+    }
+
+    if (!heap_filter_decode_row(table, row, column_count, values, lens)) {
+        LOGGER_ERROR(LOGGER, LOG_MODULE_HEAP,
+            "heap_build_index_key: invalid row, table %s row size %u", table->name, row->size);
+        CM_SET_ERROR(ERR_UNSUPPORTED, "row format");
+        return CM_ERROR;
+    }
+
+    btr_key_init(key);
+    for (uint32 i = 0; i < index->field_count; i++) {
+        const dict_field_t* field = &index->fields[i];
+        dict_col_t* col = table->columns[field->col_ind];
+        uint16 len = lens[field->col_ind];
+        int64 value;
+
+        if (len == REC_NULL_VALUE_LEN) {
+            btr_key_put_null(key);
+            has_null = TRUE;
+        } else if (heap_filter_col_fixed_len(col) > 0 && heap_filter_read_int(values[field->col_ind], len, col->is_unsigned, &value)) {
+            if (col->is_unsigned) {
+                btr_key_put_uint(key, (uint64)value);
+            } else {
+                btr_key_put_int(key, value);
+            }
+        } else {
+            btr_key_put_bytes(key, values[field->col_ind], len);
+        }
+    }
+    if ((index->type & DICT_UNIQUE) && has_null) {
+        btr_key_put_uint(key, row_id.id);
+    }
+
+    if (key->is_overflow) {
+        CM_SET_ERROR(ERR_ROW_RECORD_TOO_BIG, BTR_KEY_MAX_LEN);
+        return CM_ERROR;
+    }
+
+    return CM_SUCCESS;
+}
+
+typedef struct st_heap_index_check {
+    que_sess_t*   sess;
+    dict_table_t* table;
+    dict_index_t* index;
+} heap_index_check_t;
+
+// Asked by btr_insert for the row of a record with the same key of unique index,
+// the heap page is latched under the latch of leaf, heap pages are never latched before index pages.
+// A row deleted by a committed trx or by the trx of session does not exist any more,
+// nor does a row whose slot is free or reused with another key.
+static bool32 heap_index_row_exists(void* arg, const byte* key, uint32 key_len, uint64 value)
+{
+    heap_index_check_t* check = (heap_index_check_t*)arg;
+    trx_status_t trx_status;
+    btr_key_t row_key;
+    bool32 exists = TRUE;
+    row_id_t row_id;
+    mtr_t mtr;
+
+    row_id.id = value;
+
+    mtr_start(&mtr);
+
+    const page_id_t page_id(row_id.space_id, row_id.page_no);
+    const page_size_t page_size(row_id.space_id);
+    buf_block_t* block = buf_page_get(page_id, page_size, RW_S_LATCH, &mtr);
+    page_t* page = buf_block_get_frame(block);
+
+    row_dir_t* dir = heap_get_dir(page, (uint32)row_id.slot);
+    row_header_t* row = dir->is_free ? NULL : HEAP_GET_ROW(page, dir);
+    if (row == NULL) {
+        exists = FALSE;
+    } else if (row->is_migrate) {
+        // the row is moved to another page, it is handled as existing
+        exists = TRUE;
+    } else if (heap_build_index_key(check->table, check->index, row, row_id, &row_key) == CM_SUCCESS &&
+        (row_key.len != key_len || memcmp(row_key.data, key, key_len) != 0)) {
+        exists = FALSE;
+    } else if (row->is_deleted) {
+        if (row->itl_id == HEAP_INVALID_ITL_ID) {
+            exists = FALSE;
+        } else {
+            itl_t* itl = heap_get_itl(page, row->itl_id);
+            trx_get_status_by_itl(itl->trx_slot_id, &trx_status);
+            exists = trx_status.status != XACT_END && itl->trx_slot_id.id != check->sess->trx->trx_slot_id.id;
+        }
+    }
+
+    mtr_commit(&mtr);
+
+    return exists;
+}
+
+// Inserts the keys of row into all indexes of table, called after the heap page of row is released.
+// Keys of deleted rows are kept in indexes for older snapshots, so a delete changes no index.
+static status_t heap_insert_index_entries(que_sess_t* sess, dict_table_t* table, row_header_t* row, row_id_t row_id)
+{
+    heap_index_check_t check;
+    btr_key_t key;
+
+    check.sess = sess;
+    check.table = table;
+
+    dict_index_t* index = UT_LIST_GET_FIRST(table->indexes);
+    while (index) {
+        check.index = index;
+        CM_RETURN_IF_ERROR(heap_build_index_key(table, index, row, row_id, &key));
+        CM_RETURN_IF_ERROR(btr_insert(index, key.data, key.len, row_id.id, heap_index_row_exists, &check));
+
+        index = UT_LIST_GET_NEXT(list_node, index);
+    }
+
+    return CM_SUCCESS;
+}
+
+// Removes the keys of an inserted row by rollback, a key taken over by another row is kept
+static void heap_delete_index_entries(dict_table_t* table, row_header_t* row, row_id_t row_id)
+{
+    btr_key_t key;
+
+    dict_index_t* index = UT_LIST_GET_FIRST(table->indexes);
+    while (index) {
+        // a key which can not be built was never inserted
+        if (heap_build_index_key(table, index, row, row_id, &key) == CM_SUCCESS) {
+            btr_delete(index, key.data, key.len, row_id.id);
+        }
+
+        index = UT_LIST_GET_NEXT(list_node, index);
+    }
+}
+
+// Builds the empty tree of index from the rows visible to cursor, rows are read by a parallel scan
+// and the keys are sorted before the tree is built bottom-up.
+// It is a ddl, the table is locked in X mode until the trx of sess ends.
+status_t heap_build_index(que_sess_t* sess, scan_cursor_t* cursor, dict_index_t* index, uint32 worker_count)
+{
+    btr_bulk_t bulk;
+    btr_key_t key;
+    status_t err;
+
+    // dml waits for the lock, so no row is changed behind the scan
+    trx_start_if_not_started(sess);
+    CM_RETURN_IF_ERROR(lock_table(sess, cursor->table, LOCK_X));
+
+    CM_RETURN_IF_ERROR(btr_bulk_begin(&bulk, index));
+
+    err = heap_parallel_scan_begin(sess, cursor, worker_count);
+    while (err == CM_SUCCESS) {
+        err = heap_parallel_scan_fetch(sess, cursor);
+        if (err != CM_SUCCESS || cursor->is_eof) {
+            break;
+        }
+        err = heap_build_index_key(cursor->table, index, cursor->row, cursor->row_id, &key);
+        if (err == CM_SUCCESS) {
+            err = btr_bulk_add(&bulk, key.data, key.len, cursor->row_id.id);
+        }
+    }
+    heap_parallel_scan_end(sess, cursor);
+
+    if (err == CM_SUCCESS) {
+        err = btr_bulk_finish(&bulk);
+    }
+    btr_bulk_end(&bulk);
+
+    return err;
+}
+
 static status_t heap_get_row(que_sess_t* sess, scan_cursor_t* cursor, page_t* page, bool32 *is_found)
 {
     trx_status_t trx_status;
@@ -1169,7 +2109,8 @@ static status_t heap_get_row(que_sess_t* sess, scan_cursor_t* cursor, page_t* pa
 
     if (trx_status.status == XACT_END) {
         if (trx_status.scn <= cursor->query_scn) {
-            *is_found = !row->is_deleted;
+            // filter is evaluated on page, rejected rows are never copied
+            *is_found = !row->is_deleted && heap_match_filter(cursor, row);
             if (*is_found) {
                 cursor->row_dir = dir;
                 memcpy(cursor->row, row, row->size);
@@ -1184,7 +2125,7 @@ static status_t heap_get_row(que_sess_t* sess, scan_cursor_t* cursor, page_t* pa
         // same transaction
         if (itl->trx_slot_id == sess->trx->trx_slot_id) {
             if (dir->scn < sess->cid) {
-                *is_found = !(row->is_deleted);
+                *is_found = !(row->is_deleted) && heap_match_filter(cursor, row);
                 if (*is_found) {
                     cursor->row_dir = dir;
                     memcpy(cursor->row, row, row->size);
@@ -1207,7 +2148,12 @@ static status_t heap_get_row(que_sess_t* sess, scan_cursor_t* cursor, page_t* pa
     // Fetch a previous version of the row if the current one is not visible in the snapshot
     cursor->row_dir = dir;
     memcpy(cursor->row, row, row->size);
-    return heap_row_build_rcr_version(sess, cursor, is_found);
+    CM_RETURN_IF_ERROR(heap_row_build_rcr_version(sess, cursor, cursor->row, is_found));
+    if (*is_found) {
+        *is_found = heap_match_filter(cursor, cursor->row);
+    }
+
+    return CM_SUCCESS;
 }
 
 static status_t heap_scan_full_page(que_sess_t* sess, scan_cursor_t* cursor, bool32 *is_found)
@@ -1256,15 +2202,153 @@ static status_t heap_scan_full_page(que_sess_t* sess, scan_cursor_t* cursor, boo
     return CM_ERROR;
 }
 
-static status_t heap_read_page_to_cache(que_sess_t* sess, scan_cursor_t* cursor, scn_t* query_scn)
+// Rows changed by the transaction of session are read from the page itself
+static bool32 heap_page_has_own_itl(que_sess_t* sess, page_t* page)
 {
-    status_t err;
-    
-    mtr_t init_mtr, *mtr = &init_mtr;
+    uint16 itl_count = mach_read_from_2(page + HEAP_HEADER_OFFSET + HEAP_HEADER_ITLS);
 
-    mtr_start(mtr);
+    for (uint16 i = 0; i < itl_count; i++) {
+        itl_t* itl = heap_get_itl(page, (uint8)i);
+        if (itl->is_active && itl->trx_slot_id.id == sess->trx->trx_slot_id.id) {
+            return TRUE;
+        }
+    }
 
-    const page_id_t page_id;
+    return FALSE;
+}
+
+// Turns the copy of page into the consistent read image for the snapshot of cursor:
+// invisible rows are freed and the versions rebuilt from undo are appended to free space,
+// their dirs point to the versions as committed rows. The image is valid for snapshots
+// in [low_scn, query_scn], it is not built if no row is rebuilt or the page has no room.
+static status_t heap_build_cr_page(que_sess_t* sess, scan_cursor_t* cursor, page_t* image,
+    uint64* low_scn, bool32* is_built)
+{
+    heap_page_header_t* page_hdr = image + HEAP_HEADER_OFFSET;
+    uint16 dir_count = mach_read_from_2(page_hdr + HEAP_HEADER_DIRS);
+    uint16 lower = mach_read_from_2(page_hdr + HEAP_HEADER_LOWER);
+    uint16 upper = mach_read_from_2(page_hdr + HEAP_HEADER_UPPER);
+    row_id_t row_id = cursor->row_id;
+    uint32 rebuilt_count = 0;
+    bool32 is_aborted = FALSE;
+    trx_status_t trx_status;
+    status_t err = CM_SUCCESS;
+
+    *low_scn = 0;
+    *is_built = FALSE;
+
+    for (uint16 slot = 0; slot < dir_count && !is_aborted; slot++) {
+        row_dir_t* dir = heap_get_dir(image, slot);
+        if (dir->is_free) {
+            continue;
+        }
+        row_header_t* row = HEAP_GET_ROW(image, dir);
+        if (row->is_migrate) {
+            continue;
+        }
+
+        if (row->itl_id == HEAP_INVALID_ITL_ID) {
+            trx_status.status = XACT_END;
+            trx_status.is_ow_scn = (uint8)dir->is_ow_scn;
+            trx_status.scn = dir->scn;
+        } else {
+            trx_get_status_by_itl(heap_get_itl(image, row->itl_id)->trx_slot_id, &trx_status);
+        }
+
+        if (trx_status.status == XACT_END && trx_status.scn <= cursor->query_scn) {
+            *low_scn = ut_max(*low_scn, trx_status.scn);
+            continue;
+        }
+        // snapshot too old and xa wait are left to the row by row reading
+        if ((trx_status.status == XACT_END && trx_status.is_ow_scn) ||
+            trx_status.status == XACT_XA_PREPARE || trx_status.status == XACT_XA_ROLLBACK) {
+            is_aborted = TRUE;
+            continue;
+        }
+
+        bool32 is_found = FALSE;
+        cursor->row_id.slot = slot;
+        cursor->row_dir = *dir;
+        memcpy(cursor->row, row, row->size);
+        err = heap_row_build_rcr_version(sess, cursor, cursor->row, &is_found);
+        if (err != CM_SUCCESS) {
+            is_aborted = TRUE;
+            continue;
+        }
+        rebuilt_count++;
+
+        if (!is_found) {
+            dir->is_free = 1;
+            continue;
+        }
+        if (lower + cursor->row->size > upper) {
+            is_aborted = TRUE;
+            continue;
+        }
+        memcpy(image + lower, cursor->row, cursor->row->size);
+        ((row_header_t *)(image + lower))->itl_id = HEAP_INVALID_ITL_ID;
+        dir->offset = lower;
+        dir->scn = cursor->row_dir.scn;
+        dir->is_ow_scn = 0;
+        *low_scn = ut_max(*low_scn, cursor->row_dir.scn);
+        lower += cursor->row->size;
+    }
+
+    cursor->row_id = row_id;
+    if (!is_aborted && rebuilt_count > 0) {
+        mach_write_to_2(page_hdr + HEAP_HEADER_LOWER, lower);
+        *is_built = TRUE;
+    }
+
+    return err;
+}
+
+// Replaces the copy of page in cursor by the consistent read image cached in buffer pool,
+// or builds and caches the image if some rows of the copy are not visible to the snapshot.
+// The newest modification lsn of page is part of key, a changed page never hits stale images.
+// A page never modified since it is read from disk has lsn 0, it is not cached.
+static status_t heap_read_cr_page(que_sess_t* sess, scan_cursor_t* cursor,
+    const page_id_t& page_id, uint32 size, lsn_t lsn)
+{
+    page_t* page = (page_t *)cursor->cache_page_buf;
+    uint64 low_scn;
+    bool32 is_built;
+
+    if (srv_cr_pages_per_instance == 0 || lsn == 0 ||
+        mach_read_from_2(page + FIL_PAGE_TYPE) != FIL_PAGE_TYPE_HEAP || heap_page_has_own_itl(sess, page)) {
+        return CM_SUCCESS;
+    }
+    if (buf_cr_page_get(page_id, lsn, cursor->query_scn, page, size)) {
+        return CM_SUCCESS;
+    }
+
+    CM_SAVE_STACK(&sess->stack);
+    page_t* image = (page_t *)cm_stack_push(&sess->stack, size);
+    if (image == NULL) {
+        CM_RESTORE_STACK(&sess->stack);
+        return CM_SUCCESS;
+    }
+    memcpy(image, page, size);
+
+    status_t err = heap_build_cr_page(sess, cursor, image, &low_scn, &is_built);
+    if (err == CM_SUCCESS && is_built) {
+        buf_cr_page_put(page_id, lsn, low_scn, cursor->query_scn, image, size);
+        memcpy(page, image, size);
+    }
+    CM_RESTORE_STACK(&sess->stack);
+
+    return err;
+}
+
+static status_t heap_read_page_to_cache(que_sess_t* sess, scan_cursor_t* cursor)
+{
+    status_t err;
+    
+    mtr_t init_mtr, *mtr = &init_mtr;
+
+    mtr_start(mtr);
+
+    const page_id_t page_id;
     err = heap_get_page_id_by_row_id(page_id, cursor->row_id);
     CM_RETURN_IF_ERROR(err);
 
@@ -1275,9 +2359,14 @@ static status_t heap_read_page_to_cache(que_sess_t* sess, scan_cursor_t* cursor,
     }
 
     memcpy(cursor->cache_page_buf, buf_block_get_frame(block), page_size.physical());
+    lsn_t lsn = block->page.newest_modification;
 
     mtr_commit(mtr);
 
+    if (cursor->action == CURSOR_ACTION_SELECT) {
+        return heap_read_cr_page(sess, cursor, page_id, page_size.physical(), lsn);
+    }
+
     return CM_SUCCESS;
 }
 
@@ -1308,212 +2397,958 @@ struct TABLE_SHARE {
 
     uint16 row_buff_length{0};   /* Size of table->record[] buffer */
 
-    byte* default_row_values{NULL};      /* row with default values */
+    byte* default_row_values{NULL};      /* row with default values */
+
+};
+
+void a()
+{
+      if (!(record = (uchar *)share->mem_root.Alloc(rec_buff_length)))
+    goto err; /* purecov: inspected */
+  share->default_values = record;
+}
+
+// Moves serial scan over the pages of extents whose zone map rules out the filter of cursor,
+// only the next page pointer of a skipped page is read. Called when cursor is before a page.
+static status_t heap_skip_pruned_pages(scan_cursor_t* cursor)
+{
+    dict_table_t* table = cursor->table;
+    mtr_t mtr;
+
+    if (cursor->filter == NULL || table->zone_map_page_no == FIL_NULL) {
+        return CM_SUCCESS;
+    }
+
+    while (!HEAP_PAGE_INVALID_ROWID(cursor->row_id) && cursor->row_id.slot == HEAP_PAGE_INVALID_SLOT) {
+        uint32 extent_no = cursor->row_id.page_no / FSP_EXTENT_SIZE;
+        if (extent_no != cursor->zone_extent_no) {
+            cursor->zone_extent_match = heap_zone_map_may_match(table, cursor->filter, cursor->row_id.page_no);
+            cursor->zone_extent_no = extent_no;
+        }
+        if (cursor->zone_extent_match) {
+            break;
+        }
+
+        mtr_start(&mtr);
+        const page_id_t page_id;
+        heap_get_page_id_by_row_id(cursor->row_id, page_id);
+        const page_size_t page_size(page_id.get_space_id());
+        buf_block_t* block = buf_page_get(page_id, page_size, RW_S_LATCH, &mtr);
+        if (block == NULL) {
+            mtr_commit(&mtr);
+            return CM_ERROR;
+        }
+        cursor->row_id.page_no = block->get_next_page_no();
+        cursor->row_id.slot = HEAP_PAGE_INVALID_SLOT;
+        mtr_commit(&mtr);
+    }
+
+    return CM_SUCCESS;
+}
+
+static status_t heap_fetch_by_page(que_sess_t* sess, scan_cursor_t* cursor, bool32 *is_found)
+{
+    status_t err;
+
+retry_fetch:
+
+    if (cursor->action == CURSOR_ACTION_SELECT) {
+        *is_found = FALSE;
+        CM_RETURN_IF_ERROR(heap_skip_pruned_pages(cursor));
+        if (HEAP_PAGE_INVALID_ROWID(cursor->row_id)) {
+            return CM_SUCCESS;
+        }
+
+        if (heap_page_cached_invalid(sess, cursor)) {
+            err = heap_read_page_to_cache(sess, cursor);
+            CM_RETURN_IF_ERROR(err);
+        }
+
+        if (heap_scan_full_page(sess, cursor, is_found) != CM_SUCCESS) {
+            return CM_ERROR;
+        }
+
+        if (UNLIKELY(sess->wait_xid.id != TRANSACTION_INVALID_ID)) {
+            //CT_LOG_DEBUG_INF("fetch row begin read wait.");
+            err = sess->wait_transaction_end();
+            CM_RETURN_IF_ERROR(err);
+            goto retry_fetch;
+        }
+    } else {
+
+    }
+
+    return CM_SUCCESS;
+}
+
+
+// Delayed page cleanout for heap
+void heap_cleanout_page(que_sess_t* sess, scan_cursor_t* cursor, dict_table_t* table, row_id_t row_id)
+{
+    heap_t *heap = NULL;
+    heap_page_t *page = NULL;
+    bool32 changed = CT_FALSE;
+    bool32 lock_inuse = CT_FALSE;
+    uint8 owner_list;
+    mtr_t mtr;
+
+    //if (DB_IS_READONLY(sess)) {
+    //    return;
+    //}
+
+    // may be called during rollback, already in atmatic operation
+    //if (session->atomic_op) {
+    //    return;
+    //}
+
+    mtr_start(&mtr);
+
+    // for delay cleaning page, test the table is locked or not, and try to locking
+    // if table is locked by ddl/dcl(include truncate table) or dc invalidated, return FALSE immediate
+    //if (!lock_table_without_xact(session, cursor->dc_entity, &lock_inuse)) {
+    //    cm_reset_error();
+    //    return;
+    //}
+
+    // get block by row_id
+    // get block by row_id
+    const page_id_t page_id(row_id.space_id, row_id.page_no);
+    const page_size_t page_size(row_id.space_id);
+    buf_block_t* block = buf_page_get(page_id, page_size, RW_X_LATCH, &mtr);
+    ut_ad(block->get_page_no() == row_id.page_no);
+    ut_ad(block->get_page_type() == FIL_PAGE_TYPE_HEAP);
+    //buf_block_dbg_add_level(block, SYNC_DICT_HEADER);
+
+    page_t* page = buf_block_get_frame(block);
+
+    //heap_cleanout_itls(sess, cursor, page, &changed, &mtr);
+
+    // change catagory of page
+    uint16 avail = heap_get_page_free_space(block);
+    uint8 category = fsm_space_avail_to_category(table, avail);
+    //fsm_recursive_set_catagory(table, search_path, category, &mtr);
+    //heap_try_change_map(session, heap, page_id);
+
+    //unlock_table_without_xact(session, cursor->dc_entity, lock_inuse);
+
+    mtr_commit(&mtr);
+}
+
+
+// retrieve tuple with given tid.
+// tuple->t_self is the TID to fetch.
+// We pin the buffer holding the tuple, fill in the remaining fields of tuple.
+status_t heap_fetch(que_sess_t* sess, scan_cursor_t* cursor)
+{
+    status_t status;
+    row_id_t row_id;
+    dict_table_t* table;
+    //Snapshot snapshot,     HeapTuple tuple, Buffer *userbuf
+
+    //if (IS_DUAL_TABLE(table)) {
+    //    return dual_fetch();
+    //}
+
+    for (;;) {
+        if (HEAP_PAGE_INVALID_ROWID(cursor->row_id)) {
+            cursor->is_found = FALSE;
+            cursor->is_eof = TRUE;
+            return CM_SUCCESS;
+        }
+
+        row_id = cursor->row_id;
+        if (heap_fetch_by_page(sess, cursor, &cursor->is_found) != CM_SUCCESS) {
+            status = CM_ERROR;
+            break;
+        }
+
+#define IS_SAME_PAGID_BY_ROWID(id1, id2) ((id1).page_no == (id2).page_no && (id1).space_id == (id2).space_id)
+
+        if (!IS_SAME_PAGID_BY_ROWID(row_id, cursor->row_id)) {
+            if (sess->is_canceled) {
+                status = CM_ERROR;
+                break;
+            }
+
+            if (sess->is_killed) {
+                status = CM_ERROR;
+                break;
+            }
+            // page cleanout during full page scan
+            if (cursor->is_cleanout) {
+                heap_cleanout_page(sess, cursor, table, row_id);
+                cursor->is_cleanout = FALSE;
+            }
+        }
+
+
+        // rows rejected by pushed down filter are not found
+        if (!cursor->is_found) {
+            continue;
+        }
+
+        if (cursor->action <= CURSOR_ACTION_SELECT) {
+            status = CM_SUCCESS;
+            break;
+        }
+
+        // for update / delete
+        if (heap_lock_row(sess, cursor, &cursor->is_found) != CM_SUCCESS) {
+            status = CM_ERROR;
+            break;
+        }
+
+        if (!cursor->is_found) {
+            continue;
+        }
+        status = CM_SUCCESS;
+        break;
+    }
+
+    return CM_SUCCESS;
+}
+
+
+/*-------------------------------------------------- */
+// batched fetch
+
+// status of transactions of itls, resolved once for all rows of a page
+typedef struct st_heap_itl_status_cache {
+    bool8          is_resolved[HEAP_PAGE_MAX_ITLS];
+    trx_status_t   status[HEAP_PAGE_MAX_ITLS];
+} heap_itl_status_cache_t;
+
+static inline trx_status_t* heap_get_itl_status(heap_itl_status_cache_t* cache,
+    scan_cursor_t* cursor, page_t* page, uint8 itl_id)
+{
+    if (!cache->is_resolved[itl_id]) {
+        itl_t* itl = heap_get_itl(page, itl_id);
+        trx_get_status_by_itl(itl->trx_slot_id, &cache->status[itl_id]);
+        if (itl->is_active && cache->status[itl_id].status == XACT_END) {
+            cursor->is_cleanout = TRUE;
+        }
+        cache->is_resolved[itl_id] = TRUE;
+    }
+
+    return &cache->status[itl_id];
+}
+
+static inline void heap_row_vector_add(heap_row_vector_t* vector, scan_cursor_t* cursor, row_header_t* row)
+{
+    vector->row_ids[vector->count] = cursor->row_id;
+    vector->rows[vector->count] = row;
+    vector->lens[vector->count] = row->size;
+    vector->count++;
+}
+
+// Appends visible rows of the cached page from the slot after cursor->row_id.slot,
+// rows of current version point to the cached page, older versions are copied to vector->buf.
+static status_t heap_fetch_page_rows(que_sess_t* sess, scan_cursor_t* cursor,
+    heap_row_vector_t* vector, heap_itl_status_cache_t* itl_cache)
+{
+    page_t* copy_page = (page_t *)cursor->cache_page_buf;
+    uint32 dir_count = mach_read_from_2(copy_page + HEAP_HEADER_OFFSET + HEAP_HEADER_DIRS);
+    uint32 slot = (cursor->row_id.slot == HEAP_PAGE_INVALID_SLOT) ? 0 : cursor->row_id.slot + 1;
+    trx_status_t end_status, *trx_status;
+    bool32 is_found;
+
+    for (; slot < dir_count && vector->count < vector->max_count; slot++) {
+        row_dir_t* dir = heap_get_dir(copy_page, slot);
+        if (dir->is_free) {
+            continue;
+        }
+        row_header_t* row = HEAP_GET_ROW(copy_page, dir);
+        if (row->is_migrate) {
+            continue;
+        }
+
+        if (row->itl_id == HEAP_INVALID_ITL_ID) {
+            end_status.status = XACT_END;
+            end_status.is_ow_scn = (uint8)dir->is_ow_scn;
+            end_status.scn = dir->scn;
+            trx_status = &end_status;
+        } else {
+            trx_status = heap_get_itl_status(itl_cache, cursor, copy_page, row->itl_id);
+        }
+
+        if (trx_status->status == XACT_END) {
+            if (trx_status->scn <= cursor->query_scn) {
+                cursor->row_id.slot = slot;
+                if (!row->is_deleted && heap_match_filter(cursor, row)) {
+                    heap_row_vector_add(vector, cursor, row);
+                }
+                continue;
+            }
+            if (trx_status->is_ow_scn) {
+                return ERR_SNAPSHOT_TOO_OLD;
+            }
+        } else {
+            itl_t* itl = heap_get_itl(copy_page, row->itl_id);
+            if (itl->trx_slot_id == sess->trx->trx_slot_id && dir->scn < sess->cid) {
+                cursor->row_id.slot = slot;
+                if (!row->is_deleted && heap_match_filter(cursor, row)) {
+                    heap_row_vector_add(vector, cursor, row);
+                }
+                continue;
+            }
+            if (sess->kernel->is_xa_consistency &&
+                (trx_status->status == XACT_XA_PREPARE || trx_status->status == XACT_XA_ROLLBACK) &&
+                trx_status->scn < cursor->query_scn) {
+                // rows before this slot are returned first, the slot is rechecked by next call
+                sess->wait_xid = itl->trx_slot_id;
+                sess->wait_row_id = cursor->row_id;
+                return CM_SUCCESS;
+            }
+        }
+
+        // an older version is needed, reserve space of the row in buffer before rebuilding it
+        if (vector->buf_used + HEAP_ROW_MAX_SIZE > vector->buf_size) {
+            ut_ad(vector->count > 0);
+            return CM_SUCCESS;
+        }
+
+        // the version chain starts from the undo of dir, as heap_get_row does
+        cursor->row_id.slot = slot;
+        cursor->undo_space_index = dir->undo_space_index;
+        cursor->undo_page_no = dir->undo_page_no;
+        cursor->undo_page_offset = dir->undo_page_offset;
+        cursor->row = (row_header_t *)(vector->buf + vector->buf_used);
+        cursor->row_dir = *dir;
+        memcpy(cursor->row, row, row->size);
+        CM_RETURN_IF_ERROR(heap_row_build_rcr_version(sess, cursor, cursor->row, &is_found));
+        if (is_found && heap_match_filter(cursor, cursor->row)) {
+            heap_row_vector_add(vector, cursor, cursor->row);
+            vector->buf_used += ut_align8(cursor->row->size);
+        }
+    }
+
+    if (slot >= dir_count) {
+        cursor->row_id.slot = dir_count > 0 ? dir_count - 1 : HEAP_PAGE_INVALID_SLOT;
+        return heap_row_id_move_to_next_page(copy_page, cursor);
+    }
+
+    return CM_SUCCESS;
+}
+
+// Fills vector with up to vector->max_count visible rows of a page.
+// The rows are valid until next call, cursor->is_eof is set when there is no more row.
+status_t heap_fetch_batch(que_sess_t* sess, scan_cursor_t* cursor, heap_row_vector_t* vector)
+{
+    heap_itl_status_cache_t itl_cache;
+    row_header_t* cursor_row = cursor->row;
+    row_id_t row_id;
+    status_t err = CM_SUCCESS;
+
+    ut_ad(cursor->action == CURSOR_ACTION_SELECT);
+
+    if (vector->buf_size < HEAP_ROW_MAX_SIZE) {
+        LOGGER_ERROR(LOGGER, LOG_MODULE_HEAP,
+            "heap_fetch_batch: row buffer size %u is less than max row size %u",
+            vector->buf_size, (uint32)HEAP_ROW_MAX_SIZE);
+        return CM_ERROR;
+    }
+
+    vector->count = 0;
+    vector->buf_used = 0;
+    cursor->is_found = FALSE;
+
+    while (vector->count == 0) {
+        err = heap_skip_pruned_pages(cursor);
+        if (err != CM_SUCCESS) {
+            break;
+        }
+        if (HEAP_PAGE_INVALID_ROWID(cursor->row_id)) {
+            cursor->is_eof = TRUE;
+            break;
+        }
+        if (sess->is_canceled || sess->is_killed) {
+            err = CM_ERROR;
+            break;
+        }
+
+        // rows in vector point to the cached page, so a batch never crosses pages
+        row_id = cursor->row_id;
+        if (heap_page_cached_invalid(sess, cursor)) {
+            err = heap_read_page_to_cache(sess, cursor);
+            if (err != CM_SUCCESS) {
+                break;
+            }
+        }
+
+        memset(itl_cache.is_resolved, 0, sizeof(itl_cache.is_resolved));
+        err = heap_fetch_page_rows(sess, cursor, vector, &itl_cache);
+        if (err != CM_SUCCESS) {
+            break;
+        }
+
+        if (UNLIKELY(sess->wait_xid.id != TRANSACTION_INVALID_ID)) {
+            if (vector->count > 0) {
+                sess->wait_xid.id = TRANSACTION_INVALID_ID;
+                break;
+            }
+            err = sess->wait_transaction_end();
+            sess->wait_xid.id = TRANSACTION_INVALID_ID;
+            if (err != CM_SUCCESS) {
+                break;
+            }
+            // the prepared transaction is ended, continue from the waiting row
+            continue;
+        }
+
+        if (cursor->is_cleanout && row_id.page_no != cursor->row_id.page_no) {
+            heap_cleanout_page(sess, cursor, cursor->table, row_id);
+            cursor->is_cleanout = FALSE;
+        }
+    }
+
+    cursor->row = cursor_row;
+    cursor->is_found = (vector->count > 0);
+
+    return err;
+}
+
+
+/*-------------------------------------------------- */
+// parallel full table scan
+
+#define HEAP_PSCAN_MAX_WORKERS        32
+#define HEAP_PSCAN_WAIT_US            100000  // 0.1s
+#define HEAP_PSCAN_MTR_MAX_EXTENTS    64
+
+// a page range of heap segment, one extent or one fragment page
+typedef struct st_heap_pscan_range {
+    page_no_t  page_no;
+    uint32     page_count;
+} heap_pscan_range_t;
+
+// header of a row in worker queue, followed by row data
+typedef struct st_heap_pscan_row {
+    row_id_t   row_id;
+    uint32     size;
+} heap_pscan_row_t;
+
+typedef struct st_heap_pscan_worker {
+    heap_parallel_scan_t* pscan;
+    uint32          id;
+    os_thread_t     thread;
+    os_thread_id_t  thread_id;
+    que_sess_t*     sess;
+    scan_cursor_t*  cursor;
+
+    // bounded queue of visible rows, filled by worker and drained by consumer
+    mutex_t         mutex;
+    os_event_t      not_full_event;
+    byte*           rows;
+    uint32          head;
+    uint32          tail;
+    uint32          count;
+    bool32          is_finished;
+    status_t        status;
+
+    uint32          page_count;
+    uint64          row_count;
+} heap_pscan_worker_t;
+
+struct st_heap_parallel_scan {
+    dict_table_t*   table;
+    uint64          query_scn;  // snapshot shared by all workers
+    memory_context_t* mcontext;
+
+    heap_pscan_range_t* ranges;
+    uint32          range_count;
+    uint32          pruned_range_count;  // extents skipped by zone map
+    atomic32_t      next_range;
+
+    uint32          queue_rows;
+    uint32          row_slot_size;
+    os_event_t      consumer_event;  // a queue becomes not empty or a worker is finished
+    volatile bool32 is_aborted;
+
+    uint32          worker_count;
+    uint32          curr_worker;
+    heap_pscan_worker_t workers[HEAP_PSCAN_MAX_WORKERS];
+};
+
+// Collects the pages of heap segment from the fsm root page:
+// the fragment pages of first extent and the extents in FSM_FSEG_FULL list.
+// The list is only appended while the table is in use, so it is walked in several mtr.
+// Extents which can not match filter by zone map are skipped.
+static status_t heap_pscan_collect_ranges(heap_parallel_scan_t* pscan, scan_filter_t* filter)
+{
+    dict_table_t* table = pscan->table;
+    const page_id_t page_id(table->space_id, table->entry_page_no);
+    const page_size_t page_size(table->space_id);
+    fil_addr_t addr;
+    uint32 extent_count, frag_count;
+    mtr_t mtr;
+
+    mtr_start(&mtr);
+
+    buf_block_t* block = buf_page_get(page_id, page_size, RW_S_LATCH, &mtr);
+    if (block == NULL) {
+        mtr_commit(&mtr);
+        return CM_ERROR;
+    }
+    heap_fsm_header_t* header = buf_block_get_frame(block) + FSM_HEADER;
+
+    frag_count = mach_read_from_4(header + FSM_HEAP_PAGE_COUNT);
+    if (frag_count > FSP_EXTENT_SIZE) {
+        frag_count = FSP_EXTENT_SIZE;
+    }
+    extent_count = flst_get_len(header + FSM_FSEG_FULL);
+
+    pscan->ranges = (heap_pscan_range_t *)ut_malloc_zero(
+        sizeof(heap_pscan_range_t) * (frag_count + extent_count + 1));
+    if (pscan->ranges == NULL) {
+        mtr_commit(&mtr);
+        LOGGER_ERROR(LOGGER, LOG_MODULE_HEAP, "heap_parallel_scan: failed to malloc memory");
+        return CM_ERROR;
+    }
+
+    for (uint32 i = 0; i < frag_count; i++) {
+        page_no_t page_no = mach_read_from_4(header + FSM_FSEG_FRAG_ARR + i * FSM_NODE_PAGE_NO_SIZE);
+        if (page_no == FIL_NULL) {
+            continue;
+        }
+        pscan->ranges[pscan->range_count].page_no = page_no;
+        pscan->ranges[pscan->range_count].page_count = 1;
+        pscan->range_count++;
+    }
+
+    addr = flst_get_first(header + FSM_FSEG_FULL, &mtr);
+    for (uint32 i = 0; i < extent_count && !fil_addr_is_null(addr); i++) {
+        if (i > 0 && i % HEAP_PSCAN_MTR_MAX_EXTENTS == 0) {
+            // release latches of descriptor pages
+            mtr_commit(&mtr);
+            mtr_start(&mtr);
+            buf_page_get(page_id, page_size, RW_S_LATCH, &mtr);
+        }
+
+        xdes_t* descr = flst_get_buf_ptr(table->space_id, page_size, addr, RW_S_LATCH, &mtr, NULL) - XDES_FLST_NODE;
+        addr = flst_get_next_addr(descr + XDES_FLST_NODE, &mtr);
+
+        if (!heap_zone_map_may_match(table, filter, xdes_get_offset(descr))) {
+            pscan->pruned_range_count++;
+            continue;
+        }
+        pscan->ranges[pscan->range_count].page_no = xdes_get_offset(descr);
+        pscan->ranges[pscan->range_count].page_count = FSP_EXTENT_SIZE;
+        pscan->range_count++;
+    }
+
+    mtr_commit(&mtr);
+
+    return CM_SUCCESS;
+}
+
+static bool32 heap_pscan_worker_push_row(heap_pscan_worker_t* worker, scan_cursor_t* cursor)
+{
+    heap_parallel_scan_t* pscan = worker->pscan;
+    uint64 signal_count;
+    bool32 is_empty;
+
+    mutex_enter(&worker->mutex, NULL);
+    while (worker->count == pscan->queue_rows) {
+        signal_count = os_event_reset(worker->not_full_event);
+        mutex_exit(&worker->mutex);
+        if (pscan->is_aborted) {
+            return FALSE;
+        }
+        os_event_wait_time(worker->not_full_event, HEAP_PSCAN_WAIT_US, signal_count);
+        mutex_enter(&worker->mutex, NULL);
+    }
+
+    heap_pscan_row_t* row = (heap_pscan_row_t *)(worker->rows + worker->tail * pscan->row_slot_size);
+    row->row_id = cursor->row_id;
+    row->size = cursor->row->size;
+    memcpy((byte *)row + sizeof(heap_pscan_row_t), cursor->row, cursor->row->size);
+    worker->tail = (worker->tail + 1) % pscan->queue_rows;
+    is_empty = (worker->count == 0);
+    worker->count++;
+    mutex_exit(&worker->mutex);
+
+    // consumer only waits when all queues are empty
+    if (is_empty) {
+        os_event_set(pscan->consumer_event);
+    }
+
+    return TRUE;
+}
+
+static status_t heap_pscan_worker_scan_page(heap_pscan_worker_t* worker, page_no_t page_no)
+{
+    heap_parallel_scan_t* pscan = worker->pscan;
+    scan_cursor_t* cursor = worker->cursor;
+    que_sess_t* sess = worker->sess;
+    page_t* copy_page = (page_t *)cursor->cache_page_buf;
+    uint32 dir_count;
+    bool32 is_found;
+
+    cursor->row_id.space_id = pscan->table->space_id;
+    cursor->row_id.page_no = page_no;
+    cursor->row_id.slot = HEAP_PAGE_INVALID_SLOT;
+
+    CM_RETURN_IF_ERROR(heap_read_page_to_cache(sess, cursor));
+    // pages of extent are formatted when they are used by heap for the first time
+    if (mach_read_from_2(copy_page + FIL_PAGE_TYPE) != FIL_PAGE_TYPE_HEAP) {
+        return CM_SUCCESS;
+    }
+    worker->page_count++;
+
+    dir_count = mach_read_from_2(copy_page + HEAP_HEADER_OFFSET + HEAP_HEADER_DIRS);
+    for (uint32 slot = 0; slot < dir_count && !pscan->is_aborted; slot++) {
+        cursor->row_id.slot = slot;
+        CM_RETURN_IF_ERROR(heap_get_row(sess, cursor, copy_page, &is_found));
+
+        if (UNLIKELY(sess->wait_xid.id != TRANSACTION_INVALID_ID)) {
+            // row of a prepared xa transaction, recheck it on a new copy of page
+            CM_RETURN_IF_ERROR(sess->wait_transaction_end());
+            sess->wait_xid.id = TRANSACTION_INVALID_ID;
+            CM_RETURN_IF_ERROR(heap_read_page_to_cache(sess, cursor));
+            dir_count = mach_read_from_2(copy_page + HEAP_HEADER_OFFSET + HEAP_HEADER_DIRS);
+            slot--;
+            continue;
+        }
+
+        if (is_found) {
+            if (!heap_pscan_worker_push_row(worker, cursor)) {
+                break;
+            }
+            worker->row_count++;
+        }
+    }
 
-};
+    if (cursor->is_cleanout) {
+        heap_cleanout_page(sess, cursor, pscan->table, cursor->row_id);
+        cursor->is_cleanout = FALSE;
+    }
 
-void a()
-{
-      if (!(record = (uchar *)share->mem_root.Alloc(rec_buff_length)))
-    goto err; /* purecov: inspected */
-  share->default_values = record;
+    return CM_SUCCESS;
 }
 
-static status_t heap_fetch_by_page(que_sess_t* sess, scan_cursor_t* cursor, bool32 *is_found)
+static void* heap_pscan_worker_thread(void* arg)
 {
-    status_t err;
-
-retry_fetch:
+    heap_pscan_worker_t* worker = (heap_pscan_worker_t *)arg;
+    heap_parallel_scan_t* pscan = worker->pscan;
+    status_t err = CM_SUCCESS;
 
-    if (cursor->action == CURSOR_ACTION_SELECT) {
-        if (heap_page_cached_invalid(sess, cursor)) {
-            err = heap_read_page_to_cache(sess, cursor);
-            CM_RETURN_IF_ERROR(err);
+    while (!pscan->is_aborted && err == CM_SUCCESS) {
+        uint32 range_id = (uint32)atomic32_inc(&pscan->next_range) - 1;
+        if (range_id >= pscan->range_count) {
+            break;
         }
 
-        if (heap_scan_full_page(sess, cursor, is_found) != CM_SUCCESS) {
-            return CM_ERROR;
+        heap_pscan_range_t* range = &pscan->ranges[range_id];
+        for (uint32 i = 0; i < range->page_count && !pscan->is_aborted; i++) {
+            err = heap_pscan_worker_scan_page(worker, range->page_no + i);
+            if (err != CM_SUCCESS) {
+                LOGGER_ERROR(LOGGER, LOG_MODULE_HEAP,
+                    "heap_parallel_scan: worker %u failed to scan page (space id %u, page no %u), error %d",
+                    worker->id, pscan->table->space_id, range->page_no + i, err);
+                pscan->is_aborted = TRUE;
+                break;
+            }
         }
+    }
 
-        if (UNLIKELY(sess->wait_xid.id != TRANSACTION_INVALID_ID)) {
-            //CT_LOG_DEBUG_INF("fetch row begin read wait.");
-            err = sess->wait_transaction_end();
-            CM_RETURN_IF_ERROR(err);
-            goto retry_fetch;
-        }
-    } else {
+    mutex_enter(&worker->mutex, NULL);
+    worker->status = err;
+    worker->is_finished = TRUE;
+    mutex_exit(&worker->mutex);
+    os_event_set(pscan->consumer_event);
+
+    LOGGER_DEBUG(LOGGER, LOG_MODULE_HEAP,
+        "heap_parallel_scan: worker %u finished, scanned %u pages, %llu rows",
+        worker->id, worker->page_count, worker->row_count);
+
+    return NULL;
+}
+
+static status_t heap_pscan_worker_init(que_sess_t* sess, scan_cursor_t* cursor, heap_pscan_worker_t* worker)
+{
+    heap_parallel_scan_t* pscan = worker->pscan;
 
+    mutex_create(&worker->mutex);
+    worker->not_full_event = os_event_create(NULL);
+    worker->rows = (byte *)ut_malloc_zero(pscan->queue_rows * pscan->row_slot_size);
+    if (worker->rows == NULL) {
+        return CM_ERROR;
+    }
+
+    // worker session sees the rows of caller's transaction as caller does
+    worker->sess = que_sess_alloc();
+    if (worker->sess == NULL) {
+        return CM_ERROR;
+    }
+    worker->sess->kernel = sess->kernel;
+    worker->sess->trx = sess->trx;
+    worker->sess->cid = sess->cid;
+    worker->sess->wait_xid.id = TRANSACTION_INVALID_ID;
+
+    worker->cursor = New(pscan->mcontext) scan_cursor_t(worker->sess->mcontext_stack);
+    worker->cursor->table = pscan->table;
+    worker->cursor->trx = cursor->trx;
+    worker->cursor->query_scn = pscan->query_scn;
+    worker->cursor->isolevel = cursor->isolevel;
+    worker->cursor->action = CURSOR_ACTION_SELECT;
+    worker->cursor->is_cleanout = FALSE;
+    worker->cursor->filter = cursor->filter;
+    worker->cursor->cache_page_buf = (char *)my_malloc(pscan->mcontext, UNIV_PAGE_SIZE);
+    worker->cursor->row = (row_header_t *)my_malloc(pscan->mcontext, HEAP_ROW_MAX_SIZE);
+    if (worker->cursor->cache_page_buf == NULL || worker->cursor->row == NULL) {
+        return CM_ERROR;
     }
 
     return CM_SUCCESS;
 }
 
+static void heap_pscan_worker_destroy(heap_pscan_worker_t* worker)
+{
+    if (worker->cursor) {
+        delete worker->cursor;
+        worker->cursor = NULL;
+    }
+    if (worker->sess) {
+        worker->sess->trx = NULL;
+        que_sess_free(worker->sess);
+        worker->sess = NULL;
+    }
+    if (worker->rows) {
+        ut_free(worker->rows);
+        worker->rows = NULL;
+    }
+    if (worker->not_full_event) {
+        os_event_destroy(worker->not_full_event);
+        worker->not_full_event = NULL;
+    }
+    mutex_destroy(&worker->mutex);
+}
 
-// Delayed page cleanout for heap
-void heap_cleanout_page(que_sess_t* sess, scan_cursor_t* cursor, dict_table_t* table, row_id_t row_id)
+// Splits the heap segment into page ranges which are taken by workers one by one,
+// visible rows of the snapshot of cursor are sent back to cursor by per-worker queues.
+status_t heap_parallel_scan_begin(que_sess_t* sess, scan_cursor_t* cursor, uint32 worker_count)
 {
-    heap_t *heap = NULL;
-    heap_page_t *page = NULL;
-    bool32 changed = CT_FALSE;
-    bool32 lock_inuse = CT_FALSE;
-    uint8 owner_list;
-    mtr_t mtr;
+    heap_parallel_scan_t* pscan;
 
-    //if (DB_IS_READONLY(sess)) {
-    //    return;
-    //}
+    ut_a(cursor->pscan == NULL);
 
-    // may be called during rollback, already in atmatic operation
-    //if (session->atomic_op) {
-    //    return;
-    //}
+    if (worker_count == 0) {
+        worker_count = 1;
+    } else if (worker_count > HEAP_PSCAN_MAX_WORKERS) {
+        worker_count = HEAP_PSCAN_MAX_WORKERS;
+    }
 
-    mtr_start(&mtr);
+    pscan = (heap_parallel_scan_t *)ut_malloc_zero(sizeof(heap_parallel_scan_t));
+    if (pscan == NULL) {
+        LOGGER_ERROR(LOGGER, LOG_MODULE_HEAP, "heap_parallel_scan: failed to malloc memory");
+        return CM_ERROR;
+    }
+    pscan->table = cursor->table;
+    pscan->query_scn = cursor->query_scn;
+    pscan->queue_rows = srv_parallel_scan_queue_rows > 0 ? srv_parallel_scan_queue_rows : 1;
+    pscan->row_slot_size = ut_align8(sizeof(heap_pscan_row_t) + HEAP_ROW_MAX_SIZE);
+    pscan->consumer_event = os_event_create(NULL);
+    cursor->pscan = pscan;
+
+    pscan->mcontext = mcontext_create(srv_common_mpool);
+    if (pscan->mcontext == NULL) {
+        goto err_exit;
+    }
 
-    // for delay cleaning page, test the table is locked or not, and try to locking
-    // if table is locked by ddl/dcl(include truncate table) or dc invalidated, return FALSE immediate
-    //if (!lock_table_without_xact(session, cursor->dc_entity, &lock_inuse)) {
-    //    cm_reset_error();
-    //    return;
-    //}
+    zone_map_load(pscan->table);
+    if (heap_pscan_collect_ranges(pscan, cursor->filter) != CM_SUCCESS) {
+        goto err_exit;
+    }
+    if (worker_count > pscan->range_count) {
+        worker_count = pscan->range_count > 0 ? pscan->range_count : 1;
+    }
 
-    // get block by row_id
-    // get block by row_id
-    const page_id_t page_id(row_id.space_id, row_id.page_no);
-    const page_size_t page_size(row_id.space_id);
-    buf_block_t* block = buf_page_get(page_id, page_size, RW_X_LATCH, &mtr);
-    ut_ad(block->get_page_no() == row_id.page_no);
-    ut_ad(block->get_page_type() == FIL_PAGE_TYPE_HEAP);
-    //buf_block_dbg_add_level(block, SYNC_DICT_HEADER);
+    for (uint32 i = 0; i < worker_count; i++) {
+        heap_pscan_worker_t* worker = &pscan->workers[i];
+        worker->pscan = pscan;
+        worker->id = i;
+        pscan->worker_count++;
+        if (heap_pscan_worker_init(sess, cursor, worker) != CM_SUCCESS) {
+            LOGGER_ERROR(LOGGER, LOG_MODULE_HEAP, "heap_parallel_scan: failed to initialize worker %u", i);
+            goto err_exit;
+        }
+    }
 
-    page_t* page = buf_block_get_frame(block);
+    for (uint32 i = 0; i < pscan->worker_count; i++) {
+        heap_pscan_worker_t* worker = &pscan->workers[i];
+        worker->thread = os_thread_create(heap_pscan_worker_thread, worker, &worker->thread_id);
+        if (!os_thread_is_valid(worker->thread)) {
+            LOGGER_ERROR(LOGGER, LOG_MODULE_HEAP,
+                "heap_parallel_scan: failed to create thread for worker %u, error %u",
+                i, os_thread_get_last_error());
+            // worker is not started, the ranges are taken by others
+            mutex_enter(&worker->mutex, NULL);
+            worker->is_finished = TRUE;
+            worker->status = (i == 0) ? CM_ERROR : CM_SUCCESS;
+            mutex_exit(&worker->mutex);
+            if (i == 0) {
+                pscan->is_aborted = TRUE;
+            }
+        }
+    }
 
-    //heap_cleanout_itls(sess, cursor, page, &changed, &mtr);
+    LOGGER_DEBUG(LOGGER, LOG_MODULE_HEAP,
+        "heap_parallel_scan: table %s, %u page ranges, %u extents pruned by zone map, %u workers, query scn %llu",
+        pscan->table->name, pscan->range_count, pscan->pruned_range_count, pscan->worker_count, pscan->query_scn);
 
-    // change catagory of page
-    uint16 avail = heap_get_page_free_space(block);
-    uint8 category = fsm_space_avail_to_category(table, avail);
-    //fsm_recursive_set_catagory(table, search_path, category, &mtr);
-    //heap_try_change_map(session, heap, page_id);
+    return CM_SUCCESS;
 
-    //unlock_table_without_xact(session, cursor->dc_entity, lock_inuse);
+err_exit:
 
-    mtr_commit(&mtr);
-}
+    heap_parallel_scan_end(sess, cursor);
 
+    return CM_ERROR;
+}
 
-// retrieve tuple with given tid.
-// tuple->t_self is the TID to fetch.
-// We pin the buffer holding the tuple, fill in the remaining fields of tuple.
-status_t heap_fetch(que_sess_t* sess, scan_cursor_t* cursor)
+// Returns next visible row in cursor->row, rows are taken from worker queues in turn
+status_t heap_parallel_scan_fetch(que_sess_t* sess, scan_cursor_t* cursor)
 {
-    status_t status;
-    row_id_t row_id;
-    dict_table_t* table;
-    //Snapshot snapshot,     HeapTuple tuple, Buffer *userbuf
+    heap_parallel_scan_t* pscan = cursor->pscan;
+    uint64 signal_count;
 
-    //if (IS_DUAL_TABLE(table)) {
-    //    return dual_fetch();
-    //}
+    ut_ad(pscan);
 
     for (;;) {
-        if (HEAP_PAGE_INVALID_ROWID(cursor->row_id)) {
-            cursor->is_found = FALSE;
-            cursor->is_eof = TRUE;
-            return CM_SUCCESS;
-        }
+        uint32 finished_count = 0;
 
-        row_id = cursor->row_id;
-        if (heap_fetch_by_page(sess, cursor, &cursor->is_found) != CM_SUCCESS) {
-            status = CM_ERROR;
-            break;
-        }
+        signal_count = os_event_reset(pscan->consumer_event);
 
-#define IS_SAME_PAGID_BY_ROWID(id1, id2) ((id1).page_no == (id2).page_no && (id1).space_id == (id2).space_id)
+        for (uint32 i = 0; i < pscan->worker_count; i++) {
+            heap_pscan_worker_t* worker = &pscan->workers[(pscan->curr_worker + i) % pscan->worker_count];
 
-        if (!IS_SAME_PAGID_BY_ROWID(row_id, cursor->row_id)) {
-            if (sess->is_canceled) {
-                status = CM_ERROR;
-                break;
-            }
+            mutex_enter(&worker->mutex, NULL);
+            if (worker->count > 0) {
+                heap_pscan_row_t* row = (heap_pscan_row_t *)(worker->rows + worker->head * pscan->row_slot_size);
+                cursor->row_id = row->row_id;
+                memcpy(cursor->row, (byte *)row + sizeof(heap_pscan_row_t), row->size);
+                worker->head = (worker->head + 1) % pscan->queue_rows;
+                if (worker->count == pscan->queue_rows) {
+                    os_event_set(worker->not_full_event);
+                }
+                worker->count--;
+                mutex_exit(&worker->mutex);
 
-            if (sess->is_killed) {
-                status = CM_ERROR;
-                break;
+                // keep draining the same queue, it is likely to have more rows
+                pscan->curr_worker = (pscan->curr_worker + i) % pscan->worker_count;
+                cursor->is_found = TRUE;
+                cursor->is_eof = FALSE;
+                return CM_SUCCESS;
             }
-            // page cleanout during full page scan
-            if (cursor->is_cleanout) {
-                heap_cleanout_page(sess, cursor, table, row_id);
-                cursor->is_cleanout = FALSE;
+            if (worker->is_finished) {
+                if (worker->status != CM_SUCCESS) {
+                    mutex_exit(&worker->mutex);
+                    return worker->status;
+                }
+                finished_count++;
             }
+            mutex_exit(&worker->mutex);
         }
 
-
-        if (!cursor->is_found) {
-            continue;
-        }
-
-        //if (knl_match_cond(session, cursor, &cursor->is_found) != CM_SUCCESS) {
-        //    status = CM_ERROR;
-        //    break;
-        //}
-
-        if (!cursor->is_found) {
-            continue;
-        }
-
-        if (cursor->action <= CURSOR_ACTION_SELECT) {
-            status = CM_SUCCESS;
-            break;
+        if (finished_count == pscan->worker_count) {
+            cursor->is_found = FALSE;
+            cursor->is_eof = TRUE;
+            return CM_SUCCESS;
         }
 
-        // for update / delete
-        if (heap_lock_row(sess, cursor, &cursor->is_found) != CM_SUCCESS) {
-            status = CM_ERROR;
-            break;
+        if (sess->is_canceled || sess->is_killed) {
+            return CM_ERROR;
         }
 
-        if (!cursor->is_found) {
-            continue;
-        }
-        status = CM_SUCCESS;
-        break;
+        os_event_wait_time(pscan->consumer_event, HEAP_PSCAN_WAIT_US, signal_count);
     }
 
     return CM_SUCCESS;
 }
 
-
-status_t knl_match_cond(que_sess_t* sess, scan_cursor_t* cursor, bool32* matched)
+// Stops workers if scan is not finished and releases all resources of parallel scan
+void heap_parallel_scan_end(que_sess_t* sess, scan_cursor_t* cursor)
 {
-    knl_match_cond_t match_push_cond = NULL;
-    knl_session_t *se = (knl_session_t *)session;
+    heap_parallel_scan_t* pscan = cursor->pscan;
 
-    if (IS_INDEX_ONLY_SCAN(cursor)) {
-        idx_decode_row(se, cursor, cursor->offsets, cursor->lens, &cursor->data_size);
-        cursor->decode_cln_total = ((index_t *)cursor->index)->desc.column_count;
-    } else {
-        cm_decode_row_ex((char *)cursor->row, cursor->offsets, cursor->lens, cursor->decode_count, &cursor->data_size,
-                         &cursor->decode_cln_total);
+    if (pscan == NULL) {
+        return;
     }
 
-    match_cond = se->match_cond;
+    pscan->is_aborted = TRUE;
+    for (uint32 i = 0; i < pscan->worker_count; i++) {
+        heap_pscan_worker_t* worker = &pscan->workers[i];
+        if (worker->not_full_event) {
+            os_event_set(worker->not_full_event);
+        }
+        if (worker->thread && os_thread_is_valid(worker->thread)) {
+            os_thread_join(worker->thread);
+        }
+    }
 
-    if (cursor->stmt == NULL || match_cond == NULL) {
-        *matched = CT_TRUE;
-        return CT_SUCCESS;
+    for (uint32 i = 0; i < pscan->worker_count; i++) {
+        heap_pscan_worker_destroy(&pscan->workers[i]);
     }
 
+    if (pscan->consumer_event) {
+        os_event_destroy(pscan->consumer_event);
+    }
+    if (pscan->ranges) {
+        ut_free(pscan->ranges);
+    }
+    if (pscan->mcontext) {
+        mcontext_destroy(pscan->mcontext);
+    }
+    ut_free(pscan);
 
-    ExecReadyInterpretedExpr
+    cursor->pscan = NULL;
+}
 
 
-    return match_cond(cursor->stmt, matched);
+// Evaluates pushed down filter of cursor on current row
+status_t knl_match_cond(que_sess_t* sess, scan_cursor_t* cursor, bool32* matched)
+{
+    *matched = heap_match_filter(cursor, cursor->row);
+    return CM_SUCCESS;
 }
 
 
-status_t heap_fetch_by_rowid(que_sess_t* session, scan_cursor_t* cursor)
+// Fetches the row of an index record at cursor->row_id into cursor->row. Records of deleted rows
+// and old keys are kept in tree, so the row is found only if its version visible to cursor
+// has the key of record.
+status_t heap_fetch_by_rowid(que_sess_t* sess, scan_cursor_t* cursor, const byte* key, uint32 key_len,
+    bool32* is_found)
 {
+    page_t* copy_page = (page_t *)cursor->cache_page_buf;
+    btr_key_t row_key;
+
+    *is_found = FALSE;
+
+    for (;;) {
+        CM_RETURN_IF_ERROR(heap_read_page_to_cache(sess, cursor));
+        if (mach_read_from_2(copy_page + FIL_PAGE_TYPE) != FIL_PAGE_TYPE_HEAP ||
+            cursor->row_id.slot >= mach_read_from_2(copy_page + HEAP_HEADER_OFFSET + HEAP_HEADER_DIRS)) {
+            return CM_SUCCESS;
+        }
+
+        CM_RETURN_IF_ERROR(heap_get_row(sess, cursor, copy_page, is_found));
+        if (LIKELY(sess->wait_xid.id == TRANSACTION_INVALID_ID)) {
+            break;
+        }
+        // row of a prepared xa transaction, recheck it on a new copy of page
+        CM_RETURN_IF_ERROR(sess->wait_transaction_end());
+        sess->wait_xid.id = TRANSACTION_INVALID_ID;
+    }
+
+    if (cursor->is_cleanout) {
+        heap_cleanout_page(sess, cursor, cursor->table, cursor->row_id);
+        cursor->is_cleanout = FALSE;
+    }
+
+    if (*is_found) {
+        CM_RETURN_IF_ERROR(heap_build_index_key(cursor->table, cursor->index, cursor->row, cursor->row_id, &row_key));
+        *is_found = row_key.len == key_len && memcmp(row_key.data, key, key_len) == 0;
+    }
+
     return CM_SUCCESS;
 }
 
@@ -1536,10 +3371,14 @@ void heap_endscan(TableScanDesc sscan)
 }
 */
 
+// The keys of row are removed from the indexes of table after the heap page is released.
+// A trx recovered after crash holds no table lock, so its index entries are left in tree,
+// they are ignored by fetch as the row does not exist.
 void heap_undo_insert(que_sess_t* sess, trx_t* trx, trx_undo_rec_hdr_t* undo_rec, uint32 undo_rec_size)
 {
     mtr_t mtr;
     undo_rec_mgr_t undo_mgr;
+    row_header_t* undo_row = NULL;
 
     mtr_start(&mtr);
 
@@ -1547,6 +3386,9 @@ void heap_undo_insert(que_sess_t* sess, trx_t* trx, trx_undo_rec_hdr_t* undo_rec
     undo_mgr.deserialize(undo_rec, undo_rec_size);
     ut_a(undo_mgr.m_type == UNDO_HEAP_INSERT);
 
+    dict_table_t* table = lock_get_table(trx, undo_mgr.m_table_id);
+    void* save_ptr = mcontext_stack_save(sess->mcontext_stack);
+
     // get heap page
     const page_id_t page_id(undo_mgr.m_insert.row_id->space_id, undo_mgr.m_insert.row_id->page_no);
     const page_size_t page_size(page_id.get_space_id());
@@ -1568,6 +3410,11 @@ void heap_undo_insert(que_sess_t* sess, trx_t* trx, trx_undo_rec_hdr_t* undo_rec
         "the xid of itl and trx are not equal, panic info: page %u-%u type %u itl xid %llu trx xid %llu",
         page_id.get_space_id(), page_id.get_page_no(), FIL_PAGE_TYPE_HEAP, itl->trx_slot_id.id, sess->trx.trx_slot_id.id);
 
+    if (table != NULL && UT_LIST_GET_LEN(table->indexes) > 0) {
+        undo_row = (row_header_t*)mcontext_stack_push(sess->mcontext_stack, ROW_RECORD_MAX_SIZE);
+        memcpy(undo_row, row, row->size);
+    }
+
     // undo row
     heap_page_header_t* page_hdr = page + HEAP_HEADER_OFFSET;
     uint32 rows = mach_read_from_2(page_hdr + HEAP_HEADER_ROWS);
@@ -1587,12 +3434,20 @@ void heap_undo_insert(que_sess_t* sess, trx_t* trx, trx_undo_rec_hdr_t* undo_rec
     mlog_write_log(MLOG_HEAP_UNDO_INSERT, block->get_space_id(), block->get_page_no(), buf, buf_size, mtr);
 
     mtr_commit(&mtr);
+
+    if (undo_row != NULL) {
+        heap_delete_index_entries(table, undo_row, undo_mgr.m_insert.row_id);
+    }
+    mcontext_stack_restore(sess->mcontext_stack, save_ptr);
 }
 
+// The keys of restored row are inserted again after the heap page is released, since a key
+// of unique index may be taken over by another row of trx after the delete, see btr_insert.
 void heap_undo_delete(que_sess_t* sess, trx_t* trx, trx_undo_rec_hdr_t* undo_rec, uint32 undo_rec_size)
 {
     mtr_t mtr;
     undo_rec_mgr_t undo_mgr;
+    row_header_t* undo_row = NULL;
 
     mtr_start(&mtr);
 
@@ -1600,6 +3455,9 @@ void heap_undo_delete(que_sess_t* sess, trx_t* trx, trx_undo_rec_hdr_t* undo_rec
     undo_mgr.deserialize(undo_rec, undo_rec_size);
     ut_a(undo_mgr.m_type == UNDO_HEAP_DELETE);
 
+    dict_table_t* table = lock_get_table(trx, undo_mgr.m_table_id);
+    void* save_ptr = mcontext_stack_save(sess->mcontext_stack);
+
     // get heap page
     const page_id_t page_id(undo_mgr.m_delete.row_id->space_id, undo_mgr.m_delete.row_id->page_no);
     const page_size_t page_size(page_id.get_space_id());
@@ -1621,24 +3479,36 @@ void heap_undo_delete(que_sess_t* sess, trx_t* trx, trx_undo_rec_hdr_t* undo_rec
         "the xid of itl and trx are not equal, panic info: page %u-%u type %u itl xid %llu trx xid %llu",
         page_id.get_space_id(), page_id.get_page_no(), FIL_PAGE_TYPE_HEAP, itl->trx_slot_id.id, sess->trx.trx_slot_id.id);
 
-    // undo row
+    // undo row, the row count is decreased by heap_delete_row
     heap_page_header_t* page_hdr = page + HEAP_HEADER_OFFSET;
     uint32 rows = mach_read_from_2(page_hdr + HEAP_HEADER_ROWS);
-    mach_write_to_2(page_hdr + HEAP_HEADER_ROWS, rows - 1);
+    mach_write_to_2(page_hdr + HEAP_HEADER_ROWS, rows + 1);
     itl->fsc -= row->size;
     row->is_deleted = 0;
     heap_row_set_itl_id(row, undo_mgr.m_delete.old_itl_id);
-    memcpy(dir, undo_mgr.m_delete.old_dir, sizeof(row_dir_t));
+    memcpy(dir, &undo_mgr.m_delete.old_dir, sizeof(row_dir_t));
+
+    if (table != NULL && UT_LIST_GET_LEN(table->indexes) > 0) {
+        undo_row = (row_header_t*)mcontext_stack_push(sess->mcontext_stack, ROW_RECORD_MAX_SIZE);
+        memcpy(undo_row, row, row->size);
+    }
 
     // write redo log
     const uint32 buf_size = 3 + sizeof(row_dir_t);
     byte buf[buf_size];
     mach_write_to_2(buf, undo_mgr.m_delete.row_id->slot);
     mach_write_to_1(buf+2, undo_mgr.m_delete.old_itl_id);
-    memcpy(buf+3, undo_mgr.m_delete.old_dir, sizeof(row_dir_t));
+    memcpy(buf+3, &undo_mgr.m_delete.old_dir, sizeof(row_dir_t));
     mlog_write_log(MLOG_HEAP_UNDO_DELETE, block->get_space_id(), block->get_page_no(), buf, buf_size, mtr);
 
     mtr_commit(&mtr);
+
+    // the row exists again, so a record of its key taken over by a rolled back row is returned to it
+    if (undo_row != NULL) {
+        status_t err = heap_insert_index_entries(sess, table, undo_row, undo_mgr.m_delete.row_id);
+        ut_a(err == CM_SUCCESS);
+    }
+    mcontext_stack_restore(sess->mcontext_stack, save_ptr);
 }
 
 byte* heap_insert_replay(uint32 type, uint64 lsn, byte* log_rec_ptr, byte* log_end_ptr, void* block)
@@ -1715,3 +3585,84 @@ byte* heap_undo_insert_replay(uint32 type, uint64 lsn, byte* log_rec_ptr, byte*
     return log_rec_ptr+4;
 }
 
+
+// pages with less free space are not worth compacting
+#define HEAP_COMPACT_MIN_FREE_SIZE      (UNIV_PAGE_SIZE_DEF / 4)
+
+typedef struct st_heap_compact_ctx {
+    que_sess_t* sess;
+    uint64      min_query_scn;  // deleted rows committed before it are seen by no query
+    uint32      scanned_pages;
+    uint32      compacted_pages;
+    uint32      empty_pages;
+} heap_compact_ctx_t;
+
+// Reorganizes a sparse page in place, space of deleted rows that no query can see
+// and holes between rows are merged into the free space between lower and upper,
+// row ids are not changed so that no row lock or index maintenance is needed.
+static bool32 heap_compact_page(dict_table_t* table, page_no_t page_no, fsm_search_path_t& search_path, void* arg)
+{
+    heap_compact_ctx_t* ctx = (heap_compact_ctx_t *)arg;
+    const page_id_t page_id(table->space_id, page_no);
+    const page_size_t page_size(table->space_id);
+    mtr_t mtr;
+
+    if (srv_shutdown_state != SHUTDOWN_NONE) {
+        return FALSE;
+    }
+
+    mtr_start(&mtr);
+
+    buf_block_t* block = buf_page_get(page_id, page_size, RW_X_LATCH, &mtr);
+    if (block->get_page_type() != FIL_PAGE_TYPE_HEAP) {
+        mtr_commit(&mtr);
+        return TRUE;
+    }
+
+    page_t* page = buf_block_get_frame(block);
+    heap_page_header_t* header = page + HEAP_HEADER_OFFSET;
+    uint16 lower = mach_read_from_2(header + HEAP_HEADER_LOWER);
+    uint16 upper = mach_read_from_2(header + HEAP_HEADER_UPPER);
+    uint16 free_size = mach_read_from_2(header + HEAP_HEADER_FREE_SIZE);
+
+    ctx->scanned_pages++;
+    if (upper - lower < free_size) {
+        heap_reorganize_page(block, ctx->min_query_scn, &mtr);
+        ctx->compacted_pages++;
+    }
+    if (mach_read_from_2(header + HEAP_HEADER_ROWS) == 0) {
+        ctx->empty_pages++;
+    }
+
+    uint8 category = fsm_space_avail_to_category(table, heap_get_page_free_space(block));
+    if (category != search_path.category) {
+        fsm_recursive_set_catagory(table, search_path, category, &mtr);
+    }
+
+    mtr_commit(&mtr);
+
+    return TRUE;
+}
+
+// Online compaction of heap, sparse pages found by fsm are reorganized one by one,
+// every page is latched only during its own mini-transaction.
+status_t heap_compact(que_sess_t* sess, dict_table_t* table)
+{
+    heap_compact_ctx_t ctx;
+
+    // computed once before the scan, a snapshot opened later is not older than it
+    ctx.sess = sess;
+    ctx.min_query_scn = g_sess_pool->get_min_query_scn(trx_get_query_scn());
+    ctx.scanned_pages = 0;
+    ctx.compacted_pages = 0;
+    ctx.empty_pages = 0;
+
+    uint8 min_category = fsm_space_avail_to_category(table, HEAP_COMPACT_MIN_FREE_SIZE);
+    CM_RETURN_IF_ERROR(fsm_scan_heap_pages(table, min_category, heap_compact_page, &ctx));
+
+    LOGGER_INFO(LOGGER, LOG_MODULE_HEAP,
+        "heap_compact: table %s, scanned %u sparse pages, compacted %u pages, %u pages are empty",
+        table->name, ctx.scanned_pages, ctx.compacted_pages, ctx.empty_pages);
+
+    return CM_SUCCESS;
+}
@@ -331,6 +331,14 @@ typedef struct st_heap_page_header
 
 // --------------------------------------------------------------------------
 
+// itl of a page cleaned by heap_cleanout_itls
+typedef struct st_heap_cleanout_page {
+    buf_block_t*  block;
+    uint8         itl_id;
+} heap_cleanout_page_t;
+
+#define HEAP_CLEANOUT_MAX_PAGES     32  // pages cleaned by one mtr of heap_cleanout_itls at most
+
 //extern bool32 heap_extend_table_segment(dict_table_t* table);
 
 extern uint32 heap_create_entry(uint32 space_id);
@@ -338,9 +346,22 @@ extern uint32 heap_create_entry(uint32 space_id);
 extern inline void heap_page_init(buf_block_t* block, dict_table_t* table, mtr_t* mtr);
 
 extern status_t heap_insert(que_sess_t* sess, insert_node_t* insert_node);
+extern status_t heap_multi_insert(que_sess_t* sess, dict_table_t* table, dtuple_t** tuples, uint32 count);
+extern status_t heap_delete(que_sess_t* sess, dict_table_t* table, row_id_t row_id);
+extern status_t heap_update(que_sess_t* sess, dict_table_t* table, row_id_t row_id, insert_node_t* insert_node);
+// rollback of heap undo records, indexes of the row are changed with the page
+extern void heap_undo_insert(que_sess_t* sess, trx_t* trx, byte* undo_rec, uint32 undo_rec_size);
+extern void heap_undo_delete(que_sess_t* sess, trx_t* trx, byte* undo_rec, uint32 undo_rec_size);
 
 extern inline void heap_set_itl_trx_end(buf_block_t* block,
     trx_slot_id_t slot_id, uint8 itl_id, uint64 scn, mtr_t* mtr);
+extern bool32 heap_cleanout_itl(buf_block_t* block,
+    trx_slot_id_t slot_id, uint8 itl_id, uint64 scn, mtr_t* mtr);
+extern uint32 heap_cleanout_itls(heap_cleanout_page_t* pages, uint32 count,
+    trx_slot_id_t slot_id, uint64 scn, mtr_t* mtr);
+
+extern byte* heap_reorganize_page_replay(uint32 type, uint64 lsn, byte* log_rec_ptr, byte* log_end_ptr, void* block);
+extern byte* heap_clean_itl_replay(uint32 type, uint64 lsn, byte* log_rec_ptr, byte* log_end_ptr, void* block);
 
 
 #ifdef __cplusplus
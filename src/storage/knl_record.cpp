@@ -1,4 +1,5 @@
 #include "knl_record.h"
+#include "knl_heap_toast.h"
 
 // n: in, index of the field
 inline uint8 rec_get_nth_column_bits(rec_t* rec, uint16 n)
@@ -102,13 +103,14 @@ inline uint16 rec_get_nth_column_offset(
 
 
 // n: in, index of the field
+// a bit is set in null bitmap if the column is null
 inline bool32 tuple_check_nth_col_is_null(heap_tuple_t* tuple, uint16 nth)
 {
     bool32 is_null = FALSE;
     if (tuple->is_has_nulls) {
         byte* nulls_ptr = (byte *)tuple + HEAP_TUPLE_HEADER_SIZE;
         nulls_ptr += (nth / 8);
-        is_null = ((*nulls_ptr) & (1 << (7 - nth / 8))) ? FALSE : TRUE;
+        is_null = ((*nulls_ptr) & (1 << (7 - nth % 8))) ? TRUE : FALSE;
     }
     return is_null;
 }
@@ -117,7 +119,7 @@ inline void tuple_set_nth_col_null(heap_tuple_t* tuple, uint16 nth)
 {
     byte* nulls_ptr = (byte *)tuple + HEAP_TUPLE_HEADER_SIZE;
     nulls_ptr += (nth / 8);
-    *nulls_ptr |= (1 << (7 - nth/ 8));
+    *nulls_ptr |= (1 << (7 - nth % 8));
     tuple->is_has_nulls = TRUE;
 }
 
@@ -222,23 +224,24 @@ status_t heap_deform_tuple(tuple_slot_t* slot, heap_tuple_t* tuple)
             slot->lens[i] = g_data_type_desc[col->mtype]->fixed_length;
         } else if (col->is_ext) {
             slot->values[i] = PointerGetDatum(data_ptr);
-            slot->lens[i] = sizeof(row_id_t);
+            slot->lens[i] = TOAST_POINTER_SIZE;
         } else {
             slot->lens[i] = mach_read_from_2(data_ptr);
             slot->values[i] = PointerGetDatum(data_ptr + 2);
+            data_ptr += 2;
         }
         data_ptr += slot->lens[i];
     }
 
-    /* other columns */
+    /* other columns, added after the row was inserted, take the default of column if any */
     for (uint16 i = tuple->column_count; i < slot->column_count; i++) {
         dict_col_t* col = slot->table->columns[i];
-        if (col->nullable) {
+        if (col->default_const_value == NULL) {
+            ut_ad(col->nullable);
             slot->lens[i] = REC_NULL_VALUE_LEN;
             continue;
         }
 
-        ut_ad(col->default_const_value);
         slot->lens[i] = col->default_const_value_len;
         slot->values[i] = PointerGetDatum(col->default_const_value);
     }
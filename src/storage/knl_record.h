@@ -360,6 +360,8 @@ extern inline uint16 rec_get_nth_column_offset(
     uint16 n, // in: index of the field
     uint16* len); // out: length of the field; REC_NULL_VALUE_LEN if null
 
+extern inline bool32 tuple_check_nth_col_is_null(heap_tuple_t* tuple, uint16 nth);
+
 extern inline status_t rec_get_columns_offset(rec_t* rec,
     uint16* size, uint16* col_count, uint16* offsets, uint16* lens);
 
@@ -4,6 +4,7 @@
 #include "knl_buf_flush.h"
 #include "knl_file_system.h"
 #include "knl_fsp.h"
+#include "knl_heap.h"
 #include "knl_trx_rseg.h"
 
 
@@ -17,6 +18,7 @@ static mlog_dispatch_t g_mlog_replay_table[MLOG_BIGGEST_TYPE] = {
     {MLOG_2BYTES, mlog_replay_nbytes, mlog_replay_check},
     {MLOG_4BYTES, mlog_replay_nbytes, mlog_replay_check},
     {MLOG_8BYTES, mlog_replay_nbytes, mlog_replay_check},
+    {MLOG_WRITE_STRING, mlog_replay_string, mlog_replay_check},
 
     {MLOG_FSP_INIT, fsp_replay_fsp_init, mlog_replay_check},
     {MLOG_FSP_EXTEND, fsp_replay_fsp_extend, mlog_replay_check},
@@ -26,6 +28,9 @@ static mlog_dispatch_t g_mlog_replay_table[MLOG_BIGGEST_TYPE] = {
     {MLOG_TRX_RSEG_SLOT_BEGIN, trx_rseg_replay_begin_slot, mlog_replay_check},
     {MLOG_TRX_RSEG_SLOT_END, trx_rseg_replay_end_slot, mlog_replay_check},
 
+    {MLOG_PAGE_REORGANIZE, heap_reorganize_page_replay, mlog_replay_check},
+    {MLOG_HEAP_CLEAN_ITL, heap_clean_itl_replay, mlog_replay_check},
+
     /* end */
     {MLOG_BIGGEST_TYPE, NULL, NULL}
 };
@@ -399,6 +404,9 @@ static bool32 recovery_is_need_get_block(uint32 type, bool32* is_create_page)
     case MLOG_2BYTES:
     case MLOG_4BYTES:
     case MLOG_8BYTES:
+    case MLOG_WRITE_STRING:
+    case MLOG_PAGE_REORGANIZE:
+    case MLOG_HEAP_CLEAN_ITL:
         result = TRUE;
         break;
 
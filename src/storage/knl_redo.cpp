@@ -977,11 +977,15 @@ status_t log_group_add(char* name, uint64 file_size)
     sprintf_s(group->name, strlen(name) + 1, "%s", name);
     group->name[strlen(name)] = '\0';
 
-    bool32 ret = os_open_file(group->name, OS_FILE_OPEN, OS_FILE_AIO, &group->handle);
+    bool32 ret = os_open_file(group->name, OS_FILE_OPEN,
+        OS_FILE_AIO | (srv_log_file_direct_io ? OS_FILE_DIRECT_IO : 0), &group->handle);
     if (!ret) {
         LOGGER_ERROR(LOGGER, LOG_MODULE_REDO, "failed to open redo file, name = %s", group->name);
         goto err_exit;
     }
+    if (srv_log_file_direct_io && !os_file_is_direct_io(group->handle)) {
+        LOGGER_WARN(LOGGER, LOG_MODULE_REDO, "O_DIRECT is not supported, use buffered i/o, name = %s", group->name);
+    }
 
     return CM_SUCCESS;
 
@@ -1046,13 +1050,14 @@ status_t log_init(uint32 log_buffer_size)
     log_sys->group_count = 0;
 
     // checkpoiont
-    log_sys->checkpoint_buf = (byte*)ut_malloc(LOG_BUF_WRITE_MARGIN);
-    if (log_sys->checkpoint_buf == NULL) {
+    log_sys->checkpoint_buf_ptr = (byte*)ut_malloc(LOG_BUF_WRITE_MARGIN + OS_FILE_LOG_BLOCK_SIZE);
+    if (log_sys->checkpoint_buf_ptr == NULL) {
         LOGGER_ERROR(LOGGER, LOG_MODULE_REDO,
             "log_init: failed to malloc for checkpoint buffer, size= %u",
-            LOG_BUF_WRITE_MARGIN);
+            LOG_BUF_WRITE_MARGIN + OS_FILE_LOG_BLOCK_SIZE);
         goto err_exit;
     }
+    log_sys->checkpoint_buf = (byte*)ut_align_up(log_sys->checkpoint_buf_ptr, OS_FILE_LOG_BLOCK_SIZE);
     log_sys->last_checkpoint_lsn = 0;
     log_sys->next_checkpoint_lsn = 0;
     log_sys->next_checkpoint_no = 0;
@@ -1155,7 +1160,8 @@ static void log_checkpoint_write()
 {
     uint32      write_offset;
     uint64      fold;
-    byte        buf[OS_FILE_LOG_BLOCK_SIZE];
+    byte        buf_ptr[OS_FILE_LOG_BLOCK_SIZE * 2];
+    byte*       buf = (byte *)ut_align_up(buf_ptr, OS_FILE_LOG_BLOCK_SIZE);
 
     ut_ad(!srv_read_only_mode);
     
@@ -167,6 +167,7 @@ typedef struct st_log {
     uint64            buf_base_lsn; // lsn for buf[0] while service started
 
     //
+    byte*             checkpoint_buf_ptr; // unaligned checkpoint buffer
     byte*             checkpoint_buf;
 
     //
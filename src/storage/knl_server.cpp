@@ -17,7 +17,8 @@ bool32 buf_pool_should_madvise;
 
 
 /* The number of purge threads to use.*/
-uint32 srv_purge_threads;
+uint32 srv_purge_threads = 4;
+uint32 srv_purge_batch_size = 64;
 /* Use srv_n_io_[read|write]_threads instead. */
 uint32 srv_n_file_io_threads;
 uint32 srv_read_io_threads = 8;
@@ -27,8 +28,36 @@ uint32 srv_sync_io_contexts = 16;
 uint32 srv_read_io_timeout_seconds = 30;
 uint32 srv_write_io_timeout_seconds = 30;
 
+uint32 srv_checkpoint_io_merge_size = 1024 * 1024; // 1MB
+
+uint32 srv_io_prefetch_max_pending = 64;
+uint32 srv_io_write_max_pending = 256;
+uint64 srv_io_prefetch_rate = 0;
+uint64 srv_io_write_rate = 0;
+
+bool32 srv_data_file_direct_io = TRUE;
+bool32 srv_log_file_direct_io = FALSE;
+bool32 srv_dblwr_file_direct_io = TRUE;
+bool32 srv_temp_file_direct_io = FALSE;
+
+bool32 srv_use_fallocate = TRUE;
+uint32 srv_space_preextend_free_pages = 1024;
+
 uint32 srv_buf_LRU_old_threshold_ms = 1000;
 
+uint32 srv_parallel_scan_max_workers = 8;
+uint32 srv_parallel_scan_queue_rows = 64;
+
+uint32 srv_fast_clean_max_pages = 64;
+uint32 srv_delayed_cleanout_threads = 2;
+uint32 srv_delayed_cleanout_queue_size = 4096;
+uint32 srv_cr_pages_per_instance = 256;
+uint32 srv_sess_undo_cached_pages = 4;
+uint32 srv_lock_wait_timeout = 50;
+uint32 srv_trx_rollback_threads = 4;
+uint32 srv_index_build_sort_buffer_size = 64 * 1024 * 1024; // 64MB
+uint32 srv_index_build_fill_factor = 90;
+
 
 /** in read-only mode. We don't do any
 recovery and open all tables in RO mode instead of RW mode. We don't
@@ -10,12 +10,14 @@ attribute_t       g_attribute;
 
 status_t sess_pool_create(uint32 sess_count, uint32 session_stack_size)
 {
-    g_sess_pool = new session_pool_t();
-    if (g_sess_pool == NULL) {
+    // published after init, the background threads started before may be waiting for it
+    session_pool_t* sess_pool = new session_pool_t();
+    if (sess_pool == NULL) {
         return ERR_ALLOC_MEMORY;
     }
 
-    g_sess_pool->init(sess_count, session_stack_size, &g_attribute);
+    sess_pool->init(sess_count, session_stack_size, &g_attribute);
+    g_sess_pool = sess_pool;
 
     return CM_SUCCESS;
 }
@@ -116,6 +118,22 @@ void session_pool_t::free_session(que_sess_t* sess)
     mutex_exit(&mutex);
 }
 
+// The oldest snapshot of sessions, scn is returned if it is older
+uint64 session_pool_t::get_min_query_scn(uint64 scn)
+{
+    mutex_enter(&mutex);
+    for (que_sess_t* sess = UT_LIST_GET_FIRST(used_sess_list); sess != NULL;
+         sess = UT_LIST_GET_NEXT(list_node, sess)) {
+        uint64 query_scn = atomic64_get(&sess->query_scn);
+        if (query_scn != 0 && query_scn < scn) {
+            scn = query_scn;
+        }
+    }
+    mutex_exit(&mutex);
+
+    return scn;
+}
+
 
 status_t que_sess_t::init()
 {
@@ -136,6 +154,7 @@ status_t que_sess_t::init()
     fast_clean_mgr.init(srv_common_mpool);
 
     wait_trx_event = g_resource.events[sess_id % CM_RM_EVENT_MAX_COUNT];
+    query_scn = 0;
 
     return CM_SUCCESS;
 }
@@ -150,6 +169,7 @@ void que_sess_t::clean()
     }
 
     fast_clean_mgr.destroy();
+    trx_undo_sess_cache_release(this);
 
     if (mcontext_stack) {
         mcontext_stack_destroy(mcontext_stack);
@@ -208,6 +228,12 @@ status_t que_sess_t::wait_transaction_end(uint64 timeout_us)
         if (trx_status.status == XACT_END) {
             break;
         }
+        // trx active at crash is rolled back here if no rollback thread has claimed it
+        trx_slot_id_t slot_id;
+        slot_id.id = wait_xid.id;
+        if (trx_rollback_recovered_by_slot(this, slot_id)) {
+            continue;
+        }
 
         ut_ad(wait_trx_event);
         os_event_wait_time(wait_trx_event, timeout_us_per, signal_count);
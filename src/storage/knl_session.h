@@ -69,6 +69,11 @@ struct que_sess_t {
 
     mutex_t           scn_mutex;
     atomic64_t        current_scn;
+    atomic64_t        query_scn;  // snapshot of running query, 0 if none, purge keeps undo committed after it
+
+    // insert undo pages initialized for the next trxs of session, released to rseg of undo_cache_rseg_id
+    trx_undo_page_base undo_page_cache;
+    uint32            undo_cache_rseg_id;
 
     memory_stack_context_t* mcontext_stack{NULL};
     UT_LIST_NODE_T(que_sess_t) list_node;
@@ -87,6 +92,7 @@ public:
     status_t init(uint32 sess_count, uint32 stack_size, attribute_t* attr);
     que_sess_t* alloc_session();
     void free_session(que_sess_t* sess);
+    uint64 get_min_query_scn(uint64 scn);
 
 private:
     mutex_t        mutex;
@@ -102,6 +108,8 @@ extern void sess_pool_destroy();
 
 extern que_sess_t* que_sess_alloc();
 extern void que_sess_free(que_sess_t* sess);
+extern void trx_undo_sess_cache_release(que_sess_t* sess);
+extern bool32 trx_rollback_recovered_by_slot(que_sess_t* sess, trx_slot_id_t slot_id);
 
 
 extern attribute_t       g_attribute;
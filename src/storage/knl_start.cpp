@@ -9,7 +9,11 @@
 #include "knl_recovery.h"
 #include "knl_trx_rseg.h"
 #include "knl_checkpoint.h"
+#include "knl_dblwrite.h"
+#include "knl_fast_clean.h"
 #include "knl_undo_fsm.h"
+#include "knl_trx_purge.h"
+#include "knl_lock_rec_hash.h"
 
 #define SRV_MAX_READ_IO_THREADS    32
 #define SRV_MAX_WRITE_IO_THREADS   32
@@ -26,6 +30,19 @@ static os_thread_t    checkpoint_thread;
 static os_thread_id_t checkpoint_thread_id;
 static os_thread_t    buf_LRU_free_block_thread;
 static os_thread_id_t buf_LRU_free_block_thread_id;
+static os_thread_t    fsp_preextend_thread_handle;
+static os_thread_id_t fsp_preextend_thread_id;
+static uint32         delayed_cleanout_thread_idents[SRV_MAX_DELAYED_CLEANOUT_THREADS];
+static os_thread_t    delayed_cleanout_threads[SRV_MAX_DELAYED_CLEANOUT_THREADS];
+static os_thread_id_t delayed_cleanout_thread_ids[SRV_MAX_DELAYED_CLEANOUT_THREADS];
+static os_thread_t    purge_coordinator_thread;
+static os_thread_id_t purge_coordinator_thread_id;
+static uint32         purge_worker_thread_idents[SRV_MAX_PURGE_THREADS];
+static os_thread_t    purge_worker_threads[SRV_MAX_PURGE_THREADS];
+static os_thread_id_t purge_worker_thread_ids[SRV_MAX_PURGE_THREADS];
+static uint32         trx_rollback_thread_idents[SRV_MAX_TRX_ROLLBACK_THREADS];
+static os_thread_t    trx_rollback_threads[SRV_MAX_TRX_ROLLBACK_THREADS];
+static os_thread_id_t trx_rollback_thread_ids[SRV_MAX_TRX_ROLLBACK_THREADS];
 
 status_t server_read_control_file()
 {
@@ -160,6 +177,61 @@ status_t buf_LRU_scan_and_free_block_thread_startup()
     return CM_SUCCESS;
 }
 
+status_t buf_delayed_cleanout_threads_startup()
+{
+    if (srv_delayed_cleanout_threads > SRV_MAX_DELAYED_CLEANOUT_THREADS) {
+        srv_delayed_cleanout_threads = SRV_MAX_DELAYED_CLEANOUT_THREADS;
+    }
+
+    for (uint32 i = 0; i < srv_delayed_cleanout_threads; i++) {
+        delayed_cleanout_thread_idents[i] = i;
+        delayed_cleanout_threads[i] = os_thread_create(buf_delayed_cleanout_thread,
+            &delayed_cleanout_thread_idents[i], &delayed_cleanout_thread_ids[i]);
+    }
+
+    return CM_SUCCESS;
+}
+
+status_t trx_purge_threads_startup()
+{
+    if (srv_purge_threads > SRV_MAX_PURGE_THREADS) {
+        srv_purge_threads = SRV_MAX_PURGE_THREADS;
+    }
+
+    CM_RETURN_IF_ERROR(trx_purge_sys_create(srv_purge_threads));
+
+    for (uint32 i = 0; i < srv_purge_threads; i++) {
+        purge_worker_thread_idents[i] = i;
+        purge_worker_threads[i] = os_thread_create(trx_purge_worker_thread,
+            &purge_worker_thread_idents[i], &purge_worker_thread_ids[i]);
+    }
+    purge_coordinator_thread = os_thread_create(trx_purge_coordinator_thread, NULL, &purge_coordinator_thread_id);
+
+    return CM_SUCCESS;
+}
+
+// Threads more than the trxs active at crash are not started
+status_t trx_rollback_threads_startup()
+{
+    uint32 thread_count = ut_min(srv_trx_rollback_threads, SRV_MAX_TRX_ROLLBACK_THREADS);
+    thread_count = ut_max(thread_count, 1);
+    thread_count = ut_min(thread_count, (uint32)atomic32_get(&trx_sys->recv_trx_count));
+
+    for (uint32 i = 0; i < thread_count; i++) {
+        trx_rollback_thread_idents[i] = i;
+        trx_rollback_threads[i] = os_thread_create(trx_rollback_recovered_thread,
+            &trx_rollback_thread_idents[i], &trx_rollback_thread_ids[i]);
+    }
+
+    return CM_SUCCESS;
+}
+
+status_t fsp_preextend_thread_startup()
+{
+    fsp_preextend_thread_handle = os_thread_create(fsp_preextend_thread, NULL, &fsp_preextend_thread_id);
+    return CM_SUCCESS;
+}
+
 status_t server_create_data_files()
 {
     if (srv_create_ctrl_files() != CM_SUCCESS) {
@@ -239,6 +311,7 @@ status_t memory_pool_create(attr_memory_t* attr)
         LOGGER_ERROR(LOGGER, LOG_MODULE_STARTUP, "Failed to create temporary memory pool");
         return CM_ERROR;
     }
+    srv_temp_mem_pool->is_direct_io = srv_temp_file_direct_io;
 
     LOGGER_INFO(LOGGER, LOG_MODULE_STARTUP, "memory pool initialized");
 
@@ -264,6 +337,24 @@ status_t server_config_init(char* base_dir, attribute_t* attr)
         sprintf_s(srv_data_home, 1023, "%s%s", base_dir, "data");
     }
 
+    const char* flush_method = attr->attr_storage.flush_method;
+    if (flush_method != NULL && strcasecmp(flush_method, "O_DIRECT_ALL") == 0) {
+        srv_data_file_direct_io = TRUE;
+        srv_log_file_direct_io = TRUE;
+        srv_dblwr_file_direct_io = TRUE;
+        srv_temp_file_direct_io = TRUE;
+    } else if (flush_method != NULL && strcasecmp(flush_method, "O_DIRECT") == 0) {
+        srv_data_file_direct_io = TRUE;
+        srv_log_file_direct_io = FALSE;
+        srv_dblwr_file_direct_io = TRUE;
+        srv_temp_file_direct_io = FALSE;
+    } else {
+        srv_data_file_direct_io = FALSE;
+        srv_log_file_direct_io = FALSE;
+        srv_dblwr_file_direct_io = FALSE;
+        srv_temp_file_direct_io = FALSE;
+    }
+
     return CM_SUCCESS;
 }
 
@@ -610,13 +701,6 @@ status_t server_open_or_create_database(char* base_dir, attribute_t* attr)
     err = read_write_threads_startup();
     CM_RETURN_IF_ERROR(err);
 
-    if (!is_create_new_db) {
-        /* If we are using the doublewrite method, we will
-           check if there are half-written pages in data files,
-           and restore them from the doublewrite buffer if possible */
-        //trx_sys_doublewrite_restore_corrupt_pages();
-    }
-
     // temp file
     //err = srv_create_temp_files();
     //CM_RETURN_IF_ERROR(err);
@@ -634,12 +718,18 @@ status_t server_open_or_create_database(char* base_dir, attribute_t* attr)
     CM_RETURN_IF_ERROR(err);
     err = buf_LRU_scan_and_free_block_thread_startup();
     CM_RETURN_IF_ERROR(err);
+    if (srv_delayed_cleanout_queue_size > 0) {
+        err = buf_delayed_cleanout_threads_startup();
+        CM_RETURN_IF_ERROR(err);
+    }
 
     // Creates trx_sys at a database start
     data_file = srv_ctrl_file->get_data_file_by_node_id(DB_SYSTRANS_FILNODE_ID);
     uint32 rseg_count = (uint32)data_file->max_size;
     err = trx_sys_create(srv_common_mpool, rseg_count, srv_ctrl_file->undo_data_file_count);
     CM_RETURN_IF_ERROR(err);
+    err = lock_sys_create(LOCK_SYS_HASH_CELLS);
+    CM_RETURN_IF_ERROR(err);
 
     //
     if (is_create_new_db) {
@@ -681,6 +771,12 @@ status_t server_open_or_create_database(char* base_dir, attribute_t* attr)
         err = server_open_table_spaces();
         CM_RETURN_IF_ERROR(err);
 
+        /* check if there are half-written pages in data files,
+           and restore them from the doublewrite buffer before redo is applied */
+        data_file = srv_ctrl_file->get_data_file_by_node_id(DB_DBWR_FILNODE_ID);
+        err = buf_dblwr_restore_corrupt_pages(data_file->file_name, data_file->max_size);
+        CM_RETURN_IF_ERROR(err);
+
         recovery_sys_t* recv_sys = recovery_init(srv_common_mpool);
         if (recv_sys == NULL) {
             return CM_ERROR;
@@ -709,6 +805,12 @@ status_t server_open_or_create_database(char* base_dir, attribute_t* attr)
 
         //srv_startup_is_before_trx_rollback_phase = FALSE;
         LOGGER_NOTICE(LOGGER, LOG_MODULE_STARTUP, "recovery done");
+
+        // Roll back the trxs active at crash in background, database is opened at once
+        if (atomic32_get(&trx_sys->recv_trx_count) > 0) {
+            err = trx_rollback_threads_startup();
+            CM_RETURN_IF_ERROR(err);
+        }
     }
 
     // Create the thread which watches the timeouts for lock waits and prints monitor info
@@ -723,6 +825,18 @@ status_t server_open_or_create_database(char* base_dir, attribute_t* attr)
     // and does purge and other utility operations
     //os_thread_create(&srv_master_thread, NULL, thread_ids + 1 + SRV_MAX_N_IO_THREADS);
 
+    // Create the threads which purge committed update undo
+    if (srv_purge_threads > 0) {
+        err = trx_purge_threads_startup();
+        CM_RETURN_IF_ERROR(err);
+    }
+
+    // Create the thread which extends tablespaces ahead of demand
+    if (srv_space_preextend_free_pages > 0) {
+        err = fsp_preextend_thread_startup();
+        CM_RETURN_IF_ERROR(err);
+    }
+
     if (is_create_new_db) {
         log_checkpoint(LOG_BLOCK_HDR_SIZE);
         // Makes a checkpoint at a given lsn or later
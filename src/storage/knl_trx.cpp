@@ -1,8 +1,13 @@
 #include "knl_trx.h"
 
+#include "cm_log.h"
+#include "cm_thread.h"
 #include "cm_timer.h"
 #include "knl_buf.h"
 #include "knl_fsp.h"
+#include "knl_heap.h"
+#include "knl_heap_toast.h"
+#include "knl_lock_rec_hash.h"
 #include "knl_trx_rseg.h"
 #include "knl_undo_fsm.h"
 
@@ -23,6 +28,7 @@ status_t trx_sys_create(memory_pool_t* mem_pool, uint32 rseg_count, uint32 undo_
     trx_sys->mem_pool = mem_pool;
     trx_sys->rseg_count = rseg_count;
     trx_sys->undo_space_count = undo_space_count;
+    trx_sys->recv_trx_count = 0;
     trx_sys->context = mcontext_stack_create(trx_sys->mem_pool);
     if (trx_sys->context == NULL) {
         return CM_ERROR;
@@ -54,7 +60,7 @@ status_t trx_sys_init_at_db_start(bool32 is_create_database)
         rseg->undo_cached_max_count = 1024;
         rseg->extend_undo_in_process = FALSE;
         mutex_create(&rseg->trx_mutex);
-        SLIST_INIT(rseg->trx_free_list);
+        rseg->trx_free_stack = TRX_FREE_STACK_EMPTY;
         SLIST_INIT(rseg->trx_need_recovery_list);
 
         err = trx_rseg_undo_page_init(rseg);
@@ -75,9 +81,15 @@ status_t trx_sys_init_at_db_start(bool32 is_create_database)
             rseg = TRX_GET_RSEG(rseg_id);
             trx = &rseg->trx_list[slot_idx];
             if (trx->is_active) {
+                // undo pages are kept in use by undo_fsm_recovery_fsp_pages until trx is rolled back
+                err = trx_rseg_open_trx_undo(trx);
+                CM_RETURN_IF_ERROR(err);
+                trx->recv_state = TRX_RECV_WAITING;
+                trx_sys->recv_trx_count++;
                 SLIST_ADD_LAST(list_node, rseg->trx_need_recovery_list, trx);
             } else {
-                SLIST_ADD_LAST(list_node, rseg->trx_free_list, trx);
+                trx->recv_state = TRX_RECV_NONE;
+                trx_rseg_push_free_trx(rseg, trx);
             }
         }
     }
@@ -85,38 +97,25 @@ status_t trx_sys_init_at_db_start(bool32 is_create_database)
     return CM_SUCCESS;
 }
 
+// The trxs active at crash are not rolled back here, database is opened at once
+// and they are rolled back by trx_rollback_recovered_thread in background.
+// Their slots stay active until then, the sessions touching their rows wait for them
+// in wait_transaction_end or roll them back by themselves.
 status_t trx_sys_recovery_at_db_start()
 {
     status_t err;
-    trx_rseg_t* rseg;
-    trx_t* trx;
-
-    // rollback transaction
-    for (uint32 rseg_id = 0; rseg_id < trx_sys->rseg_count; rseg_id++) {
-        rseg = TRX_GET_RSEG(rseg_id);
-        trx = SLIST_GET_FIRST(rseg->trx_need_recovery_list);
-        while (trx) {
-            SLIST_REMOVE_FIRST(list_node, rseg->trx_need_recovery_list);
-
-            //
-
 
-            trx = SLIST_GET_FIRST(rseg->trx_need_recovery_list);
-        }
-    }
-
-    // undo tablespace
+    // undo tablespace, the undo pages of rolled back trxs are freed to it
     for (uint32 i = 0; i < trx_sys->undo_space_count; i++) {
         err = undo_fsm_recovery_fsp_pages(FIL_UNDO_START_SPACE_ID + i);
         CM_RETURN_IF_ERROR(err);
     }
 
-    return CM_SUCCESS;
-}
-
+    LOGGER_NOTICE(LOGGER, LOG_MODULE_TRX,
+        "trx_sys_recovery_at_db_start: %d transactions to be rolled back in background",
+        trx_sys->recv_trx_count);
 
-void trx_undo_insert_cleanup(trx_t* trx)
-{
+    return CM_SUCCESS;
 }
 
 #define TRX_SYS_TRX_ID_WRITE_MARGIN         256
@@ -177,28 +176,80 @@ uint64 trx_scn_inc(que_sess_t* sess, time_t init_time)
 }
 
 
-static inline void trx_commit_fast_clean(que_sess_t* sess, trx_t* trx, scn_t scn)
+static int trx_fast_clean_block_cmp(const void* a, const void* b)
+{
+    const fast_clean_block_t* block1 = *(const fast_clean_block_t **)a;
+    const fast_clean_block_t* block2 = *(const fast_clean_block_t **)b;
+
+    if (block1->space_id != block2->space_id) {
+        return block1->space_id < block2->space_id ? -1 : 1;
+    }
+    if (block1->page_no != block2->page_no) {
+        return block1->page_no < block2->page_no ? -1 : 1;
+    }
+    return 0;
+}
+
+// Cleans itls of a batch of pages in one mini-transaction with one redo record,
+// pages are latched in order of page id. A page evicted already is skipped,
+// the reader cleans it when the page is loaded again.
+static void trx_fast_clean_batch(trx_t* trx, fast_clean_block_t** clean_blocks, uint32 count, scn_t scn)
 {
-    uint32 clean_block_count = sess->fast_clean_mgr.get_clean_block_count();
     mtr_t mtr;
+    heap_cleanout_page_t pages[HEAP_CLEANOUT_MAX_PAGES];
+    uint32 page_count = 0;
 
-    for (uint32 i = 0; i < clean_block_count; i++) {
-        mtr_start(&mtr);
+    qsort(clean_blocks, count, sizeof(fast_clean_block_t *), trx_fast_clean_block_cmp);
 
-        fast_clean_block_t* clean_block = sess->fast_clean_mgr.find_clean_block(i);
-        const page_id_t page_id(clean_block->space_id, clean_block->page_no);
-        const page_size_t page_size(clean_block->space_id);
+    mtr_start(&mtr);
+
+    for (uint32 i = 0; i < count; i++) {
+        const page_id_t page_id(clean_blocks[i]->space_id, clean_blocks[i]->page_no);
+        const page_size_t page_size(clean_blocks[i]->space_id);
         buf_block_t* block = buf_page_get_gen(page_id, page_size,
-            RW_X_LATCH, clean_block->block, Page_fetch::PEEK_IF_IN_POOL, &mtr);
+            RW_X_LATCH, clean_blocks[i]->block, Page_fetch::PEEK_IF_IN_POOL, &mtr);
         if (block == NULL) {
             continue;
         }
+        pages[page_count].block = block;
+        pages[page_count].itl_id = clean_blocks[i]->itl_id;
+        page_count++;
+    }
 
-        // set itl status and fsc of data page
-        heap_set_itl_trx_end(block, trx->trx_slot_id, clean_block->itl_id, scn, &mtr);
+    // set itl status and fsc of data pages
+    if (page_count > 0) {
+        heap_cleanout_itls(pages, page_count, trx->trx_slot_id, scn, &mtr);
+    }
 
-        mtr_commit(&mtr);
+    mtr_commit(&mtr);
+}
+
+static inline void trx_commit_fast_clean(que_sess_t* sess, trx_t* trx, scn_t scn)
+{
+    uint32 clean_block_count = sess->fast_clean_mgr.get_clean_block_count();
+    fast_clean_block_t* clean_blocks[HEAP_CLEANOUT_MAX_PAGES];
+    uint32 batch_count = 0;
+
+    for (uint32 i = 0; i < clean_block_count; i++) {
+        fast_clean_block_t* clean_block = sess->fast_clean_mgr.find_clean_block(i);
+
+        // bound the commit latency, the other pages are cleaned in background
+        if (i >= srv_fast_clean_max_pages) {
+            buf_delayed_cleanout_add(clean_block->space_id, clean_block->page_no,
+                clean_block->block, trx->trx_slot_id.id, clean_block->itl_id, scn);
+            continue;
+        }
+
+        clean_blocks[batch_count++] = clean_block;
+        if (batch_count == HEAP_CLEANOUT_MAX_PAGES) {
+            trx_fast_clean_batch(trx, clean_blocks, batch_count, scn);
+            batch_count = 0;
+        }
+    }
+    if (batch_count > 0) {
+        trx_fast_clean_batch(trx, clean_blocks, batch_count, scn);
     }
+
     sess->fast_clean_mgr.clean();
 }
 
@@ -211,9 +262,7 @@ inline trx_t* trx_begin(que_sess_t* sess)
 static inline void trx_commit_in_memory(que_sess_t* sess, trx_t* trx, scn_t scn)
 {
     // undo page
-    if (UT_LIST_GET_LEN(trx->insert_undo) > 0) {
-        trx_undo_insert_cleanup(trx);
-    }
+    trx_undo_cleanup(sess, trx, TRUE, scn);
 
     // set itl status and fsc of data page
     trx_commit_fast_clean(sess,trx, scn);
@@ -225,6 +274,7 @@ inline void trx_commit(que_sess_t* sess, trx_t* trx)
     scn_t scn = trx_rseg_set_end(trx, TRUE);
 
     trx_commit_in_memory(sess, trx, scn);
+    lock_release_all(trx);
 
     trx_rseg_release_trx(trx);
     srv_stats.trx_commits.inc();
@@ -236,15 +286,22 @@ static void trx_rollback_pcr_pages(que_sess_t* sess, trx_t* trx, trx_savepoint_t
 
 static void trx_rollback_one_row(que_sess_t* sess, trx_t* trx, trx_undo_rec_hdr_t* undo_rec, uint32 undo_rec_size)
 {
-    uint16 type = mach_read_from_2(undo_rec + TRX_UNDO_REC_TYPE);
+    uint8 type = mach_read_from_1(undo_rec + TRX_UNDO_REC_TYPE);
     switch (type) {
     case UNDO_HEAP_INSERT:
         heap_undo_insert(sess, trx, undo_rec, undo_rec_size);
         break;
     case UNDO_HEAP_DELETE:
+        heap_undo_delete(sess, trx, undo_rec, undo_rec_size);
         break;
     case UNDO_HEAP_UPDATE:
         break;
+    case UNDO_LOB_INSERT:
+        toast_undo_insert(sess, trx, undo_rec, undo_rec_size);
+        break;
+    case UNDO_LOB_DELETE:
+        // the chain is referenced by the row restored by UNDO_HEAP_DELETE again
+        break;
 
     default:
         ut_error;
@@ -252,20 +309,39 @@ static void trx_rollback_one_row(que_sess_t* sess, trx_t* trx, trx_undo_rec_hdr_
     }
 }
 
-static void trx_rollback_rcr_rows(que_sess_t* sess, trx_t* trx, trx_savepoint_t* savepoint)
+#define TRX_ROLLBACK_RECS_PER_MTR      64
+
+// Undoes the rows of trx from the last undo record, trx may be not the trx of session.
+// The mtr is committed every TRX_ROLLBACK_RECS_PER_MTR records,
+// so a large trx does not hold the latches of its undo pages until the end.
+static void trx_rollback_undo_recs(que_sess_t* sess, trx_t* trx, mtr_t* mtr)
 {
-    mtr_t mtr;
     trx_rollback_undo_mgr_t undo_mgr(trx);
+    uint32 rec_count = 0;
 
-    mtr_start(&mtr);
-    undo_mgr.init(&mtr);
+    undo_mgr.init(mtr);
 
     uint32 undo_rec_size;
     trx_undo_rec_hdr_t* undo_rec = undo_mgr.pop_top_undo_rec(undo_rec_size, mtr);
     while (undo_rec) {
         trx_rollback_one_row(sess, trx, undo_rec, undo_rec_size);
+
+        if (++rec_count % TRX_ROLLBACK_RECS_PER_MTR == 0) {
+            mtr_commit(mtr);
+            undo_mgr.release_blocks();
+            mtr_start(mtr);
+        }
+
         undo_rec = undo_mgr.pop_top_undo_rec(undo_rec_size, mtr);
     }
+}
+
+static void trx_rollback_rcr_rows(que_sess_t* sess, trx_t* trx, trx_savepoint_t* savepoint)
+{
+    mtr_t mtr;
+
+    mtr_start(&mtr);
+    trx_rollback_undo_recs(sess, trx, &mtr);
 
     //for (i = 0; i < heap_assist.rows; i++) {
     //    session->change_list = heap_assist.change_list[i];
@@ -282,16 +358,98 @@ static void trx_rollback_rcr_rows(que_sess_t* sess, trx_t* trx, trx_savepoint_t*
 
 inline void trx_rollback(que_sess_t* sess, trx_t* trx, trx_savepoint_t* savepoint)
 {
-    //
-    trx_rseg_set_end(trx, FALSE);
+    // rows are restored before the slot is ended and the locks are released,
+    // so neither a reader nor a waiter of lock sees a row of the rolled back trx
+    trx_rollback_rcr_rows(sess, trx, savepoint);
+
+    scn_t scn = trx_rseg_set_end(trx, FALSE);
+    trx_undo_cleanup(sess, trx, FALSE, scn);
+    lock_release_all(trx);
 
     trx_rseg_release_trx(trx);
     srv_stats.trx_rollbacks.inc();
+}
 
-    trx_rollback_pages(sess, trx, savepoint);
+#define TRX_ROLLBACK_IDLE_WAIT_US      100000  // 100ms
 
+// Rolls back a trx active at crash, returns FALSE if it is claimed by another thread.
+// The slot is ended after all rows are undone, the waiters of trx see its end then.
+bool32 trx_rollback_recovered(que_sess_t* sess, trx_t* trx)
+{
+    mtr_t mtr;
+
+    if (!atomic32_compare_and_swap(&trx->recv_state, TRX_RECV_WAITING, TRX_RECV_ROLLING)) {
+        return FALSE;
+    }
+
+    mtr_start(&mtr);
+    trx_rollback_undo_recs(sess, trx, &mtr);
+    mtr_commit(&mtr);
 
+    scn_t scn = trx_rseg_set_end(trx, FALSE);
+    trx_undo_cleanup(sess, trx, FALSE, scn);
 
+    atomic32_test_and_set(&trx->recv_state, TRX_RECV_NONE);
+    trx_rseg_release_trx(trx);
+    atomic32_dec(&trx_sys->recv_trx_count);
+    srv_stats.trx_rollbacks.inc();
+
+    return TRUE;
+}
+
+// Called by a session before it waits for the trx of slot,
+// the trx active at crash and not claimed yet is rolled back by the session itself
+bool32 trx_rollback_recovered_by_slot(que_sess_t* sess, trx_slot_id_t slot_id)
+{
+    if (atomic32_get(&trx_sys->recv_trx_count) == 0) {
+        return FALSE;
+    }
+
+    trx_t* trx = &TRX_GET_RSEG_TRX(slot_id);
+    if (trx->trx_slot_id.xnum != slot_id.xnum || atomic32_get(&trx->recv_state) != TRX_RECV_WAITING) {
+        return FALSE;
+    }
+
+    return trx_rollback_recovered(sess, trx);
+}
+
+// Threads start from different rsegs and claim the trxs of recovery lists one by one,
+// the lists are not changed after startup. A thread exits after one pass of all lists.
+void* trx_rollback_recovered_thread(void* arg)
+{
+    uint32 id = *(uint32 *)arg;
+    uint32 rolled_back_count = 0;
+    que_sess_t* sess = NULL;
+
+    LOGGER_INFO(LOGGER, LOG_MODULE_TRX, "trx rollback thread (id = %u) starting ...", id);
+
+    // sessions are created after database is started
+    while (srv_shutdown_state != SHUTDOWN_EXIT_THREADS && atomic32_get(&trx_sys->recv_trx_count) > 0) {
+        if (g_sess_pool != NULL && (sess = que_sess_alloc()) != NULL) {
+            break;
+        }
+        os_thread_sleep(TRX_ROLLBACK_IDLE_WAIT_US);
+    }
+
+    for (uint32 i = 0; sess != NULL && i < trx_sys->rseg_count; i++) {
+        trx_rseg_t* rseg = TRX_GET_RSEG((id + i) % trx_sys->rseg_count);
+        trx_t* trx = SLIST_GET_FIRST(rseg->trx_need_recovery_list);
+        while (trx && srv_shutdown_state != SHUTDOWN_EXIT_THREADS) {
+            if (trx_rollback_recovered(sess, trx)) {
+                rolled_back_count++;
+            }
+            trx = SLIST_GET_NEXT(list_node, trx);
+        }
+    }
+
+    if (sess) {
+        que_sess_free(sess);
+    }
+
+    LOGGER_INFO(LOGGER, LOG_MODULE_TRX, "trx rollback thread (id = %u) exited, rolled back %u transactions",
+        id, rolled_back_count);
+
+    return NULL;
 }
 
 inline void trx_savepoint(que_sess_t* sess, trx_t* trx, trx_savepoint_t* savepoint)
@@ -308,13 +466,30 @@ inline void trx_savepoint(que_sess_t* sess, trx_t* trx, trx_savepoint_t* savepoi
     }
 }
 
+// Called before the first modification of statement, slot of trx is begun here
 inline void trx_start_if_not_started(que_sess_t* sess)
 {
-    if (sess->trx) {
-        return;
+    if (sess->trx == NULL) {
+        sess->trx = trx_rseg_assign_and_alloc_trx();
+        ut_a(sess->trx);
     }
 
-    sess->trx = trx_rseg_assign_and_alloc_trx();
-    ut_a(sess->trx);
+    trx_rseg_begin_slot(sess->trx);
+}
+
+// The snapshot is published before it is taken, purge computing the oldest snapshot
+// at the same time either sees the placeholder or gets a scn not newer than it.
+uint64 trx_open_snapshot(que_sess_t* sess)
+{
+    atomic64_test_and_set(&sess->query_scn, 1);
+    uint64 query_scn = trx_get_query_scn();
+    atomic64_test_and_set(&sess->query_scn, query_scn);
+
+    return query_scn;
+}
+
+void trx_close_snapshot(que_sess_t* sess)
+{
+    atomic64_test_and_set(&sess->query_scn, 0);
 }
 
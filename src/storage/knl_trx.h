@@ -100,7 +100,12 @@ typedef struct st_xa_id {
         } while (0)
 
 #define TRX_SCN_INC(scn)           ((uint64)atomic64_inc(scn))
-#define TRX_SCN_GET(scn)           ((uint64)atomic64_get(scn))
+// plain load of aligned 64 bits, no locked instruction on the path of snapshot
+#ifdef __WIN__
+#define TRX_SCN_GET(scn)           ((uint64)(*(scn)))
+#else
+#define TRX_SCN_GET(scn)           ((uint64)__atomic_load_n(scn, __ATOMIC_ACQUIRE))
+#endif
 #define TRX_SCN_IS_INVALID(scn)    ((scn) == 0 || (scn) == UINT_MAX64)
 
 
@@ -110,6 +115,8 @@ typedef struct st_xa_id {
 extern status_t trx_sys_create(memory_pool_t* mem_pool, uint32 rseg_count, uint32 undo_space_count);
 extern status_t trx_sys_init_at_db_start(bool32 is_create_database);
 extern status_t trx_sys_recovery_at_db_start();
+extern bool32 trx_rollback_recovered(que_sess_t* sess, trx_t* trx);
+extern void* trx_rollback_recovered_thread(void* arg);
 extern status_t trx_sys_create(memory_pool_t* mem_pool);
 
 extern inline trx_t* trx_begin(que_sess_t* sess);
@@ -119,6 +126,9 @@ extern inline void trx_savepoint(que_sess_t* sess, trx_t* trx, trx_savepoint_t*
 
 extern inline void trx_start_if_not_started(que_sess_t* sess);
 
+extern uint64 trx_open_snapshot(que_sess_t* sess);
+extern void trx_close_snapshot(que_sess_t* sess);
+
 //-----------------------------------------------------------------
 
 
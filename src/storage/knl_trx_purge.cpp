@@ -0,0 +1,245 @@
+#include "knl_trx_purge.h"
+#include "cm_log.h"
+#include "cm_thread.h"
+#include "knl_buf.h"
+#include "knl_heap_toast.h"
+#include "knl_session.h"
+#include "knl_trx.h"
+#include "knl_trx_rseg.h"
+#include "knl_trx_undo.h"
+#include "knl_undo_fsm.h"
+
+#define PURGE_MAX_BATCH_SIZE        4096
+#define PURGE_BACKLOG_DIVISOR       4       // a round purges a quarter of backlog at most
+#define PURGE_IDLE_WAIT_US          100000  // 100ms
+
+const page_size_t undo_log_page_size(DB_UNDO_START_SPACE_ID);
+
+static purge_sys_t  g_purge_sys;
+purge_sys_t*        purge_sys = &g_purge_sys;
+
+status_t trx_purge_sys_create(uint32 worker_count)
+{
+    ut_a(worker_count > 0 && worker_count <= SRV_MAX_PURGE_THREADS);
+
+    memset(purge_sys, 0, sizeof(purge_sys_t));
+    purge_sys->worker_count = worker_count;
+    purge_sys->done_event = os_event_create(NULL);
+    for (uint32 i = 0; i < worker_count; i++) {
+        purge_sys->workers[i].id = i;
+        purge_sys->workers[i].event = os_event_create(NULL);
+    }
+
+    return CM_SUCCESS;
+}
+
+// Global query scn is read before the snapshots of sessions,
+// a snapshot opened after it is not older than it.
+static inline uint64 trx_purge_get_scn()
+{
+    uint64 scn = trx_get_query_scn();
+    return g_sess_pool->get_min_query_scn(scn);
+}
+
+// The batch grows with backlog, a long update list is purged faster
+static inline uint32 trx_purge_get_batch_size(uint32 backlog)
+{
+    uint32 batch_size = backlog / PURGE_BACKLOG_DIVISOR;
+    batch_size = ut_max(batch_size, srv_purge_batch_size);
+    return ut_min(batch_size, PURGE_MAX_BATCH_SIZE);
+}
+
+// Frees the toast chain of a lob delete record page by page, the first page of chain in
+// the record is moved in the mtr freeing a page, so a page is never freed twice after crash.
+static void trx_purge_lob_delete(const page_id_t& undo_page_id, uint32 rec_offset)
+{
+    mtr_t mtr;
+    toast_pointer_t pointer;
+
+    for (;;) {
+        mtr_start(&mtr);
+
+        buf_block_t* block = buf_page_get(undo_page_id, undo_log_page_size, RW_X_LATCH, &mtr);
+        byte* data = buf_block_get_frame(block) + rec_offset + TRX_UNDO_REC_DATA;
+        pointer.space_id = mach_read_from_4(data);
+        pointer.page_no = mach_read_from_4(data + 4);
+        if (!toast_free_first_page(&pointer, &mtr)) {
+            mtr_commit(&mtr);
+            break;
+        }
+        mlog_write_uint32(data + 4, pointer.page_no, MLOG_4BYTES, &mtr);
+
+        mtr_commit(&mtr);
+    }
+}
+
+// Frees the toast chains of values deleted by the transactions of an undo page detached
+// from update list. Records are walked backward from the free offset by their start offsets,
+// skipping the log headers of the page, the page is unlatched while a chain is freed.
+static void trx_purge_undo_page(uint32 space_id, uint32 page_no)
+{
+    mtr_t mtr;
+    const page_id_t page_id(space_id, page_no);
+    uint32 start, end, log_offset;
+
+    mtr_start(&mtr);
+    page_t* page = buf_block_get_frame(buf_page_get(page_id, undo_log_page_size, RW_S_LATCH, &mtr));
+    start = mach_read_from_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_START);
+    end = mach_read_from_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE);
+    log_offset = mach_read_from_2(page + TRX_UNDO_SEG_HDR + TRX_UNDO_LAST_LOG);
+    mtr_commit(&mtr);
+
+    for (;;) {
+        uint32 lob_rec_offset = 0;
+
+        mtr_start(&mtr);
+        page = buf_block_get_frame(buf_page_get(page_id, undo_log_page_size, RW_S_LATCH, &mtr));
+        while (end > start && lob_rec_offset == 0) {
+            if (log_offset != 0xFFFF && end <= log_offset + TRX_UNDO_LOG_HDR_SIZE) {
+                end = log_offset;
+                log_offset = mach_read_from_2(page + log_offset + TRX_UNDO_PREV_LOG);
+                continue;
+            }
+            uint32 rec_offset = mach_read_from_2(page + end - 2);
+            ut_a(rec_offset >= start && rec_offset < end);
+            if (mach_read_from_1(page + rec_offset + TRX_UNDO_REC_TYPE) == UNDO_LOB_DELETE) {
+                lob_rec_offset = rec_offset;
+            }
+            end = rec_offset;
+        }
+        mtr_commit(&mtr);
+
+        if (lob_rec_offset == 0) {
+            break;
+        }
+        trx_purge_lob_delete(page_id, lob_rec_offset);
+    }
+}
+
+static uint32 trx_purge_pages(uint32 space_id, uint64 purge_scn, uint32 max_count)
+{
+    undo_fsm_page_t pages[UNDO_FSM_PURGE_PAGES_PER_MTR];
+    uint32 purged_count = 0;
+
+    while (purged_count < max_count) {
+        uint32 batch_count = ut_min(max_count - purged_count, UNDO_FSM_PURGE_PAGES_PER_MTR);
+        uint32 count = undo_fsm_get_purge_pages(space_id, purge_scn, pages, batch_count);
+
+        for (uint32 i = 0; i < count; i++) {
+            trx_purge_undo_page(space_id, pages[i].page_no);
+            undo_fsm_free_page(space_id, pages[i], UNDO_PAGE_TYPE_INSERT, 0);
+        }
+        purged_count += count;
+
+        if (count < batch_count) {
+            break;
+        }
+    }
+
+    return purged_count;
+}
+
+static void trx_purge_run_tasks(purge_worker_t* worker)
+{
+    for (uint32 i = worker->id; i < purge_sys->task_count; i += purge_sys->worker_count) {
+        purge_task_t* task = &purge_sys->tasks[i];
+        task->purged_count = trx_purge_pages(task->space_id, purge_sys->purge_scn, task->batch_size);
+    }
+}
+
+// Returns TRUE if some undo tablespace has more pages to purge
+static bool32 trx_purge_round()
+{
+    purge_sys->purge_scn = trx_purge_get_scn();
+
+    purge_sys->task_count = 0;
+    for (uint32 i = 0; i < trx_sys->undo_space_count; i++) {
+        uint32 space_id = FIL_UNDO_START_SPACE_ID + i;
+        uint32 backlog = undo_fsm_get_update_page_count(space_id);
+        if (backlog == 0) {
+            continue;
+        }
+
+        purge_task_t* task = &purge_sys->tasks[purge_sys->task_count++];
+        task->space_id = space_id;
+        task->batch_size = trx_purge_get_batch_size(backlog);
+        task->purged_count = 0;
+    }
+    if (purge_sys->task_count == 0) {
+        return FALSE;
+    }
+
+    // start the round, the tasks are visible to workers before the round is changed
+    uint64 signal_count = os_event_reset(purge_sys->done_event);
+    atomic32_test_and_set(&purge_sys->running_count, (int32)purge_sys->worker_count);
+    atomic32_inc(&purge_sys->round);
+    for (uint32 i = 0; i < purge_sys->worker_count; i++) {
+        os_event_set(purge_sys->workers[i].event);
+    }
+
+    while (atomic32_get(&purge_sys->running_count) > 0) {
+        if (srv_shutdown_state == SHUTDOWN_EXIT_THREADS) {
+            return FALSE;
+        }
+        os_event_wait_time(purge_sys->done_event, PURGE_IDLE_WAIT_US, signal_count);
+        signal_count = os_event_reset(purge_sys->done_event);
+    }
+
+    bool32 has_backlog = FALSE;
+    for (uint32 i = 0; i < purge_sys->task_count; i++) {
+        purge_task_t* task = &purge_sys->tasks[i];
+        purge_sys->purged_pages += task->purged_count;
+        if (task->purged_count == task->batch_size) {
+            has_backlog = TRUE;
+        }
+    }
+
+    return has_backlog;
+}
+
+void* trx_purge_coordinator_thread(void* arg)
+{
+    LOGGER_INFO(LOGGER, LOG_MODULE_UNDO, "purge coordinator thread starting ...");
+
+    while (srv_shutdown_state != SHUTDOWN_EXIT_THREADS) {
+        if (!trx_purge_round()) {
+            os_thread_sleep(PURGE_IDLE_WAIT_US);
+        }
+    }
+
+    // wake up workers to exit
+    for (uint32 i = 0; i < purge_sys->worker_count; i++) {
+        os_event_set(purge_sys->workers[i].event);
+    }
+
+    LOGGER_INFO(LOGGER, LOG_MODULE_UNDO, "purge coordinator thread exited, purged pages %llu",
+        purge_sys->purged_pages);
+
+    return NULL;
+}
+
+void* trx_purge_worker_thread(void* arg)
+{
+    purge_worker_t* worker = &purge_sys->workers[*(uint32 *)arg];
+    int32 round = 0;
+
+    LOGGER_INFO(LOGGER, LOG_MODULE_UNDO, "purge worker thread (id = %u) starting ...", worker->id);
+
+    while (srv_shutdown_state != SHUTDOWN_EXIT_THREADS) {
+        uint64 signal_count = os_event_reset(worker->event);
+        if (atomic32_get(&purge_sys->round) == round) {
+            os_event_wait_time(worker->event, PURGE_IDLE_WAIT_US, signal_count);
+            continue;
+        }
+
+        round = atomic32_get(&purge_sys->round);
+        trx_purge_run_tasks(worker);
+        if (atomic32_dec(&purge_sys->running_count) == 0) {
+            os_event_set(purge_sys->done_event);
+        }
+    }
+
+    LOGGER_INFO(LOGGER, LOG_MODULE_UNDO, "purge worker thread (id = %u) exited", worker->id);
+
+    return NULL;
+}
@@ -0,0 +1,44 @@
+#ifndef _KNL_TRX_PURGE_H
+#define _KNL_TRX_PURGE_H
+
+#include "cm_type.h"
+#include "cm_mutex.h"
+#include "knl_defs.h"
+#include "knl_server.h"
+
+// Purge moves the pages of committed update undo, which are not visible to any snapshot,
+// from update list to free list of undo tablespace in background, so that allocating
+// undo pages does not wait for retention or reuse the pages needed by consistent read.
+// A round is run by coordinator, the undo tablespaces with backlog are divided among workers.
+// Before a page is freed, the toast chains of the values deleted by its records are freed.
+
+typedef struct st_purge_task {
+    uint32          space_id;
+    uint32          batch_size;    // pages to purge in this round at most
+    uint32          purged_count;
+} purge_task_t;
+
+typedef struct st_purge_worker {
+    uint32          id;
+    os_event_t      event;         // set by coordinator when a round is started
+} purge_worker_t;
+
+typedef struct st_purge_sys {
+    uint64          purge_scn;     // undo committed before it is invisible to all snapshots
+    atomic32_t      round;         // number of round, changed after the tasks are ready
+    atomic32_t      running_count; // workers not finished the round
+    os_event_t      done_event;    // set by the last worker finishing the round
+    uint32          task_count;
+    purge_task_t    tasks[DB_UNDO_SPACE_MAX_COUNT];
+    uint32          worker_count;
+    purge_worker_t  workers[SRV_MAX_PURGE_THREADS];
+    uint64          purged_pages;
+} purge_sys_t;
+
+extern status_t trx_purge_sys_create(uint32 worker_count);
+extern void* trx_purge_coordinator_thread(void* arg);
+extern void* trx_purge_worker_thread(void* arg);
+
+extern purge_sys_t*  purge_sys;
+
+#endif  /* _KNL_TRX_PURGE_H */
@@ -1,6 +1,7 @@
 #include "knl_trx_rseg.h"
 
 #include "cm_log.h"
+#include "cm_timer.h"
 
 #include "knl_trx.h"
 #include "knl_buf.h"
@@ -9,6 +10,7 @@
 
 
 const page_size_t systrans_page_size(DB_SYSTRANS_SPACE_ID);
+const page_size_t undo_log_page_size(DB_UNDO_START_SPACE_ID);
 
 static const uint32  trx_slot_count_per_page = TRX_SLOT_COUNT_PER_PAGE;
 
@@ -251,10 +253,13 @@ status_t trx_rseg_open_trx_slots(trx_rseg_t* rseg)
             trx->trx_slot_id.rseg_id = rseg->id;
             trx->trx_slot_id.slot = slot_idx;
             trx->trx_slot_id.xnum = slot->xnum;
+            trx->status_version = 0;
             if (slot->status == XACT_END) {
                 trx->is_active = FALSE;
+                trx->is_slot_begun = FALSE;
             } else {
                 trx->is_active = TRUE;
+                trx->is_slot_begun = TRUE;
             }
         }
     }
@@ -264,6 +269,93 @@ status_t trx_rseg_open_trx_slots(trx_rseg_t* rseg)
     return CM_SUCCESS;
 }
 
+// Rebuilds the list of undo pages of an undo log from its segment page and the page list of segment,
+// pages are fixed as those of an active trx, the fsm nodes are set by undo_fsm_recovery_fsp_pages.
+static status_t trx_rseg_open_undo_pages(trx_rseg_t* rseg, uint32 page_no, trx_undo_page_base& undo_page_base)
+{
+    mtr_t mtr;
+    fil_addr_t next_addr;
+
+    while (page_no != FIL_NULL) {
+        trx_undo_page_t* undo_page = trx_rseg_alloc_free_undo_page(rseg);
+        if (undo_page == NULL) {
+            CM_SET_ERROR(ERR_NO_FREE_UNDO_PAGE);
+            return CM_ERROR;
+        }
+
+        mtr_start(&mtr);
+
+        page_id_t page_id(rseg->undo_space_id, page_no);
+        buf_block_t* block = buf_page_get(page_id, undo_log_page_size, RW_S_LATCH, &mtr);
+        page_t* page = buf_block_get_frame(block);
+        buf_page_fix(&block->page);
+
+        undo_page->page_no = page_no;
+        undo_page->page_offset = mach_read_from_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE);
+        undo_page->scn_timestamp = 0;
+        undo_page->node_page_no = 0;
+        undo_page->node_page_offset = 0;
+        undo_page->guess_block = block;
+        SLIST_ADD_LAST(list_node, undo_page_base, undo_page);
+
+        if (SLIST_GET_LEN(undo_page_base) == 1) {
+            next_addr = flst_get_first(page + TRX_UNDO_SEG_HDR + TRX_UNDO_PAGE_LIST, &mtr);
+        } else {
+            next_addr = flst_get_next_addr(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FLST_NODE, &mtr);
+        }
+
+        mtr_commit(&mtr);
+
+        page_no = fil_addr_is_null(next_addr) ? FIL_NULL : next_addr.page;
+    }
+
+    return CM_SUCCESS;
+}
+
+// Rebuilds the undo page lists of a trx active at crash, which are rolled back from them
+status_t trx_rseg_open_trx_undo(trx_t* trx)
+{
+    trx_rseg_t* rseg = TRX_GET_RSEG(trx->trx_slot_id.rseg_id);
+    trx_slot_t* slot = (trx_slot_t *)TRX_GET_RSEG_TRX_SLOT(trx->trx_slot_id);
+
+    SLIST_INIT(trx->insert_undo);
+    SLIST_INIT(trx->update_undo);
+
+    CM_RETURN_IF_ERROR(trx_rseg_open_undo_pages(rseg, slot->insert_page_no, trx->insert_undo));
+    CM_RETURN_IF_ERROR(trx_rseg_open_undo_pages(rseg, slot->update_page_no, trx->update_undo));
+
+    return CM_SUCCESS;
+}
+
+// Finds the undo page of a trx active at crash, NULL if page is not used by them
+trx_undo_page_t* trx_rseg_find_recovered_undo_page(uint32 undo_space_id, uint32 page_no)
+{
+    for (uint32 rseg_id = 0; rseg_id < trx_sys->rseg_count; rseg_id++) {
+        trx_rseg_t* rseg = TRX_GET_RSEG(rseg_id);
+        if (rseg->undo_space_id != undo_space_id) {
+            continue;
+        }
+
+        trx_t* trx = SLIST_GET_FIRST(rseg->trx_need_recovery_list);
+        for (; trx != NULL; trx = SLIST_GET_NEXT(list_node, trx)) {
+            trx_undo_page_t* undo_page = SLIST_GET_FIRST(trx->insert_undo);
+            for (; undo_page != NULL; undo_page = SLIST_GET_NEXT(list_node, undo_page)) {
+                if (undo_page->page_no == page_no) {
+                    return undo_page;
+                }
+            }
+            undo_page = SLIST_GET_FIRST(trx->update_undo);
+            for (; undo_page != NULL; undo_page = SLIST_GET_NEXT(list_node, undo_page)) {
+                if (undo_page->page_no == page_no) {
+                    return undo_page;
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
 static void trx_rseg_trx_slot_page_init(trx_rseg_t* rseg, uint32 slot_page_index, buf_block_t* block)
 {
     page_t* page = buf_block_get_frame(block);
@@ -292,7 +384,9 @@ static void trx_rseg_trx_slot_page_init(trx_rseg_t* rseg, uint32 slot_page_index
         trx->trx_slot_id.rseg_id = rseg->id;
         trx->trx_slot_id.slot = slot_idx;
         trx->trx_slot_id.xnum = 0;
+        trx->status_version = 0;
         trx->is_active = FALSE;
+        trx->is_slot_begun = FALSE;
     }
 }
 
@@ -356,24 +450,66 @@ status_t trx_sys_reserve_systrans_space()
     return err;
 }
 
-static inline trx_t* trx_rseg_alloc_trx(trx_rseg_t* rseg)
+#define TRX_FREE_STACK_TOP(stack)        (uint32)((uint64)(stack) & 0xFFFFFFFF)
+#define TRX_FREE_STACK_MAKE(tag, top)    (int64)(((uint64)(tag) << 32) | (top))
+#define TRX_FREE_STACK_NEXT_TAG(stack)   (((uint64)(stack) >> 32) + 1)
+
+// The tag is changed by every push and pop, a stale top never succeeds in compare and swap
+inline void trx_rseg_push_free_trx(trx_rseg_t* rseg, trx_t* trx)
 {
+    int64 old_stack, new_stack;
+
+    do {
+        old_stack = atomic64_get(&rseg->trx_free_stack);
+        trx->free_next = TRX_FREE_STACK_TOP(old_stack);
+        new_stack = TRX_FREE_STACK_MAKE(TRX_FREE_STACK_NEXT_TAG(old_stack), trx->trx_slot_id.slot);
+    } while (!atomic64_compare_and_swap(&rseg->trx_free_stack, old_stack, new_stack));
+}
+
+static inline trx_t* trx_rseg_pop_free_trx(trx_rseg_t* rseg)
+{
+    int64 old_stack, new_stack;
     trx_t* trx;
 
-    // get trx from trx_free_list
-    mutex_enter(&rseg->trx_mutex);
-    trx = SLIST_GET_FIRST(rseg->trx_free_list);
-    if (trx) {
-        SLIST_REMOVE_FIRST(list_node, rseg->trx_free_list);
-    }
-    mutex_exit(&rseg->trx_mutex);
+    do {
+        old_stack = atomic64_get(&rseg->trx_free_stack);
+        if (TRX_FREE_STACK_TOP(old_stack) == TRX_FREE_STACK_EMPTY) {
+            return NULL;
+        }
+        trx = &rseg->trx_list[TRX_FREE_STACK_TOP(old_stack)];
+        new_stack = TRX_FREE_STACK_MAKE(TRX_FREE_STACK_NEXT_TAG(old_stack), trx->free_next);
+    } while (!atomic64_compare_and_swap(&rseg->trx_free_stack, old_stack, new_stack));
+
+    return trx;
+}
+
+static inline trx_t* trx_rseg_alloc_trx(trx_rseg_t* rseg)
+{
+    trx_t* trx = trx_rseg_pop_free_trx(rseg);
 
     if (UNLIKELY(trx == NULL)) {
         //CM_SET_ERROR(ERR_TOO_MANY_PENDING_TRANS);
         return NULL;
     }
 
+    trx->is_slot_begun = FALSE;
+    SLIST_INIT(trx->insert_undo);
+    SLIST_INIT(trx->update_undo);
+
+    return trx;
+}
+
+// Writes the begin of slot, called by the first modification of trx
+inline void trx_rseg_begin_slot(trx_t* trx)
+{
+    trx_rseg_t* rseg = TRX_GET_RSEG(trx->trx_slot_id.rseg_id);
     mtr_t mtr;
+
+    if (trx->is_slot_begun) {
+        return;
+    }
+    trx->is_slot_begun = TRUE;
+
     mtr_start(&mtr);
 
     // get slot
@@ -401,13 +537,13 @@ static inline trx_t* trx_rseg_alloc_trx(trx_rseg_t* rseg)
     //
     mutex_enter(&trx->mutex, NULL);
     ut_ad(trx->is_active == FALSE);
+    atomic32_inc(&trx->status_version);
     trx->is_active = TRUE;
     slot->status = XACT_BEGIN;
     slot->xnum++;
     trx->trx_slot_id.xnum = slot->xnum;
+    atomic32_inc(&trx->status_version);
     mutex_exit(&trx->mutex);
-    SLIST_INIT(trx->insert_undo);
-    SLIST_INIT(trx->update_undo);
 
     // lock block
     buf_block_lock_and_fix(guess_block, RW_X_LATCH, &mtr);
@@ -425,14 +561,13 @@ static inline trx_t* trx_rseg_alloc_trx(trx_rseg_t* rseg)
     mlog_catenate_uint64(&mtr, trx->trx_slot_id.id);
 
     mtr_commit(&mtr);
-
-    return trx;
 }
 
+// Starts from the rseg of current cpu, the trxs running on a cpu share the free stack of one rseg
 inline trx_t* trx_rseg_assign_and_alloc_trx()
 {
     trx_t* trx = NULL;
-    uint64 index = os_thread_get_internal_id();
+    uint64 index = os_thread_get_cpu_id();
 
     for (uint32 i = 0; i < trx_sys->rseg_count; i++) {
         trx_rseg_t* rseg = &trx_sys->rseg_array[(index + i) & (trx_sys->rseg_count - 1)];
@@ -445,43 +580,59 @@ inline trx_t* trx_rseg_assign_and_alloc_trx()
     return trx;
 }
 
+// While the clock does not move, scn is only increased by one fetch-add,
+// the sequence may overflow into usec bits, scn runs a little ahead of clock then.
+// The first caller after a clock tick moves scn forward to the time of clock.
 static inline uint64 trx_inc_scn(time_t init_time, struct timeval* now, uint64 seq, atomic64_t* scn)
 {
-    uint64 curr_scn;
+    uint64 curr_scn, old_scn;
 
     if (now->tv_sec < init_time) {
-        return atomic64_inc(scn);
-    }
-
-    curr_scn = TRX_TIMESEQ_TO_SCN(now, init_time, seq);
-    if (curr_scn <= TRX_SCN_GET(scn)) {
         return TRX_SCN_INC(scn);
     }
 
-    while (TRX_SCN_GET(scn) < curr_scn && !atomic64_compare_and_swap(scn, TRX_SCN_GET(scn), curr_scn)) {
-        // nothing to do
+    curr_scn = TRX_TIMESEQ_TO_SCN(now, init_time, seq);
+    old_scn = TRX_SCN_GET(scn);
+    while (old_scn < curr_scn) {
+        if (atomic64_compare_and_swap(scn, old_scn, curr_scn)) {
+            return curr_scn;
+        }
+        old_scn = TRX_SCN_GET(scn);
     }
 
-    return curr_scn;
+    return TRX_SCN_INC(scn);
 }
 
+// Commit scn, the time part is taken from the coarse clock cached by cm_timer
 inline uint64 trx_get_next_scn()
 {
     uint64 seq = 1;
     uint64 scn;
     struct timeval now;
 
-    get_time_of_day(&now);
+    cm_date2timeval(g_timer()->now_us, &now);
 
     scn = trx_inc_scn(trx_sys->init_time, &now, seq, &trx_sys->scn);
 
     return scn;
 }
 
+// Snapshot scn, it is not less than the scn of any trx committed before
+inline uint64 trx_get_query_scn()
+{
+    return TRX_SCN_GET(&trx_sys->scn);
+}
+
 inline scn_t trx_rseg_set_end(trx_t* trx, bool32 is_commit)
 {
     mtr_t mtr;
     trx_slot_t* slot;
+
+    // read only trx, slot is not begun
+    if (!trx->is_slot_begun) {
+        return trx_get_query_scn();
+    }
+
     uint64 scn = trx_get_next_scn();
 
     mtr_start(&mtr);
@@ -501,9 +652,11 @@ inline scn_t trx_rseg_set_end(trx_t* trx, bool32 is_commit)
 
     //
     mutex_enter(&trx->mutex, NULL);
+    atomic32_inc(&trx->status_version);
     slot->scn = scn;
     slot->status = XACT_END;
     trx->is_active = FALSE;
+    atomic32_inc(&trx->status_version);
     mutex_exit(&trx->mutex);
 
     // lock block
@@ -524,26 +677,35 @@ inline void trx_rseg_release_trx(trx_t* trx)
 {
     trx_rseg_t* rseg = TRX_GET_RSEG(trx->trx_slot_id.rseg_id);
 
-    ut_ad(trx->is_active);
+    ut_ad(!trx->is_active);
 
-    mutex_enter(&rseg->trx_mutex);
-    SLIST_ADD_LAST(list_node, rseg->trx_free_list, trx);
-    mutex_exit(&rseg->trx_mutex);
+    trx_rseg_push_free_trx(rseg, trx);
 }
 
+// Lock free, the status of slot is read between two equal even versions
 inline void trx_get_status_by_itl(trx_slot_id_t trx_slot_id, trx_status_t* trx_status)
 {
     trx_slot_t snapshot;
     bool32 is_active;
-    trx_slot_t* slot = (trx_slot_t *)TRX_GET_RSEG_TRX_SLOT(trx_slot_id);
+    int32 version;
+    volatile trx_slot_t* slot = (trx_slot_t *)TRX_GET_RSEG_TRX_SLOT(trx_slot_id);
     trx_t* trx = &TRX_GET_RSEG_TRX(trx_slot_id);
 
-    mutex_enter(&trx->mutex, NULL);
-    snapshot.xnum = slot->xnum;
-    snapshot.status = slot->status;
-    snapshot.scn = slot->scn;
-    is_active = trx->is_active;
-    mutex_exit(&trx->mutex);
+    for (;;) {
+        version = atomic32_get(&trx->status_version);
+        if (version & 1) {
+            continue;
+        }
+        snapshot.xnum = slot->xnum;
+        snapshot.status = slot->status;
+        snapshot.scn = slot->scn;
+        is_active = *(volatile bool32 *)&trx->is_active;
+        // the snapshot reads must not pass the reread of version
+        os_rmb;
+        if (atomic32_get(&trx->status_version) == version) {
+            break;
+        }
+    }
 
     if (snapshot.xnum == trx_slot_id.xnum) {
         trx_status->is_ow_scn = FALSE;
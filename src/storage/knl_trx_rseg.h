@@ -20,15 +20,20 @@ extern status_t trx_sys_reserve_systrans_space();
 
 extern status_t trx_rseg_open_trx_slots(trx_rseg_t* rseg);
 extern status_t trx_rseg_create_trx_slots(trx_rseg_t* rseg);
+extern status_t trx_rseg_open_trx_undo(trx_t* trx);
+extern trx_undo_page_t* trx_rseg_find_recovered_undo_page(uint32 undo_space_id, uint32 page_no);
 extern status_t trx_rseg_undo_page_init(trx_rseg_t* rseg);
 
 extern inline trx_undo_page_t* trx_rseg_alloc_free_undo_page(trx_rseg_t* rseg);
 extern inline void trx_rseg_free_free_undo_page(trx_rseg_t* rseg, trx_undo_page_t* undo_page);
 
 extern inline trx_t* trx_rseg_assign_and_alloc_trx();
+extern inline void trx_rseg_begin_slot(trx_t* trx);
 extern inline void trx_rseg_release_trx(trx_t* trx);
+extern inline void trx_rseg_push_free_trx(trx_rseg_t* rseg, trx_t* trx);
 extern inline scn_t trx_rseg_set_end(trx_t* trx, bool32 is_commit);
 extern inline uint64 trx_get_next_scn();
+extern inline uint64 trx_get_query_scn();
 extern inline void trx_get_status_by_itl(trx_slot_id_t trx_slot_id, trx_status_t* trx_status);
 
 extern byte* trx_rseg_replay_trx_slot_page_init(uint32 type, uint64 lsn, byte* log_rec_ptr, byte* log_end_ptr, void* block);
@@ -2,6 +2,7 @@
 #define _KNL_TRX_TYPES_H
 
 #include "cm_type.h"
+#include "cm_atomic.h"
 #include "cm_list.h"
 #include "knl_server.h"
 #include "knl_buf.h"
@@ -139,10 +140,20 @@ typedef struct st_undo_rowid {
 
 typedef SLIST_BASE_NODE_T(trx_undo_page_t) trx_undo_page_base;
 
+// blockers kept for a lock wait, a wait blocked by more trxs is checked on these only
+#define TRX_LOCK_WAIT_FOR_MAX       16
+
 typedef struct st_trx {
     trx_slot_id_t     trx_slot_id;
     mutex_t           mutex;
     bool32            is_active;
+    // changed with xnum, status and scn of slot and is_active under mutex,
+    // odd while they are being changed, readers retry if it is changed during reading
+    atomic32_t        status_version;
+    // slot is begun by the first modification, read only trx never writes slot page
+    bool32            is_slot_begun;
+    // slot of next trx in free stack of rseg
+    uint32            free_next;
     // next undo log record number, since the undo log is private for a transaction,
     // this is a simple ascending sequence with no gaps;
     // thus it represents the number of modified/inserted rows in a transaction
@@ -153,6 +164,20 @@ typedef struct st_trx {
     trx_undo_page_base insert_undo;
     trx_undo_page_base update_undo;
 
+    // locks of lock manager, the list is only changed by the thread of trx
+    UT_LIST_BASE_NODE_T(struct st_lock) locks;
+    struct st_lock*   lock_free_list;   // freed locks for reuse
+    uint32            lock_free_count;
+    // lock waited for and the trxs blocking it, protected by wait_mutex of lock_sys
+    struct st_lock*   lock_wait;
+    struct st_trx*    lock_wait_for[TRX_LOCK_WAIT_FOR_MAX];
+    uint32            lock_wait_for_count;
+    uint64            lock_deadlock_mark;  // the last deadlock search visiting trx
+    os_event_t        lock_wait_event;  // event of waiting session
+
+    // TRX_RECV_WAITING if trx was active at crash, claimed by the thread rolling it back
+    atomic32_t        recv_state;
+
     // listnode for rseg->trxs
     SLIST_NODE_T(struct st_trx) list_node;
 } trx_t;
@@ -163,6 +188,11 @@ typedef struct st_trx {
 #define XACT_XA_PREPARE     2
 #define XACT_XA_ROLLBACK    3
 
+// trx_t.recv_state
+#define TRX_RECV_NONE       0
+#define TRX_RECV_WAITING    1  // active at crash, not rolled back yet
+#define TRX_RECV_ROLLING    2  // being rolled back by a rollback thread or a session
+
 typedef struct st_trx_status {
     uint64    scn;
     bool32    is_ow_scn;  // overwrite scn
@@ -172,6 +202,7 @@ typedef struct st_trx_status {
 #define TRX_SLOT_PAGE_COUNT_PER_RSEG     8  // total 4KB * 8 = 32KB
 #define TRX_SLOT_COUNT_PER_PAGE          ((UNIV_SYSTRANS_PAGE_SIZE - TRX_SLOT_PAGE_HDR - TRX_SLOT_PAGE_HEADER_SIZE - FIL_PAGE_DATA_END) / sizeof(trx_slot_t))
 #define TRX_SLOT_COUNT_PER_RSEG          (TRX_SLOT_PAGE_COUNT_PER_RSEG * TRX_SLOT_COUNT_PER_PAGE)
+#define TRX_FREE_STACK_EMPTY             0xFFFFFFFF
 
 
 /* The rollback segment memory object */
@@ -185,7 +216,8 @@ struct st_trx_rseg {
     // trx_list
     trx_t             trx_list[TRX_SLOT_COUNT_PER_RSEG];
     mutex_t           trx_mutex;
-    SLIST_BASE_NODE_T(trx_t) trx_free_list;
+    // lock free stack of free trxs, aba tag in high 32 bits and slot of top trx in low 32 bits
+    atomic64_t        trx_free_stack;
     SLIST_BASE_NODE_T(trx_t) trx_need_recovery_list;
 
     // trx_slot list
@@ -231,6 +263,7 @@ typedef struct st_trx_sys {
 
     time_t         init_time;
     atomic64_t     scn;
+    atomic32_t     recv_trx_count;  // trxs active at crash and not rolled back yet
     memory_pool_t* mem_pool;
     memory_stack_context_t* context;
 } trx_sys_t;
@@ -238,7 +271,7 @@ typedef struct st_trx_sys {
 
 //-----------------------------------------------------------------
 
-#define TRX_GET_RSEG(rseg_id)           &trx_sys->rseg_array[rseg_id]
+#define TRX_GET_RSEG(rseg_id)           (&trx_sys->rseg_array[rseg_id])
 
 #define TRX_GET_RSEG_TRX(slot_id)       trx_sys->rseg_array[slot_id.rseg_id].trx_list[slot_id.slot]
 
@@ -97,6 +97,47 @@ static inline trx_undo_page_t* trx_undo_reuse_cache_page(
     return undo_page;
 }
 
+// Initializes the fields in an undo log segment page
+// Takes an initialized undo page from cache of session,
+// pages of cache are reused only by the trxs of rseg in the same undo tablespace.
+static inline trx_undo_page_t* trx_undo_sess_cache_get(que_sess_t* sess, trx_rseg_t* rseg, uint32 trx_undo_op)
+{
+    trx_undo_page_t* undo_page;
+
+    if (SLIST_GET_LEN(sess->undo_page_cache) == 0 ||
+        TRX_GET_RSEG(sess->undo_cache_rseg_id)->undo_space_id != rseg->undo_space_id) {
+        return NULL;
+    }
+
+    SLIST_GET_AND_REMOVE_FIRST(list_node, sess->undo_page_cache, undo_page);
+    // pages are initialized as insert undo when they are cached
+    if (trx_undo_op != UNDO_INSERT_OP) {
+        trx_undo_page_reuse(undo_page, trx_undo_op);
+    }
+
+    return undo_page;
+}
+
+// Keeps at most srv_sess_undo_cached_pages pages of undo_page_base in cache of session,
+// pages are initialized here, out of the statements of next trxs.
+static inline void trx_undo_sess_cache_put(que_sess_t* sess, trx_rseg_t* rseg, trx_undo_page_base& undo_page_base)
+{
+    trx_undo_page_t* undo_page;
+
+    if (SLIST_GET_LEN(sess->undo_page_cache) == 0) {
+        sess->undo_cache_rseg_id = rseg->id;
+    } else if (TRX_GET_RSEG(sess->undo_cache_rseg_id)->undo_space_id != rseg->undo_space_id) {
+        return;
+    }
+
+    while (SLIST_GET_LEN(sess->undo_page_cache) < srv_sess_undo_cached_pages &&
+           SLIST_GET_LEN(undo_page_base) > 0) {
+        SLIST_GET_AND_REMOVE_FIRST(list_node, undo_page_base, undo_page);
+        trx_undo_page_reuse(undo_page, UNDO_INSERT_OP);
+        SLIST_ADD_LAST(list_node, sess->undo_page_cache, undo_page);
+    }
+}
+
 // Initializes the fields in an undo log segment page
 static inline buf_block_t* trx_undo_page_init(uint32 undo_space_id, uint32 undo_page_no, uint32 trx_undo_op)
 {
@@ -196,7 +237,7 @@ static inline void trx_undo_release_page(trx_rseg_t* rseg,
 // Tries to add a page to the undo log segment where the undo log is placed.
 // return X-latched block if success, else NULL
 static inline trx_undo_page_t* trx_undo_add_undo_page(
-    trx_t* trx, uint32 trx_undo_op, uint16 size, uint64 min_scn, mtr_t* mtr)
+    que_sess_t* sess, trx_t* trx, uint32 trx_undo_op, uint16 size, uint64 min_scn, mtr_t* mtr)
 {
     trx_rseg_t* rseg = TRX_GET_RSEG(trx->trx_slot_id.rseg_id);
 
@@ -204,8 +245,11 @@ static inline trx_undo_page_t* trx_undo_add_undo_page(
 
     // 1 get undo page
 
-    //only get undo page from insert_cache of current rseg
-    trx_undo_page_t* undo_page = trx_undo_reuse_cache_page(rseg, UNDO_INSERT_OP, size, min_scn);
+    //only get undo page from cache of session or insert_cache of current rseg
+    trx_undo_page_t* undo_page = trx_undo_sess_cache_get(sess, rseg, trx_undo_op);
+    if (undo_page == NULL) {
+        undo_page = trx_undo_reuse_cache_page(rseg, UNDO_INSERT_OP, size, min_scn);
+    }
     if (undo_page == NULL) {
         undo_page = trx_undo_create_page(rseg, trx_undo_op, min_scn);
     }
@@ -270,14 +314,17 @@ static inline void trx_undo_write_log_header(trx_t* trx, trx_undo_page_t* undo_p
 }
 
 static inline trx_undo_page_t* trx_undo_assign_undo_page(
-    trx_t* trx, uint32 trx_undo_op, uint16 size, uint64 min_scn, mtr_t* mtr)
+    que_sess_t* sess, trx_t* trx, uint32 trx_undo_op, uint16 size, uint64 min_scn, mtr_t* mtr)
 {
     trx_undo_page_t* undo_page;
     trx_rseg_t* rseg = TRX_GET_RSEG(trx->trx_slot_id.rseg_id);
 
-    // 1 get undo page from cache of current rseg
+    // 1 get undo page from cache of session, or cache of current rseg
 
-    undo_page = trx_undo_reuse_cache_page(rseg, trx_undo_op, size, min_scn);
+    undo_page = trx_undo_sess_cache_get(sess, rseg, trx_undo_op);
+    if (undo_page == NULL) {
+        undo_page = trx_undo_reuse_cache_page(rseg, trx_undo_op, size, min_scn);
+    }
     if (undo_page == NULL) {
         undo_page = trx_undo_create_page(rseg, trx_undo_op, min_scn);
     }
@@ -326,13 +373,13 @@ inline status_t trx_undo_prepare(que_sess_t* sess, undo_data_t* undo_data, mtr_t
     // get undo page
     if (undo_data->undo_op == UNDO_INSERT_OP) {
         if (SLIST_GET_LEN(trx->insert_undo) == 0) {
-            trx_undo_assign_undo_page(trx, undo_data->undo_op, TRX_UNDO_LOG_HDR_SIZE, undo_data->query_min_scn, mtr);
+            trx_undo_assign_undo_page(sess, trx, undo_data->undo_op, TRX_UNDO_LOG_HDR_SIZE, undo_data->query_min_scn, mtr);
         }
         undo_page = SLIST_GET_LAST(trx->insert_undo);
     } else {
         ut_ad(undo_data->undo_op == UNDO_MODIFY_OP);
         if (SLIST_GET_LEN(trx->update_undo) == 0) {
-            trx_undo_assign_undo_page(trx, undo_data->undo_op, TRX_UNDO_LOG_HDR_SIZE, undo_data->query_min_scn, mtr);
+            trx_undo_assign_undo_page(sess, trx, undo_data->undo_op, TRX_UNDO_LOG_HDR_SIZE, undo_data->query_min_scn, mtr);
         }
         undo_page = SLIST_GET_LAST(trx->update_undo);
     }
@@ -340,7 +387,7 @@ inline status_t trx_undo_prepare(que_sess_t* sess, undo_data_t* undo_data, mtr_t
     // Check for free space
     if (undo_page && UNDO_PAGE_LEFT(undo_page) < undo_data->rec_mgr.m_data_size) {
         // We have to extend the undo log by one page, add a page to an undo log
-        undo_page = trx_undo_add_undo_page(trx, undo_data->undo_op,
+        undo_page = trx_undo_add_undo_page(sess, trx, undo_data->undo_op,
             undo_data->rec_mgr.m_data_size, undo_data->query_min_scn, mtr);
     }
     if (undo_page == NULL) {
@@ -409,28 +456,90 @@ inline status_t trx_undo_write_log_rec(    que_sess_t* sess, undo_data_t* undo_d
     return CM_SUCCESS;
 }
 
-static inline void trx_insert_undo_cleanup(trx_rseg_t* rseg, trx_t* trx)
+// Writes the undo records of several rows of a statement in one mini-transaction,
+// the records are appended to an undo page under one latch with one redo record,
+// a page is added when the page is full. The undo position of every row is set in its undo_data.
+inline status_t trx_undo_write_log_recs(que_sess_t* sess, undo_data_t* undo_datas, uint32 count, mtr_t* mtr)
 {
-    if (SLIST_GET_LEN(trx->insert_undo) == 0) {
-        return;
+    trx_rseg_t* rseg = TRX_GET_RSEG(sess->trx->trx_slot_id.rseg_id);
+    uint32 index = 0;
+
+    while (index < count) {
+        undo_op_type undo_op = undo_datas[index].undo_op;
+
+        // the current undo page has room for the first record at least
+        CM_RETURN_IF_ERROR(trx_undo_prepare(sess, &undo_datas[index], mtr));
+
+        trx_undo_page_t* undo_page = (undo_op == UNDO_INSERT_OP) ?
+            SLIST_GET_LAST(sess->trx->insert_undo) : SLIST_GET_LAST(sess->trx->update_undo);
+        page_t* page = trx_undo_get_page(rseg->undo_space_id, undo_page, undo_op, mtr);
+        uint32 first_free = mach_read_from_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE);
+        ut_ad(first_free == undo_page->page_offset);
+
+        uint32 rec_count = 0;
+        for (; index < count; index++, rec_count++) {
+            undo_data_t* undo_data = &undo_datas[index];
+            uint16 undo_rec_len = TRX_UNDO_REC_EXTRA_SIZE + undo_data->rec_mgr.m_data_size;
+            if (undo_data->undo_op != undo_op || UNDO_PAGE_LEFT(undo_page) < undo_rec_len) {
+                break;
+            }
+
+            undo_data->undo_space_index = rseg->undo_space_id - DB_UNDO_START_SPACE_ID;
+            undo_data->undo_page_no = undo_page->page_no;
+            undo_data->undo_page_offset = undo_page->page_offset;
+            undo_data->rec_mgr.serialize(page + undo_page->page_offset, undo_page->page_offset);
+            undo_page->page_offset += undo_rec_len;
+        }
+        if (rec_count == 0) {
+            CM_SET_ERROR(ERR_NO_FREE_UNDO_PAGE);
+            return CM_ERROR;
+        }
+
+        mach_write_to_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE, undo_page->page_offset);
+
+        // the records are contiguous, they are logged as one record
+        uint32 undo_recs_len = undo_page->page_offset - first_free;
+        mlog_write_log(MLOG_UNDO_LOG_INSERT, rseg->undo_space_id, undo_page->page_no, NULL, 0, mtr);
+        mlog_catenate_uint32(mtr, undo_recs_len, MLOG_2BYTES);
+        mlog_catenate_uint32(mtr, first_free, MLOG_2BYTES);
+        mlog_catenate_string(mtr, page + first_free, undo_recs_len);
     }
 
+    return CM_SUCCESS;
+}
+
+static inline void trx_undo_free_insert_pages(trx_rseg_t* rseg, trx_undo_page_base& undo_page_base)
+{
     bool32 is_reused = FALSE;
 
     // return insert_undo_page to rseg->insert_undo_cache
     mutex_enter(&(rseg->insert_undo_cache_mutex), NULL);
-    if (SLIST_GET_LEN(trx->insert_undo) + SLIST_GET_LEN(rseg->insert_undo_cache) <= rseg->undo_cached_max_count) {
-        SLIST_APPEND_SLIST(list_node, trx->insert_undo, rseg->insert_undo_cache);
+    if (SLIST_GET_LEN(undo_page_base) + SLIST_GET_LEN(rseg->insert_undo_cache) <= rseg->undo_cached_max_count) {
+        SLIST_APPEND_SLIST(list_node, undo_page_base, rseg->insert_undo_cache);
         is_reused = TRUE;
     }
     mutex_exit(&(rseg->insert_undo_cache_mutex));
 
     // return insert_undo_page to undo table_space
     if (!is_reused) {
-        trx_undo_release_page(rseg, trx->insert_undo, UNDO_PAGE_TYPE_INSERT, 0);
+        trx_undo_release_page(rseg, undo_page_base, UNDO_PAGE_TYPE_INSERT, 0);
     }
 }
 
+static inline void trx_insert_undo_cleanup(que_sess_t* sess, trx_rseg_t* rseg, trx_t* trx)
+{
+    if (SLIST_GET_LEN(trx->insert_undo) == 0) {
+        return;
+    }
+
+    trx_undo_sess_cache_put(sess, rseg, trx->insert_undo);
+    if (SLIST_GET_LEN(trx->insert_undo) == 0) {
+        return;
+    }
+
+    trx_undo_free_insert_pages(rseg, trx->insert_undo);
+}
+
 static inline void trx_update_undo_cleanup(trx_rseg_t* rseg, trx_t* trx, bool32 is_commited, scn_t scn)
 {
     if (SLIST_GET_LEN(trx->update_undo) == 0) {
@@ -503,15 +612,26 @@ static inline void trx_update_undo_cleanup(trx_rseg_t* rseg, trx_t* trx, bool32
     }
 }
 
-inline void trx_undo_cleanup(trx_t* trx, bool32 is_commited, scn_t scn)
+inline void trx_undo_cleanup(que_sess_t* sess, trx_t* trx, bool32 is_commited, scn_t scn)
 {
     trx_rseg_t* rseg = TRX_GET_RSEG(trx->trx_slot_id.rseg_id);
 
-    trx_insert_undo_cleanup(rseg, trx);
+    trx_insert_undo_cleanup(sess, rseg, trx);
 
     trx_update_undo_cleanup(rseg, trx, is_commited, scn);
 }
 
+// Returns the undo pages cached by session when the session is freed
+void trx_undo_sess_cache_release(que_sess_t* sess)
+{
+    if (SLIST_GET_LEN(sess->undo_page_cache) == 0) {
+        return;
+    }
+
+    trx_undo_free_insert_pages(TRX_GET_RSEG(sess->undo_cache_rseg_id), sess->undo_page_cache);
+    SLIST_INIT(sess->undo_page_cache);
+}
+
 
 
 
@@ -549,9 +669,9 @@ void trx_rollback_undo_mgr_t::init(mtr_t* mtr) {
     m_insert_top_page = SLIST_GET_LAST(m_trx->insert_undo);
     if (m_insert_seg_page) {
         page_id_t page_id(m_rseg->id, m_insert_seg_page->page_no);
-        m_insert_top_block = buf_page_get_gen(page_id, undo_log_page_size,
+        buf_block_t* block = buf_page_get_gen(page_id, undo_log_page_size,
             RW_X_LATCH, m_insert_seg_page->guess_block, Page_fetch::NORMAL, mtr);
-        page_t* page = buf_block_get_frame(m_insert_top_block);
+        page_t* page = buf_block_get_frame(block);
         m_insert_seg_hdr = page + TRX_UNDO_SEG_HDR;
         m_insert_undo_log_hdr = page + mach_read_from_2(m_insert_seg_hdr + TRX_UNDO_LAST_LOG);
     }
@@ -560,9 +680,9 @@ void trx_rollback_undo_mgr_t::init(mtr_t* mtr) {
     m_update_top_page = SLIST_GET_LAST(m_trx->update_undo);
     if (m_update_seg_page) {
         page_id_t page_id(m_rseg->id, m_update_seg_page->page_no);
-        m_update_top_block = buf_page_get_gen(page_id, undo_log_page_size,
+        buf_block_t* block = buf_page_get_gen(page_id, undo_log_page_size,
             RW_X_LATCH, m_update_seg_page->guess_block, Page_fetch::NORMAL, mtr);
-        page_t* page = buf_block_get_frame(m_update_top_block);
+        page_t* page = buf_block_get_frame(block);
         m_update_seg_hdr = page + TRX_UNDO_SEG_HDR;
         m_update_undo_log_hdr = page + mach_read_from_2(m_update_seg_hdr + TRX_UNDO_LAST_LOG);
     }
@@ -582,6 +702,8 @@ trx_undo_rec_hdr_t* trx_rollback_undo_mgr_t::get_top_insert_rec(uint32& undo_rec
         page_id_t page_id(m_rseg->id, m_insert_top_page->page_no);
         m_insert_top_block = buf_page_get_gen(page_id, undo_log_page_size,
             RW_X_LATCH, m_insert_top_page->guess_block, Page_fetch::NORMAL, mtr);
+    }
+    if (m_insert_top_offset == 0) {
         trx_undo_page_hdr_t* undo_page_hdr = buf_block_get_frame(m_insert_top_block) + TRX_UNDO_PAGE_HDR;
         m_insert_top_offset = mach_read_from_2(undo_page_hdr + TRX_UNDO_PAGE_FREE - 2);
     }
@@ -611,6 +733,7 @@ void trx_rollback_undo_mgr_t::pop_top_insert_rec() {
         }
         m_insert_top_page = tmp_page;
         m_insert_top_block = NULL;
+        m_insert_top_offset = 0;
         return;
     }
 
@@ -633,6 +756,8 @@ trx_undo_rec_hdr_t* trx_rollback_undo_mgr_t::get_top_update_rec(uint32& undo_rec
         page_id_t page_id(m_rseg->id, m_update_top_page->page_no);
         m_update_top_block = buf_page_get_gen(page_id, undo_log_page_size,
             RW_X_LATCH, m_update_top_page->guess_block, Page_fetch::NORMAL, mtr);
+    }
+    if (m_update_top_offset == 0) {
         trx_undo_page_hdr_t* undo_page_hdr = buf_block_get_frame(m_update_top_block) + TRX_UNDO_PAGE_HDR;
         m_update_top_offset = mach_read_from_2(undo_page_hdr + TRX_UNDO_PAGE_FREE - 2);
     }
@@ -663,6 +788,7 @@ void trx_rollback_undo_mgr_t::pop_top_update_rec() {
         }
         m_update_top_page = tmp_page;
         m_update_top_block = NULL;
+        m_update_top_offset = 0;
         return;
     }
 
@@ -672,6 +798,17 @@ void trx_rollback_undo_mgr_t::pop_top_update_rec() {
 }
 
 
+// Forgets the undo pages latched by mtr, which is committed by caller,
+// the top records are read again from their offsets in the next mtr.
+// The segment headers are kept, undo pages of trx are fixed and only changed by trx itself.
+void trx_rollback_undo_mgr_t::release_blocks()
+{
+    m_insert_rec = NULL;
+    m_insert_top_block = NULL;
+    m_update_rec = NULL;
+    m_update_top_block = NULL;
+}
+
 // Pops the topmost record from the two undo logs of a transaction ordered by their undo numbers
 trx_undo_rec_hdr_t* trx_rollback_undo_mgr_t::pop_top_undo_rec(uint32& undo_rec_size, mtr_t* mtr)
 {
@@ -237,6 +237,12 @@ struct undo_update_rec_t {
     row_header_t* row;
 };
 
+struct undo_lob_rec_t {
+    uint32    space_id;
+    uint32    page_no; // first toast page, freed by rollback of insert or purge of delete
+    uint32    length;
+};
+
 class undo_rec_mgr_t {
 public:
     undo_rec_mgr_t() {
@@ -257,11 +263,15 @@ public:
             serialize_heap_insert_undo_rec(rec_ptr, rec_offset);
             break;
         case UNDO_HEAP_DELETE:
-            serialize_heap_insert_undo_rec(rec_ptr, rec_offset);
+            serialize_heap_delete_undo_rec(rec_ptr, rec_offset);
             break;
         case UNDO_HEAP_UPDATE:
             serialize_heap_insert_undo_rec(rec_ptr, rec_offset);
             break;
+        case UNDO_LOB_INSERT:
+        case UNDO_LOB_DELETE:
+            serialize_lob_undo_rec(rec_ptr, rec_offset);
+            break;
         default:
             ut_error
             break;
@@ -275,11 +285,15 @@ public:
             deserialize_heap_insert_undo_rec(rec_ptr, rec_len);
             break;
         case UNDO_HEAP_DELETE:
-            deserialize_heap_insert_undo_rec(rec_ptr, rec_len);
+            deserialize_heap_delete_undo_rec(rec_ptr, rec_len);
             break;
         case UNDO_HEAP_UPDATE:
             deserialize_heap_insert_undo_rec(rec_ptr, rec_len);
             break;
+        case UNDO_LOB_INSERT:
+        case UNDO_LOB_DELETE:
+            deserialize_lob_undo_rec(rec_ptr, rec_len);
+            break;
         default:
             ut_error;
             break;
@@ -290,12 +304,11 @@ private:
     void serialize_heap_insert_undo_rec(byte* rec_ptr, uint16 rec_offset) {
         // offset of the next undo log record
         mach_write_to_2(rec_ptr, rec_offset + TRX_UNDO_REC_EXTRA_SIZE + m_data_size);
-        rec_ptr += 2;
 
         mach_write_to_1(rec_ptr + TRX_UNDO_REC_TYPE, m_type);
         mach_write_to_4(rec_ptr + TRX_UNDO_REC_NO, m_trx->undo_rec_no);
         m_trx->undo_rec_no++;
-        //mach_write_to_8(rec_ptr + TRX_UNDO_REC_TABLE_ID, table->id);
+        mach_write_to_8(rec_ptr + TRX_UNDO_REC_TABLE_ID, m_table_id);
         memcpy(rec_ptr + TRX_UNDO_REC_DATA, &m_insert.row_id, sizeof(row_id_t));
 
         // start offset of current undo log record
@@ -305,6 +318,7 @@ private:
     void deserialize_heap_insert_undo_rec(const byte* rec_ptr, uint32 rec_len) {
         ut_ad(rec_len == TRX_UNDO_REC_EXTRA_SIZE + sizeof(row_id_t));
 
+        m_table_id = mach_read_from_8(rec_ptr + TRX_UNDO_REC_TABLE_ID);
         memcpy(&m_insert.row_id, rec_ptr + TRX_UNDO_REC_DATA, sizeof(row_id_t));
     }
 
@@ -315,7 +329,7 @@ private:
         mach_write_to_1(rec_ptr + TRX_UNDO_REC_TYPE, m_type);
         mach_write_to_4(rec_ptr + TRX_UNDO_REC_NO, m_trx->undo_rec_no);
         m_trx->undo_rec_no++;
-        //mach_write_to_8(rec_ptr + TRX_UNDO_REC_TABLE_ID, table->id);
+        mach_write_to_8(rec_ptr + TRX_UNDO_REC_TABLE_ID, m_table_id);
         memcpy(rec_ptr + TRX_UNDO_REC_DATA, &m_delete.row_id, sizeof(row_id_t));
         memcpy(rec_ptr + TRX_UNDO_REC_DATA + sizeof(row_id_t), &m_delete.old_dir, sizeof(row_dir_t));
         mach_write_to_1(rec_ptr + TRX_UNDO_REC_DATA + sizeof(row_id_t) + sizeof(row_dir_t), m_delete.old_itl_id);
@@ -327,12 +341,13 @@ private:
     void deserialize_heap_delete_undo_rec(const byte* rec_ptr, uint32 rec_len) {
         ut_ad(rec_len == TRX_UNDO_REC_EXTRA_SIZE + sizeof(row_id_t) + sizeof(row_dir_t) + 1);
 
-        byte* ptr = rec_ptr + TRX_UNDO_REC_DATA;
+        m_table_id = mach_read_from_8(rec_ptr + TRX_UNDO_REC_TABLE_ID);
+        const byte* ptr = rec_ptr + TRX_UNDO_REC_DATA;
         memcpy(&m_delete.row_id, ptr, sizeof(row_id_t));
         ptr += sizeof(row_id_t);
-        memcpy(&m_delete.dir, ptr, sizeof(row_dir_t));
+        memcpy(&m_delete.old_dir, ptr, sizeof(row_dir_t));
         ptr += sizeof(row_dir_t);
-        m_itl_id = mach_read_from_1(ptr);
+        m_delete.old_itl_id = mach_read_from_1(ptr);
     }
 
     void serialize_heap_update_undo_rec(byte* rec_ptr, uint32 rec_offset) {
@@ -362,16 +377,41 @@ private:
     void deserialize_heap_update_undo_rec(const byte* rec_ptr, uint32 rec_len) {
     }
 
+    void serialize_lob_undo_rec(byte* rec_ptr, uint16 rec_offset) {
+        // offset of the next undo log record
+        mach_write_to_2(rec_ptr, rec_offset + TRX_UNDO_REC_EXTRA_SIZE + m_data_size);
+
+        mach_write_to_1(rec_ptr + TRX_UNDO_REC_TYPE, m_type);
+        mach_write_to_4(rec_ptr + TRX_UNDO_REC_NO, m_trx->undo_rec_no);
+        m_trx->undo_rec_no++;
+        mach_write_to_4(rec_ptr + TRX_UNDO_REC_DATA, m_lob.space_id);
+        mach_write_to_4(rec_ptr + TRX_UNDO_REC_DATA + 4, m_lob.page_no);
+        mach_write_to_4(rec_ptr + TRX_UNDO_REC_DATA + 8, m_lob.length);
+
+        // start offset of current undo log record
+        mach_write_to_2(rec_ptr + TRX_UNDO_REC_DATA + m_data_size, rec_offset);
+    }
+
+    void deserialize_lob_undo_rec(const byte* rec_ptr, uint32 rec_len) {
+        ut_ad(rec_len == TRX_UNDO_REC_EXTRA_SIZE + 12);
+
+        m_lob.space_id = mach_read_from_4(rec_ptr + TRX_UNDO_REC_DATA);
+        m_lob.page_no = mach_read_from_4(rec_ptr + TRX_UNDO_REC_DATA + 4);
+        m_lob.length = mach_read_from_4(rec_ptr + TRX_UNDO_REC_DATA + 8);
+    }
+
 public:
     trx_t* m_trx;
     undo_type_t m_type;
     uint8 m_itl_id;
     uint16 m_data_size; // undo record data size for insert/delete/update
     uint32 m_cid;  // command id
+    table_id_t m_table_id;  // table of row for heap undo, its indexes are changed by rollback
 
     undo_insert_rec_t m_insert;
     undo_delete_rec_t m_delete;
     undo_update_rec_t m_update;
+    undo_lob_rec_t m_lob;
 };
 
 typedef struct st_undo_data {
@@ -391,6 +431,7 @@ public:
 
     void init(mtr_t* mtr);
     trx_undo_rec_hdr_t* pop_top_undo_rec(uint32& undo_rec_size, mtr_t* mtr);
+    void release_blocks();
 
 private:
     trx_undo_rec_hdr_t* get_top_insert_rec(uint32& undo_rec_size, mtr_t* mtr);
@@ -426,6 +467,9 @@ private:
 
 extern inline status_t trx_undo_prepare(que_sess_t* sess, undo_data_t* undo_data, mtr_t* mtr);
 extern inline status_t trx_undo_write_log_rec(que_sess_t* sess, undo_data_t* undo_data, mtr_t* mtr);
+extern inline status_t trx_undo_write_log_recs(que_sess_t* sess, undo_data_t* undo_datas, uint32 count, mtr_t* mtr);
+extern inline void trx_undo_cleanup(que_sess_t* sess, trx_t* trx, bool32 is_commited, scn_t scn);
+extern void trx_undo_sess_cache_release(que_sess_t* sess);
 extern inline trx_undo_rec_hdr_t* trx_roll_pop_top_rec_of_trx(trx_undo_mgr_t* trx_undo_mgr, mtr_t* mtr);
 
 #endif  /* _KNL_TRX_UNDO_H */
@@ -5,6 +5,7 @@
 #include "knl_flst.h"
 #include "knl_page.h"
 #include "knl_fsp.h"
+#include "knl_trx_rseg.h"
 
 #define UNDO_FSM_HEADER_PAGE_NO         1
 
@@ -69,6 +70,7 @@ static inline status_t undo_fsm_alloc_log_pages(uint32 space_id,
         ut_ad(!fil_addr_is_null(node_addr));
         node = flst_get_buf_ptr(space_id, undo_log_page_size, node_addr, RW_X_LATCH, mtr, NULL) - UNDO_FSM_FLST_NODE;
         flst_remove(fsm_header + UNDO_FSM_UNUSED_LIST, node + UNDO_FSM_FLST_NODE, mtr);
+        mlog_write_uint32(node + UNDO_FSM_NODE_PAGE, log_block->get_page_no(), MLOG_4BYTES, mtr);
 
         // add node to insert_list
         flst_add_first(fsm_header + UNDO_FSM_INSERT_LIST, node + UNDO_FSM_FLST_NODE, mtr);
@@ -307,23 +309,26 @@ status_t undo_fsm_recovery_fsp_pages(uint32 space_id)
         //buf_block_dbg_add_level(fsm_root_block, SYNC_RSEG_HEADER_NEW);
     }
 
-    // 3 recovery
+    // 3 recovery, the pages of trxs active at crash stay in used_list until they are rolled back
     fil_addr_t node_addr = flst_get_first(fsm_header + UNDO_FSM_USED_LIST, mtr);
     while (!fil_addr_is_null(node_addr)) {
         // get node by node_addr
         undo_fsm_node_t* node;
         node = flst_get_buf_ptr(space_id, undo_log_page_size, node_addr, RW_X_LATCH, mtr, NULL) - UNDO_FSM_FLST_NODE;
-        // remove node from used_list
-        flst_remove(fsm_header + UNDO_FSM_USED_LIST, node + UNDO_FSM_FLST_NODE, mtr);
-
-
-        // get undo log page and check: insert or update
-        
-        // add node to insert_list
-        flst_add_first(fsm_header + UNDO_FSM_INSERT_LIST, node + UNDO_FSM_FLST_NODE, mtr);
+        fil_addr_t next_addr = flst_get_next_addr(node + UNDO_FSM_FLST_NODE, mtr);
+
+        uint32 page_no = mlog_read_uint32(node + UNDO_FSM_NODE_PAGE, MLOG_4BYTES);
+        trx_undo_page_t* undo_page = trx_rseg_find_recovered_undo_page(space_id, page_no);
+        if (undo_page != NULL) {
+            undo_page->node_page_no = node_addr.page;
+            undo_page->node_page_offset = node_addr.boffset;
+        } else {
+            // remove node from used_list and add it to insert_list
+            flst_remove(fsm_header + UNDO_FSM_USED_LIST, node + UNDO_FSM_FLST_NODE, mtr);
+            flst_add_first(fsm_header + UNDO_FSM_INSERT_LIST, node + UNDO_FSM_FLST_NODE, mtr);
+        }
 
-        //
-        node_addr = flst_get_first(fsm_header + UNDO_FSM_USED_LIST, mtr);
+        node_addr = next_addr;
     }
 
     mtr_commit(mtr);
@@ -376,6 +381,8 @@ static inline undo_fsm_page_t undo_fsm_alloc_page_from_insert_list(uint32 space_
     undo_fsm_node_t* node;
     node = flst_get_buf_ptr(space_id, undo_log_page_size, fsm_page.node_addr, RW_X_LATCH, mtr, NULL) - UNDO_FSM_FLST_NODE;
 
+    fsm_page.page_no = mlog_read_uint32(node + UNDO_FSM_NODE_PAGE, MLOG_4BYTES);
+
     // remove node from insert_list
     flst_remove(fsm_header + UNDO_FSM_INSERT_LIST, node + UNDO_FSM_FLST_NODE, mtr);
 
@@ -409,6 +416,7 @@ static inline undo_fsm_page_t undo_fsm_alloc_page_from_update_list(uint32 space_
     }
 
     // run here, we will reuse this page
+    fsm_page.page_no = mlog_read_uint32(node + UNDO_FSM_NODE_PAGE, MLOG_4BYTES);
 
     // remove node from update_list
     flst_remove(fsm_header + UNDO_FSM_UPDATE_LIST, node + UNDO_FSM_FLST_NODE, mtr);
@@ -490,3 +498,60 @@ inline void undo_fsm_free_page(uint32 space_id, undo_fsm_page_t fsm_page,
 }
 
 
+
+uint32 undo_fsm_get_update_page_count(uint32 space_id)
+{
+    mtr_t init_mtr, *mtr = &init_mtr;
+    uint32 count;
+
+    if (undo_fsm_hdr_block[space_id - FIL_UNDO_START_SPACE_ID] == NULL) {
+        return 0;
+    }
+
+    mtr_start(mtr);
+    undo_fsm_header_t* fsm_header = undo_fsm_get_fsm_header(space_id, mtr);
+    count = flst_get_len(fsm_header + UNDO_FSM_UPDATE_LIST);
+    mtr_commit(mtr);
+
+    return count;
+}
+
+// Detaches the pages at the head of update_list committed before purge_scn, max_count at most,
+// into used_list. Caller purges their records and returns them by undo_fsm_free_page,
+// the pages of a crash in between are moved to insert_list by undo_fsm_recovery_fsp_pages.
+uint32 undo_fsm_get_purge_pages(uint32 space_id, uint64 purge_scn, undo_fsm_page_t* pages, uint32 max_count)
+{
+    mtr_t init_mtr, *mtr = &init_mtr;
+    uint32 purge_timestamp = (uint32)(purge_scn >> 32);
+    uint32 count = 0;
+
+    ut_ad(max_count <= UNDO_FSM_PURGE_PAGES_PER_MTR);
+
+    mtr_start(mtr);
+
+    undo_fsm_header_t* fsm_header = undo_fsm_get_fsm_header(space_id, mtr);
+    while (count < max_count) {
+        fil_addr_t node_addr = flst_get_first(fsm_header + UNDO_FSM_UPDATE_LIST, mtr);
+        if (fil_addr_is_null(node_addr)) {
+            break;
+        }
+
+        undo_fsm_node_t* node;
+        node = flst_get_buf_ptr(space_id, undo_log_page_size, node_addr, RW_X_LATCH, mtr, NULL) - UNDO_FSM_FLST_NODE;
+        if (mlog_read_uint32(node + UNDO_FSM_NODE_SCN_TIMESTAMP, MLOG_4BYTES) >= purge_timestamp) {
+            break;
+        }
+
+        pages[count].space_id = space_id;
+        pages[count].page_no = mlog_read_uint32(node + UNDO_FSM_NODE_PAGE, MLOG_4BYTES);
+        pages[count].node_addr = node_addr;
+        count++;
+
+        flst_remove(fsm_header + UNDO_FSM_UPDATE_LIST, node + UNDO_FSM_FLST_NODE, mtr);
+        flst_add_first(fsm_header + UNDO_FSM_USED_LIST, node + UNDO_FSM_FLST_NODE, mtr);
+    }
+
+    mtr_commit(mtr);
+
+    return count;
+}
@@ -39,6 +39,8 @@ typedef byte undo_fsm_node_t;
 #define UNDO_PAGE_TYPE_INSERT           1
 #define UNDO_PAGE_TYPE_UPDATE           2
 
+#define UNDO_FSM_PURGE_PAGES_PER_MTR    32
+
 typedef struct st_undo_fsm_page {
     uint32      space_id;
     uint32      page_no;
@@ -54,5 +56,8 @@ extern status_t undo_fsm_recovery_fsp_pages(uint32 space_id);
 extern inline undo_fsm_page_t undo_fsm_alloc_page(uint32 space_id, uint64 min_scn);
 extern inline void undo_fsm_free_page(uint32 space_id, undo_fsm_page_t fsm_page, uint32 undo_page_type, uint64 scn_timestamp);
 
+extern uint32 undo_fsm_get_update_page_count(uint32 space_id);
+extern uint32 undo_fsm_get_purge_pages(uint32 space_id, uint64 purge_scn, undo_fsm_page_t* pages, uint32 max_count);
+
 
 #endif  /* _KNL_UNDO_FSM_H */
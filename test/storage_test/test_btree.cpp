@@ -0,0 +1,232 @@
+#include "cm_type.h"
+#include "cm_log.h"
+#include "knl_btree.h"
+#include "knl_dict.h"
+#include "knl_file_system.h"
+#include "knl_mtr.h"
+
+#define TEST_BTREE_TABLE_ID        0xFFFF0001
+#define TEST_BTREE_INDEX_ID        0xFFFF0001
+#define TEST_BTREE_UNIQUE_INDEX_ID 0xFFFF0002
+#define TEST_BTREE_KEY_COUNT       5000
+
+static dict_table_t* g_btree_table = NULL;
+
+static dict_index_t* btree_create_index(const char* name, index_id_t index_id, uint32 type)
+{
+    const page_size_t page_size(FIL_SYSTEM_SPACE_ID);
+    dict_index_t* index;
+    mtr_t mtr;
+
+    index = dict_mem_index_create(g_btree_table, name, index_id, FIL_SYSTEM_SPACE_ID, type, 1);
+    if (index == NULL) {
+        return NULL;
+    }
+    dict_mem_index_add_field(index, "ID", 0);
+
+    mtr_start(&mtr);
+    index->entry_page_no = btr_create(type, FIL_SYSTEM_SPACE_ID, page_size, index_id, index, NULL, &mtr);
+    mtr_commit(&mtr);
+    if (index->entry_page_no == FIL_NULL) {
+        printf("error: cannot create root of index %s\n", name);
+        return NULL;
+    }
+
+    return index;
+}
+
+static bool32 btree_pcur_is_on_key(btr_pcur_t* pcur, uint64 id, uint64 value)
+{
+    btr_key_t key;
+
+    btr_key_init(&key);
+    btr_key_put_uint(&key, id);
+
+    return btr_pcur_is_on_rec(pcur) && pcur->key_len == key.len &&
+        memcmp(pcur->key, key.data, key.len) == 0 && pcur->value == value;
+}
+
+static bool32 btree_row_exists(void* arg, const byte* key, uint32 key_len, uint64 value)
+{
+    return *(bool32 *)arg;
+}
+
+// keys are inserted out of order, so that leaves are split in the middle
+bool32 test_btree_insert_and_scan()
+{
+    btr_key_t key;
+    btr_tuple_t tuple;
+    btr_pcur_t pcur;
+    uint32 count;
+
+    dict_index_t* index = btree_create_index("TEST_BTREE_IND", TEST_BTREE_INDEX_ID, 0);
+    if (index == NULL) {
+        return FALSE;
+    }
+
+    for (uint32 i = 0; i < TEST_BTREE_KEY_COUNT; i++) {
+        uint64 id = (i * 7919) % TEST_BTREE_KEY_COUNT;
+        btr_key_init(&key);
+        btr_key_put_uint(&key, id);
+        if (btr_insert(index, key.data, key.len, id, NULL, NULL) != CM_SUCCESS) {
+            printf("insert error: id=%llu\n", id);
+            return FALSE;
+        }
+    }
+
+    count = 0;
+    btr_pcur_open_at_side(index, TRUE, &pcur);
+    while (btr_pcur_is_on_rec(&pcur)) {
+        if (!btree_pcur_is_on_key(&pcur, count, count)) {
+            printf("scan check: fail, expected id=%u\n", count);
+            return FALSE;
+        }
+        count++;
+        btr_pcur_move_to_next(&pcur);
+    }
+    if (count != TEST_BTREE_KEY_COUNT) {
+        printf("scan check: fail, count=%u\n", count);
+        return FALSE;
+    }
+
+    // search
+    btr_key_init(&key);
+    btr_key_put_uint(&key, 100);
+    btr_tuple_set(&tuple, key.data, key.len, BTR_VALUE_MIN, 0);
+    btr_pcur_open(index, &tuple, BTR_SEARCH_GE, &pcur);
+    if (!btree_pcur_is_on_key(&pcur, 100, 100)) {
+        printf("search check: fail, id=100\n");
+        return FALSE;
+    }
+
+    // delete even keys, a second delete does not find the record
+    for (uint64 id = 0; id < TEST_BTREE_KEY_COUNT; id += 2) {
+        btr_key_init(&key);
+        btr_key_put_uint(&key, id);
+        if (!btr_delete(index, key.data, key.len, id)) {
+            printf("delete error: id=%llu\n", id);
+            return FALSE;
+        }
+        if (btr_delete(index, key.data, key.len, id)) {
+            printf("delete error: id=%llu is deleted twice\n", id);
+            return FALSE;
+        }
+    }
+
+    // backward scan sees odd keys only
+    count = 0;
+    btr_pcur_open_at_side(index, FALSE, &pcur);
+    while (btr_pcur_is_on_rec(&pcur)) {
+        uint64 id = TEST_BTREE_KEY_COUNT - 1 - 2 * count;
+        if (!btree_pcur_is_on_key(&pcur, id, id)) {
+            printf("backward scan check: fail, expected id=%llu\n", id);
+            return FALSE;
+        }
+        count++;
+        btr_pcur_move_to_prev(&pcur);
+    }
+    if (count != TEST_BTREE_KEY_COUNT / 2) {
+        printf("backward scan check: fail, count=%u\n", count);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// a unique key is rejected while its row exists, and taken over once the row is gone
+bool32 test_btree_unique()
+{
+    btr_key_t key;
+    btr_pcur_t pcur;
+    bool32 row_exists;
+    uint32 count;
+
+    dict_index_t* index = btree_create_index("TEST_BTREE_UNIQUE_IND", TEST_BTREE_UNIQUE_INDEX_ID, DICT_UNIQUE);
+    if (index == NULL) {
+        return FALSE;
+    }
+
+    btr_key_init(&key);
+    btr_key_put_uint(&key, 1);
+    if (btr_insert(index, key.data, key.len, 10, NULL, NULL) != CM_SUCCESS) {
+        printf("insert error: id=1\n");
+        return FALSE;
+    }
+
+    row_exists = TRUE;
+    if (btr_insert(index, key.data, key.len, 11, btree_row_exists, &row_exists) == CM_SUCCESS) {
+        printf("duplicate check: fail, id=1 is inserted twice\n");
+        return FALSE;
+    }
+
+    row_exists = FALSE;
+    if (btr_insert(index, key.data, key.len, 11, btree_row_exists, &row_exists) != CM_SUCCESS) {
+        printf("duplicate check: fail, id=1 is not taken over\n");
+        return FALSE;
+    }
+
+    btr_pcur_open_at_side(index, TRUE, &pcur);
+    if (!btree_pcur_is_on_key(&pcur, 1, 11)) {
+        printf("duplicate check: fail, record of id=1 is not the new row\n");
+        return FALSE;
+    }
+    btr_pcur_move_to_next(&pcur);
+    if (btr_pcur_is_on_rec(&pcur)) {
+        printf("duplicate check: fail, id=1 has two records\n");
+        return FALSE;
+    }
+
+    // a key with a null column ends with the row, so nulls are never duplicates
+    for (uint64 row = 100; row < 110; row++) {
+        btr_key_init(&key);
+        btr_key_put_null(&key);
+        btr_key_put_uint(&key, row);
+        row_exists = TRUE;
+        if (btr_insert(index, key.data, key.len, row, btree_row_exists, &row_exists) != CM_SUCCESS) {
+            printf("null key check: fail, row=%llu\n", row);
+            return FALSE;
+        }
+    }
+
+    count = 0;
+    btr_pcur_open_at_side(index, TRUE, &pcur);
+    while (btr_pcur_is_on_rec(&pcur)) {
+        count++;
+        btr_pcur_move_to_next(&pcur);
+    }
+    if (count != 11) {
+        printf("null key check: fail, count=%u\n", count);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+bool32 btree_main()
+{
+    bool32 ret = FALSE;
+
+    g_btree_table = dict_mem_table_create("TEST_BTREE", TEST_BTREE_TABLE_ID,
+        DICT_SYS_USER_ID, FIL_SYSTEM_SPACE_ID, 1);
+    if (g_btree_table == NULL) {
+        printf("error: cannot create table TEST_BTREE\n");
+        goto err_exit;
+    }
+    dict_mem_table_add_col(g_btree_table, "ID", DATA_BIGINT, 0, 8);
+
+    ret = test_btree_insert_and_scan();
+    if (!ret) goto err_exit;
+
+    ret = test_btree_unique();
+    if (!ret) goto err_exit;
+
+err_exit:
+
+    if (ret) {
+        printf("btree: ok\n");
+    } else {
+        printf("btree: fail\n");
+    }
+
+    return ret;
+}
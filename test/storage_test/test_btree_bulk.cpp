@@ -0,0 +1,201 @@
+#include "cm_type.h"
+#include "cm_log.h"
+#include "knl_btree.h"
+#include "knl_btree_bulk.h"
+#include "knl_dict.h"
+#include "knl_file_system.h"
+#include "knl_mtr.h"
+
+#define TEST_BULK_TABLE_ID         0xFFFF0002
+#define TEST_BULK_INDEX_ID         0xFFFF0011
+#define TEST_BULK_UNIQUE_INDEX_ID  0xFFFF0012
+#define TEST_BULK_KEY_COUNT        200000
+#define TEST_BULK_DUPLICATE_ID     150000
+
+static dict_table_t* g_bulk_table = NULL;
+
+static dict_index_t* bulk_create_index(const char* name, index_id_t index_id, uint32 type)
+{
+    const page_size_t page_size(FIL_SYSTEM_SPACE_ID);
+    dict_index_t* index;
+    mtr_t mtr;
+
+    index = dict_mem_index_create(g_bulk_table, name, index_id, FIL_SYSTEM_SPACE_ID, type, 1);
+    if (index == NULL) {
+        return NULL;
+    }
+    dict_mem_index_add_field(index, "ID", 0);
+
+    mtr_start(&mtr);
+    index->entry_page_no = btr_create(type, FIL_SYSTEM_SPACE_ID, page_size, index_id, index, NULL, &mtr);
+    mtr_commit(&mtr);
+    if (index->entry_page_no == FIL_NULL) {
+        printf("error: cannot create root of index %s\n", name);
+        return NULL;
+    }
+
+    return index;
+}
+
+// the records are more than a sort buffer, so that runs are written and merged
+static status_t bulk_add_keys(btr_bulk_t* bulk, bool32 with_duplicate)
+{
+    btr_key_t key;
+
+    for (uint32 i = 0; i < TEST_BULK_KEY_COUNT; i++) {
+        uint64 id = ((uint64)i * 7919) % TEST_BULK_KEY_COUNT;
+        btr_key_init(&key);
+        btr_key_put_uint(&key, id);
+        CM_RETURN_IF_ERROR(btr_bulk_add(bulk, key.data, key.len, id));
+    }
+
+    if (with_duplicate) {
+        btr_key_init(&key);
+        btr_key_put_uint(&key, TEST_BULK_DUPLICATE_ID);
+        CM_RETURN_IF_ERROR(btr_bulk_add(bulk, key.data, key.len, TEST_BULK_KEY_COUNT));
+    }
+
+    return CM_SUCCESS;
+}
+
+bool32 test_bulk_build()
+{
+    bool32 ret = FALSE;
+    btr_bulk_t bulk;
+    btr_key_t key;
+    btr_pcur_t pcur;
+    uint32 count;
+
+    dict_index_t* index = bulk_create_index("TEST_BULK_IND", TEST_BULK_INDEX_ID, 0);
+    if (index == NULL) {
+        return FALSE;
+    }
+
+    if (btr_bulk_begin(&bulk, index) != CM_SUCCESS) {
+        printf("error: btr_bulk_begin\n");
+        return FALSE;
+    }
+    if (bulk_add_keys(&bulk, FALSE) != CM_SUCCESS || btr_bulk_finish(&bulk) != CM_SUCCESS) {
+        printf("error: bulk build\n");
+        goto err_exit;
+    }
+    if (bulk.height < 2) {
+        printf("build check: fail, height=%u\n", bulk.height);
+        goto err_exit;
+    }
+
+    // leaves are linked in order of key
+    count = 0;
+    btr_pcur_open_at_side(index, TRUE, &pcur);
+    while (btr_pcur_is_on_rec(&pcur)) {
+        btr_key_init(&key);
+        btr_key_put_uint(&key, count);
+        if (pcur.key_len != key.len || memcmp(pcur.key, key.data, key.len) != 0 || pcur.value != count) {
+            printf("scan check: fail, expected id=%u\n", count);
+            goto err_exit;
+        }
+        count++;
+        btr_pcur_move_to_next(&pcur);
+    }
+    if (count != TEST_BULK_KEY_COUNT) {
+        printf("scan check: fail, count=%u\n", count);
+        goto err_exit;
+    }
+
+    // the built tree takes dml
+    btr_key_init(&key);
+    btr_key_put_uint(&key, TEST_BULK_KEY_COUNT);
+    if (btr_insert(index, key.data, key.len, TEST_BULK_KEY_COUNT, NULL, NULL) != CM_SUCCESS) {
+        printf("insert error: id=%u\n", TEST_BULK_KEY_COUNT);
+        goto err_exit;
+    }
+    btr_pcur_open_at_side(index, FALSE, &pcur);
+    if (!btr_pcur_is_on_rec(&pcur) || pcur.value != TEST_BULK_KEY_COUNT) {
+        printf("insert check: fail, id=%u\n", TEST_BULK_KEY_COUNT);
+        goto err_exit;
+    }
+
+    ret = TRUE;
+
+err_exit:
+
+    btr_bulk_end(&bulk);
+
+    return ret;
+}
+
+// a duplicate of unique index fails the build, the pages allocated for it are freed
+// and the root is left empty
+bool32 test_bulk_build_duplicate()
+{
+    bool32 ret = FALSE;
+    btr_bulk_t bulk;
+    btr_pcur_t pcur;
+
+    dict_index_t* index = bulk_create_index("TEST_BULK_UNIQUE_IND", TEST_BULK_UNIQUE_INDEX_ID, DICT_UNIQUE);
+    if (index == NULL) {
+        return FALSE;
+    }
+
+    if (btr_bulk_begin(&bulk, index) != CM_SUCCESS) {
+        printf("error: btr_bulk_begin\n");
+        return FALSE;
+    }
+    if (bulk_add_keys(&bulk, TRUE) != CM_SUCCESS) {
+        printf("error: btr_bulk_add\n");
+        goto err_exit;
+    }
+    if (btr_bulk_finish(&bulk) == CM_SUCCESS) {
+        printf("duplicate check: fail, build is finished\n");
+        goto err_exit;
+    }
+    if (bulk.is_finished || bulk.page_count == 0) {
+        printf("duplicate check: fail, finished %u pages %u\n", bulk.is_finished, bulk.page_count);
+        goto err_exit;
+    }
+
+    ret = TRUE;
+
+err_exit:
+
+    btr_bulk_end(&bulk);
+
+    if (ret) {
+        btr_pcur_open_at_side(index, TRUE, &pcur);
+        if (btr_pcur_is_on_rec(&pcur)) {
+            printf("duplicate check: fail, root is not empty\n");
+            ret = FALSE;
+        }
+    }
+
+    return ret;
+}
+
+bool32 btree_bulk_main()
+{
+    bool32 ret = FALSE;
+
+    g_bulk_table = dict_mem_table_create("TEST_BULK", TEST_BULK_TABLE_ID,
+        DICT_SYS_USER_ID, FIL_SYSTEM_SPACE_ID, 1);
+    if (g_bulk_table == NULL) {
+        printf("error: cannot create table TEST_BULK\n");
+        goto err_exit;
+    }
+    dict_mem_table_add_col(g_bulk_table, "ID", DATA_BIGINT, 0, 8);
+
+    ret = test_bulk_build();
+    if (!ret) goto err_exit;
+
+    ret = test_bulk_build_duplicate();
+    if (!ret) goto err_exit;
+
+err_exit:
+
+    if (ret) {
+        printf("btree bulk: ok\n");
+    } else {
+        printf("btree bulk: fail\n");
+    }
+
+    return ret;
+}
@@ -0,0 +1,154 @@
+#include "cm_type.h"
+#include "cm_file.h"
+#include "cm_log.h"
+#include "knl_dblwrite.h"
+#include "knl_file_system.h"
+#include "knl_server.h"
+
+#define TEST_DBLWR_SLOT_COUNT      4
+#define TEST_DBLWR_PAGE_DISTANCE   64  // beyond the end of system space, no one writes it
+
+static char g_dblwr_file_name[CM_FILE_PATH_BUF_SIZE];
+
+// Builds an image of page_no in system space, header and trailer lsn differ if torn
+static void dblwr_build_page(byte* page, uint32 page_no, lsn_t lsn, bool32 is_torn)
+{
+    memset(page, (int)(lsn & 0xFF), UNIV_PAGE_SIZE);
+    mach_write_to_4(page + FIL_PAGE_SPACE, FIL_SYSTEM_SPACE_ID);
+    mach_write_to_4(page + FIL_PAGE_OFFSET, page_no);
+    mach_write_to_8(page + FIL_PAGE_LSN, lsn);
+    mach_write_to_8(page + UNIV_PAGE_SIZE - FIL_PAGE_END_LSN, is_torn ? lsn - 1 : lsn);
+}
+
+static bool32 dblwr_write_file(byte* slots)
+{
+    os_file_t handle;
+
+    if (!os_open_file(g_dblwr_file_name, OS_FILE_OVERWRITE, 0, &handle)) {
+        printf("error: cannot create file %s\n", g_dblwr_file_name);
+        return FALSE;
+    }
+    if (!os_pwrite_file(handle, 0, slots, TEST_DBLWR_SLOT_COUNT * UNIV_PAGE_SIZE) || !os_fsync_file(handle)) {
+        printf("error: cannot write file %s\n", g_dblwr_file_name);
+        os_close_file(handle);
+        return FALSE;
+    }
+    os_close_file(handle);
+
+    return TRUE;
+}
+
+static bool32 dblwr_read_data_page(uint32 page_no, byte* page)
+{
+    db_data_file_t* data_file = srv_ctrl_file->get_data_file_by_node_id(DB_SYSTEM_FILNODE_ID);
+    uint32 read_size = 0;
+    os_file_t handle;
+
+    if (!os_open_file(data_file->file_name, OS_FILE_OPEN, 0, &handle)) {
+        printf("error: cannot open file %s\n", data_file->file_name);
+        return FALSE;
+    }
+    memset(page, 0x00, UNIV_PAGE_SIZE);
+    if (!os_pread_file(handle, (uint64)page_no * UNIV_PAGE_SIZE, page, UNIV_PAGE_SIZE, &read_size)) {
+        printf("error: cannot read file %s\n", data_file->file_name);
+        os_close_file(handle);
+        return FALSE;
+    }
+    os_close_file(handle);
+
+    return TRUE;
+}
+
+// The data page is missing, the newest intact copy is restored,
+// the torn copy with a greater lsn and the older copy are skipped
+bool32 test_dblwr_restore_torn_page(uint32 page_no, byte* slots, byte* page)
+{
+    memset(slots, 0x00, TEST_DBLWR_SLOT_COUNT * UNIV_PAGE_SIZE);
+    dblwr_build_page(slots, page_no, 100, FALSE);
+    dblwr_build_page(slots + UNIV_PAGE_SIZE, page_no, 200, FALSE);
+    dblwr_build_page(slots + 2 * UNIV_PAGE_SIZE, page_no, 300, TRUE);
+    // slot 3 is never used
+
+    if (!dblwr_write_file(slots)) {
+        return FALSE;
+    }
+    if (buf_dblwr_restore_corrupt_pages(g_dblwr_file_name, TEST_DBLWR_SLOT_COUNT * UNIV_PAGE_SIZE) != CM_SUCCESS) {
+        printf("error: buf_dblwr_restore_corrupt_pages\n");
+        return FALSE;
+    }
+
+    if (!dblwr_read_data_page(page_no, page)) {
+        return FALSE;
+    }
+    if (memcmp(page, slots + UNIV_PAGE_SIZE, UNIV_PAGE_SIZE) != 0) {
+        printf("restore check: fail, page no %u lsn %llu\n", page_no, mach_read_from_8(page + FIL_PAGE_LSN));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// The data page is intact and newer than the copy, it is kept
+bool32 test_dblwr_keep_newer_page(uint32 page_no, byte* slots, byte* page)
+{
+    memset(slots, 0x00, TEST_DBLWR_SLOT_COUNT * UNIV_PAGE_SIZE);
+    dblwr_build_page(slots, page_no, 150, FALSE);
+
+    if (!dblwr_write_file(slots)) {
+        return FALSE;
+    }
+    if (buf_dblwr_restore_corrupt_pages(g_dblwr_file_name, TEST_DBLWR_SLOT_COUNT * UNIV_PAGE_SIZE) != CM_SUCCESS) {
+        printf("error: buf_dblwr_restore_corrupt_pages\n");
+        return FALSE;
+    }
+
+    if (!dblwr_read_data_page(page_no, page)) {
+        return FALSE;
+    }
+    if (mach_read_from_8(page + FIL_PAGE_LSN) != 200) {
+        printf("keep check: fail, page no %u lsn %llu\n", page_no, mach_read_from_8(page + FIL_PAGE_LSN));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+bool32 dblwrite_main()
+{
+    bool32 ret = FALSE;
+    uint32 page_no = fil_space_get_size(FIL_SYSTEM_SPACE_ID) + TEST_DBLWR_PAGE_DISTANCE;
+    byte* slots = (byte *)ut_malloc(TEST_DBLWR_SLOT_COUNT * UNIV_PAGE_SIZE);
+    byte* page = (byte *)ut_malloc(UNIV_PAGE_SIZE);
+
+    if (slots == NULL || page == NULL) {
+        printf("error: cannot malloc memory\n");
+        goto err_exit;
+    }
+
+    // not the doublewrite file of server, so that checkpoint does not overwrite the slots
+    sprintf_s(g_dblwr_file_name, CM_FILE_PATH_MAX_LEN, "%s%c%s", srv_data_home, SRV_PATH_SEPARATOR, "test_dbwr");
+
+    ret = test_dblwr_restore_torn_page(page_no, slots, page);
+    if (!ret) goto err_exit;
+
+    ret = test_dblwr_keep_newer_page(page_no, slots, page);
+    if (!ret) goto err_exit;
+
+err_exit:
+
+    os_del_file(g_dblwr_file_name);
+    if (slots) {
+        ut_free(slots);
+    }
+    if (page) {
+        ut_free(page);
+    }
+
+    if (ret) {
+        printf("doublewrite: ok\n");
+    } else {
+        printf("doublewrite: fail\n");
+    }
+
+    return ret;
+}
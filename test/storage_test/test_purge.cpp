@@ -0,0 +1,209 @@
+#include "cm_type.h"
+#include "cm_log.h"
+#include "knl_btree.h"
+#include "knl_dict.h"
+#include "knl_file_system.h"
+#include "knl_heap.h"
+#include "knl_mtr.h"
+#include "knl_record.h"
+#include "knl_server.h"
+#include "knl_session.h"
+#include "knl_trx.h"
+#include "knl_trx_purge.h"
+#include "knl_undo_fsm.h"
+
+#define TEST_PURGE_TABLE_ID        0xFFFF0003
+#define TEST_PURGE_INDEX_ID        0xFFFF0021
+#define TEST_PURGE_ROW_COUNT       200
+#define TEST_PURGE_VALUE_SIZE      20000  // a toast chain of several pages
+#define TEST_PURGE_WAIT_LOOPS      600    // 60 seconds
+
+static dict_table_t* g_purge_table = NULL;
+
+static dict_table_t* purge_create_table()
+{
+    const page_size_t page_size(FIL_SYSTEM_SPACE_ID);
+    dict_table_t* table;
+    dict_index_t* index;
+    mtr_t mtr;
+
+    table = dict_mem_table_create("TEST_PURGE", TEST_PURGE_TABLE_ID,
+        DICT_SYS_USER_ID, FIL_SYSTEM_SPACE_ID, 2);
+    if (table == NULL) {
+        return NULL;
+    }
+    dict_mem_table_add_col(table, "ID", DATA_BIGINT, 0, 8);
+    dict_mem_table_add_col(table, "DATA", DATA_BLOB, 0, TEST_PURGE_VALUE_SIZE);
+    table->columns[1]->is_ext = TRUE;
+
+    table->entry_page_no = heap_create_entry(FIL_SYSTEM_SPACE_ID);
+    if (table->entry_page_no == FIL_NULL) {
+        return NULL;
+    }
+
+    index = dict_mem_index_create(table, "TEST_PURGE_IND", TEST_PURGE_INDEX_ID,
+        FIL_SYSTEM_SPACE_ID, DICT_UNIQUE, 1);
+    if (index == NULL) {
+        return NULL;
+    }
+    dict_mem_index_add_field(index, "ID", 0);
+
+    mtr_start(&mtr);
+    index->entry_page_no = btr_create(DICT_UNIQUE, FIL_SYSTEM_SPACE_ID, page_size,
+        TEST_PURGE_INDEX_ID, index, NULL, &mtr);
+    mtr_commit(&mtr);
+    if (index->entry_page_no == FIL_NULL) {
+        return NULL;
+    }
+
+    return table;
+}
+
+static bool32 purge_insert_rows(que_sess_t* sess, byte* value)
+{
+    insert_node_t insert_node;
+
+    memset(&insert_node, 0x00, sizeof(insert_node_t));
+    insert_node.table = g_purge_table;
+
+    for (uint64 id = 0; id < TEST_PURGE_ROW_COUNT; id++) {
+        void* save_ptr = mcontext_stack_save(sess->mcontext_stack);
+
+        dtuple_t* tuple = dtuple_create(sess->mcontext_stack, 2);
+        dfield_set_data(dtuple_get_nth_field(tuple, 0), &id, 8);
+        dfield_set_data(dtuple_get_nth_field(tuple, 1), value, TEST_PURGE_VALUE_SIZE);
+        dfield_set_ext(dtuple_get_nth_field(tuple, 1));
+        insert_node.heap_row = tuple;
+
+        status_t err = heap_insert(sess, &insert_node);
+        mcontext_stack_restore(sess->mcontext_stack, save_ptr);
+        if (err != CM_SUCCESS) {
+            printf("insert error: id=%llu\n", id);
+            return FALSE;
+        }
+    }
+
+    trx_commit(sess, sess->trx);
+
+    return TRUE;
+}
+
+// rows are found by the index, the value of a record is the row of heap
+static bool32 purge_delete_rows(que_sess_t* sess)
+{
+    row_id_t row_ids[TEST_PURGE_ROW_COUNT];
+    btr_pcur_t pcur;
+    uint32 count = 0;
+
+    btr_pcur_open_at_side(UT_LIST_GET_FIRST(g_purge_table->indexes), TRUE, &pcur);
+    while (btr_pcur_is_on_rec(&pcur) && count < TEST_PURGE_ROW_COUNT) {
+        row_ids[count++].id = pcur.value;
+        btr_pcur_move_to_next(&pcur);
+    }
+    if (count != TEST_PURGE_ROW_COUNT) {
+        printf("index check: fail, count=%u\n", count);
+        return FALSE;
+    }
+
+    for (uint32 i = 0; i < count; i++) {
+        if (heap_delete(sess, g_purge_table, row_ids[i]) != CM_SUCCESS) {
+            printf("delete error: row=%llu\n", row_ids[i].id);
+            return FALSE;
+        }
+    }
+
+    trx_commit(sess, sess->trx);
+
+    return TRUE;
+}
+
+static uint32 purge_get_backlog()
+{
+    uint32 backlog = 0;
+
+    for (uint32 i = 0; i < trx_sys->undo_space_count; i++) {
+        backlog += undo_fsm_get_update_page_count(FIL_UNDO_START_SPACE_ID + i);
+    }
+
+    return backlog;
+}
+
+// The undo of committed deletes is purged in background, there is no snapshot to keep it
+bool32 test_purge_deleted_rows(que_sess_t* sess)
+{
+    bool32 ret = FALSE;
+    uint64 purged_pages = purge_sys->purged_pages;
+    uint32 backlog;
+    byte* value;
+
+    value = (byte *)ut_malloc(TEST_PURGE_VALUE_SIZE);
+    if (value == NULL) {
+        printf("error: cannot malloc memory\n");
+        return FALSE;
+    }
+    for (uint32 i = 0; i < TEST_PURGE_VALUE_SIZE; i++) {
+        value[i] = (byte)('a' + i % 26);
+    }
+
+    if (!purge_insert_rows(sess, value) || !purge_delete_rows(sess)) {
+        goto err_exit;
+    }
+
+    for (uint32 loop = 0; loop < TEST_PURGE_WAIT_LOOPS; loop++) {
+        backlog = purge_get_backlog();
+        if (backlog == 0 && purge_sys->purged_pages > purged_pages) {
+            ret = TRUE;
+            break;
+        }
+        os_thread_sleep(100000);
+    }
+    if (!ret) {
+        printf("purge check: fail, backlog %u purged pages %llu\n", backlog, purge_sys->purged_pages);
+    }
+
+err_exit:
+
+    ut_free(value);
+
+    return ret;
+}
+
+bool32 purge_main()
+{
+    bool32 ret = FALSE;
+    que_sess_t* sess = NULL;
+
+    if (srv_purge_threads == 0) {
+        printf("error: purge threads are not started\n");
+        goto err_exit;
+    }
+
+    g_purge_table = purge_create_table();
+    if (g_purge_table == NULL) {
+        printf("error: cannot create table TEST_PURGE\n");
+        goto err_exit;
+    }
+
+    sess = que_sess_alloc();
+    if (sess == NULL) {
+        printf("error: cannot alloc session\n");
+        goto err_exit;
+    }
+
+    ret = test_purge_deleted_rows(sess);
+    if (!ret) goto err_exit;
+
+err_exit:
+
+    if (sess) {
+        que_sess_free(sess);
+    }
+
+    if (ret) {
+        printf("purge: ok\n");
+    } else {
+        printf("purge: fail\n");
+    }
+
+    return ret;
+}
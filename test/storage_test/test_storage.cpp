@@ -0,0 +1,127 @@
+#include "cm_type.h"
+#include "cm_error.h"
+#include "cm_file.h"
+#include "cm_log.h"
+#include "cm_timer.h"
+#include "knl_ctrl_file.h"
+#include "knl_handler.h"
+#include "knl_session.h"
+#include "guc.h"
+
+// Storage tests run on a new database created in <base_dir>/data,
+// the base dir holds share/english/errmsg.txt and etc/server.ini as the server does.
+
+extern bool32 btree_main();
+extern bool32 btree_bulk_main();
+extern bool32 dblwrite_main();
+extern bool32 purge_main();
+
+#define TEST_STORAGE_FILE_COUNT    8
+
+static const char* g_storage_file_names[TEST_STORAGE_FILE_COUNT] = {
+    "ctrl1", "system.dbf", "systrans", "redo01", "redo02", "undo01", "dbwr", "temp01"
+};
+
+static void storage_get_file_name(char* data_dir, const char* name, char* file_name)
+{
+    sprintf_s(file_name, CM_FILE_PATH_MAX_LEN, "%s%c%s", data_dir, SRV_PATH_SEPARATOR, name);
+}
+
+static status_t create_storage_database(char* base_dir, attribute_t* attr)
+{
+    char data_dir[CM_FILE_PATH_BUF_SIZE];
+    char file_name[TEST_STORAGE_FILE_COUNT][CM_FILE_PATH_BUF_SIZE];
+
+    sprintf_s(data_dir, CM_FILE_PATH_MAX_LEN, "%s%c%s", base_dir, SRV_PATH_SEPARATOR, "data");
+    if (!os_file_create_directory(data_dir, FALSE)) {
+        printf("error: cannot create directory %s\n", data_dir);
+        return CM_ERROR;
+    }
+
+    // files of the last run are removed, so that the database is created again
+    for (uint32 i = 0; i < TEST_STORAGE_FILE_COUNT; i++) {
+        storage_get_file_name(data_dir, g_storage_file_names[i], file_name[i]);
+        os_del_file(file_name[i]);
+    }
+
+    db_ctrl_create_database("cosdb", "utf8mb4_bin");
+
+    db_ctrl_add_system_file(file_name[1], 1024 * 1024, 100 * 1024 * 1024, TRUE);
+    db_ctrl_add_systrans_file(file_name[2], 64);
+
+    db_ctrl_add_redo_file(file_name[3], 4 * 1024 * 1024);
+    db_ctrl_add_redo_file(file_name[4], 4 * 1024 * 1024);
+
+    db_ctrl_add_undo_file(file_name[5], 4 * 1024 * 1024, 64 * 1024 * 1024);
+
+    db_ctrl_add_dbwr_file(file_name[6], 4 * 1024 * 1024);
+
+    db_ctrl_add_temp_file(file_name[7], 4 * 1024 * 1024, 64 * 1024 * 1024);
+
+    return knl_server_init(base_dir, attr);
+}
+
+int main(int argc, char *argv[])
+{
+    bool32 ret = FALSE;
+    status_t err;
+    char* base_dir = argc > 1 ? argv[1] : (char *)".";
+    char log_path[CM_FILE_PATH_BUF_SIZE];
+    char err_file[CM_FILE_PATH_BUF_SIZE];
+    char config_file[CM_FILE_PATH_BUF_SIZE];
+    attribute_t attr = { 0 };
+
+    os_file_init();
+
+    sprintf_s(log_path, CM_FILE_PATH_MAX_LEN, "%s%c", base_dir, SRV_PATH_SEPARATOR);
+    LOGGER.init(LOG_LEVEL_CRITICAL, log_path, "storage_test");
+
+    sprintf_s(err_file, CM_FILE_PATH_MAX_LEN, "%s%cshare%cenglish%cerrmsg.txt",
+        base_dir, SRV_PATH_SEPARATOR, SRV_PATH_SEPARATOR, SRV_PATH_SEPARATOR);
+    if (!error_message_init(err_file)) {
+        printf("error: cannot init error messages from %s\n", err_file);
+        return 1;
+    }
+
+    sprintf_s(config_file, CM_FILE_PATH_MAX_LEN, "%s%cetc%cserver.ini", base_dir, SRV_PATH_SEPARATOR, SRV_PATH_SEPARATOR);
+    err = initialize_guc_options(config_file, &attr);
+    if (err != CM_SUCCESS) {
+        printf("error: cannot read config file %s\n", config_file);
+        return 1;
+    }
+
+    cm_start_timer(g_timer());
+
+    err = create_storage_database(base_dir, &attr);
+    if (err != CM_SUCCESS) {
+        printf("error: cannot create database in %s\n", base_dir);
+        return 1;
+    }
+
+    sess_pool_create(16, SIZE_M(1));
+
+    ret = btree_main();
+    if (!ret) goto err_exit;
+
+    ret = btree_bulk_main();
+    if (!ret) goto err_exit;
+
+    ret = dblwrite_main();
+    if (!ret) goto err_exit;
+
+    ret = purge_main();
+    if (!ret) goto err_exit;
+
+err_exit:
+
+    knl_server_end();
+    LOGGER.log_file_flush();
+
+    if (ret) {
+        printf("storage: ok\n");
+    } else {
+        printf("storage: fail\n");
+    }
+
+    return ret ? 0 : 1;
+}